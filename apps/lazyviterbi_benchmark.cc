@@ -0,0 +1,569 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Benchmark of the decoders, without GNU Radio scheduler (but for the decoders
+ * which only exist as blocks).
+ *
+ * For each .fsm file, block length K and Eb/N0, random inputs are encoded,
+ * BPSK modulated, sent through an AWGN channel and turned into euclidean
+ * branch metrics in-process; each decoder then decodes the same metrics.
+ * Results are written as CSV (default) or JSON, one record per decoder, fsm,
+ * K and Eb/N0.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <gnuradio/top_block.h>
+#include <gnuradio/blocks/vector_source.h>
+#include <gnuradio/blocks/vector_sink.h>
+#include <gnuradio/trellis/fsm.h>
+#include <lazyviterbi/compiled_trellis.h>
+#include <lazyviterbi/decoder.h>
+#include <lazyviterbi/viterbi_batch.h>
+#include <lazyviterbi/viterbi_butterfly.h>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using gr::lazyviterbi::compiled_trellis;
+using gr::lazyviterbi::decoder;
+using gr::lazyviterbi::viterbi_batch;
+using gr::lazyviterbi::viterbi_butterfly;
+
+namespace {
+
+  struct engine
+  {
+    const char *name;
+    //Decoder of the engine, or NULL if it only exists as a block
+    decoder::sptr (*make)(const compiled_trellis::sptr &trellis);
+    //Block decoding blocks of K sections (if make is NULL)
+    gr::block_sptr (*make_block)(const gr::trellis::fsm &FSM, int K);
+  };
+
+  //Blocks start in state 0, final state is unknown (as in
+  //examples/bitrate_vs_ebn0.py)
+  const engine ENGINES[] = {
+    {"viterbi", [](const compiled_trellis::sptr &t) {
+        return decoder::make_viterbi(t, 0, -1); }, NULL},
+    {"viterbi_volk_branch", [](const compiled_trellis::sptr &t) {
+        return decoder::make_viterbi_volk_branch(t, 0, -1); }, NULL},
+    {"viterbi_volk_state", [](const compiled_trellis::sptr &t) {
+        return decoder::make_viterbi_volk_state(t, 0, -1); }, NULL},
+    {"viterbi_volk_state_i16", [](const compiled_trellis::sptr &t) {
+        return decoder::make_viterbi_volk_state(t, 0, -1, 1, 16); }, NULL},
+    {"viterbi_volk_state_i8", [](const compiled_trellis::sptr &t) {
+        return decoder::make_viterbi_volk_state(t, 0, -1, 1, 8); }, NULL},
+    {"lazy_viterbi", [](const compiled_trellis::sptr &t) {
+        return decoder::make_lazy_viterbi(t, 0, -1); }, NULL},
+    {"lazy_viterbi_i16", [](const compiled_trellis::sptr &t) {
+        return decoder::make_lazy_viterbi(t, 0, -1, 1.0, 16); }, NULL},
+    {"viterbi_butterfly", NULL, [](const gr::trellis::fsm &FSM, int K) {
+        return (gr::block_sptr)viterbi_butterfly::make(FSM, K, 0, -1); }},
+    {"viterbi_batch", NULL, [](const gr::trellis::fsm &FSM, int K) {
+        return (gr::block_sptr)viterbi_batch::make(FSM, K, 0, -1); }},
+  };
+  const size_t N_ENGINES = sizeof(ENGINES)/sizeof(ENGINES[0]);
+
+  struct options
+  {
+    std::vector<std::string> fsm_files;
+    std::vector<int> K;
+    std::vector<std::string> engines;
+    float ebn0_start;
+    float ebn0_stop;
+    float ebn0_step;
+    long bits;
+    int repeat;
+    unsigned seed;
+    bool json;
+    std::string output;
+
+    options()
+      : ebn0_start(0), ebn0_stop(10), ebn0_step(1), bits(1 << 20), repeat(3),
+      seed(0), json(false) {}
+  };
+
+  struct result
+  {
+    std::string fsm;
+    std::string engine;
+    int K;
+    float ebn0;
+    long blocks;
+    double bits_per_s;
+    double ns_per_step;
+    double nodes_per_step;
+    long bit_errors;
+    size_t workspace_bytes;
+    long max_rss_kb;
+  };
+
+  void
+  usage(const char *name)
+  {
+    std::fprintf(stderr,
+        "Usage: %s [options] <file.fsm>...\n"
+        "  --format csv|json     Output format (default: csv)\n"
+        "  --output <file>       Output file (default: standard output)\n"
+        "  --ebn0 start:stop:step  Eb/N0 sweep in dB (default: 0:10:1)\n"
+        "  --K <K1,K2,...>       Block lengths (default: 1024,32768)\n"
+        "  --engines <e1,e2,...> Decoders to run (default: all)\n"
+        "  --bits <n>            Decoded bits per point (default: 1048576)\n"
+        "  --repeat <n>          Timed passes, the fastest is kept (default: 3)\n"
+        "  --seed <n>            Seed of inputs and noise (default: 0)\n"
+        "Decoders:", name);
+    for(size_t e=0 ; e < N_ENGINES ; ++e) {
+      std::fprintf(stderr, " %s", ENGINES[e].name);
+    }
+    std::fprintf(stderr, "\n");
+  }
+
+  std::vector<std::string>
+  split(const std::string &s, char sep)
+  {
+    std::vector<std::string> items;
+    size_t start = 0, end;
+
+    while((end = s.find(sep, start)) != std::string::npos) {
+      items.push_back(s.substr(start, end - start));
+      start = end + 1;
+    }
+    items.push_back(s.substr(start));
+
+    return items;
+  }
+
+  bool
+  parse_options(int argc, char **argv, options &opts)
+  {
+    std::vector<std::string> K_list = split("1024,32768", ',');
+
+    for(int a=1 ; a < argc ; ++a) {
+      std::string arg = argv[a];
+
+      if(arg.compare(0, 2, "--") != 0) {
+        opts.fsm_files.push_back(arg);
+        continue;
+      }
+      if(a + 1 == argc) {
+        return false;
+      }
+
+      std::string value = argv[++a];
+      if(arg == "--format") {
+        if(value != "csv" && value != "json") {
+          return false;
+        }
+        opts.json = (value == "json");
+      }
+      else if(arg == "--output") {
+        opts.output = value;
+      }
+      else if(arg == "--ebn0") {
+        std::vector<std::string> sweep = split(value, ':');
+        if(sweep.size() != 3) {
+          return false;
+        }
+        opts.ebn0_start = std::atof(sweep[0].c_str());
+        opts.ebn0_stop = std::atof(sweep[1].c_str());
+        opts.ebn0_step = std::atof(sweep[2].c_str());
+        if(opts.ebn0_step <= 0) {
+          return false;
+        }
+      }
+      else if(arg == "--K") {
+        K_list = split(value, ',');
+      }
+      else if(arg == "--engines") {
+        opts.engines = split(value, ',');
+      }
+      else if(arg == "--bits") {
+        opts.bits = std::atol(value.c_str());
+      }
+      else if(arg == "--repeat") {
+        opts.repeat = std::max(1, std::atoi(value.c_str()));
+      }
+      else if(arg == "--seed") {
+        opts.seed = (unsigned)std::strtoul(value.c_str(), NULL, 10);
+      }
+      else {
+        return false;
+      }
+    }
+
+    for(size_t k=0 ; k < K_list.size() ; ++k) {
+      int K = std::atoi(K_list[k].c_str());
+      if(K <= 0) {
+        return false;
+      }
+      opts.K.push_back(K);
+    }
+
+    for(size_t e=0 ; e < opts.engines.size() ; ++e) {
+      bool found = false;
+      for(size_t i=0 ; i < N_ENGINES ; ++i) {
+        found |= (opts.engines[e] == ENGINES[i].name);
+      }
+      if(!found) {
+        return false;
+      }
+    }
+
+    return !opts.fsm_files.empty() && opts.bits > 0;
+  }
+
+  //Peak resident memory of the process so far, in kB (-1 if unknown)
+  long
+  max_rss_kb()
+  {
+#ifndef _WIN32
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+      return usage.ru_maxrss / 1024;
+#else
+      return usage.ru_maxrss;
+#endif
+    }
+#endif
+    return -1;
+  }
+
+  /*
+   * Encode n_blocks blocks of K random inputs, each one from state 0, and
+   * compute the euclidean metrics of the noisy received symbols. Each output
+   * symbol is sent as ceil(log2(O)) BPSK symbols (most significant bit
+   * first).
+   */
+  void
+  make_metrics(const gr::trellis::fsm &FSM, int K, long n_blocks, float ebn0_db,
+      std::mt19937 &rng, std::vector<unsigned char> &inputs,
+      std::vector<float> &metrics)
+  {
+    const int I = FSM.I();
+    const int O = FSM.O();
+    const long n_sections = n_blocks * K;
+    int n_bits = 0;
+    while((1 << n_bits) < O) {
+      ++n_bits;
+    }
+
+    //Unit energy BPSK symbols, rate log2(I)/n_bits code
+    const double rate = std::log2((double)I) / std::max(n_bits, 1);
+    const double N0 = 1.0 / (rate * std::pow(10.0, ebn0_db / 10.0));
+    std::normal_distribution<float> noise(0.0, std::sqrt(N0 / 2.0));
+    std::uniform_int_distribution<int> input(0, I - 1);
+    std::vector<float> rx(n_bits);
+
+    inputs.resize(n_sections);
+    metrics.resize(n_sections * O);
+
+    int state = 0;
+    for(long k=0 ; k < n_sections ; ++k) {
+      int i = input(rng);
+
+      if(k % K == 0) {
+        state = 0;
+      }
+      int symbol = FSM.OS()[state*I + i];
+
+      inputs[k] = (unsigned char)i;
+      state = FSM.NS()[state*I + i];
+
+      for(int b=0 ; b < n_bits ; ++b) {
+        rx[b] = (((symbol >> (n_bits - 1 - b)) & 1) ? 1.0f : -1.0f)
+          + noise(rng);
+      }
+
+      for(int o=0 ; o < O ; ++o) {
+        float metric = 0.0;
+        for(int b=0 ; b < n_bits ; ++b) {
+          float d = rx[b] - (((o >> (n_bits - 1 - b)) & 1) ? 1.0f : -1.0f);
+          metric += d*d;
+        }
+        metrics[k*O + o] = metric;
+      }
+    }
+  }
+
+  /*
+   * Decode the blocks of metrics with a flowgraph made of a vector source,
+   * the block of the engine and a vector sink, and return the running time
+   * of the flowgraph in seconds.
+   */
+  double
+  run_flowgraph(const engine &e, const gr::trellis::fsm &FSM, int K,
+      const std::vector<float> &metrics, std::vector<unsigned char> &out)
+  {
+    typedef std::chrono::steady_clock clock;
+
+    gr::top_block_sptr tb = gr::make_top_block("lazyviterbi_benchmark");
+    gr::blocks::vector_source_f::sptr src
+      = gr::blocks::vector_source_f::make(metrics);
+    gr::blocks::vector_sink_b::sptr sink = gr::blocks::vector_sink_b::make();
+    gr::block_sptr dec = e.make_block(FSM, K);
+
+    tb->connect(src, 0, dec, 0);
+    tb->connect(dec, 0, sink, 0);
+
+    clock::time_point start = clock::now();
+    tb->run();
+    double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+    out = sink->data();
+    return elapsed;
+  }
+
+  result
+  run(const engine &e, const compiled_trellis::sptr &trellis, int K,
+      long n_blocks, int repeat, const std::vector<float> &metrics,
+      const std::vector<unsigned char> &inputs)
+  {
+    typedef std::chrono::steady_clock clock;
+
+    const int O = trellis->O();
+    std::vector<unsigned char> out(n_blocks * K);
+    double best = -1.0;
+    uint64_t nodes = 0;
+    result r;
+
+    if(e.make) {
+      decoder::sptr dec = e.make(trellis);
+      decoder::workspace_sptr ws = dec->make_workspace(K);
+
+      //Warm up caches and lazily built tables
+      dec->decode(&metrics[0], K, &out[0], *ws);
+
+      for(int p=0 ; p < repeat ; ++p) {
+        uint64_t nodes_before = ws->stats.nodes_expanded;
+        clock::time_point start = clock::now();
+
+        for(long n=0 ; n < n_blocks ; ++n) {
+          dec->decode(&metrics[n*K*O], K, &out[n*K], *ws);
+        }
+
+        double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+        if(best < 0 || elapsed < best) {
+          best = elapsed;
+        }
+        nodes = ws->stats.nodes_expanded - nodes_before;
+      }
+
+      r.workspace_bytes = dec->workspace_bytes(K);
+    }
+    else {
+      //Blocks are timed through a flowgraph running every block of the
+      //point, scheduler overhead included (and their buffers are not
+      //counted as workspace)
+      const gr::trellis::fsm FSM = trellis->fsm();
+
+      run_flowgraph(e, FSM, K, std::vector<float>(metrics.begin(),
+            metrics.begin() + K*O), out);
+
+      for(int p=0 ; p < repeat ; ++p) {
+        double elapsed = run_flowgraph(e, FSM, K, metrics, out);
+        if(best < 0 || elapsed < best) {
+          best = elapsed;
+        }
+      }
+      out.resize(n_blocks * K, 0xff);
+
+      r.workspace_bytes = 0;
+    }
+
+    const double n_steps = (double)n_blocks * K;
+
+    r.engine = e.name;
+    r.K = K;
+    r.blocks = n_blocks;
+    r.bits_per_s = n_steps * std::log2((double)trellis->I()) / best;
+    r.ns_per_step = best * 1e9 / n_steps;
+    r.nodes_per_step = nodes / n_steps;
+    r.bit_errors = 0;
+    for(size_t k=0 ; k < out.size() ; ++k) {
+      r.bit_errors += (out[k] != inputs[k]);
+    }
+    r.max_rss_kb = max_rss_kb();
+
+    return r;
+  }
+
+  std::string
+  json_string(const std::string &s)
+  {
+    std::string quoted = "\"";
+
+    for(size_t c=0 ; c < s.size() ; ++c) {
+      if(s[c] == '"' || s[c] == '\\') {
+        quoted += '\\';
+      }
+      quoted += s[c];
+    }
+
+    return quoted + "\"";
+  }
+
+  void
+  write_header(FILE *f, bool json)
+  {
+    if(json) {
+      std::fprintf(f, "[\n");
+    }
+    else {
+      std::fprintf(f, "fsm,engine,K,ebn0_db,blocks,bits_per_s,ns_per_step,"
+          "nodes_per_step,bit_errors,ber,workspace_bytes,max_rss_kb\n");
+    }
+  }
+
+  void
+  write_result(FILE *f, bool json, bool first, const result &r)
+  {
+    const double ber = (double)r.bit_errors / ((double)r.blocks * r.K);
+
+    if(json) {
+      std::fprintf(f, "%s  {\"fsm\": %s, \"engine\": %s, \"K\": %d, "
+          "\"ebn0_db\": %g, \"blocks\": %ld, \"bits_per_s\": %.6g, "
+          "\"ns_per_step\": %.6g, \"nodes_per_step\": %.6g, "
+          "\"bit_errors\": %ld, \"ber\": %.6g, \"workspace_bytes\": %lu, "
+          "\"max_rss_kb\": %ld}",
+          first ? "" : ",\n", json_string(r.fsm).c_str(),
+          json_string(r.engine).c_str(), r.K, r.ebn0, r.blocks, r.bits_per_s,
+          r.ns_per_step, r.nodes_per_step, r.bit_errors, ber,
+          (unsigned long)r.workspace_bytes, r.max_rss_kb);
+    }
+    else {
+      std::fprintf(f, "%s,%s,%d,%g,%ld,%.6g,%.6g,%.6g,%ld,%.6g,%lu,%ld\n",
+          r.fsm.c_str(), r.engine.c_str(), r.K, r.ebn0, r.blocks,
+          r.bits_per_s, r.ns_per_step, r.nodes_per_step, r.bit_errors, ber,
+          (unsigned long)r.workspace_bytes, r.max_rss_kb);
+    }
+    std::fflush(f);
+  }
+
+  void
+  write_footer(FILE *f, bool json)
+  {
+    if(json) {
+      std::fprintf(f, "\n]\n");
+    }
+  }
+
+} // namespace
+
+int
+main(int argc, char **argv)
+{
+  options opts;
+
+  if(!parse_options(argc, argv, opts)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  FILE *f = stdout;
+  if(!opts.output.empty()) {
+    f = std::fopen(opts.output.c_str(), "w");
+    if(!f) {
+      std::fprintf(stderr, "%s: cannot open %s\n", argv[0], opts.output.c_str());
+      return 1;
+    }
+  }
+
+  try {
+    bool first = true;
+    write_header(f, opts.json);
+
+    for(size_t file=0 ; file < opts.fsm_files.size() ; ++file) {
+      gr::trellis::fsm FSM(opts.fsm_files[file].c_str());
+      compiled_trellis::sptr trellis = compiled_trellis::get(FSM);
+
+      //Name of the code: base name of the file, without extension
+      std::string name = opts.fsm_files[file];
+      name = name.substr(name.find_last_of("/\\") + 1);
+      name = name.substr(0, name.rfind(".fsm"));
+
+      for(size_t k=0 ; k < opts.K.size() ; ++k) {
+        const int K = opts.K[k];
+        const long n_blocks = std::max(1L, opts.bits / K);
+
+        for(float ebn0=opts.ebn0_start ; ebn0 <= opts.ebn0_stop + 1e-3 ;
+            ebn0 += opts.ebn0_step) {
+          //Same inputs and noise for every decoder of this point
+          std::mt19937 rng(opts.seed);
+          std::vector<unsigned char> inputs;
+          std::vector<float> metrics;
+          make_metrics(FSM, K, n_blocks, ebn0, rng, inputs, metrics);
+
+          for(size_t e=0 ; e < N_ENGINES ; ++e) {
+            if(!opts.engines.empty() && std::find(opts.engines.begin(),
+                  opts.engines.end(), ENGINES[e].name) == opts.engines.end()) {
+              continue;
+            }
+
+            result r;
+            try {
+              r = run(ENGINES[e], trellis, K, n_blocks, opts.repeat, metrics,
+                  inputs);
+            }
+            catch(std::invalid_argument &error) {
+              //Trellises out of the scope of a decoder (e.g. without the
+              //butterfly structure for viterbi_butterfly)
+              std::fprintf(stderr, "%s: %s skipped for %s (%s)\n", argv[0],
+                  ENGINES[e].name, name.c_str(), error.what());
+              continue;
+            }
+            r.fsm = name;
+            r.ebn0 = ebn0;
+
+            write_result(f, opts.json, first, r);
+            first = false;
+          }
+        }
+      }
+    }
+
+    write_footer(f, opts.json);
+  }
+  catch(std::exception &e) {
+    std::fprintf(stderr, "%s: %s\n", argv[0], e.what());
+    if(f != stdout) {
+      std::fclose(f);
+    }
+    return 1;
+  }
+
+  if(f != stdout) {
+    std::fclose(f);
+  }
+
+  return 0;
+}
@@ -0,0 +1,55 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Convert a gr::trellis .fsm file into a precompiled trellis file, to be
+ * loaded by the make_from_file() factories of the decoders.
+ */
+
+#include <cstdio>
+#include <exception>
+#include <gnuradio/trellis/fsm.h>
+#include <lazyviterbi/compiled_trellis.h>
+
+int
+main(int argc, char **argv)
+{
+  if(argc != 3) {
+    std::fprintf(stderr, "Usage: %s <input.fsm> <output.trellis>\n", argv[0]);
+    return 1;
+  }
+
+  try {
+    gr::trellis::fsm FSM(argv[1]);
+    gr::lazyviterbi::compiled_trellis::sptr trellis
+      = gr::lazyviterbi::compiled_trellis::get(FSM);
+
+    trellis->save(argv[2]);
+
+    std::printf("%s: I=%d S=%d O=%d, %d branches per section\n", argv[2],
+        trellis->I(), trellis->S(), trellis->O(), trellis->n_branches());
+  }
+  catch(std::exception &e) {
+    std::fprintf(stderr, "%s: %s\n", argv[0], e.what());
+    return 1;
+  }
+
+  return 0;
+}
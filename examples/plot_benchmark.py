@@ -0,0 +1,52 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+#
+# Plot bitrate vs Eb/N0 from the CSV output of lazyviterbi_benchmark, one
+# figure per code and block length (as in examples/figures).
+#
+# Usage: lazyviterbi_benchmark fsm/*.fsm > bench.csv
+#        python plot_benchmark.py bench.csv [output_dir]
+
+import csv
+import os
+import sys
+from collections import defaultdict
+
+import matplotlib
+matplotlib.use('Agg')
+import matplotlib.pyplot as plt
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.stderr.write("Usage: %s <bench.csv> [output_dir]\n" % sys.argv[0])
+        return 1
+
+    out_dir = sys.argv[2] if len(sys.argv) > 2 else '.'
+
+    #curves[(fsm, K)][engine] = [(ebn0, bits_per_s), ...]
+    curves = defaultdict(lambda: defaultdict(list))
+    with open(sys.argv[1]) as f:
+        for row in csv.DictReader(f):
+            curves[(row['fsm'], int(row['K']))][row['engine']].append(
+                    (float(row['ebn0_db']), float(row['bits_per_s'])))
+
+    for (fsm, K), engines in sorted(curves.items()):
+        plt.figure()
+        for engine, points in sorted(engines.items()):
+            points.sort()
+            plt.plot([p[0] for p in points], [p[1] for p in points], '-+',
+                    label=engine)
+
+        plt.grid(which='both')
+        plt.title('%s, K=%d' % (fsm, K))
+        plt.ylabel('Bitrate (bps)')
+        plt.xlabel('Eb/N0 (dB)')
+        plt.legend()
+        plt.savefig(os.path.join(out_dir, '%s_%d_bitrate.png' % (fsm, K)))
+        plt.close()
+
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
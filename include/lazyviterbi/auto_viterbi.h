@@ -0,0 +1,165 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_AUTO_VITERBI_H
+#define INCLUDED_LAZYVITERBI_AUTO_VITERBI_H
+
+#include <lazyviterbi/api.h>
+#include <gnuradio/block.h>
+#include <gnuradio/trellis/fsm.h>
+#include <string>
+
+namespace gr {
+  namespace lazyviterbi {
+
+    /*!
+     * \brief A maximum likelihood decoder, using the fastest implementation
+     * for its trellis on this machine.
+     *
+     * When the block is made, the viterbi, viterbi_volk_branch,
+     * viterbi_volk_state and lazy_viterbi decoders decode blocks of synthetic
+     * metrics (random data sent through an AWGN channel at the expected
+     * Eb/N0), and the fastest of them decodes the blocks of the flowgraph.
+     * Metrics are not quantized with a fixed scale by the Lazy Viterbi
+     * algorithm: the scale is estimated for each block.
+     *
+     * The result is kept in a cache file, keyed by a hash of the trellis,
+     * the model of the processor, the block length and Eb/N0 (to the tenth
+     * of dB), so that the decoders are only timed once per machine.
+     *
+     * It takes euclidean metrics as an input and produces decoded sequences.
+     */
+    class LAZYVITERBI_API auto_viterbi : virtual public gr::block
+    {
+     public:
+      typedef boost::shared_ptr<auto_viterbi> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of lazyviterbi::auto_viterbi.
+       *
+       * To avoid accidental use of raw pointers, lazyviterbi::auto_viterbi's
+       * constructor is in a private implementation
+       * class. lazyviterbi::auto_viterbi::make is the public interface for
+       * creating new instances.
+       *
+       * \param FSM Trellis of the code.
+       * \param K Length of a block of data.
+       * \param S0 Initial state of the encoder (set to -1 if unknown).
+       * \param SK Final state of the encoder (set to -1 if unknown).
+       * \param ebn0 Expected Eb/N0 of the transmission, in dB.
+       * \param cache_file File keeping the results of the timings (empty for
+       * $XDG_CACHE_HOME/gr-lazyviterbi/autotune, or
+       * ~/.cache/gr-lazyviterbi/autotune). Set to "none" to time the
+       * decoders every time.
+       */
+      static sptr make(const gr::trellis::fsm &FSM, int K, int S0, int SK,
+          float ebn0=5.0, const std::string &cache_file="");
+
+      /*!
+       * \return The trellis used by the decoder.
+       */
+      virtual gr::trellis::fsm FSM() const  = 0;
+      /*!
+       * \return The data blocks length considered by the decoder.
+       */
+      virtual int K()  const = 0;
+      /*!
+       * \return The initial state of the encoder (as given to the decoder, -1
+       * if unspecified).
+       */
+      virtual int S0()  const = 0;
+      /*!
+       * \return The final state of the encoder (as given to the decoder, -1 if
+       * unspecified).
+       */
+      virtual int SK()  const = 0;
+      /*!
+       * \return The Eb/N0 the decoders were timed at, in dB.
+       */
+      virtual float ebn0()  const = 0;
+      /*!
+       * \return The name of the decoder in use: viterbi, viterbi_volk_branch,
+       * viterbi_volk_state or lazy_viterbi.
+       */
+      virtual std::string engine()  const = 0;
+      /*!
+       * \return True if the decoder was read from the cache file (false if
+       * the decoders were timed).
+       */
+      virtual bool cached()  const = 0;
+      /*!
+       * \return The number of threads of the decode pool shared by all decoders
+       * (0 if blocks are decoded by the GNU Radio thread of each decoder).
+       */
+      virtual int pool_size()  const = 0;
+      /*!
+       * \return Counters of the blocks decoded since the start of the
+       * flowgraph (or the last call of reset_stats()), as a dictionary (see
+       * lazy_viterbi::stats()).
+       */
+      virtual pmt::pmt_t stats() = 0;
+      /*!
+       * \return The period of the publication of stats() on the "stats"
+       * message port, in seconds (0 if they are not published).
+       */
+      virtual double stats_period()  const = 0;
+      /*!
+       * \return True if blocks whose hard decisions form a path of the
+       * trellis are output without running the algorithm (see
+       * set_fast_path()).
+       */
+      virtual bool fast_path()  const = 0;
+
+      /*!
+       * Gives the initial state of the encoder to the decoder (set to -1 if unknown).
+       */
+      virtual void set_S0(int S0) = 0;
+      /*!
+       * Gives the final state of the encoder to the decoder (set to -1 if unknown).
+       */
+      virtual void set_SK(int SK) = 0;
+      /*!
+       * Set the number of threads of the decode pool shared by all decoders of
+       * the process (0 to decode blocks in the GNU Radio thread of each
+       * decoder). Independent blocks and streams are then decoded in parallel.
+       */
+      virtual void set_pool_size(int n_threads) = 0;
+      /*!
+       * Reset the counters returned by stats().
+       */
+      virtual void reset_stats() = 0;
+      /*!
+       * Publish stats() on the "stats" message port every \p period seconds
+       * (0 to stop publishing them).
+       */
+      virtual void set_stats_period(double period) = 0;
+      /*!
+       * Output the hard decisions of a block when they form a path of the
+       * trellis (this path is then the maximum likelihood one), and only run
+       * the algorithm on the other blocks. At high SNR, most blocks are then
+       * decoded at the cost of a pass over their metrics.
+       */
+      virtual void set_fast_path(bool fast_path) = 0;
+    };
+
+  } // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_AUTO_VITERBI_H */
@@ -0,0 +1,152 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_COMPILED_TRELLIS_H
+#define INCLUDED_LAZYVITERBI_COMPILED_TRELLIS_H
+
+#include <lazyviterbi/api.h>
+#include <gnuradio/trellis/fsm.h>
+#include <boost/shared_ptr.hpp>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace gr {
+namespace lazyviterbi {
+
+  /*!
+   * \brief Immutable flat tables of a trellis, shared by every decoder of the
+   * same code.
+   * \ingroup lazyviterbi
+   *
+   * Branches are stored in compressed sparse row order of their destination
+   * state: branches yielding to state s are branches [offsets()[s],
+   * offsets()[s+1]), branch b coming from state PS()[b] with input PI()[b] and
+   * output symbol OS()[b]. Branch offsets()[s] + i is branch i of
+   * gr::trellis::fsm::PS()[s] (the index stored by traceback vectors).
+   *
+   * Instances are built once per distinct trellis (same I, S, O, NS and OS)
+   * by get() or load(), and cached process-wide as long as a decoder uses
+   * them.
+   *
+   * Tables can be saved to a binary file (see save()), which load() maps in
+   * memory as is: decoders of large trellises are then built without parsing
+   * a .fsm file, nor building a gr::trellis::fsm.
+   */
+  class LAZYVITERBI_API compiled_trellis
+  {
+   public:
+    typedef boost::shared_ptr<const compiled_trellis> sptr;
+
+    //! Tables of \p FSM (built if no decoder of the process uses them yet).
+    static sptr get(const gr::trellis::fsm &FSM);
+
+    /*!
+     * \brief Tables saved in file \p path by save() (mapped if no decoder of
+     * the process uses them yet).
+     *
+     * Throws std::runtime_error if the file cannot be read, and
+     * std::invalid_argument if it is not a valid trellis file.
+     */
+    static sptr load(const std::string &path);
+
+    /*!
+     * \brief Save the tables to file \p path, in the byte order of this
+     * machine.
+     *
+     * Throws std::runtime_error if the file cannot be written.
+     */
+    void save(const std::string &path) const;
+
+    ~compiled_trellis();
+
+    int I() const { return d_I; }
+    int S() const { return d_S; }
+    int O() const { return d_O; }
+
+    //! Largest number of branches yielding to a state.
+    int max_size_PS_s() const { return d_max_size_PS_s; }
+    //! True if every state has exactly I branches yielding to it.
+    bool is_regular() const { return d_is_regular; }
+    //! Number of branches of a section.
+    int n_branches() const { return d_n_branches; }
+
+    //! Index of the first branch yielding to state \p s (S+1 items).
+    const int *offsets() const { return d_offsets; }
+    //! Previous state of each branch.
+    const int *PS() const { return d_PS; }
+    //! Input of each branch.
+    const int *PI() const { return d_PI; }
+    //! Output symbol of each branch.
+    const int *OS() const { return d_OS; }
+
+    //! Previous state of branch i yielding to state s.
+    int PS(int s, int i) const { return d_PS[d_offsets[s] + i]; }
+    //! Input of branch i yielding to state s.
+    int PI(int s, int i) const { return d_PI[d_offsets[s] + i]; }
+
+    //! Next state from state s with input i: NS()[s*I + i] (as the fsm).
+    const int *NS() const { return d_NS; }
+    //! Output symbol from state s with input i: fsm_OS()[s*I + i].
+    const int *fsm_OS() const { return d_fsm_OS; }
+
+    //! Content hash of the trellis (cache key).
+    uint64_t hash() const { return d_hash; }
+
+    //! True if the trellis is the one given by I, S, O, NS and OS.
+    bool describes(int I, int S, int O, const std::vector<int> &NS,
+        const std::vector<int> &OS) const;
+
+    //! The trellis, as a gr::trellis::fsm (built by each call).
+    gr::trellis::fsm fsm() const;
+
+   private:
+    compiled_trellis();
+    compiled_trellis(const compiled_trellis &);
+    compiled_trellis &operator=(const compiled_trellis &);
+
+    static sptr share(const sptr &candidate);
+    void set_tables(const int *tables);
+    bool same_tables(const compiled_trellis &other) const;
+
+    int d_I, d_S, d_O;
+    int d_max_size_PS_s;
+    bool d_is_regular;
+    int d_n_branches;
+    uint64_t d_hash;
+
+    //Tables are stored in d_storage, or in a mapped file: offsets (S+1
+    //items), PS, PI, OS (n_branches items each), NS and fsm_OS (S*I items each)
+    std::vector<int> d_storage;
+    void *d_map;
+    size_t d_map_size;
+
+    const int *d_offsets;
+    const int *d_PS;
+    const int *d_PI;
+    const int *d_OS;
+    const int *d_NS;
+    const int *d_fsm_OS;
+  };
+
+} // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_COMPILED_TRELLIS_H */
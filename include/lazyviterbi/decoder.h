@@ -0,0 +1,270 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_DECODER_H
+#define INCLUDED_LAZYVITERBI_DECODER_H
+
+#include <lazyviterbi/api.h>
+#include <lazyviterbi/compiled_trellis.h>
+#include <boost/shared_ptr.hpp>
+#include <cstddef>
+#include <stdint.h>
+
+namespace gr {
+  namespace lazyviterbi {
+
+    /*!
+     * \brief A maximum likelihood decoder, independent of the GNU Radio
+     * scheduler.
+     * \ingroup lazyviterbi
+     *
+     * A decoder only holds read-only data (the tables of its trellis, and
+     * its parameters): scratch buffers of the algorithm are given to each
+     * call of decode(), as a workspace. Several threads can then decode
+     * blocks with the same decoder at the same time, as long as each of them
+     * uses its own workspace.
+     *
+     * The viterbi, viterbi_volk_branch, viterbi_volk_state and lazy_viterbi
+     * blocks are thin wrappers around these decoders.
+     *
+     * Branch metrics of a block of K sections are given as K*O floats (O
+     * being the number of output symbols of the trellis): metrics[k*O + o] is
+     * the euclidean metric of output symbol o at time index k.
+     */
+    class LAZYVITERBI_API decoder
+    {
+     public:
+      typedef boost::shared_ptr<decoder> sptr;
+
+      /*!
+       * \brief Counters of the blocks decoded with a workspace.
+       *
+       * They are updated by every decoding, at the cost of reading a clock
+       * twice per block. Counters of the search are only updated by the Lazy
+       * Viterbi algorithm.
+       */
+      struct counters
+      {
+        //! Number of bins of the latency histogram.
+        static const int LATENCY_BINS = 40;
+
+        //! Decoded blocks.
+        uint64_t blocks;
+        //! Decoded trellis sections.
+        uint64_t sections;
+        //! Total decoding time, in nanoseconds.
+        uint64_t decode_ns;
+        //! Real nodes expanded.
+        uint64_t nodes_expanded;
+        //! Shadow nodes pushed to the priority queue.
+        uint64_t shadow_pushes;
+        //! Shadow nodes popped whose real node was already expanded.
+        uint64_t stale_pops;
+        //! Buckets of the priority queue gone through to find shadow nodes.
+        uint64_t buckets_scanned;
+        //! Blocks decoded by the hard-decision fast path (see
+        //! set_fast_path()).
+        uint64_t fast_path_blocks;
+        //! Blocks decoded in [2^b, 2^(b+1)) ns, for each bin b (the last
+        //! bin also counts longer decodings).
+        uint64_t latency_hist[LATENCY_BINS];
+
+        counters() { clear(); }
+
+        void clear()
+        {
+          blocks = sections = decode_ns = 0;
+          nodes_expanded = shadow_pushes = stale_pops = buckets_scanned = 0;
+          fast_path_blocks = 0;
+          for(int b=0 ; b < LATENCY_BINS ; ++b) {
+            latency_hist[b] = 0;
+          }
+        }
+
+        //! Add the counters of another workspace.
+        void add(const counters &other)
+        {
+          blocks += other.blocks;
+          sections += other.sections;
+          decode_ns += other.decode_ns;
+          nodes_expanded += other.nodes_expanded;
+          shadow_pushes += other.shadow_pushes;
+          stale_pops += other.stale_pops;
+          buckets_scanned += other.buckets_scanned;
+          fast_path_blocks += other.fast_path_blocks;
+          for(int b=0 ; b < LATENCY_BINS ; ++b) {
+            latency_hist[b] += other.latency_hist[b];
+          }
+        }
+      };
+
+      /*!
+       * \brief Scratch buffers of a decoder, to be used by one thread at a
+       * time (see make_workspace()).
+       */
+      class LAZYVITERBI_API workspace
+      {
+       public:
+        virtual ~workspace() {}
+
+        //! Counters of the decodings using this workspace.
+        counters stats;
+      };
+      typedef boost::shared_ptr<workspace> workspace_sptr;
+
+      /*!
+       * \brief Backing of the scratch buffers of a workspace.
+       *
+       * Buffers of a workspace are carved from one aligned memory area. If
+       * it spans at least one huge page (2 MiB), it can be backed by huge
+       * pages, to save TLB misses in the traceback of long blocks:
+       * HUGE_PAGES_TRANSPARENT advises the kernel to use transparent huge
+       * pages, and HUGE_PAGES_EXPLICIT maps pages from the reserved huge page
+       * pool (falling back on transparent huge pages if it is empty).
+       */
+      enum huge_pages_t {
+        HUGE_PAGES_NEVER = 0,
+        HUGE_PAGES_TRANSPARENT = 1,
+        HUGE_PAGES_EXPLICIT = 2
+      };
+
+      virtual ~decoder() {}
+
+      /*!
+       * \brief Classical Viterbi algorithm (see lazyviterbi::viterbi).
+       *
+       * \param trellis Trellis of the code (see compiled_trellis::get() and
+       * compiled_trellis::load()).
+       * \param S0 Initial state of the encoder (set to -1 if unknown).
+       * \param SK Final state of the encoder (set to -1 if unknown).
+       */
+      static sptr make_viterbi(const compiled_trellis::sptr &trellis,
+          int S0=-1, int SK=-1);
+
+      /*!
+       * \brief Classical Viterbi algorithm, branches of each state being
+       * processed in parallel (see lazyviterbi::viterbi_volk_branch).
+       */
+      static sptr make_viterbi_volk_branch(const compiled_trellis::sptr &trellis,
+          int S0=-1, int SK=-1);
+
+      /*!
+       * \brief Classical Viterbi algorithm, states being processed in
+       * parallel (see lazyviterbi::viterbi_volk_state).
+       *
+       * \param acs_threads Number of threads sharing the states of each
+       * section (their team is used by one call of decode() at a time).
+       * \param metric_bits Size of path metrics: 32 (floats), 16 or 8.
+       */
+      static sptr make_viterbi_volk_state(const compiled_trellis::sptr &trellis,
+          int S0=-1, int SK=-1, int acs_threads=1, int metric_bits=32);
+
+      /*!
+       * \brief Lazy Viterbi algorithm (see lazyviterbi::lazy_viterbi).
+       *
+       * \param scale Factor applied to metrics before quantization (0 to
+       * estimate it for each block).
+       * \param metric_bits Size of quantized metrics: 8 or 16.
+       */
+      static sptr make_lazy_viterbi(const compiled_trellis::sptr &trellis,
+          int S0=-1, int SK=-1, float scale=1.0, int metric_bits=8);
+
+      //! Tables of the trellis of the decoder.
+      const compiled_trellis::sptr &trellis() const { return d_trellis; }
+      //! Initial state of the encoder used by decode() (-1 if unknown).
+      int S0() const { return d_S0; }
+      //! Final state of the encoder used by decode() (-1 if unknown).
+      int SK() const { return d_SK; }
+      //! True if the hard-decision fast path is enabled.
+      bool fast_path() const { return d_fast_path; }
+
+      /*!
+       * \brief Enable the hard-decision fast path (disabled by default).
+       *
+       * Before running its algorithm, the decoder then checks whether the
+       * output symbols of smallest metric of the block form a path of the
+       * trellis. If they do, this path is the maximum likelihood one, and it
+       * is the output: at high SNR, most blocks are decoded at the cost of a
+       * pass over their metrics. Otherwise, this pass is wasted.
+       *
+       * Not to be called while another thread decodes with this decoder.
+       */
+      void set_fast_path(bool fast_path) { d_fast_path = fast_path; }
+
+      /*!
+       * \brief New scratch buffers, for blocks of up to \p K sections.
+       *
+       * Buffers of a workspace grow on the first decoding of a longer block.
+       */
+      virtual workspace_sptr make_workspace(size_t K,
+          huge_pages_t huge_pages=HUGE_PAGES_TRANSPARENT) const = 0;
+
+      //! Size in bytes of the scratch buffers of a workspace for \p K sections.
+      virtual size_t workspace_bytes(size_t K) const = 0;
+
+      /*!
+       * \brief Decode a block of \p K sections.
+       *
+       * \param metrics Branch metrics of the block (K*O items).
+       * \param K Number of sections of the block.
+       * \param out Decoded inputs (K items).
+       * \param ws Scratch buffers, made by make_workspace() of this decoder.
+       * It must not be used by another thread during the call.
+       */
+      void decode(const float *metrics, size_t K, uint8_t *out,
+          workspace &ws) const
+      {
+        decode(metrics, K, d_S0, d_SK, out, ws);
+      }
+
+      /*!
+       * \brief Same as above, with the initial and final states of the
+       * encoder of this block.
+       */
+      virtual void decode(const float *metrics, size_t K, int S0, int SK,
+          uint8_t *out, workspace &ws) const = 0;
+
+     protected:
+      decoder(const compiled_trellis::sptr &trellis, int S0, int SK)
+        : d_trellis(trellis), d_S0(S0), d_SK(SK), d_fast_path(false) {}
+
+      /*!
+       * \brief Hard-decision fast path (see set_fast_path()), to be tried
+       * by the algorithms first.
+       *
+       * \return True if it decoded the block.
+       */
+      bool try_fast_path(const float *metrics, int K, int S0, int SK,
+          uint8_t *out, workspace &ws) const;
+
+      compiled_trellis::sptr d_trellis;
+      int d_S0;
+      int d_SK;
+      bool d_fast_path;
+
+     private:
+      decoder(const decoder &);
+      decoder &operator=(const decoder &);
+    };
+
+  } // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_DECODER_H */
@@ -49,6 +49,13 @@ namespace gr {
      *  Then, if \f$ Q > \text{threshold} \f$, then the Lazy Viterbi is chosen,
      *  otherwise the classical Viterbi algorithm is chosen.
      *
+     *  The best threshold depends on the code and on the machine. In adaptive
+     *  mode, the threshold is not used: the decoding time of both algorithms
+     *  is measured on the decoded blocks, for ranges of values of \f$ Q \f$,
+     *  and each block is decoded by the fastest algorithm for its value of
+     *  \f$ Q \f$. A few blocks are still decoded by the other algorithm, to
+     *  follow changes of the load of the machine, and the algorithm used for
+     *  a range of \f$ Q \f$ only changes once the other one is faster by 10%.
      */
     class LAZYVITERBI_API dynamic_viterbi : virtual public gr::block
     {
@@ -69,8 +76,11 @@ namespace gr {
        * \param SK Final state of the encoder (set to -1 if unknown).
        * \param thres Threshold for choosing the Lazy Viterbi algorithm over the
        * classical Viterbi algorithm.
+       * \param adaptive Choose the fastest algorithm from measured decoding
+       * times instead of the threshold.
        */
-      static sptr make(const gr::trellis::fsm &FSM, int K, int S0, int SK, float thres=15.0);
+      static sptr make(const gr::trellis::fsm &FSM, int K, int S0, int SK,
+          float thres=15.0, bool adaptive=false);
 
       /*!
        * \return The trellis used by the decoder.
@@ -98,6 +108,39 @@ namespace gr {
        * \return True if the Lazy Viterbi algorithm is currently used.
        */
       virtual bool is_lazy()  const = 0;
+      /*!
+       * \return True if the algorithm is chosen from measured decoding times.
+       */
+      virtual bool adaptive()  const = 0;
+      /*!
+       * \return The number of threads of the decode pool shared by all decoders
+       * (0 if blocks are decoded by the GNU Radio thread of each decoder).
+       */
+      virtual int pool_size()  const = 0;
+      /*!
+       * \return Counters of the blocks decoded since the start of the
+       * flowgraph (or the last call of reset_stats()), as a dictionary:
+       * blocks, sections, decode_ns (total decoding time), nodes_expanded,
+       * shadow_pushes, stale_pops and buckets_scanned (searches of the Lazy
+       * Viterbi algorithm), fast_path_blocks (see set_fast_path()), and
+       * latency_hist (number of blocks decoded in [2^b, 2^(b+1)) ns, for each
+       * b).
+       * Blocks decoded by each algorithm are counted by lazy_blocks and
+       * viterbi_blocks, and mean_ratio is the mean of the ratio Q compared
+       * to the threshold.
+       */
+      virtual pmt::pmt_t stats() = 0;
+      /*!
+       * \return The period of the publication of stats() on the "stats"
+       * message port, in seconds (0 if they are not published).
+       */
+      virtual double stats_period()  const = 0;
+      /*!
+       * \return True if blocks whose hard decisions form a path of the
+       * trellis are output without running the algorithm (see
+       * set_fast_path()).
+       */
+      virtual bool fast_path()  const = 0;
 
       /*!
        * Gives the initial state of the encoder to the decoder (set to -1 if unknown).
@@ -111,6 +154,33 @@ namespace gr {
        * Set the threshold value.
        */
       virtual void set_thres(float thres) = 0;
+      /*!
+       * Choose the algorithm from measured decoding times (or from the
+       * threshold, if false).
+       */
+      virtual void set_adaptive(bool adaptive) = 0;
+      /*!
+       * Set the number of threads of the decode pool shared by all decoders of
+       * the process (0 to decode blocks in the GNU Radio thread of each
+       * decoder). Independent blocks and streams are then decoded in parallel.
+       */
+      virtual void set_pool_size(int n_threads) = 0;
+      /*!
+       * Reset the counters returned by stats().
+       */
+      virtual void reset_stats() = 0;
+      /*!
+       * Publish stats() on the "stats" message port every \p period seconds
+       * (0 to stop publishing them).
+       */
+      virtual void set_stats_period(double period) = 0;
+      /*!
+       * Output the hard decisions of a block when they form a path of the
+       * trellis (this path is then the maximum likelihood one), and only run
+       * the algorithm on the other blocks. At high SNR, most blocks are then
+       * decoded at the cost of a pass over their metrics.
+       */
+      virtual void set_fast_path(bool fast_path) = 0;
     };
 
   } // namespace lazyviterbi
@@ -25,6 +25,7 @@
 #include <lazyviterbi/api.h>
 #include <gnuradio/block.h>
 #include <gnuradio/trellis/fsm.h>
+#include <string>
 
 namespace gr {
   namespace lazyviterbi {
@@ -46,7 +47,12 @@ namespace gr {
      * This implementation provides a significant speedup at moderate SNRs,
      * but is slower at low SNR.
      * Finally, it shows slightly worse performance than gr-trellis's Viterbi
-     * algorithm as it converts the metrics from float to 8-bit integers.
+     * algorithm as it converts the metrics from float to 8-bit (or 16-bit)
+     * integers. Metrics are multiplied by a scale factor before this
+     * conversion, and saturate at 255 (or 65535). The resolution of the
+     * quantized metrics is what lets the search prune paths effectively, so
+     * the scale should be chosen so that most metrics spread over the whole
+     * range. If unsure, let the decoder estimate it for each block.
      */
     class LAZYVITERBI_API lazy_viterbi : virtual public gr::block
     {
@@ -65,8 +71,26 @@ namespace gr {
        * \param K Length of a block of data.
        * \param S0 Initial state of the encoder (set to -1 if unknown).
        * \param SK Final state of the encoder (set to -1 if unknown).
+       * \param scale Scale factor applied to metrics before quantization (set
+       * to 0 to estimate it from the metrics of each block).
+       * \param metric_bits Size of quantized metrics, 8 or 16 bits (16-bit
+       * metrics suit wide dynamic ranges, but use more memory).
        */
-      static sptr make(const gr::trellis::fsm &FSM, int K, int S0, int SK);
+      static sptr make(const gr::trellis::fsm &FSM, int K, int S0, int SK,
+          float scale=1.0, int metric_bits=8);
+
+      /*!
+       * \brief Same as make(), the trellis being read from a file written by
+       * lazyviterbi_compile_trellis.
+       *
+       * The file is mapped in memory as is (and shared by every decoder of the
+       * process using the same trellis): large trellises are loaded without
+       * parsing a .fsm file, nor building a gr::trellis::fsm.
+       *
+       * \param trellis_file Path of the precompiled trellis.
+       */
+      static sptr make_from_file(const std::string &trellis_file, int K, int S0,
+          int SK, float scale=1.0, int metric_bits=8);
 
       /*!
        * \return The trellis used by the decoder.
@@ -86,6 +110,41 @@ namespace gr {
        * unspecified).
        */
       virtual int SK()  const = 0;
+      /*!
+       * \return The scale factor applied to metrics before quantization (0 if
+       * estimated from each block).
+       */
+      virtual float scale()  const = 0;
+      /*!
+       * \return The size of quantized metrics, in bits.
+       */
+      virtual int metric_bits()  const = 0;
+      /*!
+       * \return The number of threads of the decode pool shared by all decoders
+       * (0 if blocks are decoded by the GNU Radio thread of each decoder).
+       */
+      virtual int pool_size()  const = 0;
+      /*!
+       * \return Counters of the blocks decoded since the start of the
+       * flowgraph (or the last call of reset_stats()), as a dictionary:
+       * blocks, sections, decode_ns (total decoding time), nodes_expanded,
+       * shadow_pushes, stale_pops and buckets_scanned (searches of the Lazy
+       * Viterbi algorithm), fast_path_blocks (see set_fast_path()), and
+       * latency_hist (number of blocks decoded in [2^b, 2^(b+1)) ns, for each
+       * b).
+       */
+      virtual pmt::pmt_t stats() = 0;
+      /*!
+       * \return The period of the publication of stats() on the "stats"
+       * message port, in seconds (0 if they are not published).
+       */
+      virtual double stats_period()  const = 0;
+      /*!
+       * \return True if blocks whose hard decisions form a path of the
+       * trellis are output without running the algorithm (see
+       * set_fast_path()).
+       */
+      virtual bool fast_path()  const = 0;
 
       /*!
        * Gives the initial state of the encoder to the decoder (set to -1 if unknown).
@@ -95,6 +154,33 @@ namespace gr {
        * Gives the final state of the encoder to the decoder (set to -1 if unknown).
        */
       virtual void set_SK(int SK) = 0;
+      /*!
+       * Set the scale factor applied to metrics before quantization (0 to
+       * estimate it from the metrics of each block).
+       */
+      virtual void set_scale(float scale) = 0;
+      /*!
+       * Set the number of threads of the decode pool shared by all decoders of
+       * the process (0 to decode blocks in the GNU Radio thread of each
+       * decoder). Independent blocks and streams are then decoded in parallel.
+       */
+      virtual void set_pool_size(int n_threads) = 0;
+      /*!
+       * Reset the counters returned by stats().
+       */
+      virtual void reset_stats() = 0;
+      /*!
+       * Publish stats() on the "stats" message port every \p period seconds
+       * (0 to stop publishing them).
+       */
+      virtual void set_stats_period(double period) = 0;
+      /*!
+       * Output the hard decisions of a block when they form a path of the
+       * trellis (this path is then the maximum likelihood one), and only run
+       * the algorithm on the other blocks. At high SNR, most blocks are then
+       * decoded at the cost of a pass over their metrics.
+       */
+      virtual void set_fast_path(bool fast_path) = 0;
 
       /*!
        * \brief Process the input metrics.
@@ -110,6 +196,9 @@ namespace gr {
        * \f}
        * whith \f$ k \f$ the time index, \f$ O \f$ the number of output symbols and \f$ i \in [0:O-1] \f$.
        *
+       * Normalized metrics are then multiplied by the scale factor, rounded
+       * and saturated to the largest value of the output type.
+       *
        * \param *in Input branch metrics.
        * \param *metrics Processed branch metrics.
        * \param K Length of a block of data.
@@ -117,6 +206,11 @@ namespace gr {
        */
       virtual void lazy_viteri_metrics_norm(const float *in, uint8_t* metrics,
           int K, int O) = 0;
+      /*!
+       * \brief Process the input metrics (16-bit variant).
+       */
+      virtual void lazy_viteri_metrics_norm(const float *in, uint16_t* metrics,
+          int K, int O) = 0;
 
       /*!
        * \brief Actual Lazy Viterbi algorithm implementation
@@ -0,0 +1,146 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_LAZYVITERBI_LAZY_VITERBI_STREAM_H
+#define INCLUDED_LAZYVITERBI_LAZY_VITERBI_STREAM_H
+
+#include <lazyviterbi/api.h>
+#include <gnuradio/block.h>
+#include <gnuradio/trellis/fsm.h>
+
+namespace gr {
+  namespace lazyviterbi {
+
+    /*!
+     * \brief A maximum likelihood decoder for continuous streams.
+     *
+     * This block implements the Lazy Viterbi algorithm \cite Feldman2002 (see
+     * lazy_viterbi), but does not split the stream into independent blocks:
+     * the shortest path search goes on from one call of general_work to the
+     * next, so that there is no block-edge degradation.
+     *
+     * Each time the search reaches a new time index \f$ t \f$, the first node
+     * expanded at this time index is the end of the shortest path to
+     * \f$ t \f$. Decisions on time indexes older than \f$ t - D \f$ (\f$ D \f$
+     * being the decision depth), where the surviving paths are assumed to have
+     * merged, are then obtained by tracing back from this node. Tracebacks are
+     * grouped, so that decisions are output by chunks of at least \f$ D \f$
+     * symbols.
+     *
+     * Only the last few time indexes are stored, in a ring of nodes which is
+     * recycled as the search goes on.
+     *
+     * Metrics are quantized as in lazy_viterbi. When the scale factor is
+     * estimated, it is estimated once, from the metrics available at the
+     * first call of general_work, so that every section of the search is
+     * quantized in the same units. It is estimated again after the flowgraph
+     * is restarted.
+     *
+     * This block has a latency of a few \f$ D \f$ symbols, and handles a single
+     * stream.
+     */
+    class LAZYVITERBI_API lazy_viterbi_stream : virtual public gr::block
+    {
+     public:
+      typedef boost::shared_ptr<lazy_viterbi_stream> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of lazyviterbi::lazy_viterbi_stream.
+       *
+       * To avoid accidental use of raw pointers, lazyviterbi::lazy_viterbi_stream's
+       * constructor is in a private implementation
+       * class. lazyviterbi::lazy_viterbi_stream::make is the public interface for
+       * creating new instances.
+       *
+       * \param FSM Trellis of the code.
+       * \param D Decision depth (5 times the memory of the code is usually
+       * enough).
+       * \param S0 Initial state of the encoder (set to -1 if unknown).
+       * \param scale Scale factor applied to metrics before quantization (set
+       * to 0 to estimate it from the metrics).
+       * \param metric_bits Size of quantized metrics, 8 or 16 bits.
+       */
+      static sptr make(const gr::trellis::fsm &FSM, int D, int S0,
+          float scale=1.0, int metric_bits=8);
+
+      /*!
+       * \return The trellis used by the decoder.
+       */
+      virtual gr::trellis::fsm FSM() const  = 0;
+      /*!
+       * \return The decision depth.
+       */
+      virtual int D()  const = 0;
+      /*!
+       * \return The initial state of the encoder (as given to the decoder, -1
+       * if unspecified).
+       */
+      virtual int S0()  const = 0;
+      /*!
+       * \return The scale factor applied to metrics before quantization (0 if
+       * estimated from the metrics).
+       */
+      virtual float scale()  const = 0;
+      /*!
+       * \return The size of quantized metrics, in bits.
+       */
+      virtual int metric_bits()  const = 0;
+      /*!
+       * \return Counters of the search since the start of the block (or the
+       * last call of reset_stats()), as a dictionary with the keys of
+       * lazy_viterbi::stats(). A block is a call of general_work: blocks
+       * counts those calls, sections the time indexes of metrics consumed,
+       * and decode_ns and latency_hist their durations.
+       */
+      virtual pmt::pmt_t stats() = 0;
+      /*!
+       * \return The period of the publication of stats() on the "stats"
+       * message port, in seconds (0 if they are not published).
+       */
+      virtual double stats_period()  const = 0;
+
+      /*!
+       * Set the scale factor applied to metrics before quantization (0 to
+       * estimate it from the metrics).
+       */
+      virtual void set_scale(float scale) = 0;
+      /*!
+       * Reset the counters returned by stats().
+       */
+      virtual void reset_stats() = 0;
+      /*!
+       * Publish stats() on the "stats" message port every \p period seconds
+       * (0 to stop publishing them).
+       */
+      virtual void set_stats_period(double period) = 0;
+
+      /*!
+       * \return The number of shadow nodes in the priority queue of the
+       * search. Those which fall behind the decision depth are dropped at each
+       * traceback, so that it stays bounded on an endless stream.
+       */
+      virtual size_t queued_nodes() = 0;
+    };
+
+  } // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_LAZY_VITERBI_STREAM_H */
@@ -26,6 +26,7 @@
 #include <lazyviterbi/api.h>
 #include <gnuradio/block.h>
 #include <gnuradio/trellis/fsm.h>
+#include <string>
 
 namespace gr {
   namespace lazyviterbi {
@@ -58,6 +59,19 @@ namespace gr {
        */
       static sptr make(const gr::trellis::fsm &FSM, int K, int S0, int SK);
 
+      /*!
+       * \brief Same as make(), the trellis being read from a file written by
+       * lazyviterbi_compile_trellis.
+       *
+       * The file is mapped in memory as is (and shared by every decoder of the
+       * process using the same trellis): large trellises are loaded without
+       * parsing a .fsm file, nor building a gr::trellis::fsm.
+       *
+       * \param trellis_file Path of the precompiled trellis.
+       */
+      static sptr make_from_file(const std::string &trellis_file, int K, int S0,
+          int SK);
+
       /*!
        * \return The trellis used by the decoder.
        */
@@ -76,6 +90,32 @@ namespace gr {
        * unspecified).
        */
       virtual int SK()  const = 0;
+      /*!
+       * \return The number of threads of the decode pool shared by all decoders
+       * (0 if blocks are decoded by the GNU Radio thread of each decoder).
+       */
+      virtual int pool_size()  const = 0;
+      /*!
+       * \return Counters of the blocks decoded since the start of the
+       * flowgraph (or the last call of reset_stats()), as a dictionary:
+       * blocks, sections, decode_ns (total decoding time), nodes_expanded,
+       * shadow_pushes, stale_pops and buckets_scanned (searches of the Lazy
+       * Viterbi algorithm), fast_path_blocks (see set_fast_path()), and
+       * latency_hist (number of blocks decoded in [2^b, 2^(b+1)) ns, for each
+       * b).
+       */
+      virtual pmt::pmt_t stats() = 0;
+      /*!
+       * \return The period of the publication of stats() on the "stats"
+       * message port, in seconds (0 if they are not published).
+       */
+      virtual double stats_period()  const = 0;
+      /*!
+       * \return True if blocks whose hard decisions form a path of the
+       * trellis are output without running the algorithm (see
+       * set_fast_path()).
+       */
+      virtual bool fast_path()  const = 0;
 
       /*!
        * Gives the initial state of the encoder to the decoder (set to -1 if unknown).
@@ -85,6 +125,28 @@ namespace gr {
        * Gives the final state of the encoder to the decoder (set to -1 if unknown).
        */
       virtual void set_SK(int SK) = 0;
+      /*!
+       * Set the number of threads of the decode pool shared by all decoders of
+       * the process (0 to decode blocks in the GNU Radio thread of each
+       * decoder). Independent blocks and streams are then decoded in parallel.
+       */
+      virtual void set_pool_size(int n_threads) = 0;
+      /*!
+       * Reset the counters returned by stats().
+       */
+      virtual void reset_stats() = 0;
+      /*!
+       * Publish stats() on the "stats" message port every \p period seconds
+       * (0 to stop publishing them).
+       */
+      virtual void set_stats_period(double period) = 0;
+      /*!
+       * Output the hard decisions of a block when they form a path of the
+       * trellis (this path is then the maximum likelihood one), and only run
+       * the algorithm on the other blocks. At high SNR, most blocks are then
+       * decoded at the cost of a pass over their metrics.
+       */
+      virtual void set_fast_path(bool fast_path) = 0;
 
       /*!
        * \brief Actual Viterbi algorithm implementation
@@ -96,8 +158,10 @@ namespace gr {
        * and its input symbol i : NS[s*I+i]=ns.
        * \param OS Gives the output symbol os of a branch defined by its initial state s
        * and its input symbol i : OS[s*I+i]=os.
-       * \param PS Such that PS[s] contains all the previous states having a branch with state s.
-       * \param PI Such that PI[s] contains all the inputs yielding to state s.
+       * \param PS Such that PS[s] contains all the previous states having a branch with state s
+       * (unused, kept for API compatibility).
+       * \param PI Such that PI[s] contains all the inputs yielding to state s
+       * (unused, kept for API compatibility).
        * \param K Length of a block of data.
        * \param S0 Initial state of the encoder (set to -1 if unknown).
        * \param SK Final state of the encoder (set to -1 if unknown).
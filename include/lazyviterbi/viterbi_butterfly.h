@@ -0,0 +1,124 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_VITERBI_BUTTERFLY_H
+#define INCLUDED_LAZYVITERBI_VITERBI_BUTTERFLY_H
+
+#include <lazyviterbi/api.h>
+#include <gnuradio/block.h>
+#include <gnuradio/trellis/fsm.h>
+#include <string>
+
+namespace gr {
+  namespace lazyviterbi {
+
+    /*!
+     * \brief A maximum likelihood decoder for shift-register convolutional
+     * codes.
+     *
+     * This block implements the classical Viterbi algorithm \cite Forney1973,
+     * for trellises of rate 1/n codes (binary input, S = 2^m states) in which
+     * the state is a shift register: states j and j + S/2 are then the
+     * predecessors of states 2j and 2j + 1 (up to a bit reversal of state
+     * indexes). Feedforward and recursive codes, such as those built by
+     * gr::trellis::fsm from generator polynomials (e.g.
+     * trellis.fsm(1, 2, [0o171, 0o133])), have this structure, which is
+     * detected at construction.
+     *
+     * Add-compare-select operations are run by pairs of states (butterflies),
+     * many butterflies at a time in SIMD registers: path metrics are 16-bit
+     * integers with modulo arithmetic, branch metrics are quantized on 8 bits
+     * once per block (with a scale estimated from the block) and looked up
+     * with in-register shuffles, and decisions are packed as bits.
+     *
+     * It takes euclidean metrics as an input and produces decoded sequences.
+     */
+    class LAZYVITERBI_API viterbi_butterfly : virtual public gr::block
+    {
+     public:
+      typedef boost::shared_ptr<viterbi_butterfly> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of lazyviterbi::viterbi_butterfly.
+       *
+       * To avoid accidental use of raw pointers, lazyviterbi::viterbi_butterfly's
+       * constructor is in a private implementation
+       * class. lazyviterbi::viterbi_butterfly::make is the public interface for
+       * creating new instances.
+       *
+       * Throws std::invalid_argument if the trellis is not a shift-register
+       * trellis.
+       *
+       * \param FSM Trellis of the code.
+       * \param K Length of a block of data.
+       * \param S0 Initial state of the encoder (set to -1 if unknown).
+       * \param SK Final state of the encoder (set to -1 if unknown).
+       */
+      static sptr make(const gr::trellis::fsm &FSM, int K, int S0, int SK);
+
+      /*!
+       * \return The trellis used by the decoder.
+       */
+      virtual gr::trellis::fsm FSM() const  = 0;
+      /*!
+       * \return The data blocks length considered by the decoder.
+       */
+      virtual int K()  const = 0;
+      /*!
+       * \return The initial state of the encoder (as given to the decoder, -1
+       * if unspecified).
+       */
+      virtual int S0()  const = 0;
+      /*!
+       * \return The final state of the encoder (as given to the decoder, -1 if
+       * unspecified).
+       */
+      virtual int SK()  const = 0;
+      /*!
+       * \return The name of the add-compare-select implementation in use
+       * ("avx2", "ssse3" or "generic").
+       */
+      virtual std::string kernel()  const = 0;
+      /*!
+       * \return The number of threads of the decode pool shared by all decoders
+       * (0 if blocks are decoded by the GNU Radio thread of each decoder).
+       */
+      virtual int pool_size()  const = 0;
+
+      /*!
+       * Gives the initial state of the encoder to the decoder (set to -1 if unknown).
+       */
+      virtual void set_S0(int S0) = 0;
+      /*!
+       * Gives the final state of the encoder to the decoder (set to -1 if unknown).
+       */
+      virtual void set_SK(int SK) = 0;
+      /*!
+       * Set the number of threads of the decode pool shared by all decoders of
+       * the process (0 to decode blocks in the GNU Radio thread of each
+       * decoder). Independent blocks and streams are then decoded in parallel.
+       */
+      virtual void set_pool_size(int n_threads) = 0;
+    };
+
+  } // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_VITERBI_BUTTERFLY_H */
@@ -0,0 +1,332 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "acs_kernels.h"
+
+//SIMD implementations are compiled with function-level target attributes, so
+//that the library itself does not require any particular instruction set.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define LV_HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace gr {
+namespace lazyviterbi {
+
+  namespace {
+
+    //***GENERIC***//
+    size_t
+    acs_select_generic(const float *can_metrics, size_t stride, int n_branches,
+        float *alpha_curr, uint16_t *decisions, size_t n)
+    {
+      size_t best = 0;
+
+      for(size_t s=0 ; s < n ; ++s) {
+        float metric = can_metrics[s];
+        uint16_t d = 0;
+
+        for(int i=1 ; i < n_branches ; ++i) {
+          float can_metric = can_metrics[i*stride + s];
+          d = (can_metric >= metric) ? i : d;
+          metric = (metric > can_metric) ? metric : can_metric;
+        }
+
+        alpha_curr[s] = metric;
+        decisions[s] = d;
+
+        if(metric > alpha_curr[best]) {
+          best = s;
+        }
+      }
+
+      return best;
+    }
+
+    bool
+    generic_is_supported()
+    {
+      return true;
+    }
+
+    //Index of the largest metric among the lanes of the SIMD loops (the
+    //smallest index in case of a tie), merged with the generic tail
+    size_t
+    merge_best(const float *lane_max, const int32_t *lane_idx, int n_lanes,
+        const float *alpha_curr, size_t tail_begin, size_t tail_best,
+        size_t n)
+    {
+      size_t best = lane_idx[0];
+      float best_metric = lane_max[0];
+
+      for(int l=1 ; l < n_lanes ; ++l) {
+        if(lane_max[l] > best_metric
+            || (lane_max[l] == best_metric && (size_t)lane_idx[l] < best)) {
+          best = lane_idx[l];
+          best_metric = lane_max[l];
+        }
+      }
+
+      if(tail_begin < n && alpha_curr[tail_begin + tail_best] > best_metric) {
+        best = tail_begin + tail_best;
+      }
+
+      return best;
+    }
+
+#ifdef LV_HAVE_X86_KERNELS
+    //***SSE4.1***//
+    __attribute__((target("sse4.1"))) size_t
+    acs_select_sse4_1(const float *can_metrics, size_t stride, int n_branches,
+        float *alpha_curr, uint16_t *decisions, size_t n)
+    {
+      size_t s = 0;
+      __m128 v_best = _mm_set1_ps(-__builtin_inff());
+      __m128i v_best_idx = _mm_setzero_si128();
+      __m128i v_idx = _mm_setr_epi32(0, 1, 2, 3);
+
+      for( ; s + 8 <= n ; s += 8) {
+        __m128 m0 = _mm_loadu_ps(can_metrics + s);
+        __m128 m1 = _mm_loadu_ps(can_metrics + s + 4);
+        __m128i d0 = _mm_setzero_si128();
+        __m128i d1 = _mm_setzero_si128();
+
+        for(int i=1 ; i < n_branches ; ++i) {
+          __m128i v_i = _mm_set1_epi32(i);
+          __m128 c0 = _mm_loadu_ps(can_metrics + i*stride + s);
+          __m128 c1 = _mm_loadu_ps(can_metrics + i*stride + s + 4);
+
+          d0 = _mm_blendv_epi8(d0, v_i, _mm_castps_si128(_mm_cmpge_ps(c0, m0)));
+          d1 = _mm_blendv_epi8(d1, v_i, _mm_castps_si128(_mm_cmpge_ps(c1, m1)));
+          m0 = _mm_max_ps(m0, c0);
+          m1 = _mm_max_ps(m1, c1);
+        }
+
+        _mm_storeu_ps(alpha_curr + s, m0);
+        _mm_storeu_ps(alpha_curr + s + 4, m1);
+        _mm_storeu_si128((__m128i*)(decisions + s), _mm_packus_epi32(d0, d1));
+
+        //Largest metric of each lane
+        __m128 gt = _mm_cmpgt_ps(m0, v_best);
+        v_best = _mm_blendv_ps(v_best, m0, gt);
+        v_best_idx = _mm_blendv_epi8(v_best_idx, v_idx, _mm_castps_si128(gt));
+        v_idx = _mm_add_epi32(v_idx, _mm_set1_epi32(4));
+
+        gt = _mm_cmpgt_ps(m1, v_best);
+        v_best = _mm_blendv_ps(v_best, m1, gt);
+        v_best_idx = _mm_blendv_epi8(v_best_idx, v_idx, _mm_castps_si128(gt));
+        v_idx = _mm_add_epi32(v_idx, _mm_set1_epi32(4));
+      }
+
+      size_t tail_best = acs_select_generic(can_metrics + s, stride, n_branches,
+          alpha_curr + s, decisions + s, n - s);
+      if(s == 0) {
+        return tail_best;
+      }
+
+      float lane_max[4];
+      int32_t lane_idx[4];
+      _mm_storeu_ps(lane_max, v_best);
+      _mm_storeu_si128((__m128i*)lane_idx, v_best_idx);
+
+      return merge_best(lane_max, lane_idx, 4, alpha_curr, s, tail_best, n);
+    }
+
+    bool
+    sse4_1_is_supported()
+    {
+      return __builtin_cpu_supports("sse4.1");
+    }
+
+    //***AVX2***//
+    __attribute__((target("avx2"))) size_t
+    acs_select_avx2(const float *can_metrics, size_t stride, int n_branches,
+        float *alpha_curr, uint16_t *decisions, size_t n)
+    {
+      size_t s = 0;
+      __m256 v_best = _mm256_set1_ps(-__builtin_inff());
+      __m256i v_best_idx = _mm256_setzero_si256();
+      __m256i v_idx = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+      for( ; s + 8 <= n ; s += 8) {
+        __m256 m = _mm256_loadu_ps(can_metrics + s);
+        __m256i d = _mm256_setzero_si256();
+
+        for(int i=1 ; i < n_branches ; ++i) {
+          __m256 c = _mm256_loadu_ps(can_metrics + i*stride + s);
+
+          d = _mm256_blendv_epi8(d, _mm256_set1_epi32(i),
+              _mm256_castps_si256(_mm256_cmp_ps(c, m, _CMP_GE_OQ)));
+          m = _mm256_max_ps(m, c);
+        }
+
+        _mm256_storeu_ps(alpha_curr + s, m);
+        _mm_storeu_si128((__m128i*)(decisions + s),
+            _mm_packus_epi32(_mm256_castsi256_si128(d),
+              _mm256_extracti128_si256(d, 1)));
+
+        //Largest metric of each lane
+        __m256 gt = _mm256_cmp_ps(m, v_best, _CMP_GT_OQ);
+        v_best = _mm256_blendv_ps(v_best, m, gt);
+        v_best_idx = _mm256_blendv_epi8(v_best_idx, v_idx, _mm256_castps_si256(gt));
+        v_idx = _mm256_add_epi32(v_idx, _mm256_set1_epi32(8));
+      }
+
+      size_t tail_best = acs_select_generic(can_metrics + s, stride, n_branches,
+          alpha_curr + s, decisions + s, n - s);
+      if(s == 0) {
+        return tail_best;
+      }
+
+      float lane_max[8];
+      int32_t lane_idx[8];
+      _mm256_storeu_ps(lane_max, v_best);
+      _mm256_storeu_si256((__m256i*)lane_idx, v_best_idx);
+
+      return merge_best(lane_max, lane_idx, 8, alpha_curr, s, tail_best, n);
+    }
+
+    bool
+    avx2_is_supported()
+    {
+      return __builtin_cpu_supports("avx2");
+    }
+
+    //***AVX512F***//
+    __attribute__((target("avx512f"))) size_t
+    acs_select_avx512f(const float *can_metrics, size_t stride, int n_branches,
+        float *alpha_curr, uint16_t *decisions, size_t n)
+    {
+      size_t s = 0;
+      __m512 v_best = _mm512_set1_ps(-__builtin_inff());
+      __m512i v_best_idx = _mm512_setzero_si512();
+      __m512i v_idx = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+          12, 13, 14, 15);
+
+      for( ; s + 16 <= n ; s += 16) {
+        __m512 m = _mm512_loadu_ps(can_metrics + s);
+        __m512i d = _mm512_setzero_si512();
+
+        for(int i=1 ; i < n_branches ; ++i) {
+          __m512 c = _mm512_loadu_ps(can_metrics + i*stride + s);
+
+          d = _mm512_mask_mov_epi32(d, _mm512_cmp_ps_mask(c, m, _CMP_GE_OQ),
+              _mm512_set1_epi32(i));
+          m = _mm512_max_ps(m, c);
+        }
+
+        _mm512_storeu_ps(alpha_curr + s, m);
+        _mm256_storeu_si256((__m256i*)(decisions + s), _mm512_cvtepi32_epi16(d));
+
+        //Largest metric of each lane
+        __mmask16 gt = _mm512_cmp_ps_mask(m, v_best, _CMP_GT_OQ);
+        v_best = _mm512_mask_mov_ps(v_best, gt, m);
+        v_best_idx = _mm512_mask_mov_epi32(v_best_idx, gt, v_idx);
+        v_idx = _mm512_add_epi32(v_idx, _mm512_set1_epi32(16));
+      }
+
+      size_t tail_best = acs_select_generic(can_metrics + s, stride, n_branches,
+          alpha_curr + s, decisions + s, n - s);
+      if(s == 0) {
+        return tail_best;
+      }
+
+      float lane_max[16];
+      int32_t lane_idx[16];
+      _mm512_storeu_ps(lane_max, v_best);
+      _mm512_storeu_si512((void*)lane_idx, v_best_idx);
+
+      return merge_best(lane_max, lane_idx, 16, alpha_curr, s, tail_best, n);
+    }
+
+    bool
+    avx512f_is_supported()
+    {
+      return __builtin_cpu_supports("avx512f");
+    }
+#endif
+
+    std::vector<acs_kernel>
+    make_acs_kernels()
+    {
+      std::vector<acs_kernel> kernels;
+      acs_kernel k;
+
+#ifdef LV_HAVE_X86_KERNELS
+      k.name = "avx512f";
+      k.is_supported = avx512f_is_supported;
+      k.select = acs_select_avx512f;
+      kernels.push_back(k);
+
+      k.name = "avx2";
+      k.is_supported = avx2_is_supported;
+      k.select = acs_select_avx2;
+      kernels.push_back(k);
+
+      k.name = "sse4_1";
+      k.is_supported = sse4_1_is_supported;
+      k.select = acs_select_sse4_1;
+      kernels.push_back(k);
+#endif
+
+      k.name = "generic";
+      k.is_supported = generic_is_supported;
+      k.select = acs_select_generic;
+      kernels.push_back(k);
+
+      return kernels;
+    }
+
+    const acs_kernel &
+    find_best_acs_kernel()
+    {
+      const std::vector<acs_kernel> &kernels = acs_kernels();
+
+      for(size_t i=0 ; i < kernels.size() ; ++i) {
+        if(kernels[i].is_supported()) {
+          return kernels[i];
+        }
+      }
+
+      return kernels.back();
+    }
+
+  } // anonymous namespace
+
+  const std::vector<acs_kernel> &
+  acs_kernels()
+  {
+    static const std::vector<acs_kernel> kernels = make_acs_kernels();
+    return kernels;
+  }
+
+  const acs_kernel &
+  best_acs_kernel()
+  {
+    static const acs_kernel &best = find_best_acs_kernel();
+    return best;
+  }
+
+} // namespace lazyviterbi
+} // namespace gr
@@ -0,0 +1,79 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_ACS_KERNELS_H
+#define INCLUDED_LAZYVITERBI_ACS_KERNELS_H
+
+#include <lazyviterbi/api.h>
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+namespace gr {
+namespace lazyviterbi {
+
+  /*!
+   * \brief "COMPARE" and "SELECT" halves of add-compare-select of
+   * viterbi_volk_state (largest path metric is best).
+   *
+   * For each state s in [0, n), with candidate metrics
+   * can_metrics[i*stride + s] of the n_branches branches yielding to it:
+   * alpha_curr[s] is the largest candidate metric, and decisions[s] the index
+   * i of the surviving branch (the last one in case of a tie). Returns the
+   * index of the largest new path metric (the first one in case of a tie).
+   *
+   * This gives the same results as a running volk_32f_x2_max_32f() over the
+   * branches followed by an equality test, and volk_32f_index_max_32u() over
+   * the new path metrics, in a single pass.
+   */
+  typedef size_t (*acs_select_kernel)(const float *can_metrics, size_t stride,
+      int n_branches, float *alpha_curr, uint16_t *decisions, size_t n);
+
+  /*!
+   * \brief One implementation of the fused compare-select, in the way of VOLK
+   * kernels. Every implementation gives the same result as the generic one.
+   */
+  struct acs_kernel
+  {
+    //! Name of the implementation ("generic", "sse4_1", "avx2", "avx512f").
+    const char *name;
+    //! True if the running CPU supports this implementation.
+    bool (*is_supported)();
+    //! Compare and select.
+    acs_select_kernel select;
+  };
+
+  /*!
+   * \brief Every implementation compiled in, from the fastest to the generic
+   * one (whether or not the running CPU supports them). Exported for the unit
+   * tests.
+   */
+  LAZYVITERBI_API const std::vector<acs_kernel> &acs_kernels();
+
+  /*!
+   * \brief Fastest implementation supported by the running CPU (looked up
+   * once).
+   */
+  const acs_kernel &best_acs_kernel();
+
+} // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_ACS_KERNELS_H */
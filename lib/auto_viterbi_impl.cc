@@ -0,0 +1,190 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include <boost/bind.hpp>
+#include "auto_viterbi_impl.h"
+#include "autotuner.h"
+#include "decode_pool.h"
+
+namespace gr {
+  namespace lazyviterbi {
+
+    auto_viterbi::sptr
+    auto_viterbi::make(const gr::trellis::fsm &FSM, int K, int S0, int SK,
+        float ebn0, const std::string &cache_file)
+    {
+      return gnuradio::get_initial_sptr
+        (new auto_viterbi_impl(FSM, K, S0, SK, ebn0, cache_file));
+    }
+
+    /*
+     * The private constructor
+     */
+    auto_viterbi_impl::auto_viterbi_impl(const gr::trellis::fsm &FSM, int K,
+        int S0, int SK, float ebn0, const std::string &cache_file)
+      : gr::block("auto_viterbi",
+              gr::io_signature::make(1, -1, sizeof(float)),
+              gr::io_signature::make(1, -1, sizeof(char))),
+        d_K(K), d_ebn0(ebn0), d_cached(false),
+        d_workspaces(decode_pool::MAX_WORKERS)
+    {
+      compiled_trellis::sptr trellis = compiled_trellis::get(FSM);
+
+      //S0 and SK must represent a state of the trellis
+      d_S0 = (S0 >= 0 && S0 < trellis->S()) ? S0 : -1;
+      d_SK = (SK >= 0 && SK < trellis->S()) ? SK : -1;
+
+      //Time the decoders, unless it was done on this machine
+      autotuner tuner(trellis, d_K, d_S0, d_SK, d_ebn0);
+      std::string file = cache_file.empty()
+        ? autotuner::default_cache_file() : cache_file;
+
+      if(file != "none") {
+        d_engine = tuner.lookup(file);
+        d_cached = !d_engine.empty();
+      }
+
+      if(d_engine.empty()) {
+        d_engine = tuner.tune();
+
+        if(file != "none") {
+          tuner.store(file, d_engine);
+        }
+      }
+
+      d_decoder = tuner.make_decoder(d_engine);
+
+      set_relative_rate(1.0 / ((double)trellis->O()));
+      set_output_multiple(d_K);
+
+      message_port_register_out(stats_port());
+    }
+
+    int
+    auto_viterbi_impl::pool_size() const
+    {
+      return decode_pool::instance().size();
+    }
+
+    void
+    auto_viterbi_impl::set_pool_size(int n_threads)
+    {
+      decode_pool::instance().set_size(n_threads);
+    }
+
+    pmt::pmt_t
+    auto_viterbi_impl::stats()
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      return stats_to_pmt(sum_stats(d_workspaces));
+    }
+
+    void
+    auto_viterbi_impl::reset_stats()
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      clear_stats(d_workspaces);
+    }
+
+    void
+    auto_viterbi_impl::set_stats_period(double period)
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      d_stats_schedule.set_period(period);
+    }
+
+    void
+    auto_viterbi_impl::set_fast_path(bool fast_path)
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      d_decoder->set_fast_path(fast_path);
+    }
+
+    void
+    auto_viterbi_impl::set_S0(int S0)
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      d_S0 = S0;
+    }
+
+    void
+    auto_viterbi_impl::set_SK(int SK)
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      d_SK = SK;
+    }
+
+    void
+    auto_viterbi_impl::forecast(int noutput_items, gr_vector_int &ninput_items_required)
+    {
+      int input_required =  d_decoder->trellis()->O() * noutput_items;
+      unsigned ninputs = ninput_items_required.size();
+      for(unsigned int i = 0; i < ninputs; i++) {
+        ninput_items_required[i] = input_required;
+      }
+    }
+
+    int
+    auto_viterbi_impl::general_work (int noutput_items,
+                       gr_vector_int &ninput_items,
+                       gr_vector_const_void_star &input_items,
+                       gr_vector_void_star &output_items)
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      int nstreams = input_items.size();
+      int nblocks = noutput_items / d_K;
+
+      //One job per stream and per block
+      decode_pool::instance().run(nstreams*nblocks,
+          boost::bind(&auto_viterbi_impl::decode_block, this, boost::cref(input_items),
+            boost::ref(output_items), nblocks, _1, _2));
+
+      if(d_stats_schedule.due()) {
+        message_port_pub(stats_port(), stats_to_pmt(sum_stats(d_workspaces)));
+      }
+
+      consume_each(d_decoder->trellis()->O() * noutput_items);
+      return noutput_items;
+    }
+
+    void
+    auto_viterbi_impl::decode_block(const gr_vector_const_void_star &input_items,
+        gr_vector_void_star &output_items, int nblocks, int job, int worker)
+    {
+      int m = job / nblocks;
+      int n = job % nblocks;
+      const float *in = (const float*)input_items[m];
+      unsigned char *out = (unsigned char*)output_items[m];
+
+      if(!d_workspaces[worker]) {
+        d_workspaces[worker] = d_decoder->make_workspace(d_K);
+      }
+
+      d_decoder->decode(&(in[n*d_K*d_decoder->trellis()->O()]), d_K, d_S0,
+          d_SK, &(out[n*d_K]), *d_workspaces[worker]);
+    }
+
+  } /* namespace lazyviterbi */
+} /* namespace gr */
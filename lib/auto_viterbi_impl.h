@@ -0,0 +1,86 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_AUTO_VITERBI_IMPL_H
+#define INCLUDED_LAZYVITERBI_AUTO_VITERBI_IMPL_H
+
+#include <lazyviterbi/auto_viterbi.h>
+#include <lazyviterbi/decoder.h>
+#include "decode_stats.h"
+
+namespace gr {
+  namespace lazyviterbi {
+
+    class auto_viterbi_impl : public auto_viterbi
+    {
+     private:
+      int d_K;
+      int d_S0;
+      int d_SK;
+      float d_ebn0;
+      std::string d_engine;
+      bool d_cached;
+
+      //Fastest decoder (shared by the workers of the decode pool)
+      decoder::sptr d_decoder;
+
+      //Scratch buffers of each worker
+      std::vector<decoder::workspace_sptr> d_workspaces;
+
+      //Publication of the counters of the workspaces
+      stats_schedule d_stats_schedule;
+
+      void decode_block(const gr_vector_const_void_star &input_items,
+          gr_vector_void_star &output_items, int nblocks, int job, int worker);
+
+     public:
+      auto_viterbi_impl(const gr::trellis::fsm &FSM, int K, int S0, int SK,
+          float ebn0, const std::string &cache_file);
+
+      gr::trellis::fsm FSM() const  { return d_decoder->trellis()->fsm(); }
+      int K()  const { return d_K; }
+      int S0()  const { return d_S0; }
+      int SK()  const { return d_SK; }
+      float ebn0()  const { return d_ebn0; }
+      std::string engine()  const { return d_engine; }
+      bool cached()  const { return d_cached; }
+
+      int pool_size() const;
+      pmt::pmt_t stats();
+      double stats_period() const { return d_stats_schedule.period(); }
+      bool fast_path() const { return d_decoder->fast_path(); }
+
+      void set_S0(int S0);
+      void set_SK(int SK);
+      void set_pool_size(int n_threads);
+      void reset_stats();
+      void set_stats_period(double period);
+      void set_fast_path(bool fast_path);
+
+      void forecast (int noutput_items, gr_vector_int &ninput_items_required);
+
+      int general_work(int noutput_items, gr_vector_int &ninput_items,
+          gr_vector_const_void_star &input_items, gr_vector_void_star &output_items);
+    };
+
+  } // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_AUTO_VITERBI_IMPL_H */
@@ -0,0 +1,251 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/stat.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include "autotuner.h"
+#include "awgn_metrics.h"
+#include "lazy_viterbi_decoder.h"
+
+namespace gr {
+namespace lazyviterbi {
+
+  //Timing of an engine: at least MIN_BLOCKS blocks, then blocks until
+  //TIME_BUDGET seconds or MAX_BLOCKS blocks
+  static const int MIN_BLOCKS = 3;
+  static const int MAX_BLOCKS = 256;
+  static const double TIME_BUDGET = 0.05;
+  //Distinct blocks of synthetic metrics
+  static const int N_METRIC_BLOCKS = 4;
+
+  autotuner::autotuner(const compiled_trellis::sptr &trellis, int K, int S0,
+      int SK, float ebn0)
+    : d_trellis(trellis), d_K(K), d_S0(S0), d_SK(SK), d_ebn0(ebn0)
+  {
+  }
+
+  const std::vector<std::string> &
+  autotuner::engines()
+  {
+    static const char *names[] = {"viterbi", "viterbi_volk_branch",
+      "viterbi_volk_state", "lazy_viterbi"};
+    static const std::vector<std::string> engines(names, names + 4);
+
+    return engines;
+  }
+
+  decoder::sptr
+  autotuner::make_decoder(const std::string &engine) const
+  {
+    if(engine == "viterbi") {
+      return decoder::make_viterbi(d_trellis, d_S0, d_SK);
+    }
+    else if(engine == "viterbi_volk_branch") {
+      return decoder::make_viterbi_volk_branch(d_trellis, d_S0, d_SK);
+    }
+    else if(engine == "viterbi_volk_state") {
+      return decoder::make_viterbi_volk_state(d_trellis, d_S0, d_SK);
+    }
+    else if(engine == "lazy_viterbi") {
+      //The scale of the metrics given to the block is not known
+      boost::shared_ptr<lazy_viterbi_decoder> dec(
+          new lazy_viterbi_decoder(d_trellis, d_S0, d_SK, 0.0));
+      dec->check_block_length(d_K);
+      return dec;
+    }
+
+    throw std::invalid_argument("auto_viterbi: unknown engine " + engine);
+  }
+
+  double
+  autotuner::time_engine(const std::string &engine) const
+  {
+    typedef std::chrono::steady_clock clock;
+
+    decoder::sptr dec;
+    try {
+      dec = make_decoder(engine);
+    }
+    catch(std::invalid_argument &) {
+      return -1.0;
+    }
+
+    //Same metrics for every engine
+    std::mt19937 rng(0);
+    std::vector<unsigned char> inputs, out(d_K);
+    std::vector<float> metrics;
+    const int O = d_trellis->O();
+    awgn_metrics(d_trellis->I(), O, d_trellis->NS(), d_trellis->fsm_OS(), d_K,
+        N_METRIC_BLOCKS, d_ebn0, d_S0, rng, inputs, metrics);
+
+    decoder::workspace_sptr ws = dec->make_workspace(d_K);
+
+    //Warm up caches and lazily built tables
+    dec->decode(&metrics[0], d_K, &out[0], *ws);
+
+    double best = -1.0, total = 0.0;
+    for(int n=0 ; n < MAX_BLOCKS && (n < MIN_BLOCKS || total < TIME_BUDGET) ;
+        ++n) {
+      const float *block = &metrics[(size_t)(n % N_METRIC_BLOCKS)*d_K*O];
+
+      clock::time_point start = clock::now();
+      dec->decode(block, d_K, &out[0], *ws);
+      double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+      if(best < 0.0 || elapsed < best) {
+        best = elapsed;
+      }
+      total += elapsed;
+    }
+
+    return best;
+  }
+
+  std::string
+  autotuner::tune() const
+  {
+    std::string best_engine;
+    double best = -1.0;
+
+    for(size_t e=0 ; e < engines().size() ; ++e) {
+      double t = time_engine(engines()[e]);
+
+      if(t >= 0.0 && (best < 0.0 || t < best)) {
+        best = t;
+        best_engine = engines()[e];
+      }
+    }
+
+    if(best_engine.empty()) {
+      throw std::invalid_argument("auto_viterbi: no engine can decode this trellis");
+    }
+
+    return best_engine;
+  }
+
+  std::string
+  autotuner::key() const
+  {
+    std::ostringstream k;
+    char hash[17];
+    char ebn0[16];
+
+    std::snprintf(hash, sizeof(hash), "%016llx",
+        (unsigned long long)d_trellis->hash());
+    std::snprintf(ebn0, sizeof(ebn0), "%.1f", d_ebn0);
+    k << hash << '\t' << cpu_model() << '\t' << d_K << '\t' << ebn0;
+
+    return k.str();
+  }
+
+  std::string
+  autotuner::lookup(const std::string &cache_file) const
+  {
+    std::ifstream f(cache_file.c_str());
+    const std::string prefix = key() + '\t';
+    std::string line, engine;
+
+    while(std::getline(f, line)) {
+      if(line.compare(0, prefix.size(), prefix) != 0) {
+        continue;
+      }
+
+      //Engines of an older version are ignored
+      std::string name = line.substr(prefix.size());
+      for(size_t e=0 ; e < engines().size() ; ++e) {
+        if(name == engines()[e]) {
+          engine = name;
+        }
+      }
+    }
+
+    return engine;
+  }
+
+  void
+  autotuner::store(const std::string &cache_file,
+      const std::string &engine) const
+  {
+    //Create the directories of the file
+    for(size_t sep = cache_file.find('/', 1) ; sep != std::string::npos ;
+        sep = cache_file.find('/', sep + 1)) {
+      mkdir(cache_file.substr(0, sep).c_str(), 0755);
+    }
+
+    //One write per line, so that concurrent tunings do not mix their lines
+    std::string line = key() + '\t' + engine + '\n';
+    std::ofstream f(cache_file.c_str(), std::ios::app);
+    f.write(line.data(), line.size());
+  }
+
+  std::string
+  autotuner::default_cache_file()
+  {
+    const char *cache_home = std::getenv("XDG_CACHE_HOME");
+    if(cache_home && *cache_home) {
+      return std::string(cache_home) + "/gr-lazyviterbi/autotune";
+    }
+
+    const char *home = std::getenv("HOME");
+    return std::string(home ? home : ".") + "/.cache/gr-lazyviterbi/autotune";
+  }
+
+  std::string
+  autotuner::cpu_model()
+  {
+    std::ifstream f("/proc/cpuinfo");
+    std::string line;
+
+    while(std::getline(f, line)) {
+      if(line.compare(0, 10, "model name") != 0) {
+        continue;
+      }
+
+      size_t colon = line.find(':');
+      if(colon == std::string::npos) {
+        break;
+      }
+
+      std::string model = line.substr(colon + 1);
+      model.erase(0, model.find_first_not_of(" \t"));
+      for(size_t c=0 ; c < model.size() ; ++c) {
+        if(model[c] == '\t') {
+          model[c] = ' ';
+        }
+      }
+
+      return model;
+    }
+
+    return "unknown";
+  }
+
+} /* namespace lazyviterbi */
+} /* namespace gr */
@@ -0,0 +1,101 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_AUTOTUNER_H
+#define INCLUDED_LAZYVITERBI_AUTOTUNER_H
+
+#include <lazyviterbi/api.h>
+#include <lazyviterbi/decoder.h>
+#include <string>
+#include <vector>
+
+namespace gr {
+namespace lazyviterbi {
+
+  /*!
+   * \brief Choice of the fastest decoder for a trellis, a block length and an
+   * SNR (see auto_viterbi).
+   *
+   * Each candidate decodes blocks of synthetic metrics (random inputs sent
+   * through an AWGN channel), and the one of shortest decoding time per
+   * block wins. Results are kept in a text file, one line per tuning:
+   * "<trellis hash>\t<CPU model>\t<K>\t<Eb/N0>\t<engine>" (the hash being
+   * compiled_trellis::hash() in hexadecimal), the last matching line of the
+   * file giving the engine. Exported for the unit tests.
+   */
+  class LAZYVITERBI_API autotuner
+  {
+   public:
+    /*!
+     * \param trellis Trellis of the code.
+     * \param K Length of the blocks.
+     * \param S0 Initial state of the encoder (-1 if unknown).
+     * \param SK Final state of the encoder (-1 if unknown).
+     * \param ebn0 Eb/N0 (in dB) of the synthetic metrics.
+     */
+    autotuner(const compiled_trellis::sptr &trellis, int K, int S0, int SK,
+        float ebn0);
+
+    //! Names of the candidate engines.
+    static const std::vector<std::string> &engines();
+
+    /*!
+     * \brief Decoder of an engine (throws std::invalid_argument if the name
+     * is unknown, or if the engine cannot decode this trellis).
+     */
+    decoder::sptr make_decoder(const std::string &engine) const;
+
+    //! Best decoding time of a block by an engine, in seconds (-1 if it
+    //! cannot decode this trellis).
+    double time_engine(const std::string &engine) const;
+
+    //! The fastest engine (timing every candidate).
+    std::string tune() const;
+
+    /*!
+     * \brief The engine found in a cache file (empty string if none).
+     */
+    std::string lookup(const std::string &cache_file) const;
+
+    //! Append the engine to a cache file (creating its directory).
+    void store(const std::string &cache_file, const std::string &engine) const;
+
+    //! Default cache file: $XDG_CACHE_HOME/gr-lazyviterbi/autotune (or
+    //! ~/.cache/gr-lazyviterbi/autotune).
+    static std::string default_cache_file();
+
+    //! Model of the processor (from /proc/cpuinfo, "unknown" otherwise).
+    static std::string cpu_model();
+
+   private:
+    compiled_trellis::sptr d_trellis;
+    int d_K;
+    int d_S0;
+    int d_SK;
+    float d_ebn0;
+
+    //Key of the tuning in cache files (fields but the engine)
+    std::string key() const;
+  };
+
+} /* namespace lazyviterbi */
+} /* namespace gr */
+
+#endif /* INCLUDED_LAZYVITERBI_AUTOTUNER_H */
@@ -0,0 +1,103 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_AWGN_METRICS_H
+#define INCLUDED_LAZYVITERBI_AWGN_METRICS_H
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace gr {
+namespace lazyviterbi {
+
+  //Number of BPSK symbols sending an output symbol: ceil(log2(O))
+  inline int
+  symbol_bits(int O)
+  {
+    int n_bits = 0;
+    while((1 << n_bits) < O) {
+      ++n_bits;
+    }
+
+    return n_bits;
+  }
+
+  /*!
+   * Encode n_blocks blocks of K random inputs with a trellis of I inputs and
+   * O outputs (NS[s*I + i] and OS[s*I + i] being the next state and the
+   * output of branch (s, i)), each block from state S0 (0 if -1), and
+   * compute the euclidean metrics of the symbols received through an AWGN
+   * channel. Each output symbol is sent as ceil(log2(O)) BPSK symbols (most
+   * significant bit first).
+   */
+  template <typename RNG>
+  inline void
+  awgn_metrics(int I, int O, const int *NS, const int *OS, int K,
+      long n_blocks, float ebn0_db, int S0, RNG &rng,
+      std::vector<unsigned char> &inputs, std::vector<float> &metrics)
+  {
+    const int n_bits = std::max(symbol_bits(O), 1);
+    const long n_sections = n_blocks * K;
+
+    //Unit energy BPSK symbols, rate log2(I)/n_bits code
+    const double rate = std::log2((double)I) / n_bits;
+    const double N0 = 1.0 / (rate * std::pow(10.0, ebn0_db / 10.0));
+    std::normal_distribution<float> noise(0.0, std::sqrt(N0 / 2.0));
+    std::uniform_int_distribution<int> input(0, I - 1);
+    std::vector<float> rx(n_bits);
+
+    inputs.resize(n_sections);
+    metrics.resize(n_sections * O);
+
+    int state = 0;
+    for(long k=0 ; k < n_sections ; ++k) {
+      int i = input(rng);
+
+      if(k % K == 0) {
+        state = (S0 == -1) ? 0 : S0;
+      }
+
+      int symbol = OS[state*I + i];
+
+      inputs[k] = (unsigned char)i;
+      state = NS[state*I + i];
+
+      for(int b=0 ; b < n_bits ; ++b) {
+        rx[b] = (((symbol >> (n_bits - 1 - b)) & 1) ? 1.0f : -1.0f)
+          + noise(rng);
+      }
+
+      for(int o=0 ; o < O ; ++o) {
+        float metric = 0.0;
+        for(int b=0 ; b < n_bits ; ++b) {
+          float d = rx[b] - (((o >> (n_bits - 1 - b)) & 1) ? 1.0f : -1.0f);
+          metric += d*d;
+        }
+        metrics[k*O + o] = metric;
+      }
+    }
+  }
+
+} /* namespace lazyviterbi */
+} /* namespace gr */
+
+#endif /* INCLUDED_LAZYVITERBI_AWGN_METRICS_H */
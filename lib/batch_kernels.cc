@@ -0,0 +1,181 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cstring>
+#include "batch_kernels.h"
+#include "path_metrics.h"
+
+//SIMD implementations are compiled with function-level target attributes, so
+//that the library itself does not require any particular instruction set.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define LV_HAVE_X86_KERNELS
+#endif
+
+namespace gr {
+namespace lazyviterbi {
+
+  namespace {
+
+    //***GENERIC***//
+    void
+    batch_acs_generic(const uint16_t *alpha_prev, uint16_t *alpha_curr,
+        const uint16_t *metrics_k, const int *ordered_PS, const int *ordered_OS,
+        int S, int max_size_PS_s, uint8_t *decisions)
+    {
+      for(int s=0 ; s < S ; ++s) {
+        for(int l=0 ; l < BATCH_LANES ; ++l) {
+          uint16_t best = alpha_prev[ordered_PS[0]*BATCH_LANES + l]
+            + metrics_k[ordered_OS[0]*BATCH_LANES + l];
+          uint8_t dec = 0;
+
+          for(int i=1 ; i < max_size_PS_s ; ++i) {
+            uint16_t can = alpha_prev[ordered_PS[i]*BATCH_LANES + l]
+              + metrics_k[ordered_OS[i]*BATCH_LANES + l];
+
+            if(modulo_less(can, best)) {
+              best = can;
+              dec = (uint8_t)i;
+            }
+          }
+
+          alpha_curr[s*BATCH_LANES + l] = best;
+          decisions[s*BATCH_LANES + l] = dec;
+        }
+
+        ordered_PS += max_size_PS_s;
+        ordered_OS += max_size_PS_s;
+      }
+    }
+
+    bool
+    generic_is_supported()
+    {
+      return true;
+    }
+
+#ifdef LV_HAVE_X86_KERNELS
+    //***AVX2***//
+    //One vector of path metrics (or of decisions) per state, written with
+    //vector extensions: the compiler uses the AVX2 registers.
+    typedef uint16_t v_metric __attribute__((vector_size(2*BATCH_LANES)));
+    typedef int16_t v_diff __attribute__((vector_size(2*BATCH_LANES)));
+    typedef uint8_t v_decision __attribute__((vector_size(BATCH_LANES)));
+
+    __attribute__((target("avx2"))) void
+    batch_acs_avx2(const uint16_t *alpha_prev, uint16_t *alpha_curr,
+        const uint16_t *metrics_k, const int *ordered_PS, const int *ordered_OS,
+        int S, int max_size_PS_s, uint8_t *decisions)
+    {
+      v_metric alpha, metric, best, can, better;
+
+      for(int s=0 ; s < S ; ++s) {
+        //Pre-loop
+        memcpy(&alpha, alpha_prev + (*ordered_PS++)*BATCH_LANES, sizeof(alpha));
+        memcpy(&metric, metrics_k + (*ordered_OS++)*BATCH_LANES, sizeof(metric));
+        best = alpha + metric;
+        v_metric dec = {0};
+
+        //Loop
+        for(int i=1 ; i < max_size_PS_s ; ++i) {
+          //ADD
+          memcpy(&alpha, alpha_prev + (*ordered_PS++)*BATCH_LANES, sizeof(alpha));
+          memcpy(&metric, metrics_k + (*ordered_OS++)*BATCH_LANES, sizeof(metric));
+          can = alpha + metric;
+
+          //COMPARE (modulo) and SELECT
+          better = (v_metric)((v_diff)(can - best) < 0);
+          best = (better & can) | (~better & best);
+          dec = (better & (uint16_t)i) | (~better & dec);
+        }
+
+        memcpy(alpha_curr + s*BATCH_LANES, &best, sizeof(best));
+
+        //Decisions are smaller than 256
+#if defined(__clang__) || __GNUC__ >= 9
+        v_decision dec8 = __builtin_convertvector(dec, v_decision);
+        memcpy(decisions + s*BATCH_LANES, &dec8, sizeof(dec8));
+#else
+        for(int l=0 ; l < BATCH_LANES ; ++l) {
+          decisions[s*BATCH_LANES + l] = (uint8_t)dec[l];
+        }
+#endif
+      }
+    }
+
+    bool
+    avx2_is_supported()
+    {
+      return __builtin_cpu_supports("avx2");
+    }
+#endif
+
+    std::vector<batch_kernel>
+    make_batch_kernels()
+    {
+      std::vector<batch_kernel> kernels;
+      batch_kernel k;
+
+#ifdef LV_HAVE_X86_KERNELS
+      k.name = "avx2";
+      k.is_supported = avx2_is_supported;
+      k.acs = batch_acs_avx2;
+      kernels.push_back(k);
+#endif
+
+      k.name = "generic";
+      k.is_supported = generic_is_supported;
+      k.acs = batch_acs_generic;
+      kernels.push_back(k);
+
+      return kernels;
+    }
+
+    const batch_kernel &
+    find_best_batch_kernel()
+    {
+      const std::vector<batch_kernel> &kernels = batch_kernels();
+
+      for(size_t i=0 ; i < kernels.size() ; ++i) {
+        if(kernels[i].is_supported()) {
+          return kernels[i];
+        }
+      }
+
+      return kernels.back();
+    }
+
+  } // anonymous namespace
+
+  const std::vector<batch_kernel> &
+  batch_kernels()
+  {
+    static const std::vector<batch_kernel> kernels = make_batch_kernels();
+    return kernels;
+  }
+
+  const batch_kernel &
+  best_batch_kernel()
+  {
+    static const batch_kernel &best = find_best_batch_kernel();
+    return best;
+  }
+
+} // namespace lazyviterbi
+} // namespace gr
@@ -0,0 +1,81 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_BATCH_KERNELS_H
+#define INCLUDED_LAZYVITERBI_BATCH_KERNELS_H
+
+#include <lazyviterbi/api.h>
+#include <stdint.h>
+#include <vector>
+
+namespace gr {
+namespace lazyviterbi {
+
+  //! Number of blocks decoded at once by the batch kernels (one per lane).
+  const int BATCH_LANES = 16;
+
+  /*!
+   * \brief Add-compare-select of a trellis section for BATCH_LANES independent
+   * blocks at once, lane l of every vector belonging to block l.
+   *
+   * Path metrics are 16-bit integers with modulo arithmetic (see
+   * modulo_less()), stored as alpha[s*BATCH_LANES + l], and branch metrics of
+   * the section as metrics_k[o*BATCH_LANES + l]. Branches yielding to state s
+   * come from states ordered_PS[s*max_size_PS_s + i], with output symbols
+   * ordered_OS[s*max_size_PS_s + i]; missing branches must be copies of the
+   * first one. decisions[s*BATCH_LANES + l] is the index i of the surviving
+   * branch (the first one in case of a tie).
+   */
+  typedef void (*batch_acs_kernel)(const uint16_t *alpha_prev,
+      uint16_t *alpha_curr, const uint16_t *metrics_k, const int *ordered_PS,
+      const int *ordered_OS, int S, int max_size_PS_s, uint8_t *decisions);
+
+  /*!
+   * \brief One implementation of the batch add-compare-select, in the way of
+   * VOLK kernels. Every implementation gives the same result as the generic
+   * one.
+   */
+  struct batch_kernel
+  {
+    //! Name of the implementation ("generic", "avx2").
+    const char *name;
+    //! True if the running CPU supports this implementation.
+    bool (*is_supported)();
+    //! Add-compare-select of one section.
+    batch_acs_kernel acs;
+  };
+
+  /*!
+   * \brief Every implementation compiled in, from the fastest to the generic
+   * one (whether or not the running CPU supports them). Exported for the unit
+   * tests.
+   */
+  LAZYVITERBI_API const std::vector<batch_kernel> &batch_kernels();
+
+  /*!
+   * \brief Fastest implementation supported by the running CPU (looked up
+   * once).
+   */
+  const batch_kernel &best_batch_kernel();
+
+} // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_BATCH_KERNELS_H */
@@ -0,0 +1,87 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_BLOCK_TIMER_H
+#define INCLUDED_LAZYVITERBI_BLOCK_TIMER_H
+
+#include <lazyviterbi/decoder.h>
+#include <chrono>
+
+namespace gr {
+  namespace lazyviterbi {
+
+    /*
+     * Times the decoding of a block, from its construction to its
+     * destruction (or to stop()), into the counters of a workspace.
+     */
+    class block_timer
+    {
+     private:
+      typedef std::chrono::steady_clock clock;
+
+      decoder::counters &d_stats;
+      size_t d_K;
+      clock::time_point d_start;
+      bool d_stopped;
+
+     public:
+      block_timer(decoder::counters &stats, size_t K)
+        : d_stats(stats), d_K(K), d_start(clock::now()), d_stopped(false) {}
+
+      ~block_timer()
+      {
+        stop();
+      }
+
+      //Number of sections of the block, if unknown at construction
+      void set_sections(size_t K)
+      {
+        d_K = K;
+      }
+
+      //Count the block now, rather than on destruction
+      void stop()
+      {
+        if(d_stopped) {
+          return;
+        }
+        d_stopped = true;
+
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            clock::now() - d_start).count();
+
+        //Bin of the latency: floor(log2(ns))
+        int bin = 0;
+        for(uint64_t x = ns >> 1 ; x && bin < decoder::counters::LATENCY_BINS - 1 ;
+            x >>= 1) {
+          ++bin;
+        }
+
+        ++d_stats.blocks;
+        d_stats.sections += d_K;
+        d_stats.decode_ns += ns;
+        ++d_stats.latency_hist[bin];
+      }
+    };
+
+  } // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_BLOCK_TIMER_H */
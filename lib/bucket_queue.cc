@@ -0,0 +1,77 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include "bucket_queue.h"
+
+namespace gr {
+namespace lazyviterbi {
+
+  bucket_queue::bucket_queue(size_t n_buckets, size_t n_chunks)
+    : d_n_fresh(0), d_free(NIL), d_head(n_buckets, NIL), d_fill(n_buckets, 0),
+      d_bitmap(n_buckets/64, 0), d_word_mask(n_buckets/64 - 1),
+      d_summary((n_buckets + 4095)/4096, 0), d_summary_mask((n_buckets + 4095)/4096 - 1)
+  {
+    d_slab.resize(n_chunks*CHUNK_SIZE);
+    d_next.resize(n_chunks);
+  }
+
+  size_t
+  bucket_queue::size() const
+  {
+    size_t n = 0;
+
+    for(size_t b=0 ; b < d_head.size() ; ++b) {
+      if(d_head[b] != NIL) {
+        n += d_fill[b];
+        for(uint32_t c=d_next[d_head[b]] ; c != NIL ; c=d_next[c]) {
+          n += CHUNK_SIZE;
+        }
+      }
+    }
+
+    return n;
+  }
+
+  void
+  bucket_queue::clear()
+  {
+    std::fill(d_head.begin(), d_head.end(), NIL);
+    std::fill(d_fill.begin(), d_fill.end(), 0);
+    std::fill(d_bitmap.begin(), d_bitmap.end(), 0);
+    std::fill(d_summary.begin(), d_summary.end(), 0);
+
+    d_n_fresh = 0;
+    d_free = NIL;
+  }
+
+  void
+  bucket_queue::grow()
+  {
+    //Chunks are addressed by index, so that growing the slab does not
+    //invalidate the lists.
+    size_t n_chunks = std::max(2*d_next.size(), (size_t)MIN_GROWTH);
+
+    d_slab.resize(n_chunks*CHUNK_SIZE);
+    d_next.resize(n_chunks);
+  }
+
+} // namespace lazyviterbi
+} // namespace gr
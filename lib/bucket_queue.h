@@ -0,0 +1,258 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_BUCKET_QUEUE_H
+#define INCLUDED_LAZYVITERBI_BUCKET_QUEUE_H
+
+#include <lazyviterbi/api.h>
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace gr {
+namespace lazyviterbi {
+
+  /*!
+   * \brief Index of the least significant bit set in a non-zero word.
+   */
+  static inline unsigned int
+  ctz64(uint64_t word)
+  {
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward64(&idx, word);
+    return (unsigned int)idx;
+#else
+    return (unsigned int)__builtin_ctzll(word);
+#endif
+  }
+
+  /*!
+   * \brief Circular bucket queue of shadow node keys.
+   *
+   * Each bucket is a LIFO stack of 32-bit keys. Stacks are made of fixed-size
+   * chunks carved from a single slab, so that pushing and popping never call
+   * the allocator once the slab is large enough (it only grows, and is kept
+   * from one block to the next). Released chunks are recycled through a free
+   * list.
+   *
+   * An occupancy bitmap (one bit per bucket), summarized by a second bitmap
+   * (one bit per non-zero word of the first one), allows to find the next
+   * non-empty bucket with a few count-trailing-zeros instead of a linear scan,
+   * even with 65536 buckets.
+   *
+   * The number of buckets must be a power of two, greater or equal to 64.
+   */
+  class bucket_queue
+  {
+   public:
+    //! Number of keys held by a chunk.
+    static const uint32_t CHUNK_SIZE = 64;
+    //! Marks the end of a chunk list.
+    static const uint32_t NIL = 0xffffffff;
+    //! Number of chunks of the first growth of an empty slab.
+    static const uint32_t MIN_GROWTH = 16;
+
+    /*!
+     * \param n_buckets Number of buckets.
+     * \param n_chunks Initial number of chunks of the slab (the expected
+     * number of keys over CHUNK_SIZE: the slab grows as needed).
+     */
+    bucket_queue(size_t n_buckets = 256, size_t n_chunks = 0);
+
+    size_t n_buckets() const { return d_head.size(); }
+
+    //! Put \p key on top of bucket \p b.
+    inline void push(size_t b, uint32_t key)
+    {
+      if(d_fill[b] == CHUNK_SIZE || d_head[b] == NIL) {
+        uint32_t c = alloc_chunk();
+        d_next[c] = d_head[b];
+        d_head[b] = c;
+        d_fill[b] = 0;
+        d_bitmap[b >> 6] |= (uint64_t)1 << (b & 63);
+        d_summary[b >> 12] |= (uint64_t)1 << ((b >> 6) & 63);
+      }
+
+      d_slab[(size_t)d_head[b]*CHUNK_SIZE + d_fill[b]++] = key;
+    }
+
+    //! Remove and return the key on top of non-empty bucket \p b.
+    inline uint32_t pop(size_t b)
+    {
+      uint32_t c = d_head[b];
+      uint32_t key = d_slab[(size_t)c*CHUNK_SIZE + --d_fill[b]];
+
+      if(d_fill[b] == 0) {
+        d_head[b] = d_next[c];
+        d_next[c] = d_free;
+        d_free = c;
+
+        if(d_head[b] == NIL) {
+          d_bitmap[b >> 6] &= ~((uint64_t)1 << (b & 63));
+          if(d_bitmap[b >> 6] == 0) {
+            d_summary[b >> 12] &= ~((uint64_t)1 << ((b >> 6) & 63));
+          }
+        }
+        else {
+          d_fill[b] = CHUNK_SIZE;
+        }
+      }
+
+      return key;
+    }
+
+    /*!
+     * \brief Index of the first non-empty bucket, starting from \p b and
+     * wrapping around the circular buffer.
+     *
+     * The queue must not be empty.
+     */
+    inline size_t next_bucket(size_t b) const
+    {
+      size_t w = b >> 6;
+      uint64_t word = d_bitmap[w] & (~(uint64_t)0 << (b & 63));
+
+      if(word == 0) {
+        //Find the next non-empty word, from the summary
+        w = (w + 1) & d_word_mask;
+        size_t sw = w >> 6;
+        uint64_t sword = d_summary[sw] & (~(uint64_t)0 << (w & 63));
+
+        while(sword == 0) {
+          sw = (sw + 1) & d_summary_mask;
+          sword = d_summary[sw];
+        }
+
+        w = (sw << 6) | ctz64(sword);
+        word = d_bitmap[w];
+      }
+
+      return (w << 6) | ctz64(word);
+    }
+
+    /*!
+     * \brief Remove the keys for which \p pred returns true, keeping the
+     * order of the other ones.
+     *
+     * Goes through every key of the queue.
+     */
+    template<typename Pred>
+    void remove_if(Pred pred)
+    {
+      for(size_t w=0 ; w < d_bitmap.size() ; ++w) {
+        uint64_t word = d_bitmap[w];
+
+        while(word != 0) {
+          size_t b = (w << 6) | ctz64(word);
+          word &= word - 1;
+
+          //Move the kept keys out of the bucket, from top to bottom, and
+          //release its chunks
+          d_kept.clear();
+          uint32_t n = d_fill[b];
+          for(uint32_t c=d_head[b] ; c != NIL ; n=CHUNK_SIZE) {
+            const uint32_t *keys = &d_slab[(size_t)c*CHUNK_SIZE];
+            for(uint32_t i=n ; i-- > 0 ;) {
+              if(!pred(keys[i])) {
+                d_kept.push_back(keys[i]);
+              }
+            }
+
+            uint32_t next = d_next[c];
+            d_next[c] = d_free;
+            d_free = c;
+            c = next;
+          }
+
+          d_head[b] = NIL;
+          d_fill[b] = 0;
+          d_bitmap[w] &= ~((uint64_t)1 << (b & 63));
+          if(d_bitmap[w] == 0) {
+            d_summary[w >> 6] &= ~((uint64_t)1 << (w & 63));
+          }
+
+          //Put them back, bottom first
+          for(std::vector<uint32_t>::reverse_iterator it=d_kept.rbegin() ;
+              it != d_kept.rend() ; ++it) {
+            push(b, *it);
+          }
+        }
+      }
+    }
+
+    //! Number of keys in the queue (goes through every chunk).
+    size_t size() const;
+
+    //! Empty every bucket, keeping the slab allocated.
+    void clear();
+
+   private:
+    //Keys storage, CHUNK_SIZE keys per chunk
+    std::vector<uint32_t> d_slab;
+    //Next chunk in the list the chunk belongs to (bucket stack or free list)
+    std::vector<uint32_t> d_next;
+    //Number of chunks never handed out since last clear()
+    uint32_t d_n_fresh;
+    //Head of the free list
+    uint32_t d_free;
+
+    //Top chunk of each bucket
+    std::vector<uint32_t> d_head;
+    //Number of keys in the top chunk of each bucket
+    std::vector<uint32_t> d_fill;
+    //Occupancy of the buckets
+    std::vector<uint64_t> d_bitmap;
+    size_t d_word_mask;
+    //Occupancy of the words of d_bitmap
+    std::vector<uint64_t> d_summary;
+    size_t d_summary_mask;
+    //Keys kept by remove_if()
+    std::vector<uint32_t> d_kept;
+
+    inline uint32_t alloc_chunk()
+    {
+      uint32_t c;
+
+      if(d_free != NIL) {
+        c = d_free;
+        d_free = d_next[c];
+      }
+      else {
+        if(d_n_fresh == d_next.size()) {
+          grow();
+        }
+        c = d_n_fresh++;
+      }
+
+      return c;
+    }
+
+    void grow();
+  };
+
+} // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_BUCKET_QUEUE_H */
@@ -0,0 +1,236 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "butterfly_kernels.h"
+#include "path_metrics.h"
+
+//SIMD implementations are compiled with function-level target attributes, so
+//that the library itself does not require any particular instruction set.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define LV_HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace gr {
+namespace lazyviterbi {
+
+  namespace {
+
+    //***GENERIC***//
+    void
+    butterfly_generic(const uint16_t *alpha_prev, uint16_t *alpha_curr,
+        const uint8_t *metrics_k, const uint8_t *idx_a, const uint8_t *idx_b,
+        uint64_t *decisions, int S)
+    {
+      const int half = S/2;
+
+      std::fill(decisions, decisions + (S + 63)/64, 0);
+
+      for(int j=0 ; j < half ; ++j) {
+        const int l = 16*(j/8) + j%8;
+
+        for(int b=0 ; b < 2 ; ++b) {
+          uint16_t m_a = alpha_prev[j] + metrics_k[idx_a[l + 8*b]];
+          uint16_t m_b = alpha_prev[j + half] + metrics_k[idx_b[l + 8*b]];
+          bool d = modulo_less(m_b, m_a);
+          int n = 2*j + b;
+
+          alpha_curr[n] = d ? m_b : m_a;
+          decisions[n/64] |= (uint64_t)d << (n%64);
+        }
+      }
+    }
+
+    bool
+    generic_is_supported()
+    {
+      return true;
+    }
+
+#ifdef LV_HAVE_X86_KERNELS
+    //***SSSE3***//
+    //Branch metrics are gathered by a byte shuffle of the (at most 16) branch
+    //metrics of the section, which stay in a register.
+    __attribute__((target("ssse3"))) void
+    butterfly_ssse3(const uint16_t *alpha_prev, uint16_t *alpha_curr,
+        const uint8_t *metrics_k, const uint8_t *idx_a, const uint8_t *idx_b,
+        uint64_t *decisions, int S)
+    {
+      const int half = S/2;
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i bm = _mm_loadu_si128((const __m128i*)metrics_k);
+      uint8_t *dec_it = (uint8_t*)decisions;
+
+      //8 butterflies (16 states) per iteration
+      for(int j=0 ; j < half ; j += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(alpha_prev + j));
+        __m128i b = _mm_loadu_si128((const __m128i*)(alpha_prev + j + half));
+        __m128i bm_a = _mm_shuffle_epi8(bm, _mm_loadu_si128((const __m128i*)(idx_a + 2*j)));
+        __m128i bm_b = _mm_shuffle_epi8(bm, _mm_loadu_si128((const __m128i*)(idx_b + 2*j)));
+
+        //ADD (candidates of even and odd states)
+        __m128i m_a0 = _mm_add_epi16(a, _mm_unpacklo_epi8(bm_a, zero));
+        __m128i m_a1 = _mm_add_epi16(a, _mm_unpackhi_epi8(bm_a, zero));
+        __m128i m_b0 = _mm_add_epi16(b, _mm_unpacklo_epi8(bm_b, zero));
+        __m128i m_b1 = _mm_add_epi16(b, _mm_unpackhi_epi8(bm_b, zero));
+
+        //COMPARE (modulo)
+        __m128i d0 = _mm_cmpgt_epi16(zero, _mm_sub_epi16(m_b0, m_a0));
+        __m128i d1 = _mm_cmpgt_epi16(zero, _mm_sub_epi16(m_b1, m_a1));
+
+        //SELECT
+        __m128i s0 = _mm_or_si128(_mm_and_si128(d0, m_b0), _mm_andnot_si128(d0, m_a0));
+        __m128i s1 = _mm_or_si128(_mm_and_si128(d1, m_b1), _mm_andnot_si128(d1, m_a1));
+
+        //Interleave even and odd states
+        _mm_storeu_si128((__m128i*)(alpha_curr + 2*j), _mm_unpacklo_epi16(s0, s1));
+        _mm_storeu_si128((__m128i*)(alpha_curr + 2*j + 8), _mm_unpackhi_epi16(s0, s1));
+
+        uint16_t bits = (uint16_t)_mm_movemask_epi8(_mm_packs_epi16(
+              _mm_unpacklo_epi16(d0, d1), _mm_unpackhi_epi16(d0, d1)));
+        memcpy(dec_it + j/4, &bits, sizeof(bits));
+      }
+    }
+
+    bool
+    ssse3_is_supported()
+    {
+      return __builtin_cpu_supports("ssse3");
+    }
+
+    //***AVX2***//
+    __attribute__((target("avx2"))) void
+    butterfly_avx2(const uint16_t *alpha_prev, uint16_t *alpha_curr,
+        const uint8_t *metrics_k, const uint8_t *idx_a, const uint8_t *idx_b,
+        uint64_t *decisions, int S)
+    {
+      const int half = S/2;
+      const __m256i zero = _mm256_setzero_si256();
+      const __m256i bm = _mm256_broadcastsi128_si256(
+          _mm_loadu_si128((const __m128i*)metrics_k));
+      uint8_t *dec_it = (uint8_t*)decisions;
+
+      //16 butterflies (32 states) per iteration: each 128-bit lane holds a
+      //chunk of 8 butterflies
+      for(int j=0 ; j < half ; j += 16) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(alpha_prev + j));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(alpha_prev + j + half));
+        __m256i bm_a = _mm256_shuffle_epi8(bm, _mm256_loadu_si256((const __m256i*)(idx_a + 2*j)));
+        __m256i bm_b = _mm256_shuffle_epi8(bm, _mm256_loadu_si256((const __m256i*)(idx_b + 2*j)));
+
+        //ADD
+        __m256i m_a0 = _mm256_add_epi16(a, _mm256_unpacklo_epi8(bm_a, zero));
+        __m256i m_a1 = _mm256_add_epi16(a, _mm256_unpackhi_epi8(bm_a, zero));
+        __m256i m_b0 = _mm256_add_epi16(b, _mm256_unpacklo_epi8(bm_b, zero));
+        __m256i m_b1 = _mm256_add_epi16(b, _mm256_unpackhi_epi8(bm_b, zero));
+
+        //COMPARE (modulo)
+        __m256i d0 = _mm256_cmpgt_epi16(zero, _mm256_sub_epi16(m_b0, m_a0));
+        __m256i d1 = _mm256_cmpgt_epi16(zero, _mm256_sub_epi16(m_b1, m_a1));
+
+        //SELECT
+        __m256i s0 = _mm256_blendv_epi8(m_a0, m_b0, d0);
+        __m256i s1 = _mm256_blendv_epi8(m_a1, m_b1, d1);
+
+        //Interleave even and odd states (unpacking works within lanes)
+        __m256i lo = _mm256_unpacklo_epi16(s0, s1);
+        __m256i hi = _mm256_unpackhi_epi16(s0, s1);
+        _mm256_storeu_si256((__m256i*)(alpha_curr + 2*j),
+            _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i*)(alpha_curr + 2*j + 16),
+            _mm256_permute2x128_si256(lo, hi, 0x31));
+
+        lo = _mm256_unpacklo_epi16(d0, d1);
+        hi = _mm256_unpackhi_epi16(d0, d1);
+        __m256i d = _mm256_packs_epi16(_mm256_permute2x128_si256(lo, hi, 0x20),
+            _mm256_permute2x128_si256(lo, hi, 0x31));
+        uint32_t bits = (uint32_t)_mm256_movemask_epi8(
+            _mm256_permute4x64_epi64(d, _MM_SHUFFLE(3, 1, 2, 0)));
+        memcpy(dec_it + j/4, &bits, sizeof(bits));
+      }
+    }
+
+    bool
+    avx2_is_supported()
+    {
+      return __builtin_cpu_supports("avx2");
+    }
+#endif
+
+    std::vector<butterfly_kernel>
+    make_butterfly_kernels()
+    {
+      std::vector<butterfly_kernel> kernels;
+      butterfly_kernel k;
+
+#ifdef LV_HAVE_X86_KERNELS
+      k.name = "avx2";
+      k.is_supported = avx2_is_supported;
+      k.min_states = 32;
+      k.max_outputs = 16;
+      k.acs = butterfly_avx2;
+      kernels.push_back(k);
+
+      k.name = "ssse3";
+      k.is_supported = ssse3_is_supported;
+      k.min_states = 16;
+      k.max_outputs = 16;
+      k.acs = butterfly_ssse3;
+      kernels.push_back(k);
+#endif
+
+      k.name = "generic";
+      k.is_supported = generic_is_supported;
+      k.min_states = 2;
+      k.max_outputs = 256;
+      k.acs = butterfly_generic;
+      kernels.push_back(k);
+
+      return kernels;
+    }
+
+  } // anonymous namespace
+
+  const std::vector<butterfly_kernel> &
+  butterfly_kernels()
+  {
+    static const std::vector<butterfly_kernel> kernels = make_butterfly_kernels();
+    return kernels;
+  }
+
+  const butterfly_kernel &
+  best_butterfly_kernel(int S, int O)
+  {
+    const std::vector<butterfly_kernel> &kernels = butterfly_kernels();
+
+    for(size_t i=0 ; i < kernels.size() ; ++i) {
+      if(kernels[i].is_supported() && S >= kernels[i].min_states
+          && O <= kernels[i].max_outputs) {
+        return kernels[i];
+      }
+    }
+
+    return kernels.back();
+  }
+
+} // namespace lazyviterbi
+} // namespace gr
@@ -0,0 +1,85 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_BUTTERFLY_KERNELS_H
+#define INCLUDED_LAZYVITERBI_BUTTERFLY_KERNELS_H
+
+#include <lazyviterbi/api.h>
+#include <stdint.h>
+#include <vector>
+
+namespace gr {
+namespace lazyviterbi {
+
+  /*!
+   * \brief Add-compare-select of a trellis section of a shift-register code
+   * (S states, binary input), in butterflies.
+   *
+   * States j and j + S/2 are the predecessors of states 2j and 2j + 1. Path
+   * metrics are 16-bit integers with modulo arithmetic (see modulo_less()):
+   * alpha_curr[n] is the smallest of the two candidates, and bit n of
+   * decisions is set if it comes from the predecessor j + S/2 (ties go to j).
+   *
+   * Branch metrics of the section, metrics_k[0..O), are looked up through
+   * idx_a and idx_b: for each chunk c of 8 butterflies (j = 8c + l),
+   * idx_a[16c + l] (resp. idx_a[16c + 8 + l]) is the output symbol of the
+   * branch from state j to state 2j (resp. 2j + 1), and idx_b the same for
+   * branches from state j + S/2. metrics_k must be readable on 16 bytes.
+   */
+  typedef void (*butterfly_acs_kernel)(const uint16_t *alpha_prev,
+      uint16_t *alpha_curr, const uint8_t *metrics_k, const uint8_t *idx_a,
+      const uint8_t *idx_b, uint64_t *decisions, int S);
+
+  /*!
+   * \brief One implementation of the butterfly add-compare-select, in the way
+   * of VOLK kernels. Every implementation gives the same result as the
+   * generic one.
+   */
+  struct butterfly_kernel
+  {
+    //! Name of the implementation ("generic", "ssse3", "avx2").
+    const char *name;
+    //! True if the running CPU supports this implementation.
+    bool (*is_supported)();
+    //! Smallest number of states handled.
+    int min_states;
+    //! Largest number of output symbols handled.
+    int max_outputs;
+    //! Add-compare-select of one section.
+    butterfly_acs_kernel acs;
+  };
+
+  /*!
+   * \brief Every implementation compiled in, from the fastest to the generic
+   * one (whether or not the running CPU supports them). Exported for the unit
+   * tests.
+   */
+  LAZYVITERBI_API const std::vector<butterfly_kernel> &butterfly_kernels();
+
+  /*!
+   * \brief Fastest implementation supported by the running CPU for S states
+   * and O output symbols.
+   */
+  const butterfly_kernel &best_butterfly_kernel(int S, int O);
+
+} // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_BUTTERFLY_KERNELS_H */
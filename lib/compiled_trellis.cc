@@ -0,0 +1,432 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/thread/thread.h>
+#include <boost/weak_ptr.hpp>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <lazyviterbi/compiled_trellis.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace gr {
+namespace lazyviterbi {
+
+  namespace {
+
+    //Header of trellis files, followed by the tables (int32 items in the
+    //byte order of the machine which saved them)
+    struct file_header
+    {
+      char magic[8];
+      uint32_t version;
+      uint32_t byte_order;
+      int32_t I, S, O;
+      int32_t max_size_PS_s;
+      int32_t is_regular;
+      int32_t n_branches;
+      uint64_t hash;
+      char pad[16];
+    };
+
+    const char FILE_MAGIC[8] = { 'L', 'V', 'T', 'R', 'E', 'L', 'L', 'I' };
+    const uint32_t FILE_VERSION = 1;
+    const uint32_t FILE_BYTE_ORDER = 0x01020304;
+
+    //Number of items of the tables
+    uint64_t
+    n_table_items(uint64_t I, uint64_t S, uint64_t n_branches)
+    {
+      return (S + 1) + 3*n_branches + 2*S*I;
+    }
+
+    //FNV-1a hash of the description of a trellis
+    uint64_t
+    hash_ints(uint64_t h, const int *v, size_t n)
+    {
+      for(size_t i=0 ; i < n ; ++i) {
+        uint32_t x = (uint32_t)v[i];
+        for(int b=0 ; b < 4 ; ++b) {
+          h ^= (x >> (8*b)) & 0xff;
+          h *= 1099511628211ULL;
+        }
+      }
+
+      return h;
+    }
+
+    uint64_t
+    hash_trellis(int I, int S, int O, const int *NS, const int *OS)
+    {
+      int dims[3] = { I, S, O };
+      uint64_t h = 14695981039346656037ULL;
+
+      h = hash_ints(h, dims, 3);
+      h = hash_ints(h, NS, (size_t)S*I);
+      h = hash_ints(h, OS, (size_t)S*I);
+
+      return h;
+    }
+
+    bool
+    all_in_range(const int *v, size_t n, int end)
+    {
+      for(size_t i=0 ; i < n ; ++i) {
+        if(v[i] < 0 || v[i] >= end) {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    //True if the branch tables of t (offsets, PS, PI and OS) are the ones
+    //get() builds from its NS and fsm_OS (which must be in range): branches
+    //yielding to each state, in the order of gr::trellis::fsm::PS()
+    bool
+    branches_match(const compiled_trellis &t)
+    {
+      const int I = t.I();
+      const int S = t.S();
+      const int *NS = t.NS();
+      std::vector<int> next(S + 1, 0);
+
+      //Index of the first branch yielding to each state
+      for(size_t b=0 ; b < (size_t)S*I ; ++b) {
+        ++next[NS[b] + 1];
+      }
+      for(int s=0 ; s < S ; ++s) {
+        next[s + 1] += next[s];
+      }
+      if(next[S] != t.n_branches()
+          || !std::equal(next.begin(), next.end(), t.offsets())) {
+        return false;
+      }
+
+      for(int s=0 ; s < S ; ++s) {
+        for(int i=0 ; i < I ; ++i) {
+          size_t b = (size_t)s*I + i;
+          int c = next[NS[b]]++;
+
+          if(t.PS()[c] != s || t.PI()[c] != i || t.OS()[c] != t.fsm_OS()[b]) {
+            return false;
+          }
+        }
+      }
+
+      return true;
+    }
+
+    //Trellises used by the decoders of the process, by hash
+    typedef std::multimap< uint64_t, boost::weak_ptr<const compiled_trellis> > trellis_cache;
+
+    trellis_cache &
+    cache()
+    {
+      static trellis_cache c;
+      return c;
+    }
+
+    gr::thread::mutex &
+    cache_lock()
+    {
+      static gr::thread::mutex m;
+      return m;
+    }
+
+  } // anonymous namespace
+
+  compiled_trellis::compiled_trellis()
+    : d_I(0), d_S(0), d_O(0), d_max_size_PS_s(0), d_is_regular(true),
+    d_n_branches(0), d_hash(0), d_map(NULL), d_map_size(0)
+  {
+  }
+
+  compiled_trellis::~compiled_trellis()
+  {
+#ifndef _WIN32
+    if(d_map) {
+      munmap(d_map, d_map_size);
+    }
+#endif
+  }
+
+  void
+  compiled_trellis::set_tables(const int *tables)
+  {
+    d_offsets = tables;
+    d_PS = d_offsets + d_S + 1;
+    d_PI = d_PS + d_n_branches;
+    d_OS = d_PI + d_n_branches;
+    d_NS = d_OS + d_n_branches;
+    d_fsm_OS = d_NS + (size_t)d_S*d_I;
+  }
+
+  bool
+  compiled_trellis::same_tables(const compiled_trellis &other) const
+  {
+    size_t n = (size_t)d_S*d_I;
+
+    return d_I == other.d_I && d_S == other.d_S && d_O == other.d_O
+      && std::equal(d_NS, d_NS + n, other.d_NS)
+      && std::equal(d_fsm_OS, d_fsm_OS + n, other.d_fsm_OS);
+  }
+
+  compiled_trellis::sptr
+  compiled_trellis::share(const sptr &candidate)
+  {
+    gr::thread::scoped_lock guard(cache_lock());
+    trellis_cache &c = cache();
+
+    std::pair<trellis_cache::iterator, trellis_cache::iterator> range =
+      c.equal_range(candidate->d_hash);
+    for(trellis_cache::iterator it = range.first ; it != range.second ; ) {
+      sptr cached = it->second.lock();
+
+      if(!cached) {
+        //No decoder uses this trellis anymore
+        c.erase(it++);
+      }
+      else if(cached->same_tables(*candidate)) {
+        return cached;
+      }
+      else {
+        ++it;
+      }
+    }
+
+    c.insert(std::make_pair(candidate->d_hash,
+          boost::weak_ptr<const compiled_trellis>(candidate)));
+
+    return candidate;
+  }
+
+  compiled_trellis::sptr
+  compiled_trellis::get(const gr::trellis::fsm &FSM)
+  {
+    const std::vector< std::vector<int> > &PS = FSM.PS();
+    const std::vector< std::vector<int> > &PI = FSM.PI();
+    const std::vector<int> &NS = FSM.NS();
+    const std::vector<int> &OS = FSM.OS();
+    boost::shared_ptr<compiled_trellis> t(new compiled_trellis());
+
+    t->d_I = FSM.I();
+    t->d_S = FSM.S();
+    t->d_O = FSM.O();
+    for(int s=0 ; s < t->d_S ; ++s) {
+      t->d_n_branches += (int)PS[s].size();
+      t->d_max_size_PS_s = std::max(t->d_max_size_PS_s, (int)PS[s].size());
+      t->d_is_regular = t->d_is_regular && ((int)PS[s].size() == t->d_I);
+    }
+
+    t->d_storage.resize(n_table_items(t->d_I, t->d_S, t->d_n_branches));
+    int *offsets = &t->d_storage[0];
+    int *ps = offsets + t->d_S + 1;
+    int *pi = ps + t->d_n_branches;
+    int *os = pi + t->d_n_branches;
+    int b = 0;
+
+    for(int s=0 ; s < t->d_S ; ++s) {
+      offsets[s] = b;
+      for(size_t i=0 ; i < PS[s].size() ; ++i, ++b) {
+        ps[b] = PS[s][i];
+        pi[b] = PI[s][i];
+        os[b] = OS[PS[s][i]*t->d_I + PI[s][i]];
+      }
+    }
+    offsets[t->d_S] = b;
+    std::copy(NS.begin(), NS.end(), os + t->d_n_branches);
+    std::copy(OS.begin(), OS.end(), os + t->d_n_branches + NS.size());
+
+    t->set_tables(offsets);
+    t->d_hash = hash_trellis(t->d_I, t->d_S, t->d_O, t->d_NS, t->d_fsm_OS);
+
+    return share(t);
+  }
+
+  compiled_trellis::sptr
+  compiled_trellis::load(const std::string &path)
+  {
+    boost::shared_ptr<compiled_trellis> t(new compiled_trellis());
+    const char *data = NULL;
+    size_t size = 0;
+
+#ifndef _WIN32
+    //Map the file as is
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+
+    if(fd < 0 || fstat(fd, &st) != 0) {
+      if(fd >= 0) {
+        close(fd);
+      }
+      throw std::runtime_error("compiled_trellis: cannot open " + path);
+    }
+
+    size = (size_t)st.st_size;
+    if(size >= sizeof(file_header)) {
+      void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if(map != MAP_FAILED) {
+        t->d_map = map;
+        t->d_map_size = size;
+        data = (const char*)map;
+      }
+    }
+    close(fd);
+
+    if(size >= sizeof(file_header) && !data) {
+      throw std::runtime_error("compiled_trellis: cannot map " + path);
+    }
+#else
+    //Read the whole file
+    std::ifstream f(path.c_str(), std::ios::binary | std::ios::ate);
+    if(!f) {
+      throw std::runtime_error("compiled_trellis: cannot open " + path);
+    }
+
+    size = (size_t)f.tellg();
+    t->d_storage.resize((size + sizeof(int) - 1)/sizeof(int));
+    f.seekg(0);
+    f.read((char*)&t->d_storage[0], size);
+    data = (const char*)&t->d_storage[0];
+#endif
+
+    //Check the header
+    file_header h;
+    if(size < sizeof(file_header)) {
+      throw std::invalid_argument("compiled_trellis: " + path + " is not a trellis file");
+    }
+    std::memcpy(&h, data, sizeof(h));
+
+    if(std::memcmp(h.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0
+        || h.version != FILE_VERSION) {
+      throw std::invalid_argument("compiled_trellis: " + path + " is not a trellis file");
+    }
+    if(h.byte_order != FILE_BYTE_ORDER) {
+      throw std::invalid_argument("compiled_trellis: " + path + " was saved with another byte order");
+    }
+    //Sizes of the tables are checked against the size of the file before
+    //n_table_items() adds them up, so that it cannot wrap around
+    const uint64_t n_items = (size - sizeof(file_header))/sizeof(int);
+    if(h.I < 1 || h.S < 1 || h.O < 1 || h.n_branches < 0
+        || (size - sizeof(file_header)) % sizeof(int) != 0
+        || (uint64_t)h.S*h.I > n_items || (uint64_t)h.n_branches > n_items
+        || n_table_items(h.I, h.S, h.n_branches) != n_items) {
+      throw std::invalid_argument("compiled_trellis: " + path + " is corrupted");
+    }
+
+    t->d_I = h.I;
+    t->d_S = h.S;
+    t->d_O = h.O;
+    t->d_max_size_PS_s = h.max_size_PS_s;
+    t->d_is_regular = (h.is_regular != 0);
+    t->d_n_branches = h.n_branches;
+    t->d_hash = h.hash;
+    t->set_tables((const int*)(data + sizeof(file_header)));
+
+    //Check the tables: decoders index their buffers with them, and share()
+    //hands them to every decoder of the same trellis. The hash only covers
+    //NS and fsm_OS: the branch tables, and the properties of the trellis
+    //given by the header, must be the ones get() derives from them.
+    const size_t n = (size_t)t->d_S*t->d_I;
+    bool valid = all_in_range(t->d_NS, n, t->d_S)
+      && all_in_range(t->d_fsm_OS, n, t->d_O)
+      && hash_trellis(t->d_I, t->d_S, t->d_O, t->d_NS, t->d_fsm_OS) == t->d_hash
+      && branches_match(*t);
+
+    int max_size_PS_s = 0;
+    bool is_regular = true;
+    for(int s=0 ; valid && s < t->d_S ; ++s) {
+      int n_s = t->d_offsets[s + 1] - t->d_offsets[s];
+
+      max_size_PS_s = std::max(max_size_PS_s, n_s);
+      is_regular = is_regular && (n_s == t->d_I);
+    }
+    valid = valid && max_size_PS_s == t->d_max_size_PS_s
+      && is_regular == t->d_is_regular;
+
+    if(!valid) {
+      throw std::invalid_argument("compiled_trellis: " + path + " is corrupted");
+    }
+
+    return share(t);
+  }
+
+  void
+  compiled_trellis::save(const std::string &path) const
+  {
+    file_header h;
+
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+    h.version = FILE_VERSION;
+    h.byte_order = FILE_BYTE_ORDER;
+    h.I = d_I;
+    h.S = d_S;
+    h.O = d_O;
+    h.max_size_PS_s = d_max_size_PS_s;
+    h.is_regular = d_is_regular ? 1 : 0;
+    h.n_branches = d_n_branches;
+    h.hash = d_hash;
+
+    std::ofstream f(path.c_str(), std::ios::binary | std::ios::trunc);
+    f.write((const char*)&h, sizeof(h));
+    f.write((const char*)d_offsets,
+        sizeof(int)*n_table_items(d_I, d_S, d_n_branches));
+
+    if(!f) {
+      throw std::runtime_error("compiled_trellis: cannot write " + path);
+    }
+  }
+
+  bool
+  compiled_trellis::describes(int I, int S, int O, const std::vector<int> &NS,
+      const std::vector<int> &OS) const
+  {
+    size_t n = (size_t)d_S*d_I;
+
+    return I == d_I && S == d_S && O == d_O && NS.size() == n && OS.size() == n
+      && std::equal(NS.begin(), NS.end(), d_NS)
+      && std::equal(OS.begin(), OS.end(), d_fsm_OS);
+  }
+
+  gr::trellis::fsm
+  compiled_trellis::fsm() const
+  {
+    size_t n = (size_t)d_S*d_I;
+
+    return gr::trellis::fsm(d_I, d_S, d_O, std::vector<int>(d_NS, d_NS + n),
+        std::vector<int>(d_fsm_OS, d_fsm_OS + n));
+  }
+
+} // namespace lazyviterbi
+} // namespace gr
@@ -0,0 +1,245 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <boost/bind.hpp>
+#include "decode_pool.h"
+
+namespace gr {
+namespace lazyviterbi {
+
+  //std::min takes it by reference
+  const int decode_pool::MAX_WORKERS;
+
+  decode_pool &
+  decode_pool::instance()
+  {
+    static decode_pool pool;
+    return pool;
+  }
+
+  decode_pool::decode_pool()
+    : d_next_worker(0), d_n_queued(0), d_stop(false)
+  {
+  }
+
+  decode_pool::~decode_pool()
+  {
+    stop_workers();
+  }
+
+  int
+  decode_pool::size() const
+  {
+    boost::shared_lock<boost::shared_mutex> guard(d_size_lock);
+    return (int)d_workers.size();
+  }
+
+  void
+  decode_pool::set_size(int n_workers)
+  {
+    n_workers = std::max(0, std::min(n_workers, MAX_WORKERS));
+
+    boost::unique_lock<boost::shared_mutex> guard(d_size_lock);
+
+    if((size_t)n_workers == d_workers.size()) {
+      return;
+    }
+
+    //No batch is running at this point: every queue is empty
+    stop_workers();
+
+    d_stop = false;
+    d_next_worker = 0;
+
+    for(int w=0 ; w < n_workers ; ++w) {
+      d_workers.push_back(boost::shared_ptr<worker>(new worker));
+    }
+
+    for(int w=0 ; w < n_workers ; ++w) {
+      d_threads.push_back(boost::shared_ptr<gr::thread::thread>(
+            new gr::thread::thread(boost::bind(&decode_pool::worker_loop, this, w))));
+    }
+  }
+
+  void
+  decode_pool::run(int n_jobs, const job_function &job)
+  {
+    boost::shared_lock<boost::shared_mutex> guard(d_size_lock);
+
+    //Without workers, jobs are run by the calling thread
+    if(d_workers.empty()) {
+      std::exception_ptr error;
+      for(int j=0 ; j < n_jobs ; ++j) {
+        try {
+          job(j, 0);
+        }
+        catch(...) {
+          if(!error) {
+            error = std::current_exception();
+          }
+        }
+      }
+
+      if(error) {
+        std::rethrow_exception(error);
+      }
+      return;
+    }
+
+    if(n_jobs <= 0) {
+      return;
+    }
+
+    batch b;
+    b.job = &job;
+    b.n_pending = n_jobs;
+
+    //Deal jobs to the workers
+    size_t w;
+    {
+      gr::thread::scoped_lock idle_guard(d_idle_lock);
+      w = d_next_worker;
+      d_next_worker = (d_next_worker + n_jobs) % d_workers.size();
+    }
+
+    for(int j=0 ; j < n_jobs ; ++j) {
+      task t = {&b, j};
+      worker &wk = *d_workers[w];
+
+      {
+        gr::thread::scoped_lock worker_guard(wk.lock);
+        wk.tasks.push_back(t);
+      }
+
+      w = (w + 1) % d_workers.size();
+    }
+
+    {
+      gr::thread::scoped_lock idle_guard(d_idle_lock);
+      d_n_queued += n_jobs;
+    }
+    d_wakeup.notify_all();
+
+    //Wait for the batch to complete
+    gr::thread::scoped_lock batch_guard(b.lock);
+    while(b.n_pending > 0) {
+      b.done.wait(batch_guard);
+    }
+
+    if(b.error) {
+      std::rethrow_exception(b.error);
+    }
+  }
+
+  void
+  decode_pool::stop_workers()
+  {
+    {
+      gr::thread::scoped_lock idle_guard(d_idle_lock);
+      d_stop = true;
+    }
+    d_wakeup.notify_all();
+
+    for(size_t w=0 ; w < d_threads.size() ; ++w) {
+      d_threads[w]->join();
+    }
+
+    d_threads.clear();
+    d_workers.clear();
+    d_n_queued = 0;
+  }
+
+  bool
+  decode_pool::pop_task(size_t w, task &t)
+  {
+    const size_t n_workers = d_workers.size();
+
+    //Newest task of our own queue
+    {
+      worker &wk = *d_workers[w];
+      gr::thread::scoped_lock worker_guard(wk.lock);
+
+      if(!wk.tasks.empty()) {
+        t = wk.tasks.back();
+        wk.tasks.pop_back();
+        return true;
+      }
+    }
+
+    //Oldest task of another queue
+    for(size_t i=1 ; i < n_workers ; ++i) {
+      worker &victim = *d_workers[(w + i) % n_workers];
+      gr::thread::scoped_lock worker_guard(victim.lock);
+
+      if(!victim.tasks.empty()) {
+        t = victim.tasks.front();
+        victim.tasks.pop_front();
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void
+  decode_pool::worker_loop(size_t w)
+  {
+    task t;
+
+    while(true) {
+      if(pop_task(w, t)) {
+        {
+          gr::thread::scoped_lock idle_guard(d_idle_lock);
+          --d_n_queued;
+        }
+
+        //An exception escaping the thread would terminate the process: it
+        //is handed to run()
+        std::exception_ptr error;
+        try {
+          (*t.b->job)(t.job, (int)w);
+        }
+        catch(...) {
+          error = std::current_exception();
+        }
+
+        gr::thread::scoped_lock batch_guard(t.b->lock);
+        if(error && !t.b->error) {
+          t.b->error = error;
+        }
+        if(--t.b->n_pending == 0) {
+          t.b->done.notify_one();
+        }
+        continue;
+      }
+
+      gr::thread::scoped_lock idle_guard(d_idle_lock);
+      if(d_stop) {
+        return;
+      }
+      if(d_n_queued <= 0) {
+        d_wakeup.wait(idle_guard);
+      }
+    }
+  }
+
+} // namespace lazyviterbi
+} // namespace gr
@@ -0,0 +1,134 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_DECODE_POOL_H
+#define INCLUDED_LAZYVITERBI_DECODE_POOL_H
+
+#include <lazyviterbi/api.h>
+#include <gnuradio/thread/thread.h>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <deque>
+#include <exception>
+#include <vector>
+
+namespace gr {
+namespace lazyviterbi {
+
+  /*!
+   * \brief Process-wide pool of decoding threads, shared by every decoder
+   * instance.
+   *
+   * Decoders submit batches of independent jobs (one per stream and per
+   * block). Jobs are dealt round-robin to the workers' queues; each worker
+   * runs the jobs of its own queue (newest first), and steals the oldest jobs
+   * of the other queues when its own is empty.
+   *
+   * Jobs are given the index of the worker running them, so that decoders can
+   * keep one set of scratch buffers per worker.
+   *
+   * The pool is empty by default: jobs are then run by the calling thread.
+   *
+   * Exported for the unit tests.
+   */
+  class LAZYVITERBI_API decode_pool
+  {
+   public:
+    //! Largest number of workers.
+    static const int MAX_WORKERS = 256;
+
+    //! job(job index, worker index)
+    typedef boost::function<void(int, int)> job_function;
+
+    //! The pool.
+    static decode_pool &instance();
+
+    //! Number of workers.
+    int size() const;
+
+    /*!
+     * \brief Set the number of workers (clamped to [0, MAX_WORKERS]).
+     *
+     * Waits for the running batches to complete.
+     */
+    void set_size(int n_workers);
+
+    /*!
+     * \brief Run job(j, w) for every j in [0, n_jobs), w < max(size(), 1) being
+     * the index of the worker running the job. Returns once every job is done.
+     *
+     * Jobs throwing an exception do not stop the others: once every job is
+     * done, the first exception caught is rethrown, whatever the size of the
+     * pool.
+     */
+    void run(int n_jobs, const job_function &job);
+
+   private:
+    struct batch
+    {
+      const job_function *job;
+      int n_pending;
+      //First exception thrown by a job
+      std::exception_ptr error;
+      gr::thread::mutex lock;
+      gr::thread::condition_variable done;
+    };
+
+    struct task
+    {
+      batch *b;
+      int job;
+    };
+
+    struct worker
+    {
+      gr::thread::mutex lock;
+      std::deque<task> tasks;
+    };
+
+    std::vector<boost::shared_ptr<worker> > d_workers;
+    std::vector<boost::shared_ptr<gr::thread::thread> > d_threads;
+    //Worker receiving the first job of the next batch
+    size_t d_next_worker;
+
+    //Idle workers wait for tasks on d_wakeup
+    gr::thread::mutex d_idle_lock;
+    gr::thread::condition_variable d_wakeup;
+    long d_n_queued;
+    bool d_stop;
+
+    //Held shared by run(), exclusively by set_size()
+    mutable boost::shared_mutex d_size_lock;
+
+    decode_pool();
+    ~decode_pool();
+    decode_pool(const decode_pool &);
+    decode_pool &operator=(const decode_pool &);
+
+    void stop_workers();
+    bool pop_task(size_t w, task &t);
+    void worker_loop(size_t w);
+  };
+
+} // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_DECODE_POOL_H */
@@ -0,0 +1,56 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "decode_stats.h"
+
+namespace gr {
+  namespace lazyviterbi {
+
+    pmt::pmt_t
+    stats_to_pmt(const decoder::counters &stats)
+    {
+      pmt::pmt_t dict = pmt::make_dict();
+
+      dict = pmt::dict_add(dict, pmt::mp("blocks"), pmt::from_uint64(stats.blocks));
+      dict = pmt::dict_add(dict, pmt::mp("sections"), pmt::from_uint64(stats.sections));
+      dict = pmt::dict_add(dict, pmt::mp("decode_ns"), pmt::from_uint64(stats.decode_ns));
+      dict = pmt::dict_add(dict, pmt::mp("nodes_expanded"),
+          pmt::from_uint64(stats.nodes_expanded));
+      dict = pmt::dict_add(dict, pmt::mp("shadow_pushes"),
+          pmt::from_uint64(stats.shadow_pushes));
+      dict = pmt::dict_add(dict, pmt::mp("stale_pops"),
+          pmt::from_uint64(stats.stale_pops));
+      dict = pmt::dict_add(dict, pmt::mp("buckets_scanned"),
+          pmt::from_uint64(stats.buckets_scanned));
+      dict = pmt::dict_add(dict, pmt::mp("fast_path_blocks"),
+          pmt::from_uint64(stats.fast_path_blocks));
+      dict = pmt::dict_add(dict, pmt::mp("latency_hist"),
+          pmt::init_u64vector(decoder::counters::LATENCY_BINS,
+            stats.latency_hist));
+
+      return dict;
+    }
+
+  } /* namespace lazyviterbi */
+} /* namespace gr */
@@ -0,0 +1,116 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_DECODE_STATS_H
+#define INCLUDED_LAZYVITERBI_DECODE_STATS_H
+
+#include <lazyviterbi/decoder.h>
+#include <pmt/pmt.h>
+#include <boost/shared_ptr.hpp>
+#include <chrono>
+#include <vector>
+
+namespace gr {
+  namespace lazyviterbi {
+
+    //Sum of the counters of the workspaces of the workers of a block
+    template <typename W>
+    decoder::counters
+    sum_stats(const std::vector< boost::shared_ptr<W> > &workspaces)
+    {
+      decoder::counters sum;
+      for(size_t w=0 ; w < workspaces.size() ; ++w) {
+        if(workspaces[w]) {
+          sum.add(workspaces[w]->stats);
+        }
+      }
+
+      return sum;
+    }
+
+    template <typename W>
+    void
+    clear_stats(const std::vector< boost::shared_ptr<W> > &workspaces)
+    {
+      for(size_t w=0 ; w < workspaces.size() ; ++w) {
+        if(workspaces[w]) {
+          workspaces[w]->stats.clear();
+        }
+      }
+    }
+
+    /*
+     * Dictionary of counters, as returned by the stats() getter of the
+     * blocks and published on their "stats" message port: blocks, sections,
+     * decode_ns, nodes_expanded, shadow_pushes, stale_pops, buckets_scanned
+     * (uint64) and latency_hist (u64vector).
+     */
+    pmt::pmt_t stats_to_pmt(const decoder::counters &stats);
+
+    /*
+     * Schedule of the publication of counters on the "stats" message port of
+     * a block, every period seconds (never if 0).
+     */
+    class stats_schedule
+    {
+     private:
+      typedef std::chrono::steady_clock clock;
+
+      double d_period;
+      clock::time_point d_last;
+
+     public:
+      stats_schedule() : d_period(0.0), d_last(clock::now()) {}
+
+      double period() const { return d_period; }
+      void set_period(double period)
+      {
+        d_period = (period < 0.0) ? 0.0 : period;
+        d_last = clock::now();
+      }
+
+      //True once per period (to be called after each call of general_work)
+      bool due()
+      {
+        if(d_period <= 0.0) {
+          return false;
+        }
+
+        clock::time_point now = clock::now();
+        if(std::chrono::duration<double>(now - d_last).count() < d_period) {
+          return false;
+        }
+
+        d_last = now;
+        return true;
+      }
+    };
+
+    //Name of the message port publishing counters
+    inline pmt::pmt_t
+    stats_port()
+    {
+      return pmt::mp("stats");
+    }
+
+  } // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_DECODE_STATS_H */
@@ -23,30 +23,118 @@
 #endif
 
 #include <gnuradio/io_signature.h>
+#include <boost/bind.hpp>
+#include <algorithm>
 #include "dynamic_viterbi_impl.h"
+#include "decode_pool.h"
 
 namespace gr {
   namespace lazyviterbi {
 
     dynamic_viterbi::sptr
-    dynamic_viterbi::make(const gr::trellis::fsm &FSM, int K, int S0, int SK, float thres)
+    dynamic_viterbi::make(const gr::trellis::fsm &FSM, int K, int S0, int SK,
+        float thres, bool adaptive)
     {
       return gnuradio::get_initial_sptr
-        (new dynamic_viterbi_impl(FSM, K, S0, SK, thres));
+        (new dynamic_viterbi_impl(FSM, K, S0, SK, thres, adaptive));
     }
 
     /*
      * The private constructor
      */
-    dynamic_viterbi_impl::dynamic_viterbi_impl(const gr::trellis::fsm &FSM, int K, int S0, int SK, float thres)
+    dynamic_viterbi_impl::dynamic_viterbi_impl(const gr::trellis::fsm &FSM,
+        int K, int S0, int SK, float thres, bool adaptive)
       : gr::block("dynamic_viterbi",
               gr::io_signature::make(1, -1, sizeof(float)),
               gr::io_signature::make(1, -1, sizeof(char))),
-        d_FSM(FSM), d_K(K), d_S0(S0), d_SK(SK), d_is_lazy(true), d_thres(thres),
-        d_lazy_block(FSM, K, S0, SK), d_viterbi_block(FSM, K, S0, SK)
+        d_lazy_workspaces(decode_pool::MAX_WORKERS),
+        d_viterbi_workspaces(decode_pool::MAX_WORKERS),
+        d_lazy_nodes_valid(decode_pool::MAX_WORKERS, 0),
+        d_ratio_sums(decode_pool::MAX_WORKERS, 0.0), d_is_lazy(true),
+        d_thres(thres), d_adaptive(adaptive), d_selector(2), d_FSM(FSM),
+        d_K(K), d_S0(S0), d_SK(SK)
     {
+      compiled_trellis::sptr trellis = compiled_trellis::get(FSM);
+
+      d_lazy_decoder.reset(new lazy_viterbi_decoder(trellis, S0, SK));
+      d_lazy_decoder->check_block_length(d_K);
+      d_viterbi_decoder.reset(new viterbi_decoder(trellis, S0, SK));
+
       set_relative_rate(1.0 / ((double)d_FSM.O()));
       set_output_multiple(d_K);
+
+      message_port_register_out(stats_port());
+    }
+
+    int
+    dynamic_viterbi_impl::pool_size() const
+    {
+      return decode_pool::instance().size();
+    }
+
+    void
+    dynamic_viterbi_impl::set_pool_size(int n_threads)
+    {
+      decode_pool::instance().set_size(n_threads);
+    }
+
+    pmt::pmt_t
+    dynamic_viterbi_impl::stats()
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      return make_stats();
+    }
+
+    pmt::pmt_t
+    dynamic_viterbi_impl::make_stats() const
+    {
+      decoder::counters lazy_stats = sum_stats(d_lazy_workspaces);
+      decoder::counters viterbi_stats = sum_stats(d_viterbi_workspaces);
+      double ratio_sum = 0.0;
+
+      for(size_t w=0 ; w < d_ratio_sums.size() ; ++w) {
+        ratio_sum += d_ratio_sums[w];
+      }
+
+      decoder::counters stats = lazy_stats;
+      stats.add(viterbi_stats);
+
+      pmt::pmt_t dict = stats_to_pmt(stats);
+      dict = pmt::dict_add(dict, pmt::mp("lazy_blocks"),
+          pmt::from_uint64(lazy_stats.blocks));
+      dict = pmt::dict_add(dict, pmt::mp("viterbi_blocks"),
+          pmt::from_uint64(viterbi_stats.blocks));
+      dict = pmt::dict_add(dict, pmt::mp("mean_ratio"),
+          pmt::from_double(stats.blocks ? ratio_sum / stats.blocks : 0.0));
+
+      return dict;
+    }
+
+    void
+    dynamic_viterbi_impl::reset_stats()
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+
+      clear_stats(d_lazy_workspaces);
+      clear_stats(d_viterbi_workspaces);
+      std::fill(d_ratio_sums.begin(), d_ratio_sums.end(), 0.0);
+    }
+
+    void
+    dynamic_viterbi_impl::set_stats_period(double period)
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+
+      d_stats_schedule.set_period(period);
+    }
+
+    void
+    dynamic_viterbi_impl::set_fast_path(bool fast_path)
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+
+      d_lazy_decoder->set_fast_path(fast_path);
+      d_viterbi_decoder->set_fast_path(fast_path);
     }
 
     void
@@ -55,8 +143,6 @@ namespace gr {
       gr::thread::scoped_lock guard(d_setlock);
 
       d_S0 = S0;
-      d_lazy_block.set_S0(S0);
-      d_viterbi_block.set_S0(S0);
     }
 
     void
@@ -65,7 +151,6 @@ namespace gr {
       gr::thread::scoped_lock guard(d_setlock);
 
       d_SK = SK;
-      d_viterbi_block.set_SK(SK);
     }
 
     void
@@ -76,6 +161,14 @@ namespace gr {
       d_thres = thres;
     }
 
+    void
+    dynamic_viterbi_impl::set_adaptive(bool adaptive)
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+
+      d_adaptive = adaptive;
+    }
+
     void
     dynamic_viterbi_impl::forecast (int noutput_items, gr_vector_int &ninput_items_required)
     {
@@ -96,24 +189,13 @@ namespace gr {
       int nstreams = input_items.size();
       int nblocks = noutput_items / d_K;
 
-      for(int m = 0; m < nstreams; m++) {
-        const float *in = (const float*)input_items[m];
-        unsigned char *out = (unsigned char*)output_items[m];
-
-        for(int n = 0; n < nblocks; n++) {
-          choose_algo(&(in[n*d_K*d_FSM.O()]), d_K, d_FSM.O());
-
-          if(d_is_lazy) {
-            d_lazy_block.lazy_viterbi_algorithm(d_FSM.I(), d_FSM.S(), d_FSM.O(),
-                d_FSM.NS(), d_FSM.OS(), d_K, d_S0, d_SK, &(in[n*d_K*d_FSM.O()]),
-                &(out[n*d_K]));
-          }
-          else {
-            d_viterbi_block.viterbi_algorithm(d_FSM.I(), d_FSM.S(), d_FSM.O(),
-                d_FSM.NS(), d_FSM.OS(), d_FSM.PS(), d_FSM.PI(), d_K, d_S0, d_SK,
-                &(in[n*d_K*d_FSM.O()]), &(out[n*d_K]));
-          }
-        }
+      //One job per stream and per block
+      decode_pool::instance().run(nstreams*nblocks,
+          boost::bind(&dynamic_viterbi_impl::decode_block, this,
+            boost::cref(input_items), boost::ref(output_items), nblocks, _1, _2));
+
+      if(d_stats_schedule.due()) {
+        message_port_pub(stats_port(), make_stats());
       }
 
       consume_each (d_FSM.O() * noutput_items);
@@ -121,7 +203,98 @@ namespace gr {
     }
 
     void
-    dynamic_viterbi_impl::choose_algo(const float *metrics, int K, int O)
+    dynamic_viterbi_impl::make_workspaces(int worker)
+    {
+      //Only one algorithm runs at a time on a worker: both of them share the
+      //same scratch memory, sized for the largest of them
+      scratch_arena::sptr arena(new scratch_arena(
+            std::max(d_lazy_decoder->workspace_bytes(d_K),
+              d_viterbi_decoder->workspace_bytes(d_K)),
+            decoder::HUGE_PAGES_TRANSPARENT));
+
+      d_lazy_workspaces[worker] = boost::static_pointer_cast<lazy_viterbi_decoder::workspace>(
+          d_lazy_decoder->make_workspace(0));
+      d_lazy_decoder->carve_workspace(*d_lazy_workspaces[worker], d_K, arena);
+      d_lazy_nodes_valid[worker] = 1;
+
+      arena->rewind(0);
+      d_viterbi_workspaces[worker] = boost::static_pointer_cast<viterbi_decoder::workspace>(
+          d_viterbi_decoder->make_workspace(0));
+      d_viterbi_decoder->carve_workspace(*d_viterbi_workspaces[worker], d_K, arena);
+    }
+
+    void
+    dynamic_viterbi_impl::decode_block(const gr_vector_const_void_star &input_items,
+        gr_vector_void_star &output_items, int nblocks, int job, int worker)
+    {
+      int m = job / nblocks;
+      int n = job % nblocks;
+      const float *in = (const float*)input_items[m];
+      unsigned char *out = (unsigned char*)output_items[m];
+
+      if(!d_lazy_workspaces[worker]) {
+        make_workspaces(worker);
+      }
+
+      //Single pass over the metrics: they are quantized for the Lazy Viterbi
+      //algorithm while the ratio Q is measured
+      metrics_profile profile;
+      d_lazy_decoder->quantize_profiled(&(in[n*d_K*d_FSM.O()]), d_K,
+          d_lazy_decoder->scale(), profile, *d_lazy_workspaces[worker]);
+
+      float ratio = profile.ratio();
+      int bin = engine_selector::bin(ratio);
+      bool is_lazy;
+      d_ratio_sums[worker] += ratio;
+
+      if(d_adaptive) {
+        is_lazy = (d_selector.choose(bin) == LAZY_ENGINE);
+      }
+      else {
+        is_lazy = ratio > d_thres;
+      }
+
+      //is_lazy() reports the choice made for the last block
+      if(job == (int)input_items.size()*nblocks - 1) {
+        d_is_lazy = is_lazy;
+      }
+
+      if(is_lazy) {
+        //Erase the stamps left by the classical Viterbi algorithm
+        if(!d_lazy_nodes_valid[worker]) {
+          d_lazy_decoder->reset_workspace(*d_lazy_workspaces[worker]);
+          d_lazy_nodes_valid[worker] = 1;
+        }
+
+        uint64_t ns = d_lazy_workspaces[worker]->stats.decode_ns;
+        d_lazy_decoder->lazy_viterbi_quantized(d_K, d_S0, d_SK,
+            &(in[n*d_K*d_FSM.O()]), &(out[n*d_K]), *d_lazy_workspaces[worker]);
+        ns = d_lazy_workspaces[worker]->stats.decode_ns - ns;
+
+        //Blocks decoded in threshold mode are measured too
+        d_selector.update(bin, LAZY_ENGINE, ns, d_K);
+      }
+      else {
+        d_lazy_nodes_valid[worker] = 0;
+
+        uint64_t ns = d_viterbi_workspaces[worker]->stats.decode_ns;
+        d_viterbi_decoder->viterbi_algorithm(d_K, d_S0, d_SK,
+            &(in[n*d_K*d_FSM.O()]), &(out[n*d_K]),
+            *d_viterbi_workspaces[worker]);
+        ns = d_viterbi_workspaces[worker]->stats.decode_ns - ns;
+
+        d_selector.update(bin, VITERBI_ENGINE, ns, d_K);
+      }
+    }
+
+    bool
+    dynamic_viterbi_impl::choose_algo(const float *metrics, int K, int O) const
+    {
+      return metrics_ratio(metrics, K, O) > d_thres;
+    }
+
+    float
+    dynamic_viterbi_impl::metrics_ratio(const float *metrics, int K, int O) const
     {
       float acc_max=0.0, acc_min=0.0;
       const float* metrics_end = metrics + K*O;
@@ -137,12 +310,7 @@ namespace gr {
         metrics += O;
       }
 
-      if(acc_max/acc_min > d_thres) {
-        d_is_lazy = true;
-      }
-      else {
-        d_is_lazy = false;
-      }
+      return acc_max/acc_min;
     }
 
   } /* namespace lazyviterbi */
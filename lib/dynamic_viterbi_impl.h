@@ -23,8 +23,11 @@
 
 #include <numeric>
 #include <lazyviterbi/dynamic_viterbi.h>
-#include "lazy_viterbi_impl.h"
-#include "viterbi_impl.h"
+#include <boost/shared_ptr.hpp>
+#include "lazy_viterbi_decoder.h"
+#include "viterbi_decoder.h"
+#include "decode_stats.h"
+#include "engine_selector.h"
 
 namespace gr {
   namespace lazyviterbi {
@@ -32,18 +35,43 @@ namespace gr {
     class dynamic_viterbi_impl : public dynamic_viterbi
     {
      private:
-      lazy_viterbi_impl d_lazy_block;
-      viterbi_impl d_viterbi_block;
+      //Engines of the selector
+      enum { VITERBI_ENGINE = 0, LAZY_ENGINE = 1 };
+
+      //Decoders of both algorithms, sharing the tables of the trellis
+      boost::shared_ptr<lazy_viterbi_decoder> d_lazy_decoder;
+      boost::shared_ptr<viterbi_decoder> d_viterbi_decoder;
+      //Scratch buffers of each worker, for each decoder (both workspaces of
+      //a worker are carved from the same arena, at the same offset)
+      std::vector< boost::shared_ptr<lazy_viterbi_decoder::workspace> > d_lazy_workspaces;
+      std::vector< boost::shared_ptr<viterbi_decoder::workspace> > d_viterbi_workspaces;
+      //Whether real nodes of the lazy workspace of each worker are intact
+      //(they are overwritten by the classical Viterbi algorithm)
+      std::vector<char> d_lazy_nodes_valid;
+      //Sum of the ratios Q of the blocks decoded by each worker
+      std::vector<double> d_ratio_sums;
+      //Publication of the counters of the workspaces
+      stats_schedule d_stats_schedule;
       bool d_is_lazy;
       float d_thres;
+      bool d_adaptive;
+      //Measured costs of both algorithms (adaptive mode)
+      engine_selector d_selector;
 
       gr::trellis::fsm d_FSM;
       int d_K;
       int d_S0;
       int d_SK;
 
+      void make_workspaces(int worker);
+      //Counters of both algorithms, and of their choice
+      pmt::pmt_t make_stats() const;
+      void decode_block(const gr_vector_const_void_star &input_items,
+          gr_vector_void_star &output_items, int nblocks, int job, int worker);
+
      public:
-      dynamic_viterbi_impl(const gr::trellis::fsm &FSM, int K, int S0, int SK, float thres);
+      dynamic_viterbi_impl(const gr::trellis::fsm &FSM, int K, int S0, int SK,
+          float thres, bool adaptive);
 
       gr::trellis::fsm FSM() const  { return d_FSM; }
       int K()  const { return d_K; }
@@ -51,10 +79,20 @@ namespace gr {
       int SK()  const { return d_SK; }
       float thres()  const { return d_thres; }
       bool is_lazy()  const { return d_is_lazy; }
+      bool adaptive()  const { return d_adaptive; }
+      int pool_size() const;
+      pmt::pmt_t stats();
+      double stats_period() const { return d_stats_schedule.period(); }
+      bool fast_path() const { return d_lazy_decoder->fast_path(); }
 
       void set_S0(int S0);
       void set_SK(int SK);
       void set_thres(float thres);
+      void set_adaptive(bool adaptive);
+      void set_pool_size(int n_threads);
+      void reset_stats();
+      void set_stats_period(double period);
+      void set_fast_path(bool fast_path);
 
       // Where all the action really happens
       void forecast (int noutput_items, gr_vector_int &ninput_items_required);
@@ -64,7 +102,9 @@ namespace gr {
            gr_vector_const_void_star &input_items,
            gr_vector_void_star &output_items);
 
-      void choose_algo(const float *metrics, int K, int O);
+      bool choose_algo(const float *metrics, int K, int O) const;
+      //Ratio Q of the metrics of a block (see dynamic_viterbi)
+      float metrics_ratio(const float *metrics, int K, int O) const;
     };
 
   } // namespace lazyviterbi
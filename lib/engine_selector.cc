@@ -0,0 +1,139 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cmath>
+#include "engine_selector.h"
+
+namespace gr {
+namespace lazyviterbi {
+
+  engine_selector::engine_selector(int n_engines, double hysteresis,
+      int explore_period)
+    : d_n_engines(n_engines), d_hysteresis(hysteresis),
+    d_explore_period(explore_period < 2 ? 2 : explore_period)
+  {
+    clear();
+  }
+
+  int
+  engine_selector::bin(float ratio)
+  {
+    //Q >= 1 (infinite if the smallest metrics are 0), NaN if no metric
+    if(!(ratio > 1.0f)) {
+      return 0;
+    }
+    if(ratio >= 4096.0f) {
+      return N_BINS - 1;
+    }
+
+    return std::min((int)(2.0f*std::log2(ratio)), N_BINS - 1);
+  }
+
+  int
+  engine_selector::choose(int bin)
+  {
+    gr::thread::scoped_lock guard(d_lock);
+    bin_state &b = d_bins[bin];
+    const arm *arms = &d_arms[bin*d_n_engines];
+
+    ++b.blocks;
+
+    //Measure every engine first
+    for(int e=0 ; e < d_n_engines ; ++e) {
+      if(arms[e].samples == 0) {
+        return e;
+      }
+    }
+
+    //Measure another engine again, from time to time
+    if(d_n_engines > 1 && b.blocks % d_explore_period == 0) {
+      if(b.next_explored == b.engine) {
+        b.next_explored = (b.next_explored + 1) % d_n_engines;
+      }
+      int e = b.next_explored;
+      b.next_explored = (b.next_explored + 1) % d_n_engines;
+
+      return e;
+    }
+
+    //Change for the fastest engine if it is significantly faster
+    int fastest = b.engine;
+    for(int e=0 ; e < d_n_engines ; ++e) {
+      if(arms[e].ns_per_section < arms[fastest].ns_per_section) {
+        fastest = e;
+      }
+    }
+
+    if(arms[fastest].ns_per_section
+        < (1.0 - d_hysteresis) * arms[b.engine].ns_per_section) {
+      b.engine = fastest;
+    }
+
+    return b.engine;
+  }
+
+  void
+  engine_selector::update(int bin, int engine, uint64_t ns, size_t sections)
+  {
+    if(sections == 0) {
+      return;
+    }
+
+    gr::thread::scoped_lock guard(d_lock);
+    arm &a = d_arms[bin*d_n_engines + engine];
+    double ns_per_section = (double)ns / sections;
+
+    if(a.samples == 0) {
+      a.ns_per_section = ns_per_section;
+    }
+    else {
+      a.ns_per_section += (ns_per_section - a.ns_per_section)
+        / COST_AVERAGE_LENGTH;
+    }
+    ++a.samples;
+  }
+
+  double
+  engine_selector::cost(int bin, int engine) const
+  {
+    gr::thread::scoped_lock guard(d_lock);
+    return d_arms[bin*d_n_engines + engine].ns_per_section;
+  }
+
+  int
+  engine_selector::engine(int bin) const
+  {
+    gr::thread::scoped_lock guard(d_lock);
+    return d_bins[bin].engine;
+  }
+
+  void
+  engine_selector::clear()
+  {
+    gr::thread::scoped_lock guard(d_lock);
+    arm new_arm = {0.0, 0};
+    bin_state new_bin = {0, 0, 0};
+
+    d_arms.assign(N_BINS*d_n_engines, new_arm);
+    d_bins.assign(N_BINS, new_bin);
+  }
+
+} /* namespace lazyviterbi */
+} /* namespace gr */
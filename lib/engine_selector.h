@@ -0,0 +1,118 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_ENGINE_SELECTOR_H
+#define INCLUDED_LAZYVITERBI_ENGINE_SELECTOR_H
+
+#include <lazyviterbi/api.h>
+#include <gnuradio/thread/thread.h>
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+namespace gr {
+namespace lazyviterbi {
+
+  /*!
+   * \brief Online choice of the fastest of several decoding engines.
+   *
+   * Blocks are sorted into bins of an SNR statistic: the ratio Q of the sums
+   * of the largest and smallest metrics of each section (see
+   * dynamic_viterbi), in half octaves. For each bin, the decoding time per
+   * section of each engine is measured on live blocks, and averaged
+   * (exponential moving average).
+   *
+   * Each block is decoded by the engine of its bin, which becomes the
+   * fastest one only once it is faster than the current one by more than a
+   * hysteresis factor, so that noisy measurements do not make the choice
+   * flap. One block out of explore_period is decoded by another engine, so
+   * that the costs of every engine follow the changes of the load of the
+   * machine.
+   *
+   * choose() and update() can be called by several workers at a time.
+   * Exported for the unit tests.
+   */
+  class LAZYVITERBI_API engine_selector
+  {
+   public:
+    //! Number of bins of Q (Q from 1 to 2^12).
+    static const int N_BINS = 24;
+
+    /*!
+     * \param n_engines Number of engines.
+     * \param hysteresis Relative gain needed to change the engine of a bin.
+     * \param explore_period Period of the blocks decoded by another engine
+     * than the one of their bin.
+     */
+    engine_selector(int n_engines, double hysteresis=0.1,
+        int explore_period=32);
+
+    int n_engines() const { return d_n_engines; }
+
+    //! Bin of a block of ratio Q.
+    static int bin(float ratio);
+
+    //! Engine decoding the next block of a bin.
+    int choose(int bin);
+
+    //! Record the decoding time of \p sections sections by an engine.
+    void update(int bin, int engine, uint64_t ns, size_t sections);
+
+    //! Mean decoding time per section of an engine (0 if not measured yet).
+    double cost(int bin, int engine) const;
+
+    //! Engine of a bin (out of exploration).
+    int engine(int bin) const;
+
+    //! Forget every measurement.
+    void clear();
+
+   private:
+    //Weight of a new measurement in the moving average of the costs
+    static const int COST_AVERAGE_LENGTH = 8;
+
+    struct arm
+    {
+      double ns_per_section;
+      uint64_t samples;
+    };
+
+    struct bin_state
+    {
+      int engine;
+      uint64_t blocks;
+      int next_explored;
+    };
+
+    int d_n_engines;
+    double d_hysteresis;
+    int d_explore_period;
+
+    //Costs of engine e for bin b: d_arms[b*d_n_engines + e]
+    std::vector<arm> d_arms;
+    std::vector<bin_state> d_bins;
+
+    mutable gr::thread::mutex d_lock;
+  };
+
+} /* namespace lazyviterbi */
+} /* namespace gr */
+
+#endif /* INCLUDED_LAZYVITERBI_ENGINE_SELECTOR_H */
@@ -0,0 +1,191 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include "gather_kernels.h"
+
+//SIMD implementations are compiled with function-level target attributes, so
+//that the library itself does not require any particular instruction set.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define LV_HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace gr {
+namespace lazyviterbi {
+
+  namespace {
+
+    //***GENERIC***//
+    void
+    gather_sub_generic(const float *alpha_prev, const float *in_k, int O,
+        const int *ordered_PS, const int *ordered_OS, float *can_metrics, size_t n)
+    {
+      for(size_t i=0 ; i < n ; ++i) {
+        can_metrics[i] = alpha_prev[ordered_PS[i]] - in_k[ordered_OS[i]];
+      }
+    }
+
+    bool
+    generic_is_supported()
+    {
+      return true;
+    }
+
+#ifdef LV_HAVE_X86_KERNELS
+    //***AVX2***//
+    __attribute__((target("avx2"))) void
+    gather_sub_avx2(const float *alpha_prev, const float *in_k, int O,
+        const int *ordered_PS, const int *ordered_OS, float *can_metrics, size_t n)
+    {
+      size_t i = 0;
+
+      if(O <= 8) {
+        //Branch metrics of the section fit in a register
+        float in_k8[8] = {0.0f};
+        std::copy(in_k, in_k + O, in_k8);
+        const __m256 bm = _mm256_loadu_ps(in_k8);
+
+        for( ; i + 8 <= n ; i += 8) {
+          __m256 a = _mm256_i32gather_ps(alpha_prev,
+              _mm256_loadu_si256((const __m256i*)(ordered_PS + i)), 4);
+          __m256 b = _mm256_permutevar8x32_ps(bm,
+              _mm256_loadu_si256((const __m256i*)(ordered_OS + i)));
+          _mm256_storeu_ps(can_metrics + i, _mm256_sub_ps(a, b));
+        }
+      }
+      else {
+        for( ; i + 8 <= n ; i += 8) {
+          __m256 a = _mm256_i32gather_ps(alpha_prev,
+              _mm256_loadu_si256((const __m256i*)(ordered_PS + i)), 4);
+          __m256 b = _mm256_i32gather_ps(in_k,
+              _mm256_loadu_si256((const __m256i*)(ordered_OS + i)), 4);
+          _mm256_storeu_ps(can_metrics + i, _mm256_sub_ps(a, b));
+        }
+      }
+
+      gather_sub_generic(alpha_prev, in_k, O, ordered_PS + i, ordered_OS + i,
+          can_metrics + i, n - i);
+    }
+
+    bool
+    avx2_is_supported()
+    {
+      return __builtin_cpu_supports("avx2");
+    }
+
+    //***AVX512F***//
+    __attribute__((target("avx512f"))) void
+    gather_sub_avx512f(const float *alpha_prev, const float *in_k, int O,
+        const int *ordered_PS, const int *ordered_OS, float *can_metrics, size_t n)
+    {
+      size_t i = 0;
+
+      if(O <= 16) {
+        //Branch metrics of the section fit in a register
+        const __m512 bm = _mm512_maskz_loadu_ps((__mmask16)((1u << O) - 1), in_k);
+
+        for( ; i + 16 <= n ; i += 16) {
+          __m512 a = _mm512_i32gather_ps(
+              _mm512_loadu_si512((const void*)(ordered_PS + i)), alpha_prev, 4);
+          __m512 b = _mm512_permutexvar_ps(
+              _mm512_loadu_si512((const void*)(ordered_OS + i)), bm);
+          _mm512_storeu_ps(can_metrics + i, _mm512_sub_ps(a, b));
+        }
+      }
+      else {
+        for( ; i + 16 <= n ; i += 16) {
+          __m512 a = _mm512_i32gather_ps(
+              _mm512_loadu_si512((const void*)(ordered_PS + i)), alpha_prev, 4);
+          __m512 b = _mm512_i32gather_ps(
+              _mm512_loadu_si512((const void*)(ordered_OS + i)), in_k, 4);
+          _mm512_storeu_ps(can_metrics + i, _mm512_sub_ps(a, b));
+        }
+      }
+
+      gather_sub_generic(alpha_prev, in_k, O, ordered_PS + i, ordered_OS + i,
+          can_metrics + i, n - i);
+    }
+
+    bool
+    avx512f_is_supported()
+    {
+      return __builtin_cpu_supports("avx512f");
+    }
+#endif
+
+    std::vector<gather_kernel>
+    make_gather_kernels()
+    {
+      std::vector<gather_kernel> kernels;
+      gather_kernel k;
+
+#ifdef LV_HAVE_X86_KERNELS
+      k.name = "avx512f";
+      k.is_supported = avx512f_is_supported;
+      k.gather_sub = gather_sub_avx512f;
+      kernels.push_back(k);
+
+      k.name = "avx2";
+      k.is_supported = avx2_is_supported;
+      k.gather_sub = gather_sub_avx2;
+      kernels.push_back(k);
+#endif
+
+      k.name = "generic";
+      k.is_supported = generic_is_supported;
+      k.gather_sub = gather_sub_generic;
+      kernels.push_back(k);
+
+      return kernels;
+    }
+
+    const gather_kernel &
+    find_best_gather_kernel()
+    {
+      const std::vector<gather_kernel> &kernels = gather_kernels();
+
+      for(size_t i=0 ; i < kernels.size() ; ++i) {
+        if(kernels[i].is_supported()) {
+          return kernels[i];
+        }
+      }
+
+      return kernels.back();
+    }
+
+  } // anonymous namespace
+
+  const std::vector<gather_kernel> &
+  gather_kernels()
+  {
+    static const std::vector<gather_kernel> kernels = make_gather_kernels();
+    return kernels;
+  }
+
+  const gather_kernel &
+  best_gather_kernel()
+  {
+    static const gather_kernel &best = find_best_gather_kernel();
+    return best;
+  }
+
+} // namespace lazyviterbi
+} // namespace gr
@@ -0,0 +1,74 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_GATHER_KERNELS_H
+#define INCLUDED_LAZYVITERBI_GATHER_KERNELS_H
+
+#include <lazyviterbi/api.h>
+#include <cstddef>
+#include <vector>
+
+namespace gr {
+namespace lazyviterbi {
+
+  /*!
+   * \brief "ADD" half of add-compare-select of the classical Viterbi decoders:
+   * can_metrics[i] = alpha_prev[ordered_PS[i]] - in_k[ordered_OS[i]], for i in
+   * [0, n), in_k holding the O branch metrics of the section.
+   */
+  typedef void (*gather_sub_kernel)(const float *alpha_prev, const float *in_k,
+      int O, const int *ordered_PS, const int *ordered_OS, float *can_metrics,
+      size_t n);
+
+  /*!
+   * \brief One implementation of the candidate metrics gather, in the way of
+   * VOLK kernels.
+   *
+   * Path metrics are gathered with SIMD gathers, and branch metrics with
+   * in-register permutes when O is small enough (hardware gathers otherwise).
+   * Every implementation gives the same result as the generic one.
+   */
+  struct gather_kernel
+  {
+    //! Name of the implementation ("generic", "avx2", "avx512f").
+    const char *name;
+    //! True if the running CPU supports this implementation.
+    bool (*is_supported)();
+    //! Gather and subtract.
+    gather_sub_kernel gather_sub;
+  };
+
+  /*!
+   * \brief Every implementation compiled in, from the fastest to the generic
+   * one (whether or not the running CPU supports them). Exported for the unit
+   * tests.
+   */
+  LAZYVITERBI_API const std::vector<gather_kernel> &gather_kernels();
+
+  /*!
+   * \brief Fastest implementation supported by the running CPU (looked up
+   * once).
+   */
+  const gather_kernel &best_gather_kernel();
+
+} // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_GATHER_KERNELS_H */
@@ -0,0 +1,110 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <lazyviterbi/decoder.h>
+#include "hard_decision.h"
+
+namespace gr {
+namespace lazyviterbi {
+
+  namespace {
+
+    //Follow the hard decisions from state s, for at most *budget sections
+    //(decremented by the sections walked)
+    bool
+    walk(const compiled_trellis &trellis, const float *metrics, int K, int s,
+        int SK, uint8_t *out, int *budget)
+    {
+      const int I = trellis.I();
+      const int O = trellis.O();
+      const int *NS = trellis.NS();
+      const int *OS = trellis.fsm_OS();
+
+      for(int k=0 ; k < K ; ++k) {
+        if((*budget)-- == 0) {
+          return false;
+        }
+
+        //Output symbol of smallest metric (ties broken to the first one,
+        //the algorithm deciding between them if needed)
+        const float *metrics_k = metrics + k*O;
+        int symbol = 0;
+        for(int o=1 ; o < O ; ++o) {
+          symbol = (metrics_k[o] < metrics_k[symbol]) ? o : symbol;
+        }
+
+        //First branch of s carrying it (selected without branches, inputs
+        //being random)
+        int input = -1;
+        for(int i=I-1 ; i >= 0 ; --i) {
+          input = (OS[s*I + i] == symbol) ? i : input;
+        }
+
+        if(input < 0) {
+          return false;
+        }
+
+        out[k] = input;
+        s = NS[s*I + input];
+      }
+
+      return SK == -1 || s == SK;
+    }
+
+  } // anonymous namespace
+
+  bool
+  hard_decision_path(const compiled_trellis &trellis, const float *metrics,
+      int K, int S0, int SK, uint8_t *out)
+  {
+    int budget = 2*K;
+
+    if(S0 != -1) {
+      return walk(trellis, metrics, K, S0, SK, out, &budget);
+    }
+
+    //Walks from wrong initial states mostly stop after a few sections
+    for(int s=0 ; s < trellis.S() && budget > 0 ; ++s) {
+      if(walk(trellis, metrics, K, s, SK, out, &budget)) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  bool
+  decoder::try_fast_path(const float *metrics, int K, int S0, int SK,
+      uint8_t *out, workspace &ws) const
+  {
+    if(!d_fast_path || !hard_decision_path(*d_trellis, metrics, K, S0, SK, out)) {
+      return false;
+    }
+
+    ++ws.stats.fast_path_blocks;
+    return true;
+  }
+
+} /* namespace lazyviterbi */
+} /* namespace gr */
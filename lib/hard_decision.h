@@ -0,0 +1,51 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_HARD_DECISION_H
+#define INCLUDED_LAZYVITERBI_HARD_DECISION_H
+
+#include <lazyviterbi/compiled_trellis.h>
+#include <stdint.h>
+
+namespace gr {
+namespace lazyviterbi {
+
+  /*!
+   * \brief Path of the hard decisions of a block, if it is one.
+   *
+   * The output symbol of smallest metric is taken at each time index, and
+   * the inputs are read back from the trellis. If every symbol is the output
+   * of a branch leaving the state reached so far (from S0, to SK), the path
+   * has the smallest metric a path can have: it is the maximum likelihood
+   * path, and its inputs are written to \p out.
+   *
+   * If S0 is unknown, every initial state is tried, the walks being bounded
+   * by 2*K sections in total.
+   *
+   * \return True if the hard decisions form a path (otherwise, \p out is
+   * garbage).
+   */
+  bool hard_decision_path(const compiled_trellis &trellis,
+      const float *metrics, int K, int S0, int SK, uint8_t *out);
+
+} /* namespace lazyviterbi */
+} /* namespace gr */
+
+#endif /* INCLUDED_LAZYVITERBI_HARD_DECISION_H */
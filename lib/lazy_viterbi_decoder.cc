@@ -0,0 +1,399 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+#include "lazy_viterbi_decoder.h"
+#include "block_timer.h"
+#include "metrics_quantizer.h"
+#include "quantize_kernels.h"
+
+namespace gr {
+  namespace lazyviterbi {
+
+    decoder::sptr
+    decoder::make_lazy_viterbi(const compiled_trellis::sptr &trellis, int S0,
+        int SK, float scale, int metric_bits)
+    {
+      return decoder::sptr(new lazy_viterbi_decoder(trellis, S0, SK, scale,
+            metric_bits));
+    }
+
+    lazy_viterbi_decoder::lazy_viterbi_decoder(
+        const compiled_trellis::sptr &trellis, int S0, int SK, float scale,
+        int metric_bits)
+      : decoder(trellis, S0, SK), d_scale(scale), d_metric_bits(metric_bits)
+    {
+      int I = d_trellis->I();
+      int S = d_trellis->S();
+      const compiled_trellis &T = *d_trellis;
+
+      //Compute the layout of shadow nodes keys
+      size_t max_size_PS_s = std::max(1, T.max_size_PS_s());
+
+      d_state_bits = 0;
+      while((1 << d_state_bits) < S) {
+        ++d_state_bits;
+      }
+
+      d_pidx_bits = 0;
+      while(((size_t)1 << d_pidx_bits) < max_size_PS_s) {
+        ++d_pidx_bits;
+      }
+
+      //Survivors are stored on 8 bits
+      if(d_pidx_bits > 8) {
+        throw std::invalid_argument("lazy_viterbi: too many branches per state");
+      }
+
+      //Compute branch_pidx
+      d_branch_pidx.resize(S*I);
+      for(int s=0 ; s < S ; ++s) {
+        for(int b=T.offsets()[s] ; b < T.offsets()[s + 1] ; ++b) {
+          d_branch_pidx[T.PS()[b]*I + T.PI()[b]] = b - T.offsets()[s];
+        }
+      }
+
+      //Metrics are quantized on 8 or 16 bits
+      if(d_metric_bits != 16) {
+        d_metric_bits = 8;
+      }
+
+      if(d_scale < 0.0) {
+        d_scale = 0.0;
+      }
+    }
+
+    void
+    lazy_viterbi_decoder::check_block_length(size_t K) const
+    {
+      //Time indexes range from 0 to K (included)
+      if(((uint64_t)K << (d_state_bits + d_pidx_bits)) > 0xffffffffULL) {
+        throw std::invalid_argument("lazy_viterbi: block too long for this trellis");
+      }
+    }
+
+    decoder::workspace_sptr
+    lazy_viterbi_decoder::make_workspace(size_t K, huge_pages_t huge_pages) const
+    {
+      int I = d_trellis->I();
+      int S = d_trellis->S();
+      boost::shared_ptr<workspace> ws(new workspace(huge_pages));
+
+      //Allocate shadow nodes container, sized for the branches of a section
+      //(the slab grows if the search queues more shadow nodes)
+      size_t n_buckets = (size_t)1 << d_metric_bits;
+      ws->shadow_nodes = bucket_queue(n_buckets,
+          (size_t)S*I/bucket_queue::CHUNK_SIZE + 1);
+
+      //Carve metrics and expanded nodes containers
+      check_block_length(K);
+      carve_workspace(*ws, K, scratch_arena::sptr(
+            new scratch_arena(workspace_bytes(K), huge_pages)));
+
+      return ws;
+    }
+
+    size_t
+    lazy_viterbi_decoder::workspace_bytes(size_t K) const
+    {
+      size_t bytes = scratch_arena::bytes<node>((K+1)*d_trellis->S());
+
+      if(d_metric_bits == 8) {
+        bytes += scratch_arena::bytes<uint8_t>(K*d_trellis->O());
+      }
+      else {
+        bytes += scratch_arena::bytes<uint16_t>(K*d_trellis->O());
+      }
+
+      return bytes;
+    }
+
+    void
+    lazy_viterbi_decoder::carve_workspace(workspace &ws, size_t K,
+        const scratch_arena::sptr &arena) const
+    {
+      ws.arena = arena;
+      ws.real_nodes = arena->alloc<node>((K+1)*d_trellis->S());
+
+      if(d_metric_bits == 8) {
+        ws.metrics = arena->alloc<uint8_t>(K*d_trellis->O());
+      }
+      else {
+        ws.metrics16 = arena->alloc<uint16_t>(K*d_trellis->O());
+      }
+
+      ws.K = K;
+      reset_workspace(ws);
+    }
+
+    void
+    lazy_viterbi_decoder::reset_workspace(workspace &ws) const
+    {
+      struct node new_node = {0, 0}; //{epoch, prev_pidx}
+
+      std::fill(ws.real_nodes, ws.real_nodes + (ws.K+1)*d_trellis->S(),
+          new_node);
+      ws.epoch = 0;
+    }
+
+    void
+    lazy_viterbi_decoder::decode(const float *metrics, size_t K, int S0,
+        int SK, uint8_t *out, decoder::workspace &ws) const
+    {
+      workspace *lws = dynamic_cast<workspace*>(&ws);
+      if(!lws) {
+        throw std::invalid_argument("lazy_viterbi: workspace made by another decoder");
+      }
+
+      lazy_viterbi_algorithm(K, S0, SK, d_scale, metrics, out, *lws);
+    }
+
+    void
+    lazy_viterbi_decoder::lazy_viteri_metrics_norm(const float *in, uint8_t* metrics,
+        int K, int O, float scale) const
+    {
+      if(scale <= 0.0) {
+        scale = estimate_metrics_scale(in, K, O, 255);
+      }
+
+      best_quantize_kernel().u8(in, metrics, K, O, scale);
+    }
+
+    void
+    lazy_viterbi_decoder::lazy_viteri_metrics_norm(const float *in, uint16_t* metrics,
+        int K, int O, float scale) const
+    {
+      if(scale <= 0.0) {
+        scale = estimate_metrics_scale(in, K, O, 65535);
+      }
+
+      best_quantize_kernel().u16(in, metrics, K, O, scale);
+    }
+
+    void
+    lazy_viterbi_decoder::grow_workspace(workspace &ws, int K) const
+    {
+      //Longer blocks than the workspace was made for
+      if(K > ws.K) {
+        check_block_length(K);
+        carve_workspace(ws, K, scratch_arena::sptr(
+              new scratch_arena(workspace_bytes(K), ws.huge_pages)));
+      }
+    }
+
+    void
+    lazy_viterbi_decoder::lazy_viterbi_algorithm(int K, int S0, int SK,
+        float scale, const float *in, unsigned char *out, workspace &ws) const
+    {
+      const int O = d_trellis->O();
+
+      block_timer timer(ws.stats, K);
+
+      //Blocks whose hard decisions form a path need no search
+      if(try_fast_path(in, K, S0, SK, out, ws)) {
+        return;
+      }
+
+      grow_workspace(ws, K);
+
+      //***NORMALIZE METRICS***//
+      if(d_metric_bits == 16) {
+        lazy_viteri_metrics_norm(in, ws.metrics16, K, O, scale);
+        find_shortest_path(ws.metrics16, K, S0, SK, out, ws);
+      }
+      else {
+        lazy_viteri_metrics_norm(in, ws.metrics, K, O, scale);
+        find_shortest_path(ws.metrics, K, S0, SK, out, ws);
+      }
+    }
+
+    void
+    lazy_viterbi_decoder::quantize_profiled(const float *in, int K,
+        float scale, metrics_profile &profile, workspace &ws) const
+    {
+      const int O = d_trellis->O();
+
+      grow_workspace(ws, K);
+
+      if(d_metric_bits == 16) {
+        if(scale <= 0.0) {
+          scale = estimate_metrics_scale(in, K, O, 65535);
+        }
+        best_quantize_kernel().profile_u16(in, ws.metrics16, K, O, scale, profile);
+      }
+      else {
+        if(scale <= 0.0) {
+          scale = estimate_metrics_scale(in, K, O, 255);
+        }
+        best_quantize_kernel().profile_u8(in, ws.metrics, K, O, scale, profile);
+      }
+    }
+
+    void
+    lazy_viterbi_decoder::lazy_viterbi_quantized(int K, int S0, int SK,
+        const float *in, unsigned char *out, workspace &ws) const
+    {
+      block_timer timer(ws.stats, K);
+
+      //Blocks whose hard decisions form a path need no search
+      if(try_fast_path(in, K, S0, SK, out, ws)) {
+        return;
+      }
+
+      if(d_metric_bits == 16) {
+        find_shortest_path(ws.metrics16, K, S0, SK, out, ws);
+      }
+      else {
+        find_shortest_path(ws.metrics, K, S0, SK, out, ws);
+      }
+    }
+
+    template <typename T>
+    void
+    lazy_viterbi_decoder::find_shortest_path(const T *metrics, int K, int S0,
+        int SK, unsigned char *out, workspace &ws) const
+    {
+      //***INIT***//
+      const compiled_trellis &trellis = *d_trellis;
+      const int I = trellis.I();
+      const int S = trellis.S();
+      const int O = trellis.O();
+      const uint32_t pidx_mask = (1 << d_pidx_bits) - 1;
+      const uint32_t state_mask = (1 << d_state_bits) - 1;
+      const int key_time_shift = d_state_bits + d_pidx_bits;
+
+      const size_t bucket_mask = ws.shadow_nodes.n_buckets() - 1;
+
+      const T *metrics_os_it;
+      size_t min_dist_idx = 0, next_dist_idx;
+      uint32_t key, time_idx, state_idx;
+      int tb_state, pidx;
+      uint64_t n_expanded = 0, n_pushed = 0, n_popped = 0, n_scanned = 0;
+      node *expanded_it;
+      const int *NS_it, *OS_it;
+      std::vector<int>::const_iterator pidx_it;
+
+      //Start a new epoch: every real node becomes non-expanded.
+      //Upon wrapping, stamps of the previous 255 epochs must be erased.
+      if(++ws.epoch == 0) {
+        for(node *it=ws.real_nodes ; it != ws.real_nodes + (ws.K+1)*S ; ++it) {
+          (*it).epoch=0;
+        }
+        ws.epoch = 1;
+      }
+
+      //If exist put initial node in the shadow queue,
+      //otherwise, put every nodes a time_idx==0 in it
+      if(S0 != -1) {
+        ws.shadow_nodes.push(0, make_key(0, S0, 0));
+        n_pushed = 1;
+      }
+      else {
+        //For each state
+        for(int s=0 ; s < S ; ++s) {
+          ws.shadow_nodes.push(0, make_key(0, s, 0));
+        }
+        n_pushed = S;
+      }
+
+      //***FIND SHORTEST PATH***//
+      while(true) {
+        //Select another candidate if this node has already been expanded
+        do {
+          //Find minimum distance index
+          next_dist_idx = ws.shadow_nodes.next_bucket(min_dist_idx);
+          n_scanned += (next_dist_idx - min_dist_idx) & bucket_mask;
+          min_dist_idx = next_dist_idx;
+
+          //Retrieve a candidate at minimum distance
+          key = ws.shadow_nodes.pop(min_dist_idx);
+          ++n_popped;
+          state_idx = (key >> d_pidx_bits) & state_mask;
+          time_idx = key >> key_time_shift;
+
+          //Update iterator
+          expanded_it = ws.real_nodes + time_idx*S + state_idx;
+        } while((*expanded_it).epoch == ws.epoch);
+
+        //At this point, we are sure this node will be expanded
+        (*expanded_it).epoch=ws.epoch;
+        (*expanded_it).prev_pidx=key & pidx_mask;
+        ++n_expanded;
+
+        //Stop at the first node expanded at time K (in the final state, if
+        //specified), nodes at time K have no neighbors anyway.
+        if(time_idx == (uint32_t)K) {
+          if(SK == -1 || state_idx == (uint32_t)SK) {
+            break;
+          }
+          continue;
+        }
+
+        //Scan all neighbors of the last expanded node
+        //Initialize iterators
+        expanded_it += S - state_idx; //real_nodes[(time_idx+1)*S]
+        metrics_os_it = metrics + time_idx*O; //metrics[time_idx*O]
+        NS_it = trellis.NS() + state_idx*I; //NS[state_idx*I]
+        OS_it = trellis.fsm_OS() + state_idx*I; //OS[state_idx*I]
+        pidx_it = d_branch_pidx.begin() + state_idx*I; //branch_pidx[state_idx*I]
+
+        //For all neighbors
+        for(int i=0 ; i < I ; ++i) {
+          //Add non-expanded neighbors as shadow nodes
+          if((*(expanded_it + *NS_it)).epoch != ws.epoch) {
+            ws.shadow_nodes.push((min_dist_idx + *(metrics_os_it + *OS_it)) & bucket_mask,
+                make_key(time_idx+1, *NS_it, *pidx_it));
+            ++n_pushed;
+          }
+
+          //Increment iterators
+          ++NS_it;
+          ++OS_it;
+          ++pidx_it;
+        }
+      }
+
+      //***TRACEBACK***//
+      tb_state = state_idx;
+      expanded_it = ws.real_nodes + K*S; //Place expanded_it at the last time index
+      for(unsigned char* out_k=out + K-1 ; out_k >= out ; --out_k) {
+        //Previous input and state are read back from the trellis
+        pidx = (*(expanded_it + tb_state)).prev_pidx;
+        *out_k = (unsigned char)trellis.PI(tb_state, pidx);
+        tb_state = trellis.PS(tb_state, pidx);
+
+        expanded_it -= S;
+      }
+
+      //Clear shadow nodes container (real nodes are cleared by the next epoch)
+      ws.shadow_nodes.clear();
+      ws.stats.nodes_expanded += n_expanded;
+      ws.stats.shadow_pushes += n_pushed;
+      ws.stats.stale_pops += n_popped - n_expanded;
+      ws.stats.buckets_scanned += n_scanned;
+    }
+
+  } /* namespace lazyviterbi */
+} /* namespace gr */
@@ -0,0 +1,142 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_LAZY_VITERBI_DECODER_H
+#define INCLUDED_LAZYVITERBI_LAZY_VITERBI_DECODER_H
+
+#include <lazyviterbi/decoder.h>
+#include <vector>
+#include "bucket_queue.h"
+#include "metrics_quantizer.h"
+#include "node.h"
+#include "scratch_arena.h"
+
+namespace gr {
+  namespace lazyviterbi {
+
+    //Lazy Viterbi algorithm (decoder of the lazy_viterbi block)
+    class lazy_viterbi_decoder : public decoder
+    {
+     public:
+      //Scratch buffers of the algorithm
+      struct workspace : public decoder::workspace
+      {
+        //Number of sections the buffers are sized for
+        int K;
+        //Backing of the arena, kept to grow it
+        decoder::huge_pages_t huge_pages;
+        //Memory of real nodes and metrics
+        scratch_arena::sptr arena;
+        /*
+         * Real nodes, to be addressed by real_nodes[time_index*S + state_index]
+         * ((K+1)*S nodes)
+         */
+        node *real_nodes;
+        //Nodes stamped with this epoch are expanded
+        uint8_t epoch;
+        /*
+         * Shadow nodes, stored as packed keys in a circular buffer of 256 (or
+         * 65536) buckets (corresponding to the possible values of branch
+         * metrics). A key is made of the time index, the state index and the
+         * index of the incoming branch in PS[state] (see make_key()).
+         */
+        bucket_queue shadow_nodes;
+        //Store path metrics (only one of them is carved, depending on d_metric_bits)
+        uint8_t *metrics;
+        uint16_t *metrics16;
+
+        workspace(decoder::huge_pages_t huge_pages)
+          : K(0), huge_pages(huge_pages), real_nodes(NULL), epoch(0),
+          metrics(NULL), metrics16(NULL) {}
+      };
+
+     private:
+      float d_scale;
+      int d_metric_bits;
+
+      //Number of bits used to store a state index in a key
+      int d_state_bits;
+      //Number of bits used to store a branch index in a key
+      int d_pidx_bits;
+      //Index of the branch (s, i) in PS[NS[s*I+i]]: d_branch_pidx[s*I+i]
+      std::vector<int> d_branch_pidx;
+      inline uint32_t make_key(uint32_t time_idx, uint32_t state_idx,
+          uint32_t pidx) const
+      {
+        return (((time_idx << d_state_bits) | state_idx) << d_pidx_bits) | pidx;
+      }
+
+      //Carve larger buffers in ws if blocks of K sections do not fit in them
+      void grow_workspace(workspace &ws, int K) const;
+
+      template <typename T>
+      void find_shortest_path(const T *metrics, int K, int S0, int SK,
+          unsigned char *out, workspace &ws) const;
+
+     public:
+      lazy_viterbi_decoder(const compiled_trellis::sptr &trellis, int S0,
+          int SK, float scale=1.0, int metric_bits=8);
+
+      float scale()  const { return d_scale; }
+      int metric_bits()  const { return d_metric_bits; }
+
+      //Throw if time indexes of blocks of K sections do not fit in keys
+      void check_block_length(size_t K) const;
+
+      decoder::workspace_sptr make_workspace(size_t K,
+          huge_pages_t huge_pages=HUGE_PAGES_TRANSPARENT) const;
+      size_t workspace_bytes(size_t K) const;
+
+      //Carve the buffers of ws for K sections from arena
+      void carve_workspace(workspace &ws, size_t K,
+          const scratch_arena::sptr &arena) const;
+      //Make every real node of ws non-expanded (to be called once its
+      //memory was overwritten by another decoder sharing its arena)
+      void reset_workspace(workspace &ws) const;
+
+      void decode(const float *metrics, size_t K, int S0, int SK,
+          uint8_t *out, decoder::workspace &ws) const;
+
+      //Quantize metrics with factor scale (estimated for each block if 0)
+      void lazy_viteri_metrics_norm(const float *in, uint8_t* metrics, int K,
+          int O, float scale) const;
+      void lazy_viteri_metrics_norm(const float *in, uint16_t* metrics, int K,
+          int O, float scale) const;
+
+      void lazy_viterbi_algorithm(int K, int S0, int SK, float scale,
+          const float *in, unsigned char *out, workspace &ws) const;
+
+      /*
+       * Quantize metrics into ws with factor scale (estimated for each block
+       * if 0), adding their statistics to profile in the same pass: the
+       * algorithm may then run on them (see lazy_viterbi_quantized()), or not.
+       */
+      void quantize_profiled(const float *in, int K, float scale,
+          metrics_profile &profile, workspace &ws) const;
+      //Lazy Viterbi algorithm on the metrics quantized by quantize_profiled()
+      //(in being the metrics it was given, for the fast path)
+      void lazy_viterbi_quantized(int K, int S0, int SK, const float *in,
+          unsigned char *out, workspace &ws) const;
+    };
+
+  } // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_LAZY_VITERBI_DECODER_H */
@@ -21,47 +21,62 @@
 #ifndef INCLUDED_LAZYVITERBI_LAZY_VITERBI_IMPL_H
 #define INCLUDED_LAZYVITERBI_LAZY_VITERBI_IMPL_H
 
-#include <boost/container/slist.hpp>
-#include <boost/container/stable_vector.hpp>
-
 #include <lazyviterbi/lazy_viterbi.h>
-#include "node.h"
+#include <boost/shared_ptr.hpp>
+#include "lazy_viterbi_decoder.h"
+#include "decode_stats.h"
 
 namespace gr {
   namespace lazyviterbi {
 
     class lazy_viterbi_impl : public lazy_viterbi
     {
+     public:
+      typedef lazy_viterbi_decoder::workspace workspace;
+
      private:
-      gr::trellis::fsm d_FSM;
       int d_K;
       int d_S0;
       int d_SK;
+      float d_scale;
+
+      //Decoder of the blocks (shared by the workers of the decode pool)
+      boost::shared_ptr<lazy_viterbi_decoder> d_decoder;
 
-      /*
-       * Real nodes, to be addressed by real_nodes[time_index*d_FSM.S() + state_index]
-       */
-      std::vector<node> d_real_nodes;
-      /*
-       * Shadow nodes. First dimension is used to make a circular buffer of 256
-       * vectors (corresponding to the 256 possible values of branch metrics).
-       * The vector nested stores shadow_nodes whose incoming branch have same
-       * metrics.
-       */
-      std::vector<std::vector<shadow_node> > d_shadow_nodes;
-      //Store path metrics
-      std::vector<uint8_t> d_metrics;
+      //Scratch buffers of each worker
+      std::vector< boost::shared_ptr<workspace> > d_workspaces;
+
+      //Publication of the counters of the workspaces
+      stats_schedule d_stats_schedule;
+
+      void decode_block(const gr_vector_const_void_star &input_items,
+          gr_vector_void_star &output_items, int nblocks, int job, int worker);
 
      public:
-      lazy_viterbi_impl(const gr::trellis::fsm &FSM, int K, int S0, int SK);
+      lazy_viterbi_impl(const gr::trellis::fsm &FSM, int K, int S0, int SK,
+          float scale=1.0, int metric_bits=8);
+      lazy_viterbi_impl(const compiled_trellis::sptr &trellis, int K, int S0,
+          int SK, float scale=1.0, int metric_bits=8);
 
-      gr::trellis::fsm FSM() const  { return d_FSM; }
+      gr::trellis::fsm FSM() const  { return d_decoder->trellis()->fsm(); }
       int K()  const { return d_K; }
       int S0()  const { return d_S0; }
       int SK()  const { return d_SK; }
+      float scale()  const { return d_scale; }
+      int metric_bits()  const { return d_decoder->metric_bits(); }
+
+      int pool_size() const;
+      pmt::pmt_t stats();
+      double stats_period() const { return d_stats_schedule.period(); }
+      bool fast_path() const { return d_decoder->fast_path(); }
 
       void set_S0(int S0);
       void set_SK(int SK);
+      void set_scale(float scale);
+      void set_pool_size(int n_threads);
+      void reset_stats();
+      void set_stats_period(double period);
+      void set_fast_path(bool fast_path);
 
       void forecast (int noutput_items, gr_vector_int &ninput_items_required);
 
@@ -69,10 +84,14 @@ namespace gr {
           gr_vector_const_void_star &input_items, gr_vector_void_star &output_items);
 
       void lazy_viteri_metrics_norm(const float *in, uint8_t* metrics, int K, int O);
+      void lazy_viteri_metrics_norm(const float *in, uint16_t* metrics, int K, int O);
 
       void lazy_viterbi_algorithm(int I, int S, int O, const std::vector<int> &NS,
           const std::vector<int> &OS, int K, int S0, int SK, const float *in,
           unsigned char *out);
+
+      //Scratch buffers of a worker of the decode pool
+      workspace &get_workspace(int worker);
     };
 
   } // namespace lazyviterbi
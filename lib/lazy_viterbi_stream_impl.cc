@@ -0,0 +1,501 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdexcept>
+#include <gnuradio/io_signature.h>
+#include "lazy_viterbi_stream_impl.h"
+#include "block_timer.h"
+#include "metrics_quantizer.h"
+#include "quantize_kernels.h"
+
+namespace gr {
+  namespace lazyviterbi {
+
+    namespace {
+
+      //True for keys whose time index is not in [oldest, oldest + R)
+      struct outside_ring
+      {
+        uint32_t oldest;
+        uint32_t R;
+        int time_shift;
+        uint32_t time_mask;
+
+        outside_ring(uint64_t oldest, int R, int time_shift, int time_bits)
+          : R(R), time_shift(time_shift),
+            time_mask((uint32_t)(((uint64_t)1 << time_bits) - 1))
+        {
+          this->oldest = (uint32_t)oldest & time_mask;
+        }
+
+        bool operator()(uint32_t key) const
+        {
+          return (((key >> time_shift) - oldest) & time_mask) >= R;
+        }
+      };
+
+    } // anonymous namespace
+
+    lazy_viterbi_stream::sptr
+    lazy_viterbi_stream::make(const gr::trellis::fsm &FSM, int D, int S0,
+        float scale, int metric_bits)
+    {
+      return gnuradio::get_initial_sptr
+        (new lazy_viterbi_stream_impl(FSM, D, S0, scale, metric_bits));
+    }
+
+    /*
+     * The private constructor
+     */
+    lazy_viterbi_stream_impl::lazy_viterbi_stream_impl(const gr::trellis::fsm &FSM,
+        int D, int S0, float scale, int metric_bits)
+      : gr::block("lazy_viterbi_stream",
+              gr::io_signature::make(1, 1, sizeof(float)),
+              gr::io_signature::make(1, 1, sizeof(char))),
+        d_FSM(FSM), d_trellis(compiled_trellis::get(FSM)), d_D(D), d_scale(scale), d_metric_bits(metric_bits)
+    {
+      //S0 must represent a state of the trellis
+      if(S0 >= 0 && S0 < d_FSM.S()) {
+        d_S0 = S0;
+      }
+      else {
+        d_S0 = -1;
+      }
+
+      if(d_D < 0) {
+        d_D = 0;
+      }
+
+      //Metrics are quantized on 8 or 16 bits
+      if(d_metric_bits != 16) {
+        d_metric_bits = 8;
+      }
+
+      if(d_scale < 0.0) {
+        d_scale = 0.0;
+      }
+
+      int I = d_FSM.I();
+      int S = d_FSM.S();
+      const compiled_trellis &T = *d_trellis;
+
+      //The ring must hold the last D+L time indexes, plus the time index
+      //being expanded and the next one, with L >= D.
+      d_R = 1;
+      while(d_R < 2*d_D + 2) {
+        d_R <<= 1;
+      }
+      d_L = d_R - d_D - 2;
+
+      //Compute the layout of shadow nodes keys
+      size_t max_size_PS_s = std::max(1, T.max_size_PS_s());
+
+      d_state_bits = 0;
+      while((1 << d_state_bits) < S) {
+        ++d_state_bits;
+      }
+
+      d_pidx_bits = 0;
+      while(((size_t)1 << d_pidx_bits) < max_size_PS_s) {
+        ++d_pidx_bits;
+      }
+
+      d_time_bits = 32 - d_state_bits - d_pidx_bits;
+
+      //Truncated time indexes must identify the time index of every key of
+      //the queue: keys behind the ring are purged every L < R time indexes,
+      //so that they are less than 2*R time indexes behind.
+      if(d_time_bits < 2 || ((uint64_t)1 << (d_time_bits - 1)) < 2*(uint64_t)d_R) {
+        throw std::invalid_argument("lazy_viterbi_stream: decision depth too large for this trellis");
+      }
+
+      //Survivors are stored on 8 bits
+      if(d_pidx_bits > 8) {
+        throw std::invalid_argument("lazy_viterbi_stream: too many branches per state");
+      }
+
+      //Compute branch_pidx
+      d_branch_pidx.resize(S*I);
+      for(int s=0 ; s < S ; ++s) {
+        for(int b=T.offsets()[s] ; b < T.offsets()[s + 1] ; ++b) {
+          d_branch_pidx[T.PS()[b]*I + T.PI()[b]] = b - T.offsets()[s];
+        }
+      }
+
+      //Allocate expanded and shadow nodes containers
+      size_t n_buckets = (size_t)1 << d_metric_bits;
+      d_shadow_nodes = bucket_queue(n_buckets, (size_t)S*I/bucket_queue::CHUNK_SIZE + 1);
+      d_real_nodes.resize(d_R*S);
+      d_row_epoch.resize(d_R);
+      d_metrics.resize(d_R*d_FSM.O());
+
+      reset();
+
+      set_relative_rate(1.0 / ((double)d_FSM.O()));
+      set_output_multiple(d_L);
+
+      message_port_register_out(stats_port());
+    }
+
+    void
+    lazy_viterbi_stream_impl::set_scale(float scale)
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      d_scale = (scale < 0.0) ? 0.0 : scale;
+    }
+
+    pmt::pmt_t
+    lazy_viterbi_stream_impl::stats()
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      return stats_to_pmt(d_stats);
+    }
+
+    void
+    lazy_viterbi_stream_impl::reset_stats()
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      d_stats.clear();
+    }
+
+    void
+    lazy_viterbi_stream_impl::set_stats_period(double period)
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      d_stats_schedule.set_period(period);
+    }
+
+    size_t
+    lazy_viterbi_stream_impl::queued_nodes()
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      return d_shadow_nodes.size();
+    }
+
+    bool
+    lazy_viterbi_stream_impl::start()
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      reset();
+
+      return block::start();
+    }
+
+    void
+    lazy_viterbi_stream_impl::reset()
+    {
+      struct node new_node = {0, 0}; //{epoch, prev_pidx}
+
+      std::fill(d_real_nodes.begin(), d_real_nodes.end(), new_node);
+      std::fill(d_row_epoch.begin(), d_row_epoch.end(), 0);
+      d_shadow_nodes.clear();
+
+      d_min_dist_idx = 0;
+      d_n_metrics = 0;
+      d_T_max = 0;
+      d_best_state = -1;
+      d_n_decided = 0;
+      d_pending_state = -1;
+      d_est_scale = 0.0;
+
+      recycle_row(0);
+      recycle_row(1);
+
+      //If exist put initial node in the shadow queue,
+      //otherwise, put every nodes a time_idx==0 in it
+      if(d_S0 != -1) {
+        d_shadow_nodes.push(0, make_key(0, d_S0, 0));
+        d_stats.shadow_pushes += 1;
+      }
+      else {
+        for(int s=0 ; s < d_FSM.S() ; ++s) {
+          d_shadow_nodes.push(0, make_key(0, s, 0));
+        }
+        d_stats.shadow_pushes += d_FSM.S();
+      }
+    }
+
+    void
+    lazy_viterbi_stream_impl::recycle_row(uint64_t time_idx)
+    {
+      size_t r = time_idx & (d_R - 1);
+
+      //Start a new epoch for this row, erase stamps upon wrapping
+      if(++d_row_epoch[r] == 0) {
+        std::vector<node>::iterator row_it = d_real_nodes.begin() + r*d_FSM.S();
+        for(std::vector<node>::iterator it=row_it ; it != row_it + d_FSM.S() ; ++it) {
+          (*it).epoch=0;
+        }
+        d_row_epoch[r] = 1;
+      }
+    }
+
+    void
+    lazy_viterbi_stream_impl::forecast(int noutput_items, gr_vector_int &ninput_items_required)
+    {
+      ninput_items_required[0] = d_FSM.O() * noutput_items;
+    }
+
+    int
+    lazy_viterbi_stream_impl::general_work (int noutput_items,
+                       gr_vector_int &ninput_items,
+                       gr_vector_const_void_star &input_items,
+                       gr_vector_void_star &output_items)
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      const int O = d_FSM.O();
+      const float *in = (const float*)input_items[0];
+      unsigned char *out = (unsigned char*)output_items[0];
+
+      int n_steps = ninput_items[0] / O;
+      int consumed = 0;
+      int produced = 0;
+      block_timer timer(d_stats, 0);
+
+      const uint16_t max_metric = (uint16_t)((1 << d_metric_bits) - 1);
+      float scale = d_scale;
+
+      //Estimate the scale from the first metrics, and keep it for the rest of
+      //the stream
+      if(!(scale > 0.0)) {
+        if(!(d_est_scale > 0.0) && n_steps > 0) {
+          d_est_scale = estimate_metrics_scale(in, n_steps, O, max_metric);
+        }
+        scale = d_est_scale;
+      }
+
+      //Normalize metrics of the whole window at once, before moving them to
+      //the ring one time index at a time
+      if(n_steps > 0) {
+        if(d_metric_bits == 8) {
+          d_in_metrics8.resize(n_steps*O);
+          best_quantize_kernel().u8(in, &d_in_metrics8[0], n_steps, O, scale);
+        }
+        else {
+          d_in_metrics16.resize(n_steps*O);
+          best_quantize_kernel().u16(in, &d_in_metrics16[0], n_steps, O, scale);
+        }
+      }
+
+      while(consumed < n_steps) {
+        //The next time index will trigger a traceback: make sure there is
+        //enough room for its output
+        if(d_n_metrics + 1 == d_n_decided + d_D + d_L
+            && produced + d_L > noutput_items) {
+          break;
+        }
+
+        //Store normalized metrics of the next time index in the ring
+        if(d_metric_bits == 8) {
+          std::copy(d_in_metrics8.begin() + consumed*O,
+              d_in_metrics8.begin() + (consumed + 1)*O,
+              d_metrics.begin() + (d_n_metrics & (d_R - 1))*O);
+        }
+        else {
+          std::copy(d_in_metrics16.begin() + consumed*O,
+              d_in_metrics16.begin() + (consumed + 1)*O,
+              d_metrics.begin() + (d_n_metrics & (d_R - 1))*O);
+        }
+
+        ++d_n_metrics;
+        ++consumed;
+
+        //Go on with the search, up to the new time index
+        search();
+
+        //Output decisions on the L oldest undecided time indexes
+        if(d_T_max == d_n_decided + d_D + d_L) {
+          traceback(out + produced);
+          purge();
+
+          d_n_decided += d_L;
+          produced += d_L;
+        }
+      }
+
+      timer.set_sections(consumed);
+      timer.stop();
+      if(d_stats_schedule.due()) {
+        message_port_pub(stats_port(), stats_to_pmt(d_stats));
+      }
+
+      consume_each(O * consumed);
+      return produced;
+    }
+
+    int
+    lazy_viterbi_stream_impl::scan_neighbors(uint64_t time_idx, int state_idx)
+    {
+      const int I = d_FSM.I();
+      const int S = d_FSM.S();
+      const int O = d_FSM.O();
+
+      //Iterators
+      std::vector<node>::const_iterator next_row_it = d_real_nodes.begin()
+        + ((time_idx + 1) & (d_R - 1))*S;
+      uint8_t next_row_epoch = d_row_epoch[(time_idx + 1) & (d_R - 1)];
+      const size_t bucket_mask = d_shadow_nodes.n_buckets() - 1;
+      std::vector<uint16_t>::const_iterator metrics_os_it = d_metrics.begin()
+        + (time_idx & (d_R - 1))*O;
+      const int *NS_it = d_trellis->NS() + state_idx*I;
+      const int *OS_it = d_trellis->fsm_OS() + state_idx*I;
+      std::vector<int>::const_iterator pidx_it = d_branch_pidx.begin() + state_idx*I;
+      int n_pushed = 0;
+
+      //For all neighbors
+      for(int i=0 ; i < I ; ++i) {
+        //Add non-expanded neighbors as shadow nodes
+        if((*(next_row_it + *NS_it)).epoch != next_row_epoch) {
+          d_shadow_nodes.push((d_min_dist_idx + *(metrics_os_it + *OS_it)) & bucket_mask,
+              make_key(time_idx + 1, *NS_it, *pidx_it));
+          ++n_pushed;
+        }
+
+        //Increment iterators
+        ++NS_it;
+        ++OS_it;
+        ++pidx_it;
+      }
+
+      return n_pushed;
+    }
+
+    void
+    lazy_viterbi_stream_impl::search()
+    {
+      const int S = d_FSM.S();
+      const uint32_t pidx_mask = (1 << d_pidx_bits) - 1;
+      const uint32_t state_mask = (1 << d_state_bits) - 1;
+      const uint32_t time_mask = (uint32_t)(((uint64_t)1 << d_time_bits) - 1);
+      const int64_t time_half = (int64_t)1 << (d_time_bits - 1);
+      const int key_time_shift = d_state_bits + d_pidx_bits;
+
+      const size_t bucket_mask = d_shadow_nodes.n_buckets() - 1;
+
+      uint32_t key, state_idx;
+      int64_t delta;
+      uint64_t time_idx;
+      size_t r, next_dist_idx;
+      uint64_t n_expanded = 0, n_pushed = 0, n_popped = 0, n_scanned = 0;
+      std::vector<node>::iterator expanded_it;
+
+      //Metrics of the pending node are now available
+      if(d_pending_state != -1) {
+        n_pushed += scan_neighbors(d_n_metrics - 1, d_pending_state);
+        d_pending_state = -1;
+      }
+
+      while(true) {
+        //Find minimum distance index
+        next_dist_idx = d_shadow_nodes.next_bucket(d_min_dist_idx);
+        n_scanned += (next_dist_idx - d_min_dist_idx) & bucket_mask;
+        d_min_dist_idx = next_dist_idx;
+
+        //Retrieve a candidate at minimum distance
+        key = d_shadow_nodes.pop(d_min_dist_idx);
+        ++n_popped;
+        state_idx = (key >> d_pidx_bits) & state_mask;
+
+        //Recover the full time index, relatively to d_T_max
+        delta = (int64_t)(((key >> key_time_shift) - (uint32_t)d_T_max) & time_mask);
+        if(delta >= time_half) {
+          delta -= 2*time_half;
+        }
+
+        //Discard shadow nodes older than the ring (their row was recycled, and
+        //every decision up to their time index have been output anyway)
+        if(delta < 2 - d_R) {
+          continue;
+        }
+
+        time_idx = d_T_max + delta;
+        r = time_idx & (d_R - 1);
+        expanded_it = d_real_nodes.begin() + r*S + state_idx;
+
+        //Select another candidate if this node has already been expanded
+        if((*expanded_it).epoch == d_row_epoch[r]) {
+          continue;
+        }
+
+        //At this point, we are sure this node will be expanded
+        (*expanded_it).epoch=d_row_epoch[r];
+        (*expanded_it).prev_pidx=key & pidx_mask;
+        ++n_expanded;
+
+        //First node expanded at a new time index: end of the shortest path
+        if(time_idx > d_T_max) {
+          d_T_max = time_idx;
+          d_best_state = state_idx;
+          recycle_row(time_idx + 1);
+        }
+
+        //Wait for the metrics of this time index
+        if(time_idx == d_n_metrics) {
+          d_pending_state = state_idx;
+          break;
+        }
+
+        n_pushed += scan_neighbors(time_idx, state_idx);
+      }
+
+      d_stats.nodes_expanded += n_expanded;
+      d_stats.shadow_pushes += n_pushed;
+      d_stats.stale_pops += n_popped - n_expanded;
+      d_stats.buckets_scanned += n_scanned;
+    }
+
+    void
+    lazy_viterbi_stream_impl::purge()
+    {
+      //Keys older than the ring are discarded by search() anyway, but those
+      //whose metric is too large for the search to reach them before their
+      //row is recycled are never popped: drop them, or the queue would grow
+      //forever.
+      d_shadow_nodes.remove_if(outside_ring(d_T_max + 2 - d_R, d_R,
+            d_state_bits + d_pidx_bits, d_time_bits));
+    }
+
+    void
+    lazy_viterbi_stream_impl::traceback(unsigned char *out)
+    {
+      const int S = d_FSM.S();
+      const compiled_trellis &T = *d_trellis;
+
+      int tb_state = d_best_state;
+      int pidx;
+
+      //Go through the decision depth, then output the next L decisions
+      for(uint64_t t=d_T_max ; t > d_n_decided ; --t) {
+        pidx = d_real_nodes[(t & (d_R - 1))*S + tb_state].prev_pidx;
+
+        if(t <= d_n_decided + d_L) {
+          out[t - 1 - d_n_decided] = (unsigned char)T.PI(tb_state, pidx);
+        }
+
+        tb_state = T.PS(tb_state, pidx);
+      }
+    }
+
+  } /* namespace lazyviterbi */
+} /* namespace gr */
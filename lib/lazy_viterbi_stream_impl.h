@@ -0,0 +1,136 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_LAZY_VITERBI_STREAM_IMPL_H
+#define INCLUDED_LAZYVITERBI_LAZY_VITERBI_STREAM_IMPL_H
+
+#include <lazyviterbi/lazy_viterbi_stream.h>
+#include "bucket_queue.h"
+#include <lazyviterbi/compiled_trellis.h>
+#include "decode_stats.h"
+#include "node.h"
+
+namespace gr {
+  namespace lazyviterbi {
+
+    class lazy_viterbi_stream_impl : public lazy_viterbi_stream
+    {
+     private:
+      gr::trellis::fsm d_FSM;
+      //Flat tables of the trellis (shared with other decoders)
+      compiled_trellis::sptr d_trellis;
+      int d_D;
+      int d_S0;
+      float d_scale;
+      int d_metric_bits;
+
+      //Number of time indexes stored in the rings (a power of two)
+      int d_R;
+      //Number of decisions output by each traceback
+      int d_L;
+
+      /*
+       * Real nodes, to be addressed by
+       * real_nodes[(time_index & (d_R-1))*d_FSM.S() + state_index]
+       */
+      std::vector<node> d_real_nodes;
+      //Nodes of row r whose epoch equals d_row_epoch[r] are expanded
+      std::vector<uint8_t> d_row_epoch;
+      //Quantized branch metrics, addressed as real nodes (O per time index)
+      std::vector<uint16_t> d_metrics;
+      //Normalized metrics of the current input window (8 or 16 bits)
+      std::vector<uint8_t> d_in_metrics8;
+      std::vector<uint16_t> d_in_metrics16;
+
+      /*
+       * Shadow nodes, as in lazy_viterbi_impl. The time index in keys is
+       * truncated to its d_time_bits least significant bits.
+       */
+      bucket_queue d_shadow_nodes;
+      int d_state_bits;
+      int d_pidx_bits;
+      int d_time_bits;
+      std::vector<int> d_branch_pidx;
+
+      //***Search state, kept from one call of general_work to the next***//
+      //Current minimum distance index
+      size_t d_min_dist_idx;
+      //Number of time indexes whose metrics have been received
+      uint64_t d_n_metrics;
+      //Greatest time index reached by the search
+      uint64_t d_T_max;
+      //State of the first node expanded at time d_T_max
+      int d_best_state;
+      //Number of decisions output so far
+      uint64_t d_n_decided;
+      //Scale factor estimated from the first input window (0 until then)
+      float d_est_scale;
+      //State of the last expanded node, if its neighbors have not been scanned
+      //yet because metrics at its time index were missing (-1 otherwise)
+      int d_pending_state;
+
+      //Counters of the search, and their publication
+      decoder::counters d_stats;
+      stats_schedule d_stats_schedule;
+
+      inline uint32_t make_key(uint64_t time_idx, uint32_t state_idx,
+          uint32_t pidx) const
+      {
+        return ((((uint32_t)time_idx << d_state_bits) | state_idx) << d_pidx_bits)
+          | pidx;
+      }
+
+      void reset();
+      void recycle_row(uint64_t time_idx);
+      int scan_neighbors(uint64_t time_idx, int state_idx);
+      void search();
+      void traceback(unsigned char *out);
+      void purge();
+
+     public:
+      lazy_viterbi_stream_impl(const gr::trellis::fsm &FSM, int D, int S0,
+          float scale=1.0, int metric_bits=8);
+
+      gr::trellis::fsm FSM() const  { return d_FSM; }
+      int D()  const { return d_D; }
+      int S0()  const { return d_S0; }
+      float scale()  const { return d_scale; }
+      int metric_bits()  const { return d_metric_bits; }
+      pmt::pmt_t stats();
+      double stats_period() const { return d_stats_schedule.period(); }
+
+      void set_scale(float scale);
+      void reset_stats();
+      void set_stats_period(double period);
+
+      size_t queued_nodes();
+
+      bool start();
+
+      void forecast (int noutput_items, gr_vector_int &ninput_items_required);
+
+      int general_work(int noutput_items, gr_vector_int &ninput_items,
+          gr_vector_const_void_star &input_items, gr_vector_void_star &output_items);
+    };
+
+  } // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_LAZY_VITERBI_STREAM_IMPL_H */
@@ -0,0 +1,58 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "metrics_quantizer.h"
+
+namespace gr {
+namespace lazyviterbi {
+
+  float
+  estimate_metrics_scale(const float *in, int K, int O, int max_metric)
+  {
+    double acc = 0.0;
+
+    if(K <= 0 || O < 2) {
+      return 1.0;
+    }
+
+    for(const float *in_k=in ; in_k < in + K*O ; in_k += O) {
+      float min_metric = in_k[0];
+      float sum_metric = 0.0;
+
+      for(int o=0 ; o < O ; ++o) {
+        min_metric = std::min(min_metric, in_k[o]);
+        sum_metric += in_k[o];
+      }
+
+      acc += sum_metric - O*min_metric;
+    }
+
+    //Mean normalized metric (the minimum of each time index excluded)
+    acc /= (double)K*(O-1);
+
+    if(!(acc > 0.0)) {
+      return 1.0;
+    }
+
+    return (float)(max_metric/(8.0*acc));
+  }
+
+} // namespace lazyviterbi
+} // namespace gr
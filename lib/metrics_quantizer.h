@@ -0,0 +1,120 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_METRICS_QUANTIZER_H
+#define INCLUDED_LAZYVITERBI_METRICS_QUANTIZER_H
+
+#include <lazyviterbi/api.h>
+#include <algorithm>
+#include <stdint.h>
+
+namespace gr {
+namespace lazyviterbi {
+
+  /*!
+   * \brief Scale adapted to the metrics of a block.
+   *
+   * The scale is chosen so that the mean of the normalized metrics
+   * (metrics minus the minimum metric at the same time index, the zeros being
+   * excluded) becomes max_metric/8: this gives a good resolution to most
+   * metrics, while only the largest ones (whose branches are unlikely to be
+   * on the shortest path anyway) saturate.
+   *
+   * \param in Input branch metrics.
+   * \param K Number of time indexes.
+   * \param O Number of branch metrics per time index.
+   * \param max_metric Largest quantized metric.
+   */
+  float estimate_metrics_scale(const float *in, int K, int O, int max_metric);
+
+  /*!
+   * \brief Statistics of the metrics of a block, gathered while they are
+   * quantized (see quantize_kernel::profile_u8).
+   */
+  struct metrics_profile
+  {
+    //Sum over the time indexes of the smallest metric
+    double sum_min;
+    //Sum over the time indexes of the largest metric
+    double sum_max;
+
+    metrics_profile() : sum_min(0.0), sum_max(0.0) {}
+
+    //Ratio Q of the block (see dynamic_viterbi)
+    float ratio() const { return (float)(sum_max/sum_min); }
+  };
+
+  /*!
+   * \brief Normalize and quantize branch metrics.
+   *
+   * metrics[k*O + j] = min(round(scale*(in[k*O + j] - min_i in[k*O + i])), max_metric)
+   */
+  template <typename T>
+  void quantize_metrics(const float *in, T *metrics, int K, int O, float scale,
+      T max_metric)
+  {
+    const float max_f = (float)max_metric;
+    float min_metric, q;
+
+    for(const float *in_k=in ; in_k < in + K*O ; in_k += O) {
+      //Find min_element
+      min_metric = *std::min_element(in_k, in_k+O);
+
+      //Remove it from metrics, scale and saturate
+      for(int o=0 ; o < O ; ++o) {
+        q = scale*(in_k[o] - min_metric) + 0.5f;
+        *(metrics++) = (q < max_f) ? (T)q : max_metric;
+      }
+    }
+  }
+
+  /*!
+   * \brief Normalize and quantize branch metrics (see quantize_metrics()),
+   * adding the smallest and largest metric of each time index to \p profile.
+   */
+  template <typename T>
+  void profile_quantize_metrics(const float *in, T *metrics, int K, int O,
+      float scale, T max_metric, metrics_profile &profile)
+  {
+    const float max_f = (float)max_metric;
+    float min_metric, max_metric_k, q;
+
+    for(const float *in_k=in ; in_k < in + K*O ; in_k += O) {
+      //Find min_element and max_element
+      min_metric = max_metric_k = in_k[0];
+      for(int o=1 ; o < O ; ++o) {
+        min_metric = std::min(min_metric, in_k[o]);
+        max_metric_k = std::max(max_metric_k, in_k[o]);
+      }
+      profile.sum_min += min_metric;
+      profile.sum_max += max_metric_k;
+
+      //Remove it from metrics, scale and saturate
+      for(int o=0 ; o < O ; ++o) {
+        q = scale*(in_k[o] - min_metric) + 0.5f;
+        *(metrics++) = (q < max_f) ? (T)q : max_metric;
+      }
+    }
+  }
+
+} // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_METRICS_QUANTIZER_H */
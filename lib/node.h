@@ -22,62 +22,33 @@
 #define INCLUDED_LAZYVITERBI_NODE_H
 
 #include <lazyviterbi/api.h>
-#include <cfloat>
+#include <stdint.h>
 
 namespace gr {
 namespace lazyviterbi {
 	/*!
 	 * \struct node "Structure for real nodes."
 	 *
-	 * Contains the previous state and previous
-	 * input sequence (identifying the branch) leading to itself.
+	 * Contains the index of the branch leading to itself on the shortest path,
+	 * as an index in PS[s] and PI[s] (s being the state of the node), from
+	 * which the previous state and previous input are recovered.
 	 * The identifying information of the node itself in the trellis must be
 	 * handled by its container.
 	 */
     struct node
     {
       /*!
-       * Index of the previous state on the shortest path.
+       * The node has been expanded if epoch is the current epoch of its
+       * container (this way, resetting every nodes only requires to change
+       * the current epoch).
        */
-      unsigned int prev_state_idx;
+      uint8_t epoch;
       /*!
-       * Previous input leading to this node.
+       * Index of the incoming branch on the shortest path, in PS[s] and PI[s].
        */
-      int prev_input;
-
-      /*!
-       * Wether or note this nodes has been expanded.
-       */
-      bool expanded;
+      uint8_t prev_pidx;
     };
 
-	/*!
-	 * \struct node "Structure for shadow nodes."
-	 *
-	 * Contains its identifying information (time and state indexes), as well as
-	 * the previous state and previous input sequence (identifying the branch)
-	 * leading to itself.
-	 */
-    struct shadow_node
-    {
-      /*!
-       * Index of the previous state on the shortest path.
-       */
-      unsigned int prev_state_idx;
-      /*!
-       * Previous input leading to this node.
-       */
-      int prev_input;
-
-      /*!
-       * Time index of the node.
-       */
-      unsigned int time_idx;
-      /*!
-       * State identifier of the node.
-       */
-      unsigned int state_idx;
-    };
   } // namespace lazyviterbi
 } // namespace gr
 
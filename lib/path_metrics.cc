@@ -0,0 +1,143 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <vector>
+#include "path_metrics.h"
+
+namespace gr {
+namespace lazyviterbi {
+
+  namespace {
+
+    //Largest number of states searched by trellis_mixing_depth(): its two
+    //sets of S*S bits then take 4 MiB
+    const int MAX_SEARCHED_STATES = 4096;
+
+    //Memory m of a shift-register trellis of S = I^m states (the input being
+    //the least or the most significant digit of the next state), or -1 if
+    //the trellis is not a shift register
+    int
+    shift_register_memory(int I, int S, const int *NS)
+    {
+      if(I < 2) {
+        return -1;
+      }
+
+      int m = 0;
+      long size = 1;
+      while(size < S) {
+        size *= I;
+        ++m;
+      }
+      if(size != S) {
+        return -1;
+      }
+
+      bool lsb = true;
+      bool msb = true;
+      for(int s=0 ; s < S ; ++s) {
+        for(int i=0 ; i < I ; ++i) {
+          lsb = lsb && (NS[s*I + i] == (int)(((long)s*I + i) % S));
+          msb = msb && (NS[s*I + i] == s/I + i*(S/I));
+        }
+      }
+
+      return (lsb || msb) ? m : -1;
+    }
+
+  } // anonymous namespace
+
+  int
+  trellis_mixing_depth(const gr::trellis::fsm &FSM, int max_depth)
+  {
+    return trellis_mixing_depth(FSM.I(), FSM.S(), &FSM.NS()[0], max_depth);
+  }
+
+  int
+  trellis_mixing_depth(int I, int S, const int *NS, int max_depth)
+  {
+    //Larger trellises are not searched: every state of a shift register of
+    //memory m is reached from every state through exactly m branches (and
+    //the first digit of the state cannot change in less)
+    if(S > MAX_SEARCHED_STATES) {
+      int m = shift_register_memory(I, S, NS);
+      return (m <= max_depth) ? m : -1;
+    }
+
+    const size_t n_words = ((size_t)S + 63)/64;
+
+    //reach[s*n_words...] is the set of states reachable from s through
+    //exactly d branches
+    std::vector<uint64_t> reach((size_t)S*n_words, 0);
+    std::vector<uint64_t> next_reach((size_t)S*n_words);
+
+    for(int s=0 ; s < S ; ++s) {
+      reach[s*n_words + s/64] = (uint64_t)1 << (s%64);
+    }
+
+    //Mask of the last word of a full set
+    const uint64_t last_mask = (S%64 == 0) ? ~(uint64_t)0
+      : (((uint64_t)1 << (S%64)) - 1);
+
+    for(int d=1 ; d <= max_depth ; ++d) {
+      bool all_full = true;
+
+      //States reachable from s in d branches are the states reachable from
+      //its next states in d-1 branches
+      for(int s=0 ; s < S ; ++s) {
+        uint64_t *set = &next_reach[s*n_words];
+
+        std::fill(set, set + n_words, 0);
+        for(int i=0 ; i < I ; ++i) {
+          const uint64_t *ns_set = &reach[NS[s*I + i]*n_words];
+          for(size_t w=0 ; w < n_words ; ++w) {
+            set[w] |= ns_set[w];
+          }
+        }
+
+        for(size_t w=0 ; all_full && w < n_words ; ++w) {
+          all_full = (set[w] == ((w == n_words - 1) ? last_mask : ~(uint64_t)0));
+        }
+      }
+
+      if(all_full) {
+        return d;
+      }
+
+      reach.swap(next_reach);
+    }
+
+    return -1;
+  }
+
+  int
+  max_fixed_branch_metric(int metric_bits, int depth)
+  {
+    if(depth < 1) {
+      return 0;
+    }
+
+    //2*depth*max_metric + 1 < 2^(metric_bits-1)
+    return (int)((((long)1 << (metric_bits - 1)) - 2) / (2*depth));
+  }
+
+} // namespace lazyviterbi
+} // namespace gr
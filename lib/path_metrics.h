@@ -0,0 +1,93 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_PATH_METRICS_H
+#define INCLUDED_LAZYVITERBI_PATH_METRICS_H
+
+#include <lazyviterbi/api.h>
+#include <gnuradio/trellis/fsm.h>
+#include <stdint.h>
+
+namespace gr {
+namespace lazyviterbi {
+
+  /*!
+   * \brief Integer path metrics with modulo arithmetic.
+   *
+   * Path metrics are accumulated branch metrics (smaller is better), and are
+   * allowed to wrap around. As long as two path metrics differ by less than
+   * half the range of T, the sign of their (wrapped) difference tells which is
+   * the smallest: no normalization is ever needed.
+   */
+  template <typename T> struct modulo_metric;
+
+  template <> struct modulo_metric<uint8_t>
+  {
+    typedef int8_t diff_type;
+  };
+
+  template <> struct modulo_metric<uint16_t>
+  {
+    typedef int16_t diff_type;
+  };
+
+  //! True if path metric \p a is smaller than \p b.
+  template <typename T>
+  inline bool modulo_less(T a, T b)
+  {
+    return (typename modulo_metric<T>::diff_type)(T)(a - b) < 0;
+  }
+
+  /*!
+   * \brief Smallest number of sections D such that every state of the trellis
+   * can be reached from every state through exactly D branches, or -1 if
+   * there is no such D up to max_depth.
+   *
+   * This is the constraint length minus one of a shift-register code. D
+   * sections after any time index, the largest and smallest path metrics
+   * differ by at most D times the largest branch metric.
+   *
+   * Trellises of more than 4096 states are only recognized as shift
+   * registers (of depth log_I(S)): the depth of the others is -1.
+   */
+  int trellis_mixing_depth(const gr::trellis::fsm &FSM, int max_depth=64);
+
+  /*!
+   * \brief Same as above, for the trellis whose next states are
+   * NS[s*I + i]. Exported for the unit tests.
+   */
+  LAZYVITERBI_API int trellis_mixing_depth(int I, int S, const int *NS,
+      int max_depth=64);
+
+  /*!
+   * \brief Largest branch metric keeping path metrics of metric_bits bits
+   * comparable with modulo_less() (0 if there is none).
+   *
+   * Branch metrics are bounded by the returned value, and the initial states
+   * other than S0 (if known) start with depth*max_metric + 1: path metrics
+   * then spread over less than 2*depth*max_metric + 1, which must stay below
+   * half the range of the path metrics.
+   */
+  int max_fixed_branch_metric(int metric_bits, int depth);
+
+} // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_PATH_METRICS_H */
@@ -0,0 +1,260 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Tests of the cache of the timings of auto_viterbi, in a temporary
+ * directory.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/test/unit_test.hpp>
+#include <lazyviterbi/auto_viterbi.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include "autotuner.h"
+
+using namespace gr::lazyviterbi;
+
+namespace {
+
+  //Code (5, 7), the new bit being the least significant bit of the state
+  gr::trellis::fsm
+  code_5_7()
+  {
+    const int NS[8] = {0, 1, 2, 3, 0, 1, 2, 3};
+    const int OS[8] = {0, 3, 1, 2, 3, 0, 2, 1};
+
+    return gr::trellis::fsm(2, 4, 4, std::vector<int>(NS, NS + 8),
+        std::vector<int>(OS, OS + 8));
+  }
+
+  //Temporary directory, removed with the cache files of the tests
+  class temp_dir
+  {
+   public:
+    temp_dir()
+    {
+      char path[] = "/tmp/qa_auto_viterbi_XXXXXX";
+      BOOST_REQUIRE(mkdtemp(path));
+      d_path = path;
+    }
+
+    ~temp_dir()
+    {
+      std::remove((d_path + "/gr-lazyviterbi/autotune").c_str());
+      rmdir((d_path + "/gr-lazyviterbi").c_str());
+      std::remove((d_path + "/autotune").c_str());
+      rmdir(d_path.c_str());
+    }
+
+    const std::string &path() const { return d_path; }
+
+   private:
+    std::string d_path;
+  };
+
+  bool
+  file_exists(const std::string &path)
+  {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+  }
+
+  std::string
+  read_file(const std::string &path)
+  {
+    std::ifstream f(path.c_str());
+    std::ostringstream s;
+    s << f.rdbuf();
+
+    return s.str();
+  }
+
+  void
+  write_file(const std::string &path, const std::string &content)
+  {
+    std::ofstream f(path.c_str());
+    f << content;
+  }
+
+  //Key of a tuning in cache files (fields but the engine)
+  std::string
+  cache_key(const std::string &hash, int K, const char *ebn0)
+  {
+    std::ostringstream k;
+    k << hash << '\t' << autotuner::cpu_model() << '\t' << K << '\t' << ebn0;
+
+    return k.str();
+  }
+
+} // anonymous namespace
+
+/*
+ * Keys of cache files do not change from one run (or build) to another: the
+ * hash of the trellis only depends on its tables.
+ */
+BOOST_AUTO_TEST_CASE(cache_key_is_stable)
+{
+  compiled_trellis::sptr t = compiled_trellis::get(code_5_7());
+  BOOST_CHECK_EQUAL(t->hash(), 0x7fa5b53b9d314577ULL);
+
+  //Lines written by hand with the documented format are found
+  temp_dir dir;
+  const std::string file = dir.path() + "/autotune";
+  write_file(file, cache_key("7fa5b53b9d314577", 200, "5.0")
+      + "\tviterbi_volk_state\n");
+
+  BOOST_CHECK_EQUAL(autotuner(t, 200, 0, -1, 5.0f).lookup(file),
+      "viterbi_volk_state");
+  //Eb/N0 to the tenth of dB
+  BOOST_CHECK_EQUAL(autotuner(t, 200, 0, -1, 5.04f).lookup(file),
+      "viterbi_volk_state");
+  BOOST_CHECK_EQUAL(autotuner(t, 200, 0, -1, 5.1f).lookup(file), "");
+  BOOST_CHECK_EQUAL(autotuner(t, 201, 0, -1, 5.0f).lookup(file), "");
+
+  //Another trellis
+  std::vector<int> NS = code_5_7().NS(), OS = code_5_7().OS();
+  std::swap(OS[0], OS[1]);
+  compiled_trellis::sptr other
+    = compiled_trellis::get(gr::trellis::fsm(2, 4, 4, NS, OS));
+  BOOST_CHECK(other->hash() != t->hash());
+  BOOST_CHECK_EQUAL(autotuner(other, 200, 0, -1, 5.0f).lookup(file), "");
+
+  //Stored lines are found again, the last one winning
+  autotuner tuner(t, 300, 0, -1, 3.0f);
+  tuner.store(file, "lazy_viterbi");
+  tuner.store(file, "viterbi");
+  BOOST_CHECK_EQUAL(tuner.lookup(file), "viterbi");
+  BOOST_CHECK_EQUAL(autotuner(t, 200, 0, -1, 5.0f).lookup(file),
+      "viterbi_volk_state");
+}
+
+/*
+ * A block whose tuning is in the cache file does not time the decoders, nor
+ * writes to the file; otherwise, it appends the result of the timings.
+ */
+BOOST_AUTO_TEST_CASE(cache_hit_skips_tuning)
+{
+  const gr::trellis::fsm FSM = code_5_7();
+  temp_dir dir;
+  const std::string file = dir.path() + "/autotune";
+
+  //Miss: timed and stored
+  auto_viterbi::sptr dec = auto_viterbi::make(FSM, 200, 0, -1, 6.0, file);
+  BOOST_CHECK(!dec->cached());
+  const std::string stored = read_file(file);
+  BOOST_CHECK_EQUAL(stored, cache_key("7fa5b53b9d314577", 200, "6.0") + '\t'
+      + dec->engine() + '\n');
+
+  //Hit: the same engine, without tuning again
+  dec = auto_viterbi::make(FSM, 200, 0, -1, 6.0, file);
+  BOOST_CHECK(dec->cached());
+  BOOST_CHECK_EQUAL(read_file(file), stored);
+
+  //Whatever engine the file gives
+  autotuner(compiled_trellis::get(FSM), 200, 0, -1, 6.0f).store(file,
+      "viterbi_volk_branch");
+  const std::string forced = read_file(file);
+  dec = auto_viterbi::make(FSM, 200, 0, -1, 6.0, file);
+  BOOST_CHECK(dec->cached());
+  BOOST_CHECK_EQUAL(dec->engine(), "viterbi_volk_branch");
+  BOOST_CHECK_EQUAL(read_file(file), forced);
+}
+
+/*
+ * Lines of a corrupt cache file (garbage, engines of another version, lines
+ * truncated by a crash) are ignored.
+ */
+BOOST_AUTO_TEST_CASE(corrupt_cache_lines_are_ignored)
+{
+  compiled_trellis::sptr t = compiled_trellis::get(code_5_7());
+  autotuner tuner(t, 200, 0, -1, 5.0f);
+  const std::string key = cache_key("7fa5b53b9d314577", 200, "5.0");
+  temp_dir dir;
+  const std::string file = dir.path() + "/autotune";
+
+  write_file(file, "garbage\n\n\t\t\t\n"
+      + key + "\tviterbi_volk_state\n"
+      + key + "\tno_such_engine\n"
+      + key + "\n"
+      + key + "\t\n"
+      + key.substr(0, key.size() - 2) + "\tviterbi\n"
+      + key + "\tlazy_vit");
+  BOOST_CHECK_EQUAL(tuner.lookup(file), "viterbi_volk_state");
+
+  //The line appended to the truncated one is lost, not the next ones
+  tuner.store(file, "lazy_viterbi");
+  tuner.store(file, "viterbi");
+  BOOST_CHECK_EQUAL(tuner.lookup(file), "viterbi");
+
+  //The block times the decoders when the file holds nothing valid
+  write_file(file, key + "\tno_such_engine\n" + key + "\tvit");
+  BOOST_CHECK(!auto_viterbi::make(code_5_7(), 200, 0, -1, 5.0,
+        file)->cached());
+
+  //Missing file
+  BOOST_CHECK_EQUAL(tuner.lookup(dir.path() + "/missing"), "");
+}
+
+/*
+ * The default cache file is in $XDG_CACHE_HOME, and "none" disables the
+ * cache.
+ */
+BOOST_AUTO_TEST_CASE(default_cache_file_and_none)
+{
+  const gr::trellis::fsm FSM = code_5_7();
+  temp_dir dir;
+  const std::string file = dir.path() + "/gr-lazyviterbi/autotune";
+
+  const char *old_cache_home = std::getenv("XDG_CACHE_HOME");
+  const std::string saved = old_cache_home ? old_cache_home : "";
+  setenv("XDG_CACHE_HOME", dir.path().c_str(), 1);
+
+  BOOST_CHECK_EQUAL(autotuner::default_cache_file(), file);
+
+  //Neither read nor written
+  BOOST_CHECK(!auto_viterbi::make(FSM, 200, 0, -1, 7.0, "none")->cached());
+  BOOST_CHECK(!file_exists(file));
+  BOOST_CHECK(!file_exists(dir.path() + "/gr-lazyviterbi"));
+
+  //The default file (and its directory) is created
+  BOOST_CHECK(!auto_viterbi::make(FSM, 200, 0, -1, 7.0)->cached());
+  BOOST_CHECK(file_exists(file));
+  BOOST_CHECK(auto_viterbi::make(FSM, 200, 0, -1, 7.0)->cached());
+
+  //Even with a valid line, "none" times the decoders
+  const std::string content = read_file(file);
+  BOOST_CHECK(!auto_viterbi::make(FSM, 200, 0, -1, 7.0, "none")->cached());
+  BOOST_CHECK_EQUAL(read_file(file), content);
+
+  if(old_cache_home) {
+    setenv("XDG_CACHE_HOME", saved.c_str(), 1);
+  }
+  else {
+    unsetenv("XDG_CACHE_HOME");
+  }
+}
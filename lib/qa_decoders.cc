@@ -0,0 +1,1045 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Differential tests of the decoders (see lazyviterbi/decoder.h, and the
+ * decoders which only exist as blocks) against a reference Viterbi decoder,
+ * on random trellises, block lengths, initial and final states and noise;
+ * failures of the worker threads; differential tests of the SIMD kernels against the generic ones; and
+ * throughput check against stored baselines, relative to the viterbi
+ * decoder.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/test/unit_test.hpp>
+#include <boost/bind.hpp>
+#include <lazyviterbi/compiled_trellis.h>
+#include <lazyviterbi/decoder.h>
+#include <lazyviterbi/lazy_viterbi_stream.h>
+#include <lazyviterbi/viterbi_batch.h>
+#include <lazyviterbi/viterbi_butterfly.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "acs_kernels.h"
+#include "batch_kernels.h"
+#include "butterfly_kernels.h"
+#include "decode_pool.h"
+#include "gather_kernels.h"
+#include "quantize_kernels.h"
+#include "qa_reference.h"
+#include "thread_team.h"
+
+using namespace gr::lazyviterbi;
+using namespace gr::lazyviterbi::qa;
+
+namespace {
+
+  struct engine
+  {
+    const char *name;
+    decoder::sptr (*make)(const compiled_trellis::sptr &trellis, int S0,
+        int SK);
+  };
+
+  /*
+   * Decoder running a block in a flowgraph, for the decoders which only exist
+   * as blocks: each call of decode() runs a new flowgraph, with a block made
+   * for this block length and these initial and final states.
+   */
+  class block_decoder : public decoder
+  {
+   public:
+    typedef gr::block_sptr (*make_block_fn)(const gr::trellis::fsm &FSM,
+        int K, int S0, int SK);
+
+    /*!
+     * \param tail Number of sections of null metrics appended to each block,
+     * for the decoders whose decisions lag behind their input.
+     */
+    static sptr make(const compiled_trellis::sptr &trellis, int S0, int SK,
+        make_block_fn make_block, int tail=0)
+    {
+      return sptr(new block_decoder(trellis, S0, SK, make_block, tail));
+    }
+
+    workspace_sptr make_workspace(size_t K, huge_pages_t huge_pages) const
+    {
+      return workspace_sptr(new workspace());
+    }
+
+    size_t workspace_bytes(size_t K) const
+    {
+      return 0;
+    }
+
+    void decode(const float *metrics, size_t K, int S0, int SK, uint8_t *out,
+        workspace &ws) const
+    {
+      const int O = d_trellis->O();
+      std::vector<float> in(metrics, metrics + K*O);
+      in.resize((K + d_tail)*O, 0.0);
+
+      std::vector<unsigned char> data
+        = run_flowgraph(d_make_block(d_trellis->fsm(), K, S0, SK), in);
+
+      //Missing decisions are not inputs of the trellis
+      data.resize(K, 0xff);
+      std::copy(data.begin(), data.end(), out);
+    }
+
+   private:
+    make_block_fn d_make_block;
+    int d_tail;
+
+    block_decoder(const compiled_trellis::sptr &trellis, int S0, int SK,
+        make_block_fn make_block, int tail)
+      : decoder(trellis, S0, SK), d_make_block(make_block), d_tail(tail)
+    {
+      //Trellises out of the scope of the block are rejected by its
+      //constructor
+      d_make_block(trellis->fsm(), 1, S0, SK);
+    }
+  };
+
+  //Decision depth of lazy_viterbi_stream for a shift-register code
+  int
+  stream_depth(int S)
+  {
+    int m = 0;
+    while((1 << m) < S) {
+      ++m;
+    }
+
+    return 8*(m + 1);
+  }
+
+  decoder::sptr
+  make_stream_decoder(const compiled_trellis::sptr &t, int S0, int SK,
+      block_decoder::make_block_fn make_block)
+  {
+    //Streams have no final state
+    if(SK != -1) {
+      throw std::invalid_argument("lazy_viterbi_stream: no final state");
+    }
+
+    //Decisions lag behind by less than D + 2*L < 8*(D+1) sections
+    return block_decoder::make(t, S0, SK, make_block,
+        8*(stream_depth(t->S()) + 1));
+  }
+
+  //Decoders computing path metrics with floats
+  const engine EXACT_ENGINES[] = {
+    {"viterbi", [](const compiled_trellis::sptr &t, int S0, int SK) {
+        return decoder::make_viterbi(t, S0, SK); }},
+    {"viterbi_volk_branch", [](const compiled_trellis::sptr &t, int S0, int SK) {
+        return decoder::make_viterbi_volk_branch(t, S0, SK); }},
+    {"viterbi_volk_state", [](const compiled_trellis::sptr &t, int S0, int SK) {
+        return decoder::make_viterbi_volk_state(t, S0, SK); }},
+    {"viterbi_volk_state_mt", [](const compiled_trellis::sptr &t, int S0, int SK) {
+        return decoder::make_viterbi_volk_state(t, S0, SK, 2); }},
+  };
+
+  //Decoders quantizing branch metrics
+  const engine QUANTIZED_ENGINES[] = {
+    {"viterbi_volk_state_i16", [](const compiled_trellis::sptr &t, int S0, int SK) {
+        return decoder::make_viterbi_volk_state(t, S0, SK, 1, 16); }},
+    {"viterbi_volk_state_i8", [](const compiled_trellis::sptr &t, int S0, int SK) {
+        return decoder::make_viterbi_volk_state(t, S0, SK, 1, 8); }},
+    {"lazy_viterbi", [](const compiled_trellis::sptr &t, int S0, int SK) {
+        return decoder::make_lazy_viterbi(t, S0, SK); }},
+    {"lazy_viterbi_i16", [](const compiled_trellis::sptr &t, int S0, int SK) {
+        return decoder::make_lazy_viterbi(t, S0, SK, 1.0, 16); }},
+    {"lazy_viterbi_auto", [](const compiled_trellis::sptr &t, int S0, int SK) {
+        return decoder::make_lazy_viterbi(t, S0, SK, 0.0); }},
+    {"lazy_viterbi_auto_i16", [](const compiled_trellis::sptr &t, int S0, int SK) {
+        return decoder::make_lazy_viterbi(t, S0, SK, 0.0, 16); }},
+    {"viterbi_butterfly", [](const compiled_trellis::sptr &t, int S0, int SK) {
+        return block_decoder::make(t, S0, SK,
+            [](const gr::trellis::fsm &FSM, int K, int S0, int SK) {
+              return (gr::block_sptr)viterbi_butterfly::make(FSM, K, S0, SK); }); }},
+    {"viterbi_batch", [](const compiled_trellis::sptr &t, int S0, int SK) {
+        return block_decoder::make(t, S0, SK,
+            [](const gr::trellis::fsm &FSM, int K, int S0, int SK) {
+              return (gr::block_sptr)viterbi_batch::make(FSM, K, S0, SK); }); }},
+    {"lazy_viterbi_stream", [](const compiled_trellis::sptr &t, int S0, int SK) {
+        return make_stream_decoder(t, S0, SK,
+            [](const gr::trellis::fsm &FSM, int K, int S0, int SK) {
+              return (gr::block_sptr)lazy_viterbi_stream::make(FSM,
+                  stream_depth(FSM.S()), S0); }); }},
+    {"lazy_viterbi_stream_auto_i16", [](const compiled_trellis::sptr &t, int S0, int SK) {
+        return make_stream_decoder(t, S0, SK,
+            [](const gr::trellis::fsm &FSM, int K, int S0, int SK) {
+              return (gr::block_sptr)lazy_viterbi_stream::make(FSM,
+                  stream_depth(FSM.S()), S0, 0.0, 16); }); }},
+  };
+
+  template <size_t N>
+  size_t n_engines(const engine (&)[N]) { return N; }
+
+  //Random trellis of a random shape (shift register or not)
+  gr::trellis::fsm
+  random_trellis(rng_t &rng)
+  {
+    if(uniform(rng, 0, 2) == 0) {
+      return random_shift_register_fsm(rng, uniform(rng, 2, 8),
+          uniform(rng, 2, 3));
+    }
+
+    const int I = (uniform(rng, 0, 3) == 0) ? 4 : 2;
+    return random_fsm(rng, I, uniform(rng, 2, (I == 4) ? 64 : 256),
+        uniform(rng, 2, 16));
+  }
+
+  /*
+   * Decode blocks of random lengths (shorter, then longer, than the
+   * workspace was made for) with each engine, on a random trellis, and check
+   * every decoded block is a best path.
+   */
+  void
+  check_engines(const engine *engines, size_t n, rng_t &rng, float ebn0_min,
+      float ebn0_max, int n_trellises, bool codes_only)
+  {
+    for(int t=0 ; t < n_trellises ; ++t) {
+      gr::trellis::fsm FSM = codes_only
+        ? random_shift_register_fsm(rng, uniform(rng, 2, 8), uniform(rng, 2, 3))
+        : random_trellis(rng);
+      compiled_trellis::sptr trellis = compiled_trellis::get(FSM);
+
+      int S0 = uniform(rng, 0, 1) ? uniform(rng, 0, FSM.S() - 1) : -1;
+      int SK = uniform(rng, 0, 1) ? uniform(rng, 0, FSM.S() - 1) : -1;
+      int K_ws = uniform(rng, 64, 512);
+      float ebn0 = std::uniform_real_distribution<float>(ebn0_min, ebn0_max)(rng);
+
+      int K[3] = {uniform(rng, 64, K_ws), uniform(rng, K_ws, 2*K_ws),
+        uniform(rng, 64, K_ws)};
+
+      for(size_t e=0 ; e < n ; ++e) {
+        decoder::sptr dec;
+        try {
+          dec = engines[e].make(trellis, S0, SK);
+        }
+        catch(std::invalid_argument &) {
+          //Trellis out of the scope of this decoder (too deep for integer
+          //path metrics)
+          continue;
+        }
+
+        decoder::workspace_sptr ws = dec->make_workspace(K_ws);
+        rng_t block_rng(t);
+
+        for(int b=0 ; b < 3 ; ++b) {
+          std::vector<unsigned char> inputs, out(K[b]), ref_out(K[b]);
+          std::vector<float> metrics;
+          make_metrics(FSM, K[b], 1, ebn0, S0, block_rng, inputs, metrics);
+
+          //Terminated codes: the final state is the one of the encoder
+          //(given for this block only)
+          int block_SK = SK;
+          if(codes_only && SK != -1) {
+            block_SK = final_state(FSM, K[b], (S0 == -1) ? 0 : S0, &inputs[0]);
+          }
+
+          double ref_metric = reference_viterbi(FSM, K[b], S0, block_SK,
+              &metrics[0], &ref_out[0]);
+          if(std::isinf(ref_metric)) {
+            //SK cannot be reached from S0 in K sections
+            continue;
+          }
+
+          if(block_SK == SK) {
+            dec->decode(&metrics[0], K[b], &out[0], *ws);
+          }
+          else {
+            dec->decode(&metrics[0], K[b], S0, block_SK, &out[0], *ws);
+          }
+
+          BOOST_CHECK_MESSAGE(is_best_path(FSM, K[b], S0, block_SK,
+                &metrics[0], &out[0], &ref_out[0], ref_metric),
+              engines[e].name << ": not a best path (I=" << FSM.I()
+              << " S=" << FSM.S() << " O=" << FSM.O() << " K=" << K[b]
+              << " S0=" << S0 << " SK=" << block_SK << " Eb/N0=" << ebn0 << ")");
+        }
+      }
+    }
+  }
+
+  //Environment variable, or default value
+  std::string
+  setting(const char *name, const char *default_value)
+  {
+    const char *value = std::getenv(name);
+
+    return value ? value : default_value;
+  }
+
+  /*
+   * Nanoseconds per section taken by the decoder called name by
+   * lazyviterbi_benchmark (same initial and final states, fastest of five
+   * passes as with --repeat 5) on the n_blocks blocks of metrics, or -1 for an unknown name.
+   * Blocks are timed through a flowgraph decoding every block, as in the
+   * benchmark.
+   */
+  double
+  benchmark_ns(const std::string &name, const gr::trellis::fsm &FSM, int K,
+      long n_blocks, const std::vector<float> &metrics)
+  {
+    typedef std::chrono::steady_clock clock;
+
+    const compiled_trellis::sptr trellis = compiled_trellis::get(FSM);
+    decoder::sptr dec;
+    gr::block_sptr (*make_block)(const gr::trellis::fsm &FSM, int K) = NULL;
+
+    if(name == "viterbi") {
+      dec = decoder::make_viterbi(trellis, 0, -1);
+    }
+    else if(name == "viterbi_volk_branch") {
+      dec = decoder::make_viterbi_volk_branch(trellis, 0, -1);
+    }
+    else if(name == "viterbi_volk_state") {
+      dec = decoder::make_viterbi_volk_state(trellis, 0, -1);
+    }
+    else if(name == "viterbi_volk_state_i16") {
+      dec = decoder::make_viterbi_volk_state(trellis, 0, -1, 1, 16);
+    }
+    else if(name == "viterbi_volk_state_i8") {
+      dec = decoder::make_viterbi_volk_state(trellis, 0, -1, 1, 8);
+    }
+    else if(name == "lazy_viterbi") {
+      dec = decoder::make_lazy_viterbi(trellis, 0, -1);
+    }
+    else if(name == "lazy_viterbi_i16") {
+      dec = decoder::make_lazy_viterbi(trellis, 0, -1, 1.0, 16);
+    }
+    else if(name == "viterbi_butterfly") {
+      make_block = [](const gr::trellis::fsm &FSM, int K) {
+        return (gr::block_sptr)viterbi_butterfly::make(FSM, K, 0, -1); };
+    }
+    else if(name == "viterbi_batch") {
+      make_block = [](const gr::trellis::fsm &FSM, int K) {
+        return (gr::block_sptr)viterbi_batch::make(FSM, K, 0, -1); };
+    }
+    else {
+      return -1.0;
+    }
+
+    const int O = FSM.O();
+    std::vector<unsigned char> out((size_t)n_blocks*K);
+    decoder::workspace_sptr ws;
+
+    //Warm up caches and lazily built tables
+    if(dec) {
+      ws = dec->make_workspace(K);
+      dec->decode(&metrics[0], K, &out[0], *ws);
+    }
+    else {
+      run_flowgraph(make_block(FSM, K),
+          std::vector<float>(metrics.begin(), metrics.begin() + K*O));
+    }
+
+    double best = -1.0;
+    for(int p=0 ; p < 5 ; ++p) {
+      double elapsed;
+
+      if(dec) {
+        clock::time_point start = clock::now();
+        for(long n=0 ; n < n_blocks ; ++n) {
+          dec->decode(&metrics[(size_t)n*K*O], K, &out[(size_t)n*K], *ws);
+        }
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+      }
+      else {
+        run_flowgraph(make_block(FSM, K), metrics, 100000000, &elapsed);
+      }
+
+      if(best < 0 || elapsed < best) {
+        best = elapsed;
+      }
+    }
+
+    return best * 1e9 / ((double)n_blocks * K);
+  }
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(exact_decoders_find_best_paths)
+{
+  rng_t rng(1);
+
+  //From very noisy blocks (many ties and long error events) to clean ones
+  check_engines(EXACT_ENGINES, n_engines(EXACT_ENGINES), rng, -3.0, 8.0, 60,
+      false);
+}
+
+BOOST_AUTO_TEST_CASE(quantized_decoders_find_best_paths_at_high_snr)
+{
+  rng_t rng(2);
+
+  //Quantization only changes the best path of noisy blocks: with
+  //convolutional codes at high SNR, the best path stands out
+  check_engines(QUANTIZED_ENGINES, n_engines(QUANTIZED_ENGINES), rng, 9.0,
+      12.0, 60, true);
+}
+
+BOOST_AUTO_TEST_CASE(lazy_decoder_is_exact_on_integer_metrics)
+{
+  rng_t rng(3);
+
+  //Integer metrics are quantized without loss with a unit scale
+  for(int t=0 ; t < 60 ; ++t) {
+    gr::trellis::fsm FSM = random_trellis(rng);
+    compiled_trellis::sptr trellis = compiled_trellis::get(FSM);
+
+    int K = uniform(rng, 1, 1000);
+    int S0 = uniform(rng, 0, 1) ? uniform(rng, 0, FSM.S() - 1) : -1;
+    int SK = uniform(rng, 0, 1) ? uniform(rng, 0, FSM.S() - 1) : -1;
+    int max_metric = uniform(rng, 1, 255);
+
+    std::vector<float> metrics((size_t)K*FSM.O());
+    for(size_t m=0 ; m < metrics.size() ; ++m) {
+      metrics[m] = (float)uniform(rng, 0, max_metric);
+    }
+
+    std::vector<unsigned char> out(K), ref_out(K);
+    double ref_metric = reference_viterbi(FSM, K, S0, SK, &metrics[0],
+        &ref_out[0]);
+    if(std::isinf(ref_metric)) {
+      continue;
+    }
+
+    for(int bits=8 ; bits <= 16 ; bits += 8) {
+      decoder::sptr dec = decoder::make_lazy_viterbi(trellis, S0, SK, 1.0, bits);
+      decoder::workspace_sptr ws = dec->make_workspace(K);
+
+      dec->decode(&metrics[0], K, &out[0], *ws);
+
+      BOOST_CHECK_MESSAGE(path_metric(FSM, K, S0, SK, &metrics[0], &out[0])
+          == ref_metric, "lazy_viterbi (" << bits << " bits): not a best path"
+          << " (I=" << FSM.I() << " S=" << FSM.S() << " K=" << K << ")");
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(workspace_of_another_decoder_is_rejected)
+{
+  rng_t rng(4);
+  compiled_trellis::sptr trellis = compiled_trellis::get(
+      random_shift_register_fsm(rng, 2, 2));
+
+  decoder::sptr viterbi = decoder::make_viterbi(trellis);
+  decoder::sptr lazy = decoder::make_lazy_viterbi(trellis);
+  decoder::workspace_sptr ws = lazy->make_workspace(16);
+
+  std::vector<float> metrics(16*trellis->O(), 0.0);
+  std::vector<unsigned char> out(16);
+
+  BOOST_CHECK_THROW(viterbi->decode(&metrics[0], 16, &out[0], *ws),
+      std::invalid_argument);
+}
+
+/*
+ * Trellis files whose header or branch tables disagree with their NS and OS
+ * tables are rejected, before the cache of the process could hand them to
+ * other decoders.
+ */
+BOOST_AUTO_TEST_CASE(corrupted_trellis_files_are_rejected)
+{
+  //Offsets in the file: is_regular, S and n_branches in the header, then the
+  //tables (offsets, PS, PI, OS, NS and fsm_OS)
+  const size_t IS_REGULAR = 32, S_FIELD = 20, N_BRANCHES = 36, TABLES = 64;
+
+  //State 0 has 3 branches yielding to it, state 3 a single one
+  const int NS[8] = {0, 0, 0, 1, 2, 3, 1, 2};
+  const int OS[8] = {0, 3, 1, 2, 3, 0, 2, 1};
+  const gr::trellis::fsm FSM(2, 4, 4, std::vector<int>(NS, NS + 8),
+      std::vector<int>(OS, OS + 8));
+  compiled_trellis::sptr trellis = compiled_trellis::get(FSM);
+  BOOST_REQUIRE(!trellis->is_regular());
+
+  char path[] = "/tmp/qa_decoders_XXXXXX";
+  int fd = mkstemp(path);
+  BOOST_REQUIRE(fd >= 0);
+  close(fd);
+
+  trellis->save(path);
+  std::vector<char> file;
+  {
+    std::ifstream f(path, std::ios::binary);
+    file.assign(std::istreambuf_iterator<char>(f),
+        std::istreambuf_iterator<char>());
+  }
+  BOOST_REQUIRE_EQUAL(file.size(), TABLES + sizeof(int)*(5 + 3*8 + 2*8));
+
+  //The valid file gives the trellis already used by the process
+  BOOST_CHECK(compiled_trellis::load(path) == trellis);
+
+  const int one = 1, big = 1 << 30;
+  const int offsets[5] = {0, 3, 5, 7, 8};
+  int ps[3];
+  std::memcpy(ps, &file[TABLES + sizeof(int)*5], sizeof(ps));
+  BOOST_REQUIRE_NE(ps[1], ps[2]);
+  std::swap(ps[1], ps[2]);
+
+  //Fields patched one at a time: regular, branches of state 0 swapped (in
+  //range, and not covered by the hash), huge S and n_branches
+  const size_t patch_at[4] = {IS_REGULAR, TABLES + sizeof(int)*5, S_FIELD,
+    N_BRANCHES};
+  const void *patch[4] = {&one, ps, &big, &big};
+  const size_t patch_size[4] = {sizeof(int), sizeof(ps), sizeof(int),
+    sizeof(int)};
+
+  for(int p=0 ; p < 4 ; ++p) {
+    std::vector<char> corrupted(file);
+    std::memcpy(&corrupted[patch_at[p]], patch[p], patch_size[p]);
+    {
+      std::ofstream f(path, std::ios::binary | std::ios::trunc);
+      f.write(&corrupted[0], corrupted.size());
+    }
+
+    BOOST_CHECK_THROW(compiled_trellis::load(path), std::invalid_argument);
+  }
+
+  //The trellis of the process keeps its own tables
+  BOOST_CHECK(std::equal(offsets, offsets + 5, trellis->offsets()));
+  BOOST_CHECK(!compiled_trellis::get(FSM)->is_regular());
+
+  std::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(counters_of_workspaces)
+{
+  const int K = 500;
+  const int n_blocks = 4;
+  rng_t rng(5);
+  gr::trellis::fsm FSM = random_shift_register_fsm(rng, 4, 2);
+  compiled_trellis::sptr trellis = compiled_trellis::get(FSM);
+
+  std::vector<unsigned char> inputs, out(K);
+  std::vector<float> metrics;
+  make_metrics(FSM, K, n_blocks, 4.0, 0, rng, inputs, metrics);
+
+  decoder::sptr viterbi = decoder::make_viterbi(trellis, 0, -1);
+  decoder::sptr lazy = decoder::make_lazy_viterbi(trellis, 0, -1, 0.0);
+  decoder::workspace_sptr viterbi_ws = viterbi->make_workspace(K);
+  decoder::workspace_sptr lazy_ws = lazy->make_workspace(K);
+
+  for(int n=0 ; n < n_blocks ; ++n) {
+    viterbi->decode(&metrics[n*K*FSM.O()], K, &out[0], *viterbi_ws);
+    lazy->decode(&metrics[n*K*FSM.O()], K, &out[0], *lazy_ws);
+  }
+
+  for(int w=0 ; w < 2 ; ++w) {
+    const decoder::counters &stats = (w ? lazy_ws : viterbi_ws)->stats;
+    uint64_t hist_blocks = 0;
+    for(int b=0 ; b < decoder::counters::LATENCY_BINS ; ++b) {
+      hist_blocks += stats.latency_hist[b];
+    }
+
+    BOOST_CHECK_EQUAL(stats.blocks, (uint64_t)n_blocks);
+    BOOST_CHECK_EQUAL(stats.sections, (uint64_t)n_blocks*K);
+    BOOST_CHECK_EQUAL(hist_blocks, (uint64_t)n_blocks);
+  }
+
+  //Counters of the search are only updated by the Lazy Viterbi algorithm
+  const decoder::counters &stats = lazy_ws->stats;
+  BOOST_CHECK_EQUAL(viterbi_ws->stats.nodes_expanded, 0u);
+  //At least one node per section, each of them pushed at least once
+  BOOST_CHECK_GE(stats.nodes_expanded, (uint64_t)n_blocks*(K + 1));
+  BOOST_CHECK_GE(stats.shadow_pushes, stats.nodes_expanded + stats.stale_pops);
+  BOOST_CHECK_GT(stats.buckets_scanned, 0u);
+
+  lazy_ws->stats.clear();
+  BOOST_CHECK_EQUAL(lazy_ws->stats.blocks, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(fast_path_finds_best_paths)
+{
+  rng_t rng(6);
+  uint64_t n_blocks = 0, n_fast_blocks = 0;
+
+  //Noisy blocks fall back on the algorithm, clean ones take the fast path
+  for(int t=0 ; t < 60 ; ++t) {
+    gr::trellis::fsm FSM = random_trellis(rng);
+    compiled_trellis::sptr trellis = compiled_trellis::get(FSM);
+
+    int K = uniform(rng, 1, 500);
+    int S0 = uniform(rng, 0, 1) ? uniform(rng, 0, FSM.S() - 1) : -1;
+    int SK = uniform(rng, 0, 1) ? uniform(rng, 0, FSM.S() - 1) : -1;
+    float ebn0 = std::uniform_real_distribution<float>(-3.0, 20.0)(rng);
+
+    std::vector<unsigned char> inputs, out(K), ref_out(K);
+    std::vector<float> metrics;
+    make_metrics(FSM, K, 1, ebn0, S0, rng, inputs, metrics);
+
+    double ref_metric = reference_viterbi(FSM, K, S0, SK, &metrics[0],
+        &ref_out[0]);
+    if(std::isinf(ref_metric)) {
+      continue;
+    }
+
+    for(size_t e=0 ; e < n_engines(EXACT_ENGINES) ; ++e) {
+      decoder::sptr dec = EXACT_ENGINES[e].make(trellis, S0, SK);
+      decoder::workspace_sptr ws = dec->make_workspace(K);
+      dec->set_fast_path(true);
+
+      dec->decode(&metrics[0], K, &out[0], *ws);
+
+      BOOST_CHECK_MESSAGE(is_best_path(FSM, K, S0, SK, &metrics[0], &out[0],
+            &ref_out[0], ref_metric), EXACT_ENGINES[e].name
+          << " (fast path): not a best path (I=" << FSM.I() << " S="
+          << FSM.S() << " O=" << FSM.O() << " K=" << K << " S0=" << S0
+          << " SK=" << SK << " Eb/N0=" << ebn0 << ")");
+
+      ++n_blocks;
+      n_fast_blocks += ws->stats.fast_path_blocks;
+    }
+  }
+
+  BOOST_CHECK_GT(n_fast_blocks, 0u);
+  BOOST_CHECK_LT(n_fast_blocks, n_blocks);
+}
+
+namespace {
+
+  //Job of decode_pool counting its calls, and failing on job 3
+  void
+  failing_job(std::vector<int> *calls, int j, int w)
+  {
+    ++(*calls)[j];
+    if(j == 3) {
+      throw std::runtime_error("job 3");
+    }
+  }
+
+  //Task of thread_team crossing barriers, the last member failing before the
+  //second
+  void
+  failing_member(thread_team *team, int member)
+  {
+    team->barrier();
+    if(member == team->size() - 1) {
+      throw std::runtime_error("last member");
+    }
+    team->barrier();
+    team->barrier();
+  }
+
+  void
+  member_task(std::vector<int> *calls, thread_team *team, int member)
+  {
+    team->barrier();
+    ++(*calls)[member];
+    team->barrier();
+  }
+
+} // anonymous namespace
+
+/*
+ * An exception thrown by a job is rethrown by decode_pool::run() once every
+ * job has run, with or without workers.
+ */
+BOOST_AUTO_TEST_CASE(pool_rethrows_exceptions_of_jobs)
+{
+  static const int n_sizes = 3;
+  static const int sizes[n_sizes] = {0, 1, 3};
+  decode_pool &pool = decode_pool::instance();
+
+  for(int s=0 ; s < n_sizes ; ++s) {
+    pool.set_size(sizes[s]);
+
+    std::vector<int> calls(16, 0);
+    BOOST_CHECK_THROW(pool.run(calls.size(), boost::bind(failing_job, &calls,
+            _1, _2)), std::runtime_error);
+    BOOST_CHECK(std::count(calls.begin(), calls.end(), 1) == (int)calls.size());
+
+    //The pool is still usable
+    std::fill(calls.begin(), calls.end(), 0);
+    BOOST_CHECK_THROW(pool.run(calls.size(), boost::bind(failing_job, &calls,
+            _1, _2)), std::runtime_error);
+    BOOST_CHECK(std::count(calls.begin(), calls.end(), 1) == (int)calls.size());
+  }
+
+  pool.set_size(0);
+}
+
+/*
+ * An exception thrown by a member of a thread_team releases the others from
+ * the barriers, and is rethrown by run(). The team is still usable.
+ */
+BOOST_AUTO_TEST_CASE(team_rethrows_exceptions_of_members)
+{
+  for(int n_members=1 ; n_members <= 3 ; ++n_members) {
+    thread_team team(n_members);
+
+    BOOST_CHECK_THROW(team.run(boost::bind(failing_member, &team, _1)),
+        std::runtime_error);
+
+    std::vector<int> calls(n_members, 0);
+    for(int r=0 ; r < 10 ; ++r) {
+      team.run(boost::bind(member_task, &calls, &team, _1));
+    }
+    BOOST_CHECK(std::count(calls.begin(), calls.end(), 10) == n_members);
+  }
+}
+
+/*
+ * Every SIMD kernel supported by the running CPU gives the same results as
+ * the generic one (the last of each table), on random shapes.
+ */
+BOOST_AUTO_TEST_CASE(quantize_kernels_agree_with_generic)
+{
+  rng_t rng(7);
+  const std::vector<quantize_kernel> &kernels = quantize_kernels();
+  const quantize_kernel &generic = kernels.back();
+
+  for(size_t k=0 ; k + 1 < kernels.size() ; ++k) {
+    if(!kernels[k].is_supported()) {
+      continue;
+    }
+
+    for(int t=0 ; t < 200 ; ++t) {
+      int K = uniform(rng, 1, 300);
+      int O = uniform(rng, 2, 64);
+      float scale = std::uniform_real_distribution<float>(0.1, 40.0)(rng);
+
+      std::vector<float> in((size_t)K*O);
+      for(size_t m=0 ; m < in.size() ; ++m) {
+        in[m] = std::uniform_real_distribution<float>(0.0, 30.0)(rng);
+      }
+
+      std::vector<uint8_t> out8(in.size()), ref8(in.size());
+      std::vector<uint16_t> out16(in.size()), ref16(in.size());
+
+      kernels[k].u8(&in[0], &out8[0], K, O, scale);
+      generic.u8(&in[0], &ref8[0], K, O, scale);
+      kernels[k].u16(&in[0], &out16[0], K, O, scale);
+      generic.u16(&in[0], &ref16[0], K, O, scale);
+
+      BOOST_CHECK_MESSAGE(out8 == ref8 && out16 == ref16, kernels[k].name
+          << ": quantized metrics differ (K=" << K << " O=" << O << ")");
+
+      metrics_profile profile8, ref_profile8, profile16, ref_profile16;
+
+      kernels[k].profile_u8(&in[0], &out8[0], K, O, scale, profile8);
+      generic.profile_u8(&in[0], &ref8[0], K, O, scale, ref_profile8);
+      kernels[k].profile_u16(&in[0], &out16[0], K, O, scale, profile16);
+      generic.profile_u16(&in[0], &ref16[0], K, O, scale, ref_profile16);
+
+      BOOST_CHECK_MESSAGE(out8 == ref8 && out16 == ref16, kernels[k].name
+          << " (profile): quantized metrics differ (K=" << K << " O=" << O << ")");
+      //Same sums, not only close ones: every ISA computes the same profile
+      BOOST_CHECK_EQUAL(profile8.sum_min, ref_profile8.sum_min);
+      BOOST_CHECK_EQUAL(profile8.sum_max, ref_profile8.sum_max);
+      BOOST_CHECK_EQUAL(profile16.sum_min, ref_profile16.sum_min);
+      BOOST_CHECK_EQUAL(profile16.sum_max, ref_profile16.sum_max);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(gather_kernels_agree_with_generic)
+{
+  rng_t rng(8);
+  const std::vector<gather_kernel> &kernels = gather_kernels();
+  const gather_kernel &generic = kernels.back();
+
+  for(size_t k=0 ; k + 1 < kernels.size() ; ++k) {
+    if(!kernels[k].is_supported()) {
+      continue;
+    }
+
+    for(int t=0 ; t < 200 ; ++t) {
+      int S = uniform(rng, 2, 512);
+      int O = uniform(rng, 2, 32);
+      size_t n = uniform(rng, 1, 1000);
+
+      std::vector<float> alpha_prev(S), in_k(O);
+      for(int i=0 ; i < S ; ++i) {
+        alpha_prev[i] = std::uniform_real_distribution<float>(-1000.0, 0.0)(rng);
+      }
+      for(int o=0 ; o < O ; ++o) {
+        in_k[o] = std::uniform_real_distribution<float>(0.0, 30.0)(rng);
+      }
+
+      std::vector<int> ordered_PS(n), ordered_OS(n);
+      for(size_t i=0 ; i < n ; ++i) {
+        ordered_PS[i] = uniform(rng, 0, S - 1);
+        ordered_OS[i] = uniform(rng, 0, O - 1);
+      }
+
+      std::vector<float> out(n), ref(n);
+      kernels[k].gather_sub(&alpha_prev[0], &in_k[0], O, &ordered_PS[0],
+          &ordered_OS[0], &out[0], n);
+      generic.gather_sub(&alpha_prev[0], &in_k[0], O, &ordered_PS[0],
+          &ordered_OS[0], &ref[0], n);
+
+      BOOST_CHECK_MESSAGE(out == ref, kernels[k].name << ": candidate metrics"
+          << " differ (S=" << S << " O=" << O << " n=" << n << ")");
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(acs_kernels_agree_with_generic)
+{
+  rng_t rng(9);
+  const std::vector<acs_kernel> &kernels = acs_kernels();
+  const acs_kernel &generic = kernels.back();
+
+  for(size_t k=0 ; k + 1 < kernels.size() ; ++k) {
+    if(!kernels[k].is_supported()) {
+      continue;
+    }
+
+    for(int t=0 ; t < 200 ; ++t) {
+      size_t n = uniform(rng, 1, 600);
+      size_t stride = n + uniform(rng, 0, 16);
+      int n_branches = uniform(rng, 1, 4);
+
+      //Small integers, so that there are ties between branches and states
+      std::vector<float> can_metrics(n_branches*stride);
+      for(size_t i=0 ; i < can_metrics.size() ; ++i) {
+        can_metrics[i] = (float)uniform(rng, -8, 0);
+      }
+
+      std::vector<float> alpha(n), ref_alpha(n);
+      std::vector<uint16_t> decisions(n), ref_decisions(n);
+      size_t best = kernels[k].select(&can_metrics[0], stride, n_branches,
+          &alpha[0], &decisions[0], n);
+      size_t ref_best = generic.select(&can_metrics[0], stride, n_branches,
+          &ref_alpha[0], &ref_decisions[0], n);
+
+      BOOST_CHECK_MESSAGE(alpha == ref_alpha && decisions == ref_decisions
+          && best == ref_best, kernels[k].name << ": compare-select differs"
+          << " (n=" << n << " branches=" << n_branches << ")");
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(butterfly_kernels_agree_with_generic)
+{
+  rng_t rng(10);
+  const std::vector<butterfly_kernel> &kernels = butterfly_kernels();
+  const butterfly_kernel &generic = kernels.back();
+
+  for(size_t k=0 ; k + 1 < kernels.size() ; ++k) {
+    if(!kernels[k].is_supported()) {
+      continue;
+    }
+
+    for(int t=0 ; t < 200 ; ++t) {
+      int S = kernels[k].min_states << uniform(rng, 0, 5);
+      int O = uniform(rng, 2, kernels[k].max_outputs);
+
+      //Path metrics spread around a random origin (they wrap around)
+      uint16_t origin = (uint16_t)uniform(rng, 0, 65535);
+      std::vector<uint16_t> alpha_prev(S);
+      for(int s=0 ; s < S ; ++s) {
+        alpha_prev[s] = (uint16_t)(origin + uniform(rng, 0, 2000));
+      }
+
+      std::vector<uint8_t> metrics_k(std::max(O, 16), 0);
+      for(int o=0 ; o < O ; ++o) {
+        metrics_k[o] = (uint8_t)uniform(rng, 0, 255);
+      }
+
+      std::vector<uint8_t> idx_a(std::max(S, 16)), idx_b(std::max(S, 16));
+      for(size_t i=0 ; i < idx_a.size() ; ++i) {
+        idx_a[i] = (uint8_t)uniform(rng, 0, O - 1);
+        idx_b[i] = (uint8_t)uniform(rng, 0, O - 1);
+      }
+
+      std::vector<uint16_t> alpha(S), ref_alpha(S);
+      std::vector<uint64_t> decisions((S + 63)/64), ref_decisions((S + 63)/64);
+      kernels[k].acs(&alpha_prev[0], &alpha[0], &metrics_k[0], &idx_a[0],
+          &idx_b[0], &decisions[0], S);
+      generic.acs(&alpha_prev[0], &ref_alpha[0], &metrics_k[0], &idx_a[0],
+          &idx_b[0], &ref_decisions[0], S);
+
+      BOOST_CHECK_MESSAGE(alpha == ref_alpha && decisions == ref_decisions,
+          kernels[k].name << ": add-compare-select differs (S=" << S
+          << " O=" << O << ")");
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(batch_kernels_agree_with_generic)
+{
+  rng_t rng(11);
+  const std::vector<batch_kernel> &kernels = batch_kernels();
+  const batch_kernel &generic = kernels.back();
+
+  for(size_t k=0 ; k + 1 < kernels.size() ; ++k) {
+    if(!kernels[k].is_supported()) {
+      continue;
+    }
+
+    for(int t=0 ; t < 200 ; ++t) {
+      int S = uniform(rng, 2, 256);
+      int O = uniform(rng, 2, 16);
+      int max_size_PS_s = uniform(rng, 1, 4);
+
+      uint16_t origin = (uint16_t)uniform(rng, 0, 65535);
+      std::vector<uint16_t> alpha_prev(S*BATCH_LANES);
+      for(size_t i=0 ; i < alpha_prev.size() ; ++i) {
+        alpha_prev[i] = (uint16_t)(origin + uniform(rng, 0, 2000));
+      }
+
+      std::vector<uint16_t> metrics_k(O*BATCH_LANES);
+      for(size_t i=0 ; i < metrics_k.size() ; ++i) {
+        metrics_k[i] = (uint16_t)uniform(rng, 0, 255);
+      }
+
+      std::vector<int> ordered_PS(S*max_size_PS_s), ordered_OS(S*max_size_PS_s);
+      for(size_t i=0 ; i < ordered_PS.size() ; ++i) {
+        ordered_PS[i] = uniform(rng, 0, S - 1);
+        ordered_OS[i] = uniform(rng, 0, O - 1);
+      }
+
+      std::vector<uint16_t> alpha(S*BATCH_LANES), ref_alpha(S*BATCH_LANES);
+      std::vector<uint8_t> decisions(S*BATCH_LANES), ref_decisions(S*BATCH_LANES);
+      kernels[k].acs(&alpha_prev[0], &alpha[0], &metrics_k[0], &ordered_PS[0],
+          &ordered_OS[0], S, max_size_PS_s, &decisions[0]);
+      generic.acs(&alpha_prev[0], &ref_alpha[0], &metrics_k[0], &ordered_PS[0],
+          &ordered_OS[0], S, max_size_PS_s, &ref_decisions[0]);
+
+      BOOST_CHECK_MESSAGE(alpha == ref_alpha && decisions == ref_decisions,
+          kernels[k].name << ": add-compare-select differs (S=" << S
+          << " O=" << O << " branches=" << max_size_PS_s << ")");
+    }
+  }
+}
+
+/*
+ * Throughput regression check against baselines written by
+ * lazyviterbi_benchmark (CSV format). Absolute times depend on the machine,
+ * so each record is measured again together with the viterbi record of the
+ * same point (fsm, K, Eb/N0), and the time of the decoder relative to viterbi
+ * must not exceed the relative time of the baseline by more than a factor
+ * LAZYVITERBI_MAX_SLOWDOWN. Skipped if LAZYVITERBI_BASELINES is empty.
+ */
+BOOST_AUTO_TEST_CASE(throughput_against_baselines)
+{
+  const std::string baselines = setting("LAZYVITERBI_BASELINES",
+      LAZYVITERBI_QA_BASELINES);
+  const std::string fsm_dir = setting("LAZYVITERBI_FSM_DIR",
+      LAZYVITERBI_QA_FSM_DIR);
+  const double max_slowdown = std::atof(setting("LAZYVITERBI_MAX_SLOWDOWN",
+        LAZYVITERBI_QA_MAX_SLOWDOWN).c_str());
+
+  if(baselines.empty()) {
+    BOOST_TEST_MESSAGE("No throughput baselines (LAZYVITERBI_BASELINES), skipped");
+    return;
+  }
+
+  std::ifstream f(baselines.c_str());
+  BOOST_REQUIRE_MESSAGE(f, "cannot open " << baselines);
+
+  //Header: fsm,engine,K,ebn0_db,blocks,bits_per_s,ns_per_step,...
+  std::vector<std::vector<std::string> > records;
+  std::string line;
+  std::getline(f, line);
+
+  while(std::getline(f, line)) {
+    std::vector<std::string> fields;
+    std::istringstream fields_in(line);
+    for(std::string field ; std::getline(fields_in, field, ',') ; ) {
+      fields.push_back(field);
+    }
+    if(fields.size() >= 7) {
+      records.push_back(fields);
+    }
+  }
+
+  for(size_t r=0 ; r < records.size() ; ++r) {
+    const std::vector<std::string> &fields = records[r];
+    const std::string &name = fields[1];
+    if(name == "viterbi") {
+      continue;
+    }
+
+    //viterbi record of the same point (fsm, K, Eb/N0 and blocks)
+    const std::vector<std::string> *reference = NULL;
+    for(size_t v=0 ; v < records.size() ; ++v) {
+      const std::vector<std::string> &other = records[v];
+      if(other[1] == "viterbi" && other[0] == fields[0]
+          && other[2] == fields[2] && other[3] == fields[3]
+          && other[4] == fields[4]) {
+        reference = &records[v];
+      }
+    }
+    if(!reference) {
+      BOOST_TEST_MESSAGE("No viterbi record for " << fields[0] << " " << name
+          << ", skipped");
+      continue;
+    }
+
+    const int K = std::atoi(fields[2].c_str());
+    const float ebn0 = std::atof(fields[3].c_str());
+    const long n_blocks = std::atol(fields[4].c_str());
+    const double baseline_ratio = std::atof(fields[6].c_str())
+      / std::atof((*reference)[6].c_str());
+
+    gr::trellis::fsm FSM((fsm_dir + "/" + fields[0] + ".fsm").c_str());
+
+    rng_t rng(0);
+    std::vector<unsigned char> inputs;
+    std::vector<float> metrics;
+    make_metrics(FSM, K, n_blocks, ebn0, 0, rng, inputs, metrics);
+
+    //Noise only slows decoders down: a record is measured again (up to
+    //three times) until one ratio is within bounds
+    double ratio = -1.0;
+    for(int m=0 ; m < 3 ; ++m) {
+      const double ns = benchmark_ns(name, FSM, K, n_blocks, metrics);
+      if(ns < 0) {
+        break;
+      }
+      const double viterbi_ns = benchmark_ns("viterbi", FSM, K, n_blocks,
+          metrics);
+
+      if(ratio < 0 || ns/viterbi_ns < ratio) {
+        ratio = ns/viterbi_ns;
+      }
+      if(ratio <= baseline_ratio * max_slowdown) {
+        break;
+      }
+    }
+    if(ratio < 0) {
+      BOOST_TEST_MESSAGE("Unknown decoder " << name << ", skipped");
+      continue;
+    }
+
+    BOOST_CHECK_MESSAGE(ratio <= baseline_ratio * max_slowdown,
+        fields[0] << " " << name << " K=" << K << " Eb/N0=" << ebn0 << ": "
+        << ratio << " times the time of viterbi, baseline "
+        << baseline_ratio);
+  }
+}
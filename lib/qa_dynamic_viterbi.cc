@@ -0,0 +1,271 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Tests of the adaptive mode of dynamic_viterbi: choices of engine_selector
+ * from given decoding times, and decoding of blocks of various SNR.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/test/unit_test.hpp>
+#include <gnuradio/top_block.h>
+#include <gnuradio/blocks/vector_source.h>
+#include <gnuradio/blocks/vector_sink.h>
+#include <lazyviterbi/dynamic_viterbi.h>
+#include <cmath>
+#include <limits>
+#include <set>
+#include "engine_selector.h"
+#include "qa_reference.h"
+
+using namespace gr::lazyviterbi;
+using namespace gr::lazyviterbi::qa;
+
+namespace {
+
+  //Measure every engine of a bin once, engine e decoding a section in
+  //costs[e] ns
+  void
+  measure_all(engine_selector &selector, int bin, const double *costs)
+  {
+    for(int e=0 ; e < selector.n_engines() ; ++e) {
+      int chosen = selector.choose(bin);
+
+      BOOST_REQUIRE_EQUAL(chosen, e);
+      selector.update(bin, chosen, (uint64_t)(100*costs[chosen]), 100);
+    }
+  }
+
+} // anonymous namespace
+
+/*
+ * Each engine of a bin is measured once before any choice, bins being
+ * independent.
+ */
+BOOST_AUTO_TEST_CASE(selector_measures_every_engine_first)
+{
+  engine_selector selector(3, 0.1, 1000);
+
+  for(int bin=0 ; bin < engine_selector::N_BINS ; bin += 5) {
+    //Not measured yet: asked again
+    BOOST_CHECK_EQUAL(selector.choose(bin), 0);
+    BOOST_CHECK_EQUAL(selector.choose(bin), 0);
+    BOOST_CHECK_EQUAL(selector.cost(bin, 0), 0.0);
+
+    //An update without sections measures nothing
+    selector.update(bin, 0, 1000, 0);
+    BOOST_CHECK_EQUAL(selector.choose(bin), 0);
+
+    const double costs[3] = {30.0, 10.0, 20.0};
+    measure_all(selector, bin, costs);
+
+    for(int e=0 ; e < 3 ; ++e) {
+      BOOST_CHECK_CLOSE(selector.cost(bin, e), costs[e], 1e-9);
+    }
+    BOOST_CHECK_EQUAL(selector.choose(bin), 1);
+    BOOST_CHECK_EQUAL(selector.engine(bin), 1);
+  }
+
+  //Other bins are still unmeasured
+  BOOST_CHECK_EQUAL(selector.choose(1), 0);
+
+  selector.clear();
+  BOOST_CHECK_EQUAL(selector.cost(0, 1), 0.0);
+  BOOST_CHECK_EQUAL(selector.engine(0), 0);
+  BOOST_CHECK_EQUAL(selector.choose(0), 0);
+}
+
+/*
+ * The engine of a bin only changes for an engine faster by more than the
+ * hysteresis.
+ */
+BOOST_AUTO_TEST_CASE(selector_switches_beyond_hysteresis)
+{
+  //Exploration out of the way
+  engine_selector selector(2, 0.1, 1000);
+  const double costs[2] = {100.0, 95.0};
+  measure_all(selector, 0, costs);
+
+  //5% faster: kept
+  for(int i=0 ; i < 10 ; ++i) {
+    BOOST_CHECK_EQUAL(selector.choose(0), 0);
+  }
+
+  //Engine 1 gets 15% faster than engine 0 (moving average of its costs)
+  while(selector.cost(0, 1) >= 90.0) {
+    BOOST_CHECK_EQUAL(selector.choose(0), 0);
+    selector.update(0, 1, 8500, 100);
+  }
+  BOOST_CHECK_EQUAL(selector.choose(0), 1);
+  BOOST_CHECK_EQUAL(selector.engine(0), 1);
+
+  //Engine 0 gets slightly faster than engine 1: kept
+  while(selector.cost(0, 0) >= selector.cost(0, 1)) {
+    BOOST_CHECK_EQUAL(selector.choose(0), 1);
+    selector.update(0, 0, 8500, 100);
+  }
+  BOOST_REQUIRE_GT(selector.cost(0, 0), 0.9*selector.cost(0, 1));
+  BOOST_CHECK_EQUAL(selector.choose(0), 1);
+
+  //Without hysteresis, the fastest engine is chosen
+  engine_selector eager(2, 0.0, 1000);
+  measure_all(eager, 0, costs);
+  BOOST_CHECK_EQUAL(eager.choose(0), 1);
+}
+
+/*
+ * One block out of explore_period is decoded by another engine than the one
+ * of its bin, every other engine in turn.
+ */
+BOOST_AUTO_TEST_CASE(selector_explores_other_engines)
+{
+  const int period = 4;
+  engine_selector selector(3, 0.1, period);
+  const double costs[3] = {10.0, 30.0, 20.0};
+  measure_all(selector, 7, costs);
+
+  //Blocks counted so far: the measures
+  int blocks = 3;
+  std::set<int> explored;
+
+  for(int i=0 ; i < 10*period ; ++i) {
+    int current = selector.engine(7);
+    int chosen = selector.choose(7);
+    ++blocks;
+
+    if(blocks % period == 0) {
+      BOOST_CHECK_NE(chosen, current);
+      explored.insert(chosen);
+    }
+    else {
+      BOOST_CHECK_EQUAL(chosen, 0);
+    }
+  }
+
+  BOOST_CHECK_EQUAL(explored.size(), 2u);
+  BOOST_CHECK(explored.count(0) == 0);
+
+  //Other bins have their own count
+  BOOST_CHECK_EQUAL(selector.choose(8), 0);
+
+  //A single engine is never explored away
+  engine_selector single(1, 0.1, 2);
+  measure_all(single, 0, costs);
+  for(int i=0 ; i < 10 ; ++i) {
+    BOOST_CHECK_EQUAL(single.choose(0), 0);
+  }
+}
+
+/*
+ * Bins of Q are half octaves, from 1 to 2^12: ratios of blocks without
+ * metrics (NaN), or whose smallest metrics are 0 (infinity), fall in the
+ * first and last bins.
+ */
+BOOST_AUTO_TEST_CASE(selector_bins)
+{
+  const float inf = std::numeric_limits<float>::infinity();
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  const int last = engine_selector::N_BINS - 1;
+
+  BOOST_CHECK_EQUAL(engine_selector::bin(nan), 0);
+  BOOST_CHECK_EQUAL(engine_selector::bin(-inf), 0);
+  BOOST_CHECK_EQUAL(engine_selector::bin(-2.0f), 0);
+  BOOST_CHECK_EQUAL(engine_selector::bin(0.0f), 0);
+  BOOST_CHECK_EQUAL(engine_selector::bin(0.5f), 0);
+  BOOST_CHECK_EQUAL(engine_selector::bin(1.0f), 0);
+  BOOST_CHECK_EQUAL(engine_selector::bin(inf), last);
+  BOOST_CHECK_EQUAL(engine_selector::bin(4096.0f), last);
+  BOOST_CHECK_EQUAL(engine_selector::bin(1e30f), last);
+
+  //Bin b holds [2^(b/2), 2^((b+1)/2))
+  for(int b=1 ; b < last ; ++b) {
+    float low = std::pow(2.0f, 0.5f*b);
+
+    BOOST_CHECK_EQUAL(engine_selector::bin(low*1.001f), b);
+    BOOST_CHECK_EQUAL(engine_selector::bin(low*0.999f), b - 1);
+  }
+
+  //Monotonic
+  int prev = 0;
+  for(float ratio=1.0f ; ratio < 8192.0f ; ratio *= 1.01f) {
+    int b = engine_selector::bin(ratio);
+
+    BOOST_CHECK(b >= prev && b <= last);
+    prev = b;
+  }
+}
+
+/*
+ * In adaptive mode, blocks of every SNR are decoded along the best path,
+ * whichever algorithm decodes them.
+ */
+BOOST_AUTO_TEST_CASE(adaptive_mode_finds_best_paths)
+{
+  rng_t rng(5);
+
+  for(int t=0 ; t < 6 ; ++t) {
+    gr::trellis::fsm FSM = random_shift_register_fsm(rng, uniform(rng, 2, 6),
+        uniform(rng, 2, 3));
+    const int K = uniform(rng, 50, 200);
+    const int S0 = uniform(rng, -1, FSM.S() - 1);
+    const int nblocks = 40;
+
+    //Blocks of increasing SNR: Q goes through several bins
+    std::vector<float> metrics;
+    for(int b=0 ; b < nblocks ; ++b) {
+      std::vector<unsigned char> block_inputs;
+      std::vector<float> block_metrics;
+      make_metrics(FSM, K, 1, 8.0 + 0.2*b, (S0 == -1) ? 0 : S0, rng,
+          block_inputs, block_metrics);
+
+      metrics.insert(metrics.end(), block_metrics.begin(),
+          block_metrics.end());
+    }
+
+    dynamic_viterbi::sptr dec = dynamic_viterbi::make(FSM, K, S0, -1, 15.0,
+        true);
+    BOOST_REQUIRE(dec->adaptive());
+
+    gr::top_block_sptr tb = gr::make_top_block("qa_dynamic_viterbi");
+    gr::blocks::vector_source_f::sptr src
+      = gr::blocks::vector_source_f::make(metrics);
+    gr::blocks::vector_sink_b::sptr sink = gr::blocks::vector_sink_b::make();
+    tb->connect(src, 0, dec, 0);
+    tb->connect(dec, 0, sink, 0);
+    tb->run();
+
+    std::vector<unsigned char> out = sink->data();
+    BOOST_REQUIRE_EQUAL(out.size(), (size_t)nblocks*K);
+
+    std::vector<unsigned char> ref_out(K);
+    for(int b=0 ; b < nblocks ; ++b) {
+      const float *m = &metrics[(size_t)b*K*FSM.O()];
+      double ref_metric = reference_viterbi(FSM, K, S0, -1, m, &ref_out[0]);
+
+      BOOST_CHECK_MESSAGE(is_best_path(FSM, K, S0, -1, m, &out[(size_t)b*K],
+            &ref_out[0], ref_metric),
+          "S=" << FSM.S() << " K=" << K << " S0=" << S0 << " block " << b
+          << ": not the best path");
+    }
+  }
+}
@@ -0,0 +1,173 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Tests of lazy_viterbi_stream on long streams, decoded through many calls
+ * of general_work.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/test/unit_test.hpp>
+#include <lazyviterbi/lazy_viterbi_stream.h>
+#include <algorithm>
+#include "qa_reference.h"
+
+using namespace gr::lazyviterbi;
+using namespace gr::lazyviterbi::qa;
+
+namespace {
+
+  //64 states, rate 1/2 code (171, 133)
+  gr::trellis::fsm
+  code_171_133()
+  {
+    std::vector<int> G(2);
+    G[0] = 0171;
+    G[1] = 0133;
+
+    return gr::trellis::fsm(1, 2, G);
+  }
+
+  uint64_t
+  counter(const pmt::pmt_t &stats, const char *name)
+  {
+    return pmt::to_uint64(pmt::dict_ref(stats, pmt::intern(name),
+          pmt::PMT_NIL));
+  }
+
+} // namespace
+
+/*
+ * Shadow nodes of losing branches whose metric the search never reaches must
+ * not pile up in the queue: on a noiseless stream, the search never leaves
+ * the first buckets, and without purging them the queue would hold about one
+ * key per section.
+ */
+BOOST_AUTO_TEST_CASE(queue_stays_bounded_on_a_long_stream)
+{
+  const gr::trellis::fsm FSM = code_171_133();
+  const int N = 1 << 20;
+  const int D = 40;
+  rng_t rng(1);
+
+  std::vector<unsigned char> inputs;
+  std::vector<float> metrics;
+  make_metrics(FSM, N, 1, 100.0, 0, rng, inputs, metrics);
+
+  lazy_viterbi_stream::sptr dec = lazy_viterbi_stream::make(FSM, D, 0);
+  std::vector<unsigned char> out = run_flowgraph(dec, metrics, 8192);
+
+  //Decisions lag behind the input by less than D + 2*L < 8*(D+1) sections
+  BOOST_REQUIRE_GT(out.size(), (size_t)(N - 8*(D + 1)));
+  BOOST_CHECK(std::equal(out.begin(), out.end(), inputs.begin()));
+
+  //Shadow nodes in the ring of less than 4*(D+1) time indexes, at most I
+  //per node
+  const size_t bound = (size_t)4*(D + 1)*FSM.S()*FSM.I();
+  BOOST_CHECK_LE(dec->queued_nodes(), bound);
+  BOOST_CHECK_LT(bound, (size_t)N/32);
+}
+
+/*
+ * At high SNR, decisions of the stream are the ones of the maximum likelihood
+ * path of the whole stream, whatever the number of calls to general_work (the
+ * scale factor is estimated once, at the first one).
+ */
+BOOST_AUTO_TEST_CASE(stream_decisions_are_best_path_across_calls)
+{
+  const gr::trellis::fsm FSM = code_171_133();
+  const int N = 100000;
+  const int D = 40;
+  rng_t rng(2);
+
+  std::vector<unsigned char> inputs, ref_out(N);
+  std::vector<float> metrics;
+  make_metrics(FSM, N, 1, 5.0, 0, rng, inputs, metrics);
+  reference_viterbi(FSM, N, 0, -1, &metrics[0], &ref_out[0]);
+
+  const int max_noutput_items[3] = {N, 4096, 256};
+  std::vector<unsigned char> first_out;
+
+  for(int m=0 ; m < 3 ; ++m) {
+    for(int bits=8 ; bits <= 16 ; bits += 8) {
+      std::vector<unsigned char> out = run_flowgraph(
+          lazy_viterbi_stream::make(FSM, D, 0, 0.0, bits), metrics,
+          max_noutput_items[m]);
+
+      BOOST_REQUIRE_GT(out.size(), (size_t)(N - 8*(D + 1)));
+      BOOST_CHECK_MESSAGE(std::equal(out.begin(), out.end(), ref_out.begin()),
+          "metric_bits=" << bits << " max_noutput_items="
+          << max_noutput_items[m] << ": not the best path");
+    }
+  }
+
+  //With a fixed scale, the search does not depend on the input windows
+  for(int m=0 ; m < 3 ; ++m) {
+    std::vector<unsigned char> out = run_flowgraph(
+        lazy_viterbi_stream::make(FSM, D, 0, 4.0), metrics,
+        max_noutput_items[m]);
+
+    if(m == 0) {
+      first_out = out;
+    }
+    else {
+      BOOST_CHECK(out == first_out);
+    }
+  }
+}
+
+/*
+ * The stream counts its search as lazy_viterbi does: every time index of the
+ * stream is reached by an expanded node, and each expanded node or stale key
+ * was pushed once.
+ */
+BOOST_AUTO_TEST_CASE(stream_counts_its_search)
+{
+  const gr::trellis::fsm FSM = code_171_133();
+  const int N = 20000;
+  const int D = 40;
+  rng_t rng(3);
+
+  std::vector<unsigned char> inputs;
+  std::vector<float> metrics;
+  make_metrics(FSM, N, 1, 3.0, 0, rng, inputs, metrics);
+
+  lazy_viterbi_stream::sptr dec = lazy_viterbi_stream::make(FSM, D, 0, 0.0);
+  run_flowgraph(dec, metrics, 1024);
+
+  //The last metrics wait for room for a traceback
+  pmt::pmt_t stats = dec->stats();
+  const uint64_t sections = counter(stats, "sections");
+  BOOST_CHECK_GT(counter(stats, "blocks"), 1u);
+  BOOST_CHECK_LE(sections, (uint64_t)N);
+  BOOST_CHECK_GT(sections, (uint64_t)(N - 8*(D + 1)));
+  BOOST_CHECK_GT(counter(stats, "decode_ns"), 0u);
+  BOOST_CHECK_GE(counter(stats, "nodes_expanded"), sections);
+  BOOST_CHECK_GE(counter(stats, "shadow_pushes"),
+      counter(stats, "nodes_expanded") + counter(stats, "stale_pops"));
+  BOOST_CHECK_GT(counter(stats, "stale_pops"), 0u);
+  BOOST_CHECK_GT(counter(stats, "buckets_scanned"), 0u);
+
+  dec->reset_stats();
+  BOOST_CHECK_EQUAL(counter(dec->stats(), "sections"), 0u);
+}
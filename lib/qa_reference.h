@@ -0,0 +1,319 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_QA_REFERENCE_H
+#define INCLUDED_LAZYVITERBI_QA_REFERENCE_H
+
+/*
+ * Helpers of the differential tests: random trellises, an AWGN channel (the
+ * same as lazyviterbi_benchmark), a flowgraph running decoder blocks and a
+ * straightforward double precision Viterbi decoder, the reference of every
+ * optimized decoder.
+ */
+
+#include <gnuradio/top_block.h>
+#include <gnuradio/blocks/vector_source.h>
+#include <gnuradio/blocks/vector_sink.h>
+#include <gnuradio/trellis/fsm.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+#include "awgn_metrics.h"
+
+namespace gr {
+namespace lazyviterbi {
+namespace qa {
+
+  typedef std::mt19937 rng_t;
+
+  inline int
+  uniform(rng_t &rng, int min, int max)
+  {
+    return std::uniform_int_distribution<int>(min, max)(rng);
+  }
+
+  /*!
+   * Random trellis of I inputs and S states, every state being the next
+   * state of I branches.
+   */
+  inline gr::trellis::fsm
+  random_fsm(rng_t &rng, int I, int S, int O)
+  {
+    std::vector<int> NS(S*I), OS(S*I);
+
+    for(int b=0 ; b < S*I ; ++b) {
+      NS[b] = b % S;
+      OS[b] = uniform(rng, 0, O - 1);
+    }
+    std::shuffle(NS.begin(), NS.end(), rng);
+
+    return gr::trellis::fsm(I, S, O, NS, OS);
+  }
+
+  //Degree of a polynomial over GF(2) (bit i being the coefficient of D^i)
+  inline int
+  gf2_degree(int a)
+  {
+    int degree = -1;
+    for( ; a ; a >>= 1) {
+      ++degree;
+    }
+
+    return degree;
+  }
+
+  //Greatest common divisor of two polynomials over GF(2)
+  inline int
+  gf2_gcd(int a, int b)
+  {
+    while(b) {
+      //a mod b
+      while(a && gf2_degree(a) >= gf2_degree(b)) {
+        a ^= b << (gf2_degree(a) - gf2_degree(b));
+      }
+      std::swap(a, b);
+    }
+
+    return a;
+  }
+
+  /*!
+   * Random non catastrophic feedforward convolutional code of rate 1/n and
+   * memory m >= 2 (binary input, new bit shifted in as the least
+   * significant bit of the state).
+   *
+   * Generators of a catastrophic code share a factor: some input sequences
+   * differing everywhere then have almost the same metric, and quantized
+   * decoders legitimately pick either of them.
+   */
+  inline gr::trellis::fsm
+  random_shift_register_fsm(rng_t &rng, int m, int n)
+  {
+    const int S = 1 << m;
+    const int O = 1 << n;
+    std::vector<int> G(n);
+    std::vector<int> NS(2*S), OS(2*S);
+
+    //Generators using the new bit and the oldest one, without common factor
+    int gcd;
+    do {
+      gcd = 0;
+      for(int j=0 ; j < n ; ++j) {
+        G[j] = uniform(rng, 0, (1 << (m + 1)) - 1) | 1 | (1 << m);
+        gcd = gf2_gcd(gcd, G[j]);
+      }
+    } while(gcd != 1);
+
+    for(int s=0 ; s < S ; ++s) {
+      for(int i=0 ; i < 2 ; ++i) {
+        int reg = (s << 1) | i;
+        int symbol = 0;
+
+        for(int j=0 ; j < n ; ++j) {
+          int parity = 0;
+          for(int x = reg & G[j] ; x ; x >>= 1) {
+            parity ^= x & 1;
+          }
+          symbol = (symbol << 1) | parity;
+        }
+
+        NS[s*2 + i] = reg & (S - 1);
+        OS[s*2 + i] = symbol;
+      }
+    }
+
+    return gr::trellis::fsm(2, S, O, NS, OS);
+  }
+
+  /*!
+   * Encode n_blocks blocks of K random inputs, each one from state S0 (0 if
+   * -1), and compute the euclidean metrics of the noisy received symbols
+   * (see awgn_metrics()).
+   */
+  inline void
+  make_metrics(const gr::trellis::fsm &FSM, int K, long n_blocks,
+      float ebn0_db, int S0, rng_t &rng, std::vector<unsigned char> &inputs,
+      std::vector<float> &metrics)
+  {
+    awgn_metrics(FSM.I(), FSM.O(), &FSM.NS()[0], &FSM.OS()[0], K, n_blocks,
+        ebn0_db, S0, rng, inputs, metrics);
+  }
+
+  /*!
+   * Run \p metrics through \p block (float metrics in, decisions out) in a
+   * flowgraph, at most \p max_noutput_items items per call of general_work,
+   * and return the decisions. The running time of the flowgraph (not of its
+   * construction) is stored in \p run_seconds if not NULL.
+   */
+  inline std::vector<unsigned char>
+  run_flowgraph(gr::block_sptr block, const std::vector<float> &metrics,
+      int max_noutput_items=100000000, double *run_seconds=NULL)
+  {
+    typedef std::chrono::steady_clock clock;
+
+    gr::top_block_sptr tb = gr::make_top_block("qa_lazyviterbi");
+    gr::blocks::vector_source_f::sptr src
+      = gr::blocks::vector_source_f::make(metrics);
+    gr::blocks::vector_sink_b::sptr sink = gr::blocks::vector_sink_b::make();
+
+    tb->connect(src, 0, block, 0);
+    tb->connect(block, 0, sink, 0);
+
+    clock::time_point start = clock::now();
+    tb->run(max_noutput_items);
+    if(run_seconds) {
+      *run_seconds = std::chrono::duration<double>(clock::now() - start).count();
+    }
+
+    return sink->data();
+  }
+
+  //State reached by inputs in (K items) from state S0
+  inline int
+  final_state(const gr::trellis::fsm &FSM, int K, int S0,
+      const unsigned char *in)
+  {
+    int state = S0;
+    for(int k=0 ; k < K ; ++k) {
+      state = FSM.NS()[state*FSM.I() + in[k]];
+    }
+
+    return state;
+  }
+
+  /*!
+   * Viterbi algorithm in double precision, without normalization nor
+   * packing. Returns the metric of the best path (infinity if no path from
+   * S0 reaches SK in K sections).
+   */
+  inline double
+  reference_viterbi(const gr::trellis::fsm &FSM, int K, int S0, int SK,
+      const float *metrics, unsigned char *out)
+  {
+    const int I = FSM.I();
+    const int S = FSM.S();
+    const int O = FSM.O();
+    const double inf = std::numeric_limits<double>::infinity();
+
+    std::vector<double> alpha(S, (S0 == -1) ? 0.0 : inf), next(S);
+    std::vector<int> trace((size_t)K*S);
+
+    if(S0 != -1) {
+      alpha[S0] = 0.0;
+    }
+
+    for(int k=0 ; k < K ; ++k) {
+      std::fill(next.begin(), next.end(), inf);
+
+      for(int s=0 ; s < S ; ++s) {
+        for(int i=0 ; i < I ; ++i) {
+          int ns = FSM.NS()[s*I + i];
+          double metric = alpha[s] + metrics[(size_t)k*O + FSM.OS()[s*I + i]];
+
+          if(metric < next[ns]) {
+            next[ns] = metric;
+            trace[(size_t)k*S + ns] = s*I + i;
+          }
+        }
+      }
+
+      alpha.swap(next);
+    }
+
+    int state = SK;
+    if(SK == -1) {
+      state = (int)(std::min_element(alpha.begin(), alpha.end()) - alpha.begin());
+    }
+    if(alpha[state] == inf) {
+      return inf;
+    }
+
+    double best = alpha[state];
+    for(int k=K-1 ; k >= 0 ; --k) {
+      int b = trace[(size_t)k*S + state];
+      out[k] = (unsigned char)(b % I);
+      state = b / I;
+    }
+
+    return best;
+  }
+
+  /*!
+   * Metric of the best path taking inputs \p in from S0 (from any state if
+   * -1) to SK (any state if -1): infinity if there is none.
+   */
+  inline double
+  path_metric(const gr::trellis::fsm &FSM, int K, int S0, int SK,
+      const float *metrics, const unsigned char *in)
+  {
+    const int I = FSM.I();
+    const int S = FSM.S();
+    const int O = FSM.O();
+    double best = std::numeric_limits<double>::infinity();
+
+    for(int s0=0 ; s0 < S ; ++s0) {
+      if(S0 != -1 && s0 != S0) {
+        continue;
+      }
+
+      int state = s0;
+      double metric = 0.0;
+      for(int k=0 ; k < K ; ++k) {
+        if(in[k] >= I) {
+          return std::numeric_limits<double>::infinity();
+        }
+        metric += metrics[(size_t)k*O + FSM.OS()[state*I + in[k]]];
+        state = FSM.NS()[state*I + in[k]];
+      }
+
+      if(SK == -1 || state == SK) {
+        best = std::min(best, metric);
+      }
+    }
+
+    return best;
+  }
+
+  /*!
+   * True if \p out is a best path: either the reference path, or a path of
+   * the same metric (up to rounding errors of float path metrics).
+   */
+  inline bool
+  is_best_path(const gr::trellis::fsm &FSM, int K, int S0, int SK,
+      const float *metrics, const unsigned char *out,
+      const unsigned char *ref_out, double ref_metric)
+  {
+    if(std::equal(out, out + K, ref_out)) {
+      return true;
+    }
+
+    double metric = path_metric(FSM, K, S0, SK, metrics, out);
+
+    return metric <= ref_metric + 1e-5*std::fabs(ref_metric) + 1e-3;
+  }
+
+} /* namespace qa */
+} /* namespace lazyviterbi */
+} /* namespace gr */
+
+#endif /* INCLUDED_LAZYVITERBI_QA_REFERENCE_H */
@@ -0,0 +1,150 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Tests of viterbi_batch on full and partial batches of blocks, and of the
+ * depth bounding its 16-bit path metrics.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/test/unit_test.hpp>
+#include <lazyviterbi/viterbi_batch.h>
+#include "path_metrics.h"
+#include "qa_reference.h"
+
+using namespace gr::lazyviterbi;
+using namespace gr::lazyviterbi::qa;
+
+namespace {
+
+  //Decode nblocks random blocks of K sections, and check each one against
+  //the reference. Branch metrics are quantized: the SNR is high enough for
+  //the best path to stand out.
+  void
+  check_blocks(const gr::trellis::fsm &FSM, int K, int S0, int nblocks,
+      int max_noutput_items, rng_t &rng)
+  {
+    std::vector<unsigned char> inputs;
+    std::vector<float> metrics;
+    make_metrics(FSM, K, nblocks, 9.0, (S0 == -1) ? 0 : S0, rng, inputs,
+        metrics);
+
+    viterbi_batch::sptr dec = viterbi_batch::make(FSM, K, S0, -1);
+    std::vector<unsigned char> out = run_flowgraph(dec, metrics,
+        max_noutput_items);
+    BOOST_REQUIRE_EQUAL(out.size(), (size_t)nblocks*K);
+
+    std::vector<unsigned char> ref_out(K);
+    for(int b=0 ; b < nblocks ; ++b) {
+      const float *m = &metrics[(size_t)b*K*FSM.O()];
+      double ref_metric = reference_viterbi(FSM, K, S0, -1, m, &ref_out[0]);
+
+      BOOST_CHECK_MESSAGE(is_best_path(FSM, K, S0, -1, m, &out[(size_t)b*K],
+            &ref_out[0], ref_metric),
+          "S=" << FSM.S() << " K=" << K << " S0=" << S0 << " nblocks="
+          << nblocks << " block " << b << ": not the best path");
+    }
+  }
+
+} // anonymous namespace
+
+/*
+ * The block asks the scheduler for whole batches of blocks.
+ */
+BOOST_AUTO_TEST_CASE(asks_for_full_batches)
+{
+  rng_t rng(1);
+  gr::trellis::fsm FSM = random_shift_register_fsm(rng, 4, 2);
+  viterbi_batch::sptr dec = viterbi_batch::make(FSM, 100, 0, -1);
+
+  BOOST_CHECK_EQUAL(dec->output_multiple(), 100);
+  BOOST_CHECK_EQUAL(dec->min_noutput_items(), dec->batch_size()*100);
+}
+
+/*
+ * A batch completed with dummy blocks (1 to 15 blocks at the end of the
+ * stream, or after full batches) decodes its real blocks as the reference
+ * does.
+ */
+BOOST_AUTO_TEST_CASE(decodes_partial_batches)
+{
+  rng_t rng(2);
+
+  for(int nblocks=1 ; nblocks < 16 ; ++nblocks) {
+    gr::trellis::fsm FSM = random_shift_register_fsm(rng, uniform(rng, 2, 6),
+        uniform(rng, 2, 3));
+    const int K = uniform(rng, 20, 120);
+    const int S0 = uniform(rng, -1, FSM.S() - 1);
+
+    check_blocks(FSM, K, S0, nblocks, 1 << 16, rng);
+    check_blocks(FSM, K, S0, 16 + nblocks, 1 << 16, rng);
+  }
+}
+
+/*
+ * Full batches decode as the reference does, whatever the number of blocks
+ * per call of general_work.
+ */
+BOOST_AUTO_TEST_CASE(decodes_full_batches)
+{
+  rng_t rng(3);
+
+  for(int t=0 ; t < 10 ; ++t) {
+    gr::trellis::fsm FSM = random_shift_register_fsm(rng, uniform(rng, 2, 6),
+        uniform(rng, 2, 3));
+    const int K = uniform(rng, 20, 120);
+    const int S0 = uniform(rng, -1, FSM.S() - 1);
+
+    check_blocks(FSM, K, S0, 64, 1 << 16, rng);
+    check_blocks(FSM, K, S0, 64, 16*K, rng);
+  }
+}
+
+/*
+ * Shift registers are recognized at any size, with the new input as the
+ * least or the most significant bit of the state; other trellises too large
+ * to be searched have no depth.
+ */
+BOOST_AUTO_TEST_CASE(mixing_depth_of_large_trellises)
+{
+  rng_t rng(4);
+  const int m_values[] = {4, 12, 13, 16};
+
+  for(int t=0 ; t < 4 ; ++t) {
+    const int m = m_values[t];
+    const int S = 1 << m;
+    gr::trellis::fsm FSM = random_shift_register_fsm(rng, m, 2);
+    BOOST_CHECK_EQUAL(trellis_mixing_depth(2, S, &FSM.NS()[0]), m);
+    BOOST_CHECK_EQUAL(trellis_mixing_depth(2, S, &FSM.NS()[0], m - 1), -1);
+
+    std::vector<int> NS(2*S);
+    for(int s=0 ; s < S ; ++s) {
+      NS[2*s] = s >> 1;
+      NS[2*s + 1] = (s >> 1) | (S >> 1);
+    }
+    BOOST_CHECK_EQUAL(trellis_mixing_depth(2, S, &NS[0]), m);
+  }
+
+  gr::trellis::fsm FSM = random_fsm(rng, 2, 8192, 4);
+  BOOST_CHECK_EQUAL(trellis_mixing_depth(2, 8192, &FSM.NS()[0]), -1);
+}
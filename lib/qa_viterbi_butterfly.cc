@@ -0,0 +1,230 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Tests of viterbi_butterfly: detection of the butterfly structure of the
+ * trellis, choice of the add-compare-select kernel, and decoding.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/test/unit_test.hpp>
+#include <lazyviterbi/viterbi_butterfly.h>
+#include <stdexcept>
+#include <string>
+#include "butterfly_kernels.h"
+#include "qa_reference.h"
+
+using namespace gr::lazyviterbi;
+using namespace gr::lazyviterbi::qa;
+
+namespace {
+
+  //Same trellis, state s of FSM being state perm[s] of the result
+  gr::trellis::fsm
+  renumber_states(const gr::trellis::fsm &FSM, const std::vector<int> &perm)
+  {
+    const int I = FSM.I();
+    const int S = FSM.S();
+    std::vector<int> NS(S*I), OS(S*I);
+
+    for(int s=0 ; s < S ; ++s) {
+      for(int i=0 ; i < I ; ++i) {
+        NS[perm[s]*I + i] = perm[FSM.NS()[s*I + i]];
+        OS[perm[s]*I + i] = FSM.OS()[s*I + i];
+      }
+    }
+
+    return gr::trellis::fsm(I, S, FSM.O(), NS, OS);
+  }
+
+  //Shift register trellis whose new bit is the most significant one
+  gr::trellis::fsm
+  bit_reversed(const gr::trellis::fsm &FSM)
+  {
+    const int S = FSM.S();
+    int m = 0;
+    while((1 << m) < S) {
+      ++m;
+    }
+
+    std::vector<int> perm(S);
+    for(int s=0 ; s < S ; ++s) {
+      perm[s] = 0;
+      for(int b=0 ; b < m ; ++b) {
+        perm[s] |= ((s >> b) & 1) << (m - 1 - b);
+      }
+    }
+
+    return renumber_states(FSM, perm);
+  }
+
+  //Decode random blocks with FSM, and check each one against the reference
+  //(the final state of terminated blocks is the one of the encoder). Branch
+  //metrics are quantized: the SNR is high enough for the best path to stand
+  //out.
+  void
+  check_decoding(const gr::trellis::fsm &FSM, int K, int S0, bool terminated,
+      rng_t &rng)
+  {
+    //A terminated block has its own final state
+    const int nblocks = terminated ? 1 : 8;
+    std::vector<unsigned char> inputs;
+    std::vector<float> metrics;
+    make_metrics(FSM, K, nblocks, 9.0, (S0 == -1) ? 0 : S0, rng, inputs,
+        metrics);
+
+    int SK = -1;
+    if(terminated) {
+      SK = final_state(FSM, K, (S0 == -1) ? 0 : S0, &inputs[0]);
+    }
+
+    std::vector<unsigned char> out
+      = run_flowgraph(viterbi_butterfly::make(FSM, K, S0, SK), metrics);
+    BOOST_REQUIRE_EQUAL(out.size(), (size_t)nblocks*K);
+
+    std::vector<unsigned char> ref_out(K);
+    for(int b=0 ; b < nblocks ; ++b) {
+      const float *m = &metrics[(size_t)b*K*FSM.O()];
+      double ref_metric = reference_viterbi(FSM, K, S0, SK, m, &ref_out[0]);
+
+      BOOST_CHECK_MESSAGE(is_best_path(FSM, K, S0, SK, m,
+            &out[(size_t)b*K], &ref_out[0], ref_metric),
+          "S=" << FSM.S() << " O=" << FSM.O() << " S0=" << S0 << " SK="
+          << SK << " block " << b << ": not the best path");
+    }
+  }
+
+  //The kernel best_butterfly_kernel() must choose: the first supported one
+  //handling S states and O output symbols
+  std::string
+  expected_kernel(int S, int O)
+  {
+    const std::vector<butterfly_kernel> &kernels = butterfly_kernels();
+
+    for(size_t i=0 ; i < kernels.size() ; ++i) {
+      if(kernels[i].is_supported() && S >= kernels[i].min_states
+          && O <= kernels[i].max_outputs) {
+        return kernels[i].name;
+      }
+    }
+
+    return "";
+  }
+
+} // anonymous namespace
+
+/*
+ * Shift register trellises are accepted whether the new bit of the state is
+ * its least or its most significant bit, and decoded as the reference does.
+ */
+BOOST_AUTO_TEST_CASE(decodes_both_shift_register_layouts)
+{
+  rng_t rng(1);
+
+  for(int m=2 ; m <= 7 ; ++m) {
+    for(int n=2 ; n <= 4 ; ++n) {
+      gr::trellis::fsm FSM = random_shift_register_fsm(rng, m, n);
+      gr::trellis::fsm reversed = bit_reversed(FSM);
+      const int K = 50 + uniform(rng, 0, 150);
+      const int S0 = uniform(rng, -1, FSM.S() - 1);
+
+      BOOST_REQUIRE_NO_THROW(viterbi_butterfly::make(FSM, K, S0, -1));
+      BOOST_REQUIRE_NO_THROW(viterbi_butterfly::make(reversed, K, S0, -1));
+
+      check_decoding(FSM, K, S0, false, rng);
+      check_decoding(reversed, K, S0, false, rng);
+      check_decoding(FSM, K, S0, true, rng);
+      check_decoding(reversed, K, S0, true, rng);
+    }
+  }
+}
+
+/*
+ * Trellises without the butterfly structure are rejected at construction.
+ */
+BOOST_AUTO_TEST_CASE(rejects_non_butterfly_trellises)
+{
+  rng_t rng(2);
+
+  //Not a binary input
+  BOOST_CHECK_THROW(viterbi_butterfly::make(random_fsm(rng, 4, 16, 4), 100,
+        0, -1), std::invalid_argument);
+  //Not a power of two number of states
+  BOOST_CHECK_THROW(viterbi_butterfly::make(random_fsm(rng, 2, 12, 4), 100,
+        0, -1), std::invalid_argument);
+  //Too many output symbols
+  BOOST_CHECK_THROW(viterbi_butterfly::make(
+        random_shift_register_fsm(rng, 6, 9), 100, 0, -1),
+      std::invalid_argument);
+
+  //Shift register trellises whose states are shuffled (swapping two states
+  //breaks both layouts)
+  for(int m=3 ; m <= 6 ; ++m) {
+    gr::trellis::fsm FSM = random_shift_register_fsm(rng, m, 2);
+    std::vector<int> perm(FSM.S());
+    for(int s=0 ; s < FSM.S() ; ++s) {
+      perm[s] = s;
+    }
+    std::swap(perm[1], perm[2]);
+
+    BOOST_CHECK_THROW(viterbi_butterfly::make(renumber_states(FSM, perm), 100,
+          0, -1), std::invalid_argument);
+  }
+
+  //Random binary input trellises
+  for(int t=0 ; t < 20 ; ++t) {
+    BOOST_CHECK_THROW(viterbi_butterfly::make(random_fsm(rng, 2, 32, 8), 100,
+          0, -1), std::invalid_argument);
+  }
+}
+
+/*
+ * The SIMD kernels handle at least min_states states and at most max_outputs
+ * output symbols: below (resp. above), the block falls back on a slower
+ * kernel, and still decodes as the reference does.
+ */
+BOOST_AUTO_TEST_CASE(falls_back_on_smaller_kernels)
+{
+  rng_t rng(3);
+
+  //(m, n): 4 states, 8, 16 (SSSE3 minimum), 32 (AVX2 minimum) and 64 states,
+  //then 16 output symbols (SIMD maximum) and 32
+  const int shapes[7][2] = {{2, 2}, {3, 2}, {4, 2}, {5, 2}, {6, 2}, {6, 4},
+    {6, 5}};
+
+  for(int i=0 ; i < 7 ; ++i) {
+    gr::trellis::fsm FSM = random_shift_register_fsm(rng, shapes[i][0],
+        shapes[i][1]);
+    viterbi_butterfly::sptr dec = viterbi_butterfly::make(FSM, 100, 0, -1);
+
+    BOOST_CHECK_EQUAL(dec->kernel(), expected_kernel(FSM.S(), FSM.O()));
+    check_decoding(FSM, 100, 0, false, rng);
+  }
+
+  //Only the generic kernel handles less than 16 states or more than 16
+  //output symbols
+  BOOST_CHECK_EQUAL(viterbi_butterfly::make(
+        random_shift_register_fsm(rng, 3, 2), 100, 0, -1)->kernel(), "generic");
+  BOOST_CHECK_EQUAL(viterbi_butterfly::make(
+        random_shift_register_fsm(rng, 6, 5), 100, 0, -1)->kernel(), "generic");
+}
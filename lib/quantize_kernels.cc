@@ -0,0 +1,743 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <cstring>
+#include "quantize_kernels.h"
+#include "metrics_quantizer.h"
+
+//SIMD implementations are compiled with function-level target attributes, so
+//that the library itself does not require any particular instruction set.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define LV_HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace gr {
+namespace lazyviterbi {
+
+  namespace {
+
+    //***GENERIC***//
+    void
+    quantize_generic_u8(const float *in, uint8_t *metrics, int K, int O, float scale)
+    {
+      quantize_metrics<uint8_t>(in, metrics, K, O, scale, 255);
+    }
+
+    void
+    quantize_generic_u16(const float *in, uint16_t *metrics, int K, int O, float scale)
+    {
+      quantize_metrics<uint16_t>(in, metrics, K, O, scale, 65535);
+    }
+
+    void
+    profile_generic_u8(const float *in, uint8_t *metrics, int K, int O, float scale,
+        metrics_profile &profile)
+    {
+      profile_quantize_metrics<uint8_t>(in, metrics, K, O, scale, 255, profile);
+    }
+
+    void
+    profile_generic_u16(const float *in, uint16_t *metrics, int K, int O, float scale,
+        metrics_profile &profile)
+    {
+      profile_quantize_metrics<uint16_t>(in, metrics, K, O, scale, 65535, profile);
+    }
+
+    bool
+    generic_is_supported()
+    {
+      return true;
+    }
+
+#ifdef LV_HAVE_X86_KERNELS
+    //***SSE4.1***//
+    //Store 4 (or 8) quantized metrics held by 32-bit lanes
+    __attribute__((target("sse4.1"))) inline void
+    store4(uint8_t *out, __m128i a)
+    {
+      __m128i p = _mm_packus_epi32(a, a);
+      int32_t x = _mm_cvtsi128_si32(_mm_packus_epi16(p, p));
+      memcpy(out, &x, 4);
+    }
+
+    __attribute__((target("sse4.1"))) inline void
+    store4(uint16_t *out, __m128i a)
+    {
+      _mm_storel_epi64((__m128i*)out, _mm_packus_epi32(a, a));
+    }
+
+    __attribute__((target("sse4.1"))) inline void
+    store8(uint8_t *out, __m128i a, __m128i b)
+    {
+      __m128i p = _mm_packus_epi32(a, b);
+      _mm_storel_epi64((__m128i*)out, _mm_packus_epi16(p, p));
+    }
+
+    __attribute__((target("sse4.1"))) inline void
+    store8(uint16_t *out, __m128i a, __m128i b)
+    {
+      _mm_storeu_si128((__m128i*)out, _mm_packus_epi32(a, b));
+    }
+
+    //Minimum of the 4 lanes, broadcast to every lane
+    __attribute__((target("sse4.1"))) inline __m128
+    hmin4(__m128 v)
+    {
+      v = _mm_min_ps(v, _mm_shuffle_ps(v, v, 0xB1));
+      return _mm_min_ps(v, _mm_shuffle_ps(v, v, 0x4E));
+    }
+
+    //Maximum of the 4 lanes, broadcast to every lane
+    __attribute__((target("sse4.1"))) inline __m128
+    hmax4(__m128 v)
+    {
+      v = _mm_max_ps(v, _mm_shuffle_ps(v, v, 0xB1));
+      return _mm_max_ps(v, _mm_shuffle_ps(v, v, 0x4E));
+    }
+
+    //Add the extremum of a time index (broadcast to the lanes of v) to acc.
+    //Profile sums are accumulated in double and in time order, as
+    //profile_quantize_metrics() does (both lanes of acc holding the same
+    //sum): every implementation computes the same profile.
+    __attribute__((target("sse4.1"))) inline __m128d
+    add_extremum(__m128d acc, __m128 v)
+    {
+      return _mm_add_pd(acc, _mm_cvtps_pd(v));
+    }
+
+    //min(round(scale*(v - vmin)), max), with the same rounding as
+    //quantize_metrics()
+    __attribute__((target("sse4.1"))) inline __m128i
+    quantize4(__m128 v, __m128 vmin, __m128 vscale, __m128 vmax)
+    {
+      __m128 q = _mm_add_ps(_mm_mul_ps(vscale, _mm_sub_ps(v, vmin)), _mm_set1_ps(0.5f));
+      return _mm_cvttps_epi32(_mm_min_ps(q, vmax));
+    }
+
+    //Quantization, and profile of the metrics if PROFILE
+    template <typename T, bool PROFILE>
+    __attribute__((target("sse4.1"))) void
+    quantize_sse4_1(const float *in, T *metrics, int K, int O, float scale,
+        T max_metric, metrics_profile *profile)
+    {
+      if(O % 4 != 0) {
+        if(PROFILE) {
+          profile_quantize_metrics<T>(in, metrics, K, O, scale, max_metric, *profile);
+        }
+        else {
+          quantize_metrics<T>(in, metrics, K, O, scale, max_metric);
+        }
+        return;
+      }
+
+      const __m128 vscale = _mm_set1_ps(scale);
+      const __m128 vmax = _mm_set1_ps((float)max_metric);
+      __m128 vmin, vpeak, w;
+      __m128d acc_min = _mm_set1_pd(PROFILE ? profile->sum_min : 0.0);
+      __m128d acc_max = _mm_set1_pd(PROFILE ? profile->sum_max : 0.0);
+
+      if(O == 4) {
+        //One time index per vector
+        for(int k=0 ; k < K ; ++k) {
+          __m128 v = _mm_loadu_ps(in);
+          vmin = hmin4(v);
+          store4(metrics, quantize4(v, vmin, vscale, vmax));
+
+          if(PROFILE) {
+            acc_min = add_extremum(acc_min, vmin);
+            acc_max = add_extremum(acc_max, hmax4(v));
+          }
+
+          in += 4;
+          metrics += 4;
+        }
+      }
+      else {
+        for(int k=0 ; k < K ; ++k) {
+          vmin = vpeak = _mm_loadu_ps(in);
+          for(int o=4 ; o < O ; o += 4) {
+            w = _mm_loadu_ps(in + o);
+            vmin = _mm_min_ps(vmin, w);
+            if(PROFILE) {
+              vpeak = _mm_max_ps(vpeak, w);
+            }
+          }
+          vmin = hmin4(vmin);
+
+          for(int o=0 ; o < O ; o += 4) {
+            store4(metrics + o, quantize4(_mm_loadu_ps(in + o), vmin, vscale, vmax));
+          }
+
+          if(PROFILE) {
+            acc_min = add_extremum(acc_min, vmin);
+            acc_max = add_extremum(acc_max, hmax4(vpeak));
+          }
+
+          in += O;
+          metrics += O;
+        }
+      }
+
+      if(PROFILE) {
+        profile->sum_min = _mm_cvtsd_f64(acc_min);
+        profile->sum_max = _mm_cvtsd_f64(acc_max);
+      }
+    }
+
+    __attribute__((target("sse4.1"))) void
+    quantize_sse4_1_u8(const float *in, uint8_t *metrics, int K, int O, float scale)
+    {
+      quantize_sse4_1<uint8_t, false>(in, metrics, K, O, scale, 255, NULL);
+    }
+
+    __attribute__((target("sse4.1"))) void
+    quantize_sse4_1_u16(const float *in, uint16_t *metrics, int K, int O, float scale)
+    {
+      quantize_sse4_1<uint16_t, false>(in, metrics, K, O, scale, 65535, NULL);
+    }
+
+    __attribute__((target("sse4.1"))) void
+    profile_sse4_1_u8(const float *in, uint8_t *metrics, int K, int O, float scale,
+        metrics_profile &profile)
+    {
+      quantize_sse4_1<uint8_t, true>(in, metrics, K, O, scale, 255, &profile);
+    }
+
+    __attribute__((target("sse4.1"))) void
+    profile_sse4_1_u16(const float *in, uint16_t *metrics, int K, int O, float scale,
+        metrics_profile &profile)
+    {
+      quantize_sse4_1<uint16_t, true>(in, metrics, K, O, scale, 65535, &profile);
+    }
+
+    bool
+    sse4_1_is_supported()
+    {
+      return __builtin_cpu_supports("sse4.1");
+    }
+
+    //***AVX2***//
+    __attribute__((target("avx2"))) inline void
+    store8(uint8_t *out, __m256i a)
+    {
+      store8(out, _mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+    }
+
+    __attribute__((target("avx2"))) inline void
+    store8(uint16_t *out, __m256i a)
+    {
+      store8(out, _mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+    }
+
+    __attribute__((target("avx2"))) inline void
+    store16(uint8_t *out, __m256i a, __m256i b)
+    {
+      __m128i pa = _mm_packus_epi32(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+      __m128i pb = _mm_packus_epi32(_mm256_castsi256_si128(b), _mm256_extracti128_si256(b, 1));
+      _mm_storeu_si128((__m128i*)out, _mm_packus_epi16(pa, pb));
+    }
+
+    __attribute__((target("avx2"))) inline void
+    store16(uint16_t *out, __m256i a, __m256i b)
+    {
+      store8(out, a);
+      store8(out + 8, b);
+    }
+
+    //Minimum of each group of 4 lanes, broadcast to the lanes of the group
+    __attribute__((target("avx2"))) inline __m256
+    hmin4x2(__m256 v)
+    {
+      v = _mm256_min_ps(v, _mm256_permute_ps(v, 0xB1));
+      return _mm256_min_ps(v, _mm256_permute_ps(v, 0x4E));
+    }
+
+    //Minimum of the 8 lanes, broadcast to every lane
+    __attribute__((target("avx2"))) inline __m256
+    hmin8(__m256 v)
+    {
+      v = hmin4x2(v);
+      return _mm256_min_ps(v, _mm256_permute2f128_ps(v, v, 0x01));
+    }
+
+    //Maximum of each group of 4 lanes, broadcast to the lanes of the group
+    __attribute__((target("avx2"))) inline __m256
+    hmax4x2(__m256 v)
+    {
+      v = _mm256_max_ps(v, _mm256_permute_ps(v, 0xB1));
+      return _mm256_max_ps(v, _mm256_permute_ps(v, 0x4E));
+    }
+
+    //Maximum of the 8 lanes, broadcast to every lane
+    __attribute__((target("avx2"))) inline __m256
+    hmax8(__m256 v)
+    {
+      v = hmax4x2(v);
+      return _mm256_max_ps(v, _mm256_permute2f128_ps(v, v, 0x01));
+    }
+
+    //Add the extrema of the n_times (1 or 2) time indexes of v, each one
+    //broadcast to its group of 8/n_times lanes, to acc in time order
+    __attribute__((target("avx2"))) inline __m128d
+    add_extrema(__m128d acc, __m256 v, int n_times)
+    {
+      acc = add_extremum(acc, _mm256_castps256_ps128(v));
+      if(n_times == 2) {
+        acc = add_extremum(acc, _mm256_extractf128_ps(v, 1));
+      }
+
+      return acc;
+    }
+
+    __attribute__((target("avx2"))) inline __m256i
+    quantize8(__m256 v, __m256 vmin, __m256 vscale, __m256 vmax)
+    {
+      __m256 q = _mm256_add_ps(_mm256_mul_ps(vscale, _mm256_sub_ps(v, vmin)),
+          _mm256_set1_ps(0.5f));
+      return _mm256_cvttps_epi32(_mm256_min_ps(q, vmax));
+    }
+
+    template <typename T, bool PROFILE>
+    __attribute__((target("avx2"))) void
+    quantize_avx2(const float *in, T *metrics, int K, int O, float scale,
+        T max_metric, metrics_profile *profile)
+    {
+      if(O % 8 != 0 && O != 4) {
+        quantize_sse4_1<T, PROFILE>(in, metrics, K, O, scale, max_metric, profile);
+        return;
+      }
+
+      const __m256 vscale = _mm256_set1_ps(scale);
+      const __m256 vmax = _mm256_set1_ps((float)max_metric);
+      __m256 v, w, vmin, vpeak;
+      __m128d acc_min = _mm_set1_pd(PROFILE ? profile->sum_min : 0.0);
+      __m128d acc_max = _mm_set1_pd(PROFILE ? profile->sum_max : 0.0);
+      int k = 0;
+
+      switch(O) {
+        case 4:
+          //Two time indexes per vector
+          for( ; k + 2 <= K ; k += 2) {
+            v = _mm256_loadu_ps(in);
+            vmin = hmin4x2(v);
+            store8(metrics, quantize8(v, vmin, vscale, vmax));
+
+            if(PROFILE) {
+              acc_min = add_extrema(acc_min, vmin, 2);
+              acc_max = add_extrema(acc_max, hmax4x2(v), 2);
+            }
+
+            in += 8;
+            metrics += 8;
+          }
+          break;
+
+        case 8:
+          //One time index per vector
+          for( ; k < K ; ++k) {
+            v = _mm256_loadu_ps(in);
+            vmin = hmin8(v);
+            store8(metrics, quantize8(v, vmin, vscale, vmax));
+
+            if(PROFILE) {
+              acc_min = add_extrema(acc_min, vmin, 1);
+              acc_max = add_extrema(acc_max, hmax8(v), 1);
+            }
+
+            in += 8;
+            metrics += 8;
+          }
+          break;
+
+        case 16:
+          //One time index per pair of vectors
+          for( ; k < K ; ++k) {
+            v = _mm256_loadu_ps(in);
+            w = _mm256_loadu_ps(in + 8);
+            vmin = hmin8(_mm256_min_ps(v, w));
+            store16(metrics, quantize8(v, vmin, vscale, vmax),
+                quantize8(w, vmin, vscale, vmax));
+
+            if(PROFILE) {
+              acc_min = add_extrema(acc_min, vmin, 1);
+              acc_max = add_extrema(acc_max, hmax8(_mm256_max_ps(v, w)), 1);
+            }
+
+            in += 16;
+            metrics += 16;
+          }
+          break;
+
+        default:
+          for( ; k < K ; ++k) {
+            vmin = vpeak = _mm256_loadu_ps(in);
+            for(int o=8 ; o < O ; o += 8) {
+              w = _mm256_loadu_ps(in + o);
+              vmin = _mm256_min_ps(vmin, w);
+              if(PROFILE) {
+                vpeak = _mm256_max_ps(vpeak, w);
+              }
+            }
+            vmin = hmin8(vmin);
+
+            for(int o=0 ; o < O ; o += 8) {
+              store8(metrics + o, quantize8(_mm256_loadu_ps(in + o), vmin, vscale, vmax));
+            }
+
+            if(PROFILE) {
+              acc_min = add_extrema(acc_min, vmin, 1);
+              acc_max = add_extrema(acc_max, hmax8(vpeak), 1);
+            }
+
+            in += O;
+            metrics += O;
+          }
+      }
+
+      if(PROFILE) {
+        profile->sum_min = _mm_cvtsd_f64(acc_min);
+        profile->sum_max = _mm_cvtsd_f64(acc_max);
+      }
+
+      //Remaining time index (O == 4 and K odd)
+      if(k < K) {
+        quantize_sse4_1<T, PROFILE>(in, metrics, K - k, O, scale, max_metric, profile);
+      }
+    }
+
+    __attribute__((target("avx2"))) void
+    quantize_avx2_u8(const float *in, uint8_t *metrics, int K, int O, float scale)
+    {
+      quantize_avx2<uint8_t, false>(in, metrics, K, O, scale, 255, NULL);
+    }
+
+    __attribute__((target("avx2"))) void
+    quantize_avx2_u16(const float *in, uint16_t *metrics, int K, int O, float scale)
+    {
+      quantize_avx2<uint16_t, false>(in, metrics, K, O, scale, 65535, NULL);
+    }
+
+    __attribute__((target("avx2"))) void
+    profile_avx2_u8(const float *in, uint8_t *metrics, int K, int O, float scale,
+        metrics_profile &profile)
+    {
+      quantize_avx2<uint8_t, true>(in, metrics, K, O, scale, 255, &profile);
+    }
+
+    __attribute__((target("avx2"))) void
+    profile_avx2_u16(const float *in, uint16_t *metrics, int K, int O, float scale,
+        metrics_profile &profile)
+    {
+      quantize_avx2<uint16_t, true>(in, metrics, K, O, scale, 65535, &profile);
+    }
+
+    bool
+    avx2_is_supported()
+    {
+      return __builtin_cpu_supports("avx2");
+    }
+
+    //***AVX-512F***//
+    __attribute__((target("avx512f"))) inline void
+    store16(uint8_t *out, __m512i a)
+    {
+      _mm_storeu_si128((__m128i*)out, _mm512_cvtusepi32_epi8(a));
+    }
+
+    __attribute__((target("avx512f"))) inline void
+    store16(uint16_t *out, __m512i a)
+    {
+      _mm256_storeu_si256((__m256i*)out, _mm512_cvtusepi32_epi16(a));
+    }
+
+    //Minimum of each group of 4 lanes, broadcast to the lanes of the group
+    __attribute__((target("avx512f"))) inline __m512
+    hmin4x4(__m512 v)
+    {
+      v = _mm512_min_ps(v, _mm512_permute_ps(v, 0xB1));
+      return _mm512_min_ps(v, _mm512_permute_ps(v, 0x4E));
+    }
+
+    //Minimum of each group of 8 lanes, broadcast to the lanes of the group
+    __attribute__((target("avx512f"))) inline __m512
+    hmin8x2(__m512 v)
+    {
+      v = hmin4x4(v);
+      return _mm512_min_ps(v, _mm512_shuffle_f32x4(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    }
+
+    //Minimum of the 16 lanes, broadcast to every lane
+    __attribute__((target("avx512f"))) inline __m512
+    hmin16(__m512 v)
+    {
+      v = hmin8x2(v);
+      return _mm512_min_ps(v, _mm512_shuffle_f32x4(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    }
+
+    //Maximum of each group of 4 lanes, broadcast to the lanes of the group
+    __attribute__((target("avx512f"))) inline __m512
+    hmax4x4(__m512 v)
+    {
+      v = _mm512_max_ps(v, _mm512_permute_ps(v, 0xB1));
+      return _mm512_max_ps(v, _mm512_permute_ps(v, 0x4E));
+    }
+
+    //Maximum of each group of 8 lanes, broadcast to the lanes of the group
+    __attribute__((target("avx512f"))) inline __m512
+    hmax8x2(__m512 v)
+    {
+      v = hmax4x4(v);
+      return _mm512_max_ps(v, _mm512_shuffle_f32x4(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    }
+
+    //Maximum of the 16 lanes, broadcast to every lane
+    __attribute__((target("avx512f"))) inline __m512
+    hmax16(__m512 v)
+    {
+      v = hmax8x2(v);
+      return _mm512_max_ps(v, _mm512_shuffle_f32x4(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    }
+
+    //Add the extrema of the n_times (1, 2 or 4) time indexes of v, each one
+    //broadcast to its group of 16/n_times lanes, to acc in time order
+    __attribute__((target("avx512f"))) inline __m128d
+    add_extrema(__m128d acc, __m512 v, int n_times)
+    {
+      acc = add_extremum(acc, _mm512_castps512_ps128(v));
+      if(n_times == 4) {
+        acc = add_extremum(acc, _mm512_extractf32x4_ps(v, 1));
+      }
+      if(n_times >= 2) {
+        acc = add_extremum(acc, _mm512_extractf32x4_ps(v, 2));
+      }
+      if(n_times == 4) {
+        acc = add_extremum(acc, _mm512_extractf32x4_ps(v, 3));
+      }
+
+      return acc;
+    }
+
+    __attribute__((target("avx512f"))) inline __m512i
+    quantize16(__m512 v, __m512 vmin, __m512 vscale, __m512 vmax)
+    {
+      __m512 q = _mm512_add_ps(_mm512_mul_ps(vscale, _mm512_sub_ps(v, vmin)),
+          _mm512_set1_ps(0.5f));
+      return _mm512_cvttps_epi32(_mm512_min_ps(q, vmax));
+    }
+
+    template <typename T, bool PROFILE>
+    __attribute__((target("avx512f"))) void
+    quantize_avx512f(const float *in, T *metrics, int K, int O, float scale,
+        T max_metric, metrics_profile *profile)
+    {
+      if(O % 16 != 0 && O != 4 && O != 8) {
+        quantize_avx2<T, PROFILE>(in, metrics, K, O, scale, max_metric, profile);
+        return;
+      }
+
+      const __m512 vscale = _mm512_set1_ps(scale);
+      const __m512 vmax = _mm512_set1_ps((float)max_metric);
+      __m512 v, w, vmin, vpeak;
+      __m128d acc_min = _mm_set1_pd(PROFILE ? profile->sum_min : 0.0);
+      __m128d acc_max = _mm_set1_pd(PROFILE ? profile->sum_max : 0.0);
+      int k = 0;
+
+      switch(O) {
+        case 4:
+          //Four time indexes per vector
+          for( ; k + 4 <= K ; k += 4) {
+            v = _mm512_loadu_ps(in);
+            vmin = hmin4x4(v);
+            store16(metrics, quantize16(v, vmin, vscale, vmax));
+
+            if(PROFILE) {
+              acc_min = add_extrema(acc_min, vmin, 4);
+              acc_max = add_extrema(acc_max, hmax4x4(v), 4);
+            }
+
+            in += 16;
+            metrics += 16;
+          }
+          break;
+
+        case 8:
+          //Two time indexes per vector
+          for( ; k + 2 <= K ; k += 2) {
+            v = _mm512_loadu_ps(in);
+            vmin = hmin8x2(v);
+            store16(metrics, quantize16(v, vmin, vscale, vmax));
+
+            if(PROFILE) {
+              acc_min = add_extrema(acc_min, vmin, 2);
+              acc_max = add_extrema(acc_max, hmax8x2(v), 2);
+            }
+
+            in += 16;
+            metrics += 16;
+          }
+          break;
+
+        default:
+          //One time index per (group of) vector(s)
+          for( ; k < K ; ++k) {
+            vmin = vpeak = _mm512_loadu_ps(in);
+            for(int o=16 ; o < O ; o += 16) {
+              w = _mm512_loadu_ps(in + o);
+              vmin = _mm512_min_ps(vmin, w);
+              if(PROFILE) {
+                vpeak = _mm512_max_ps(vpeak, w);
+              }
+            }
+            vmin = hmin16(vmin);
+
+            for(int o=0 ; o < O ; o += 16) {
+              store16(metrics + o, quantize16(_mm512_loadu_ps(in + o), vmin, vscale, vmax));
+            }
+
+            if(PROFILE) {
+              acc_min = add_extrema(acc_min, vmin, 1);
+              acc_max = add_extrema(acc_max, hmax16(vpeak), 1);
+            }
+
+            in += O;
+            metrics += O;
+          }
+      }
+
+      if(PROFILE) {
+        profile->sum_min = _mm_cvtsd_f64(acc_min);
+        profile->sum_max = _mm_cvtsd_f64(acc_max);
+      }
+
+      //Remaining time indexes
+      if(k < K) {
+        quantize_avx2<T, PROFILE>(in, metrics, K - k, O, scale, max_metric, profile);
+      }
+    }
+
+    __attribute__((target("avx512f"))) void
+    quantize_avx512f_u8(const float *in, uint8_t *metrics, int K, int O, float scale)
+    {
+      quantize_avx512f<uint8_t, false>(in, metrics, K, O, scale, 255, NULL);
+    }
+
+    __attribute__((target("avx512f"))) void
+    quantize_avx512f_u16(const float *in, uint16_t *metrics, int K, int O, float scale)
+    {
+      quantize_avx512f<uint16_t, false>(in, metrics, K, O, scale, 65535, NULL);
+    }
+
+    __attribute__((target("avx512f"))) void
+    profile_avx512f_u8(const float *in, uint8_t *metrics, int K, int O, float scale,
+        metrics_profile &profile)
+    {
+      quantize_avx512f<uint8_t, true>(in, metrics, K, O, scale, 255, &profile);
+    }
+
+    __attribute__((target("avx512f"))) void
+    profile_avx512f_u16(const float *in, uint16_t *metrics, int K, int O, float scale,
+        metrics_profile &profile)
+    {
+      quantize_avx512f<uint16_t, true>(in, metrics, K, O, scale, 65535, &profile);
+    }
+
+    bool
+    avx512f_is_supported()
+    {
+      return __builtin_cpu_supports("avx512f");
+    }
+#endif
+
+    std::vector<quantize_kernel>
+    make_quantize_kernels()
+    {
+      std::vector<quantize_kernel> kernels;
+      quantize_kernel k;
+
+#ifdef LV_HAVE_X86_KERNELS
+      k.name = "avx512f";
+      k.is_supported = avx512f_is_supported;
+      k.u8 = quantize_avx512f_u8;
+      k.u16 = quantize_avx512f_u16;
+      k.profile_u8 = profile_avx512f_u8;
+      k.profile_u16 = profile_avx512f_u16;
+      kernels.push_back(k);
+
+      k.name = "avx2";
+      k.is_supported = avx2_is_supported;
+      k.u8 = quantize_avx2_u8;
+      k.u16 = quantize_avx2_u16;
+      k.profile_u8 = profile_avx2_u8;
+      k.profile_u16 = profile_avx2_u16;
+      kernels.push_back(k);
+
+      k.name = "sse4_1";
+      k.is_supported = sse4_1_is_supported;
+      k.u8 = quantize_sse4_1_u8;
+      k.u16 = quantize_sse4_1_u16;
+      k.profile_u8 = profile_sse4_1_u8;
+      k.profile_u16 = profile_sse4_1_u16;
+      kernels.push_back(k);
+#endif
+
+      k.name = "generic";
+      k.is_supported = generic_is_supported;
+      k.u8 = quantize_generic_u8;
+      k.u16 = quantize_generic_u16;
+      k.profile_u8 = profile_generic_u8;
+      k.profile_u16 = profile_generic_u16;
+      kernels.push_back(k);
+
+      return kernels;
+    }
+
+    const quantize_kernel &
+    find_best_quantize_kernel()
+    {
+      const std::vector<quantize_kernel> &kernels = quantize_kernels();
+
+      for(size_t i=0 ; i < kernels.size() ; ++i) {
+        if(kernels[i].is_supported()) {
+          return kernels[i];
+        }
+      }
+
+      return kernels.back();
+    }
+
+  } // anonymous namespace
+
+  const std::vector<quantize_kernel> &
+  quantize_kernels()
+  {
+    static const std::vector<quantize_kernel> kernels = make_quantize_kernels();
+    return kernels;
+  }
+
+  const quantize_kernel &
+  best_quantize_kernel()
+  {
+    static const quantize_kernel &best = find_best_quantize_kernel();
+    return best;
+  }
+
+} // namespace lazyviterbi
+} // namespace gr
@@ -0,0 +1,84 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_QUANTIZE_KERNELS_H
+#define INCLUDED_LAZYVITERBI_QUANTIZE_KERNELS_H
+
+#include <lazyviterbi/api.h>
+#include <stdint.h>
+#include <vector>
+#include "metrics_quantizer.h"
+
+namespace gr {
+namespace lazyviterbi {
+
+  typedef void (*quantize_u8_kernel)(const float *in, uint8_t *metrics, int K,
+      int O, float scale);
+  typedef void (*quantize_u16_kernel)(const float *in, uint16_t *metrics, int K,
+      int O, float scale);
+  typedef void (*profile_u8_kernel)(const float *in, uint8_t *metrics, int K,
+      int O, float scale, metrics_profile &profile);
+  typedef void (*profile_u16_kernel)(const float *in, uint16_t *metrics, int K,
+      int O, float scale, metrics_profile &profile);
+
+  /*!
+   * \brief One implementation of the metrics normalization and quantization
+   * (see quantize_metrics()), in the way of VOLK kernels.
+   *
+   * Each implementation computes the minimum of each time index, subtracts it,
+   * scales, rounds, saturates and narrows the metrics in a single pass, and
+   * gives the same result as the generic one. The profile variants also add
+   * the smallest and largest metric of each time index to a metrics_profile,
+   * so that the statistics of a block come with its quantization, without
+   * reading the metrics again.
+   */
+  struct quantize_kernel
+  {
+    //! Name of the implementation ("generic", "sse4_1", "avx2", "avx512f").
+    const char *name;
+    //! True if the running CPU supports this implementation.
+    bool (*is_supported)();
+    //! Quantization on 8 bits.
+    quantize_u8_kernel u8;
+    //! Quantization on 16 bits.
+    quantize_u16_kernel u16;
+    //Quantization on 8 bits, profiling the metrics.
+    profile_u8_kernel profile_u8;
+    //Quantization on 16 bits, profiling the metrics.
+    profile_u16_kernel profile_u16;
+  };
+
+  /*!
+   * \brief Every implementation compiled in, from the fastest to the generic
+   * one (whether or not the running CPU supports them). Exported for the unit
+   * tests.
+   */
+  LAZYVITERBI_API const std::vector<quantize_kernel> &quantize_kernels();
+
+  /*!
+   * \brief Fastest implementation supported by the running CPU (looked up
+   * once).
+   */
+  const quantize_kernel &best_quantize_kernel();
+
+} // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_QUANTIZE_KERNELS_H */
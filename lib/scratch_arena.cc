@@ -0,0 +1,109 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <volk/volk.h>
+#include <new>
+#include "scratch_arena.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+namespace gr {
+namespace lazyviterbi {
+
+  const size_t scratch_arena::ALIGNMENT;
+  const size_t scratch_arena::HUGE_PAGE_SIZE;
+
+  scratch_arena::scratch_arena(size_t size, decoder::huge_pages_t huge_pages)
+    : d_base(NULL), d_size((size + ALIGNMENT - 1) & ~(ALIGNMENT - 1)),
+    d_used(0), d_map_size(0), d_huge_pages(false)
+  {
+#ifndef _WIN32
+    //Huge pages are only worth it if the area spans at least one of them
+    if(huge_pages != decoder::HUGE_PAGES_NEVER && d_size >= HUGE_PAGE_SIZE) {
+      size_t map_size = (d_size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+      void *map = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+      if(huge_pages == decoder::HUGE_PAGES_EXPLICIT) {
+        map = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      }
+#endif
+
+      //No explicit huge page available: let the kernel back the area with
+      //transparent huge pages
+      if(map == MAP_FAILED) {
+        map = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+        if(map != MAP_FAILED) {
+          madvise(map, map_size, MADV_HUGEPAGE);
+        }
+#endif
+      }
+
+      if(map != MAP_FAILED) {
+        d_base = static_cast<char*>(map);
+        d_map_size = map_size;
+        d_huge_pages = true;
+        return;
+      }
+    }
+#endif
+
+    d_base = static_cast<char*>(volk_malloc(d_size > 0 ? d_size : ALIGNMENT,
+          ALIGNMENT));
+    if(!d_base) {
+      throw std::bad_alloc();
+    }
+  }
+
+  scratch_arena::~scratch_arena()
+  {
+#ifndef _WIN32
+    if(d_map_size > 0) {
+      munmap(d_base, d_map_size);
+      return;
+    }
+#endif
+    volk_free(d_base);
+  }
+
+  void *
+  scratch_arena::alloc_bytes(size_t size)
+  {
+    if(size > d_size - d_used) {
+      throw std::bad_alloc();
+    }
+
+    void *p = d_base + d_used;
+    d_used += size;
+
+    return p;
+  }
+
+} /* namespace lazyviterbi */
+} /* namespace gr */
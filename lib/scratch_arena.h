@@ -0,0 +1,92 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_SCRATCH_ARENA_H
+#define INCLUDED_LAZYVITERBI_SCRATCH_ARENA_H
+
+#include <lazyviterbi/decoder.h>
+#include <boost/shared_ptr.hpp>
+#include <cstddef>
+
+namespace gr {
+namespace lazyviterbi {
+
+  /*!
+   * \brief One aligned memory area, holding every scratch buffer of a
+   * workspace.
+   *
+   * Buffers are carved at once, in a fixed order, when the workspace is
+   * made (or grows): decoding a block never allocates memory. Each buffer
+   * starts on a cache line. The area is not cleared.
+   */
+  class scratch_arena
+  {
+   public:
+    typedef boost::shared_ptr<scratch_arena> sptr;
+
+    //! Alignment of every buffer (a cache line, enough for AVX-512).
+    static const size_t ALIGNMENT = 64;
+    //! Size of a huge page.
+    static const size_t HUGE_PAGE_SIZE = 2*1024*1024;
+
+    //! Size in bytes of a buffer of n items of type T, padding included.
+    template <class T>
+    static size_t bytes(size_t n)
+    {
+      return (n*sizeof(T) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    }
+
+    scratch_arena(size_t size, decoder::huge_pages_t huge_pages);
+    ~scratch_arena();
+
+    //! Next buffer of n items of type T.
+    template <class T>
+    T *alloc(size_t n)
+    {
+      return static_cast<T*>(alloc_bytes(bytes<T>(n)));
+    }
+
+    //! Offset of the next buffer.
+    size_t mark() const { return d_used; }
+    //! Carve next buffers from offset \p mark again (see mark()).
+    void rewind(size_t mark) { d_used = mark; }
+
+    //! Capacity of the area in bytes.
+    size_t size() const { return d_size; }
+    //! True if huge pages were requested for the area.
+    bool huge_pages() const { return d_huge_pages; }
+
+   private:
+    void *alloc_bytes(size_t size);
+
+    char *d_base;
+    size_t d_size;
+    size_t d_used;
+    size_t d_map_size;
+    bool d_huge_pages;
+
+    scratch_arena(const scratch_arena &);
+    scratch_arena &operator=(const scratch_arena &);
+  };
+
+} /* namespace lazyviterbi */
+} /* namespace gr */
+
+#endif /* INCLUDED_LAZYVITERBI_SCRATCH_ARENA_H */
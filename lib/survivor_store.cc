@@ -0,0 +1,116 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <algorithm>
+#include "survivor_store.h"
+
+namespace gr {
+namespace lazyviterbi {
+
+  survivor_store::survivor_store(int K, int S, size_t max_size_PS_s)
+  {
+    set_layout(S, max_size_PS_s);
+
+    d_words.assign((size_t)K*d_row_words, 0);
+    d_data = d_words.empty() ? NULL : &d_words[0];
+  }
+
+  survivor_store::survivor_store(int K, int S, size_t max_size_PS_s,
+      uint64_t *words)
+    : d_data(words)
+  {
+    set_layout(S, max_size_PS_s);
+  }
+
+  survivor_store::survivor_store(const survivor_store &other)
+  {
+    *this = other;
+  }
+
+  survivor_store &
+  survivor_store::operator=(const survivor_store &other)
+  {
+    d_words = other.d_words;
+    d_data = d_words.empty() ? other.d_data : &d_words[0];
+    d_row_words = other.d_row_words;
+    d_S = other.d_S;
+    d_bits_log2 = other.d_bits_log2;
+    d_state_mask = other.d_state_mask;
+    d_field_mask = other.d_field_mask;
+
+    return *this;
+  }
+
+  size_t
+  survivor_store::words(int K, int S, size_t max_size_PS_s)
+  {
+    survivor_store layout(0, S, max_size_PS_s);
+
+    return (size_t)K*layout.d_row_words;
+  }
+
+  void
+  survivor_store::set_layout(int S, size_t max_size_PS_s)
+  {
+    d_S = S;
+
+    //Smallest power of two number of bits holding branch indexes
+    //0 to max_size_PS_s-1 (decisions are at most 16-bit wide)
+    d_bits_log2 = 0;
+    while(d_bits_log2 < 4
+        && ((size_t)1 << (1 << d_bits_log2)) < max_size_PS_s) {
+      ++d_bits_log2;
+    }
+
+    d_state_mask = (64 >> d_bits_log2) - 1;
+    d_field_mask = ((uint64_t)1 << (1 << d_bits_log2)) - 1;
+
+    d_row_words = ((size_t)S + d_state_mask) >> (6 - d_bits_log2);
+  }
+
+  void
+  survivor_store::pack_row(int k, const uint16_t *decisions)
+  {
+    pack_row(k, 0, d_S, decisions);
+  }
+
+  void
+  survivor_store::pack_row(int k, int s0, int n_states, const uint16_t *decisions)
+  {
+    const int bits_log2 = d_bits_log2;
+    const int per_word = d_state_mask + 1;
+    uint64_t *word_it = d_data + (size_t)k*d_row_words + ((size_t)s0 >> (6 - bits_log2));
+    const uint16_t *decisions_end = decisions + n_states;
+
+    while(decisions < decisions_end) {
+      int n = std::min(per_word, (int)(decisions_end - decisions));
+      uint64_t word = 0;
+
+      for(int j=0 ; j < n ; ++j) {
+        word |= (uint64_t)decisions[j] << (j << bits_log2);
+      }
+
+      *(word_it++) = word;
+      decisions += n;
+    }
+  }
+
+} // namespace lazyviterbi
+} // namespace gr
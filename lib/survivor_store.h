@@ -0,0 +1,111 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_SURVIVOR_STORE_H
+#define INCLUDED_LAZYVITERBI_SURVIVOR_STORE_H
+
+#include <lazyviterbi/api.h>
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+namespace gr {
+namespace lazyviterbi {
+
+  /*!
+   * \brief Bit-packed traceback vector of the classical Viterbi decoders.
+   *
+   * The decision of a state at a time index (the index of the surviving branch
+   * in PS[state]) is stored on the smallest power of two number of bits able
+   * to hold every branch index: 1 bit for binary codes, 2 bits for up to 4
+   * branches per state, etc. Decisions of a time index are packed in 64-bit
+   * words, which never hold decisions of two time indexes.
+   */
+  class survivor_store
+  {
+   public:
+    /*!
+     * \param K Number of time indexes.
+     * \param S Number of states.
+     * \param max_size_PS_s Largest number of branches yielding to a state.
+     */
+    survivor_store(int K = 0, int S = 0, size_t max_size_PS_s = 2);
+
+    /*!
+     * \brief Same as above, decisions being stored in \p words (words(K, S,
+     * max_size_PS_s) items, owned by the caller).
+     */
+    survivor_store(int K, int S, size_t max_size_PS_s, uint64_t *words);
+
+    survivor_store(const survivor_store &other);
+    survivor_store &operator=(const survivor_store &other);
+
+    //! Number of words storing the decisions of K time indexes.
+    static size_t words(int K, int S, size_t max_size_PS_s);
+
+    //! Number of bits of a decision.
+    int bits() const { return 1 << d_bits_log2; }
+
+    //! Decision of state \p s at time index \p k.
+    inline int get(int k, int s) const
+    {
+      uint64_t word = d_data[(size_t)k*d_row_words
+        + ((size_t)s >> (6 - d_bits_log2))];
+
+      return (int)((word >> ((s & d_state_mask) << d_bits_log2)) & d_field_mask);
+    }
+
+    /*!
+     * \brief Packed decisions of time index \p k, for kernels writing them
+     * directly (bits() bits per state, state s in word s/(64/bits())).
+     */
+    uint64_t *row(int k) { return d_data + (size_t)k*d_row_words; }
+
+    //! Store the decisions of every state at time index \p k (one per item).
+    void pack_row(int k, const uint16_t *decisions);
+
+    /*!
+     * \brief Store the decisions of \p n_states consecutive states, starting
+     * at state \p s0 at time index \p k.
+     *
+     * \p s0 must be a multiple of the number of decisions per word: packing
+     * rows of different slices of states can then run concurrently.
+     */
+    void pack_row(int k, int s0, int n_states, const uint16_t *decisions);
+
+   private:
+    void set_layout(int S, size_t max_size_PS_s);
+
+    //Own storage (empty if words are owned by the caller)
+    std::vector<uint64_t> d_words;
+    uint64_t *d_data;
+    //Number of words per time index
+    size_t d_row_words;
+    int d_S;
+    int d_bits_log2;
+    //Decisions per word minus 1
+    int d_state_mask;
+    uint64_t d_field_mask;
+  };
+
+} // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_SURVIVOR_STORE_H */
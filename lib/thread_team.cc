@@ -0,0 +1,168 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <boost/bind.hpp>
+#include <algorithm>
+#include "thread_team.h"
+
+namespace gr {
+namespace lazyviterbi {
+
+  //Spins before a waiting member starts yielding its core
+  static const int BARRIER_SPINS = 4096;
+
+  namespace {
+
+  //Thrown by barrier() to the members of a team one of which has thrown
+  struct team_aborted {};
+
+  } // anonymous namespace
+
+  thread_team::thread_team(int n_members)
+    : d_n_members(n_members < 1 ? 1 : n_members), d_task(NULL), d_task_gen(0),
+    d_stop(false), d_n_waiting(d_n_members), d_barrier_gen(0), d_n_done(0),
+    d_failed(false)
+  {
+    for(int m=1 ; m < d_n_members ; ++m) {
+      d_threads.push_back(boost::shared_ptr<gr::thread::thread>(
+            new gr::thread::thread(boost::bind(&thread_team::helper_loop, this, m))));
+    }
+  }
+
+  thread_team::~thread_team()
+  {
+    {
+      gr::thread::scoped_lock guard(d_task_lock);
+      d_stop = true;
+    }
+    d_task_cond.notify_all();
+
+    for(size_t t=0 ; t < d_threads.size() ; ++t) {
+      d_threads[t]->join();
+    }
+  }
+
+  void
+  thread_team::run(const boost::function<void(int)> &f)
+  {
+    {
+      gr::thread::scoped_lock guard(d_task_lock);
+      d_task = &f;
+      ++d_task_gen;
+    }
+    d_task_cond.notify_all();
+
+    call_task(f, 0);
+
+    //Wait for the helpers to complete. Not a barrier(), which would not be
+    //reached by the helpers leaving f on a failure.
+    int spins = 0;
+    while(d_n_done.load(std::memory_order_acquire) < d_n_members - 1) {
+      if(++spins > BARRIER_SPINS) {
+        gr::thread::thread::yield();
+      }
+    }
+    d_n_done.store(0, std::memory_order_relaxed);
+
+    if(d_failed.load(std::memory_order_relaxed)) {
+      //Members may have left in the middle of a barrier
+      d_n_waiting.store(d_n_members, std::memory_order_relaxed);
+      d_failed.store(false, std::memory_order_relaxed);
+
+      std::exception_ptr error;
+      std::swap(error, d_error);
+      std::rethrow_exception(error);
+    }
+  }
+
+  void
+  thread_team::barrier()
+  {
+    if(d_failed.load(std::memory_order_acquire)) {
+      throw team_aborted();
+    }
+
+    unsigned int gen = d_barrier_gen.load(std::memory_order_acquire);
+
+    if(d_n_waiting.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      //Last member to arrive: open the barrier
+      d_n_waiting.store(d_n_members, std::memory_order_relaxed);
+      d_barrier_gen.fetch_add(1, std::memory_order_release);
+    }
+    else {
+      int spins = 0;
+      while(d_barrier_gen.load(std::memory_order_acquire) == gen) {
+        if(d_failed.load(std::memory_order_acquire)) {
+          throw team_aborted();
+        }
+        if(++spins > BARRIER_SPINS) {
+          gr::thread::thread::yield();
+        }
+      }
+    }
+  }
+
+  void
+  thread_team::call_task(const boost::function<void(int)> &f, int member)
+  {
+    //An exception escaping a helper would terminate the process: it is
+    //handed to run(), and the other members are released from the barriers
+    try {
+      f(member);
+    }
+    catch(const team_aborted &) {
+    }
+    catch(...) {
+      gr::thread::scoped_lock guard(d_error_lock);
+      if(!d_error) {
+        d_error = std::current_exception();
+      }
+      d_failed.store(true, std::memory_order_release);
+    }
+  }
+
+  void
+  thread_team::helper_loop(int member)
+  {
+    unsigned int last_gen = 0;
+
+    while(true) {
+      const boost::function<void(int)> *task;
+
+      {
+        gr::thread::scoped_lock guard(d_task_lock);
+        while(d_task_gen == last_gen && !d_stop) {
+          d_task_cond.wait(guard);
+        }
+        if(d_stop) {
+          return;
+        }
+
+        last_gen = d_task_gen;
+        task = d_task;
+      }
+
+      call_task(*task, member);
+      d_n_done.fetch_add(1, std::memory_order_release);
+    }
+  }
+
+} // namespace lazyviterbi
+} // namespace gr
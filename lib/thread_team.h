@@ -0,0 +1,99 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_THREAD_TEAM_H
+#define INCLUDED_LAZYVITERBI_THREAD_TEAM_H
+
+#include <lazyviterbi/api.h>
+#include <gnuradio/thread/thread.h>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <atomic>
+#include <exception>
+#include <vector>
+
+namespace gr {
+namespace lazyviterbi {
+
+  /*!
+   * \brief A fixed team of threads running the same function in lockstep.
+   *
+   * run(f) calls f(member) once per member of the team, member 0 being the
+   * calling thread. Inside f, members synchronize with barrier(), a spinning
+   * barrier cheap enough to be crossed once per trellis section.
+   *
+   * Helper threads sleep between two calls of run().
+   *
+   * Exported for the unit tests.
+   */
+  class LAZYVITERBI_API thread_team
+  {
+   public:
+    //! Team of n_members threads (including the caller of run()).
+    thread_team(int n_members);
+    ~thread_team();
+
+    int size() const { return d_n_members; }
+
+    /*!
+     * \brief Run f(member) on every member, and wait for all of them to return.
+     *
+     * If a member throws, the members waiting at (or later reaching) a barrier
+     * leave f, and the first exception is rethrown once every member is done.
+     */
+    void run(const boost::function<void(int)> &f);
+
+    //! Wait for every member of the team to reach the barrier.
+    void barrier();
+
+   private:
+    int d_n_members;
+    std::vector<boost::shared_ptr<gr::thread::thread> > d_threads;
+
+    //Function run by the team, and number of calls to run() so far
+    const boost::function<void(int)> *d_task;
+    unsigned int d_task_gen;
+    bool d_stop;
+    gr::thread::mutex d_task_lock;
+    gr::thread::condition_variable d_task_cond;
+
+    //Barrier: members yet to arrive, and number of completed barriers
+    std::atomic<int> d_n_waiting;
+    std::atomic<unsigned int> d_barrier_gen;
+
+    //Helpers done with the current task
+    std::atomic<int> d_n_done;
+
+    //First exception thrown by a member during the current task
+    std::atomic<bool> d_failed;
+    std::exception_ptr d_error;
+    gr::thread::mutex d_error_lock;
+
+    thread_team(const thread_team &);
+    thread_team &operator=(const thread_team &);
+
+    void helper_loop(int member);
+    void call_task(const boost::function<void(int)> &f, int member);
+  };
+
+} // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_THREAD_TEAM_H */
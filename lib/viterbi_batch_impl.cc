@@ -0,0 +1,255 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdexcept>
+#include <gnuradio/io_signature.h>
+#include <boost/bind.hpp>
+#include "viterbi_batch_impl.h"
+#include "decode_pool.h"
+#include "metrics_quantizer.h"
+#include "path_metrics.h"
+#include "quantize_kernels.h"
+
+namespace gr {
+  namespace lazyviterbi {
+
+    viterbi_batch::sptr
+    viterbi_batch::make(const gr::trellis::fsm &FSM, int K, int S0, int SK)
+    {
+      return gnuradio::get_initial_sptr
+        (new viterbi_batch_impl(FSM, K, S0, SK));
+    }
+
+    /*
+     * The private constructor
+     */
+    viterbi_batch_impl::viterbi_batch_impl(const gr::trellis::fsm &FSM, int K,
+        int S0, int SK)
+      : gr::block("viterbi_batch",
+              gr::io_signature::make(1, -1, sizeof(float)),
+              gr::io_signature::make(1, -1, sizeof(char))),
+        d_FSM(FSM), d_K(K), d_trellis(compiled_trellis::get(FSM)),
+        d_workspaces(decode_pool::MAX_WORKERS)
+    {
+      const compiled_trellis &T = *d_trellis;
+      const int S = T.S();
+
+      //S0 and SK must represent a state of the trellis
+      d_S0 = (S0 >= 0 && S0 < S) ? S0 : -1;
+      d_SK = (SK >= 0 && SK < S) ? SK : -1;
+
+      //Compute max size of PS[s] (decisions are stored on 8 bits)
+      d_max_size_PS_s = T.max_size_PS_s();
+      if(d_max_size_PS_s > 256) {
+        throw std::invalid_argument("viterbi_batch: too many branches yielding to a state");
+      }
+
+      //Order PS and OS state by state, padding with copies of the first branch
+      d_ordered_PS.resize(S*d_max_size_PS_s);
+      d_ordered_OS.resize(S*d_max_size_PS_s);
+      for(int s=0 ; s < S ; ++s) {
+        for(int i=0 ; i < d_max_size_PS_s ; ++i) {
+          int b = T.offsets()[s] + ((i < T.offsets()[s + 1] - T.offsets()[s]) ? i : 0);
+          d_ordered_PS[s*d_max_size_PS_s + i] = T.PS()[b];
+          d_ordered_OS[s*d_max_size_PS_s + i] = T.OS()[b];
+        }
+      }
+
+      //Branch metrics must keep 16-bit path metrics comparable
+      int depth = trellis_mixing_depth(d_FSM);
+      d_max_metric = (depth > 0) ? max_fixed_branch_metric(16, depth) : 0;
+      if(d_max_metric < 1) {
+        throw std::invalid_argument("viterbi_batch: trellis is too deep for 16-bit path metrics");
+      }
+      d_init_metric = depth*d_max_metric + 1;
+
+      d_kernel = &best_batch_kernel();
+
+      set_relative_rate(1.0 / ((double)d_FSM.O()));
+      set_output_multiple(d_K);
+      //Ask for full batches (the scheduler still gives fewer blocks when the
+      //input runs short, e.g. at the end of the stream), with room for two of
+      //them in the output buffer
+      set_min_noutput_items(BATCH_LANES*d_K);
+      set_min_output_buffer(2*BATCH_LANES*d_K);
+    }
+
+    int
+    viterbi_batch_impl::pool_size() const
+    {
+      return decode_pool::instance().size();
+    }
+
+    void
+    viterbi_batch_impl::set_pool_size(int n_threads)
+    {
+      decode_pool::instance().set_size(n_threads);
+    }
+
+    viterbi_batch_impl::workspace &
+    viterbi_batch_impl::get_workspace(int worker)
+    {
+      if(!d_workspaces[worker]) {
+        d_workspaces[worker].reset(new workspace(d_FSM.S(), d_K, d_FSM.O()));
+      }
+
+      return *d_workspaces[worker];
+    }
+
+    void
+    viterbi_batch_impl::set_S0(int S0)
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      d_S0 = S0;
+    }
+
+    void
+    viterbi_batch_impl::set_SK(int SK)
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      d_SK = SK;
+    }
+
+    void
+    viterbi_batch_impl::forecast(int noutput_items, gr_vector_int &ninput_items_required)
+    {
+      int input_required =  d_FSM.O() * noutput_items;
+      unsigned ninputs = ninput_items_required.size();
+      for(unsigned int i = 0; i < ninputs; i++) {
+        ninput_items_required[i] = input_required;
+      }
+    }
+
+    int
+    viterbi_batch_impl::general_work (int noutput_items,
+                       gr_vector_int &ninput_items,
+                       gr_vector_const_void_star &input_items,
+                       gr_vector_void_star &output_items)
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      int nstreams = input_items.size();
+      int nblocks = noutput_items / d_K;
+      int n_jobs = nstreams*nblocks;
+
+      //One job per batch of BATCH_LANES blocks (taken from every stream)
+      decode_pool::instance().run((n_jobs + BATCH_LANES - 1) / BATCH_LANES,
+          boost::bind(&viterbi_batch_impl::decode_batch, this, boost::cref(input_items),
+            boost::ref(output_items), nblocks, n_jobs, _1, _2));
+
+      consume_each(d_FSM.O() * noutput_items);
+      return noutput_items;
+    }
+
+    void
+    viterbi_batch_impl::decode_batch(const gr_vector_const_void_star &input_items,
+        gr_vector_void_star &output_items, int nblocks, int n_jobs, int batch,
+        int worker)
+    {
+      const float *in[BATCH_LANES];
+      unsigned char *out[BATCH_LANES];
+      int n_blocks = std::min(BATCH_LANES, n_jobs - batch*BATCH_LANES);
+
+      for(int l=0 ; l < n_blocks ; ++l) {
+        int m = (batch*BATCH_LANES + l) / nblocks;
+        int n = (batch*BATCH_LANES + l) % nblocks;
+
+        in[l] = &(((const float*)input_items[m])[n*d_K*d_FSM.O()]);
+        out[l] = &(((unsigned char*)output_items[m])[n*d_K]);
+      }
+
+      viterbi_algorithm(d_K, d_S0, d_SK, n_blocks, in, out, get_workspace(worker));
+    }
+
+    void
+    viterbi_batch_impl::viterbi_algorithm(int K, int S0, int SK, int n_blocks,
+        const float * const *in, unsigned char * const *out, workspace &ws)
+    {
+      const int S = d_FSM.S();
+      const int O = d_FSM.O();
+      const int L = BATCH_LANES;
+      int tb_state, i;
+
+      //Quantize branch metrics of each block, and interleave them (unused
+      //lanes decode all-zero metrics)
+      if(n_blocks < L) {
+        std::fill(ws.metrics.begin(), ws.metrics.begin() + K*O*L, 0);
+      }
+      for(int l=0 ; l < n_blocks ; ++l) {
+        float scale = estimate_metrics_scale(in[l], K, O, d_max_metric);
+        best_quantize_kernel().u16(in[l], &ws.block_metrics[0], K, O, scale);
+
+        for(int j=0 ; j < K*O ; ++j) {
+          ws.metrics[j*L + l] = std::min(ws.block_metrics[j], (uint16_t)d_max_metric);
+        }
+      }
+
+      //If initial state was specified
+      if(S0 != -1) {
+        std::fill(ws.alpha[0].begin(), ws.alpha[0].end(), (uint16_t)d_init_metric);
+        std::fill(ws.alpha[0].begin() + S0*L, ws.alpha[0].begin() + (S0 + 1)*L, 0);
+      }
+      else {
+        std::fill(ws.alpha[0].begin(), ws.alpha[0].end(), 0);
+      }
+
+      //ADD, COMPARE and SELECT
+      for(int k=0 ; k < K ; ++k) {
+        d_kernel->acs(&ws.alpha[k & 1][0], &ws.alpha[(k + 1) & 1][0],
+            &ws.metrics[k*O*L], &d_ordered_PS[0], &d_ordered_OS[0], S,
+            d_max_size_PS_s, &ws.trace[(size_t)k*S*L]);
+      }
+
+      //Traceback of each block
+      const compiled_trellis &T = *d_trellis;
+      const std::vector<uint16_t> &alpha = ws.alpha[K & 1];
+
+      for(int l=0 ; l < n_blocks ; ++l) {
+        //If final state was specified
+        if(SK != -1) {
+          tb_state = SK;
+        }
+        else {
+          //Smallest path metric after time K
+          tb_state = 0;
+          for(int s=1 ; s < S ; ++s) {
+            if(modulo_less(alpha[s*L + l], alpha[tb_state*L + l])) {
+              tb_state = s;
+            }
+          }
+        }
+
+        for(int k=K-1 ; k >= 0 ; --k) {
+          i = ws.trace[((size_t)k*S + tb_state)*L + l];
+
+          //Output previous input
+          out[l][k] = (unsigned char) T.PI(tb_state, i);
+
+          //Update tb_state with the previous state on the shortest path
+          tb_state = T.PS(tb_state, i);
+        }
+      }
+    }
+
+  } /* namespace lazyviterbi */
+} /* namespace gr */
@@ -0,0 +1,120 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_VITERBI_BATCH_IMPL_H
+#define INCLUDED_LAZYVITERBI_VITERBI_BATCH_IMPL_H
+
+#include <lazyviterbi/viterbi_batch.h>
+#include <boost/shared_ptr.hpp>
+#include "batch_kernels.h"
+#include <lazyviterbi/compiled_trellis.h>
+
+namespace gr {
+  namespace lazyviterbi {
+
+    class viterbi_batch_impl : public viterbi_batch
+    {
+      public:
+        //Scratch buffers of the algorithm (one set per worker of the decode pool)
+        struct workspace
+        {
+          //Quantized branch metrics of a block
+          std::vector<uint16_t> block_metrics;
+          //Branch metrics of the batch: metrics[(k*O + o)*BATCH_LANES + l]
+          std::vector<uint16_t> metrics;
+          //Path metrics of even and odd sections:
+          //alpha[k & 1][s*BATCH_LANES + l]
+          std::vector<uint16_t> alpha[2];
+          //Traceback vector: trace[(k*S + s)*BATCH_LANES + l]
+          std::vector<uint8_t> trace;
+
+          workspace(int S, int K, int O)
+            : block_metrics(K*O), metrics(K*O*BATCH_LANES),
+            trace((size_t)K*S*BATCH_LANES)
+          {
+            alpha[0].resize(S*BATCH_LANES);
+            alpha[1].resize(S*BATCH_LANES);
+          }
+        };
+
+      private:
+        gr::trellis::fsm d_FSM; //Trellis description
+        int d_K;                //Number of trellis sections
+        int d_S0;               //Initial state idx (-1 if unknown)
+        int d_SK;               //Final state idx (-1 if unknown)
+
+        //Flat tables of the trellis (shared with other decoders)
+        compiled_trellis::sptr d_trellis;
+
+        //Max size of PS[s]
+        int d_max_size_PS_s;
+        //Previous states and output symbols of the branches yielding to each
+        //state: d_ordered_PS[s*d_max_size_PS_s + i] = d_FSM.PS()[s][i], and
+        //d_ordered_OS[s*d_max_size_PS_s + i] = d_FSM.OS()[d_FSM.PS()[s][i]*I + d_FSM.PI()[s][i]]
+        //(missing branches are copies of the first one)
+        std::vector<int> d_ordered_PS;
+        std::vector<int> d_ordered_OS;
+
+        int d_max_metric;       //Largest quantized branch metric
+        int d_init_metric;      //Initial path metric of states other than S0
+        const batch_kernel *d_kernel;
+
+        std::vector< boost::shared_ptr<workspace> > d_workspaces;
+
+        void decode_batch(const gr_vector_const_void_star &input_items,
+            gr_vector_void_star &output_items, int nblocks, int n_jobs, int batch,
+            int worker);
+
+      public:
+        viterbi_batch_impl(const gr::trellis::fsm &FSM, int K, int S0, int SK);
+
+        gr::trellis::fsm FSM() const  { return d_FSM; }
+        int K()  const { return d_K; }
+        int S0()  const { return d_S0; }
+        int SK()  const { return d_SK; }
+        int batch_size()  const { return BATCH_LANES; }
+        std::string kernel()  const { return d_kernel->name; }
+
+        int pool_size() const;
+
+        void set_S0(int S0);
+        void set_SK(int SK);
+        void set_pool_size(int n_threads);
+
+        void forecast (int noutput_items, gr_vector_int &ninput_items_required);
+
+        int general_work(int noutput_items, gr_vector_int &ninput_items,
+            gr_vector_const_void_star &input_items, gr_vector_void_star &output_items);
+
+        /*!
+         * Decode n_blocks <= BATCH_LANES blocks: in[l] holds the K*O input
+         * metrics of block l, and out[l] receives its K decoded symbols.
+         */
+        void viterbi_algorithm(int K, int S0, int SK, int n_blocks,
+            const float * const *in, unsigned char * const *out, workspace &ws);
+
+        //Scratch buffers of a worker of the decode pool
+        workspace &get_workspace(int worker);
+    };
+
+  } // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_VITERBI_BATCH_IMPL_H */
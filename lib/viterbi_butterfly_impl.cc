@@ -0,0 +1,282 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdexcept>
+#include <gnuradio/io_signature.h>
+#include <boost/bind.hpp>
+#include "viterbi_butterfly_impl.h"
+#include "decode_pool.h"
+#include "metrics_quantizer.h"
+#include "path_metrics.h"
+#include "quantize_kernels.h"
+
+namespace gr {
+  namespace lazyviterbi {
+
+    viterbi_butterfly::sptr
+    viterbi_butterfly::make(const gr::trellis::fsm &FSM, int K, int S0, int SK)
+    {
+      return gnuradio::get_initial_sptr
+        (new viterbi_butterfly_impl(FSM, K, S0, SK));
+    }
+
+    /*
+     * The private constructor
+     */
+    viterbi_butterfly_impl::viterbi_butterfly_impl(const gr::trellis::fsm &FSM,
+        int K, int S0, int SK)
+      : gr::block("viterbi_butterfly",
+              gr::io_signature::make(1, -1, sizeof(float)),
+              gr::io_signature::make(1, -1, sizeof(char))),
+        d_FSM(FSM), d_K(K), d_state(FSM.S()), d_input(2*FSM.S()),
+        d_workspaces(decode_pool::MAX_WORKERS)
+    {
+      const int S = d_FSM.S();
+      const int O = d_FSM.O();
+      const std::vector<int> &NS = d_FSM.NS();
+      const std::vector<int> &OS = d_FSM.OS();
+
+      //S0 and SK must represent a state of the trellis
+      d_S0 = (S0 >= 0 && S0 < S) ? S0 : -1;
+      d_SK = (SK >= 0 && SK < S) ? SK : -1;
+
+      //Binary input, and a power of two number of states
+      int m = 0;
+      while((1 << m) < S) {
+        ++m;
+      }
+      if(d_FSM.I() != 2 || S < 2 || (1 << m) != S) {
+        throw std::invalid_argument("viterbi_butterfly: trellis is not a shift register trellis");
+      }
+      if(O > 256) {
+        throw std::invalid_argument("viterbi_butterfly: too many output symbols");
+      }
+
+      //The new bit of the state is either its least significant bit, or its
+      //most significant one (then reverse the bits of state indexes)
+      for(int s=0 ; s < S ; ++s) {
+        d_state[s] = s;
+      }
+      if(!is_butterfly(d_state)) {
+        for(int s=0 ; s < S ; ++s) {
+          int r = 0;
+          for(int b=0 ; b < m ; ++b) {
+            r |= ((s >> b) & 1) << (m - 1 - b);
+          }
+          d_state[s] = r;
+        }
+
+        if(!is_butterfly(d_state)) {
+          throw std::invalid_argument("viterbi_butterfly: trellis is not a shift register trellis");
+        }
+      }
+
+      //Inputs and output symbols of each branch
+      const int half = S/2;
+      d_idx_a.assign(16*((half + 7)/8), 0);
+      d_idx_b.assign(16*((half + 7)/8), 0);
+
+      for(int s=0 ; s < S ; ++s) {
+        for(int i=0 ; i < 2 ; ++i) {
+          int p = d_state[s];
+          int b = d_state[NS[2*s + i]] & 1;
+          int j = p % half;
+          std::vector<uint8_t> &idx = (p < half) ? d_idx_a : d_idx_b;
+
+          d_input[2*p + b] = (unsigned char)i;
+          idx[16*(j/8) + j%8 + 8*b] = (uint8_t)OS[2*s + i];
+        }
+      }
+
+      //m sections link any two states: branch metrics must keep 16-bit path
+      //metrics comparable (and fit in 8 bits)
+      d_max_metric = std::min(255, max_fixed_branch_metric(16, m));
+      d_init_metric = m*d_max_metric + 1;
+
+      d_kernel = &best_butterfly_kernel(S, O);
+
+      set_relative_rate(1.0 / ((double)d_FSM.O()));
+      set_output_multiple(d_K);
+    }
+
+    bool
+    viterbi_butterfly_impl::is_butterfly(const std::vector<int> &state) const
+    {
+      const int S = d_FSM.S();
+      const std::vector<int> &NS = d_FSM.NS();
+
+      for(int s=0 ; s < S ; ++s) {
+        int n0 = state[NS[2*s]];
+        int n1 = state[NS[2*s + 1]];
+
+        //Next states of p are (2p mod S) and (2p mod S) + 1
+        if((n0 >> 1) != state[s] % (S/2) || (n0 ^ n1) != 1) {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    int
+    viterbi_butterfly_impl::pool_size() const
+    {
+      return decode_pool::instance().size();
+    }
+
+    void
+    viterbi_butterfly_impl::set_pool_size(int n_threads)
+    {
+      decode_pool::instance().set_size(n_threads);
+    }
+
+    viterbi_butterfly_impl::workspace &
+    viterbi_butterfly_impl::get_workspace(int worker)
+    {
+      if(!d_workspaces[worker]) {
+        d_workspaces[worker].reset(new workspace(d_FSM.S(), d_K, d_FSM.O()));
+      }
+
+      return *d_workspaces[worker];
+    }
+
+    void
+    viterbi_butterfly_impl::set_S0(int S0)
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      d_S0 = S0;
+    }
+
+    void
+    viterbi_butterfly_impl::set_SK(int SK)
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      d_SK = SK;
+    }
+
+    void
+    viterbi_butterfly_impl::forecast(int noutput_items, gr_vector_int &ninput_items_required)
+    {
+      int input_required =  d_FSM.O() * noutput_items;
+      unsigned ninputs = ninput_items_required.size();
+      for(unsigned int i = 0; i < ninputs; i++) {
+        ninput_items_required[i] = input_required;
+      }
+    }
+
+    int
+    viterbi_butterfly_impl::general_work (int noutput_items,
+                       gr_vector_int &ninput_items,
+                       gr_vector_const_void_star &input_items,
+                       gr_vector_void_star &output_items)
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      int nstreams = input_items.size();
+      int nblocks = noutput_items / d_K;
+
+      //One job per stream and per block
+      decode_pool::instance().run(nstreams*nblocks,
+          boost::bind(&viterbi_butterfly_impl::decode_block, this, boost::cref(input_items),
+            boost::ref(output_items), nblocks, _1, _2));
+
+      consume_each(d_FSM.O() * noutput_items);
+      return noutput_items;
+    }
+
+    void
+    viterbi_butterfly_impl::decode_block(const gr_vector_const_void_star &input_items,
+        gr_vector_void_star &output_items, int nblocks, int job, int worker)
+    {
+      int m = job / nblocks;
+      int n = job % nblocks;
+      const float *in = (const float*)input_items[m];
+      unsigned char *out = (unsigned char*)output_items[m];
+
+      viterbi_algorithm(d_K, d_S0, d_SK, &(in[n*d_K*d_FSM.O()]), &(out[n*d_K]),
+          get_workspace(worker));
+    }
+
+    void
+    viterbi_butterfly_impl::viterbi_algorithm(int K, int S0, int SK,
+        const float *in, unsigned char *out, workspace &ws)
+    {
+      const int S = d_FSM.S();
+      const int O = d_FSM.O();
+      const int half = S/2;
+      int tb_state, d, p;
+
+      //Quantize branch metrics of the whole block at once
+      float scale = estimate_metrics_scale(in, K, O, d_max_metric);
+      best_quantize_kernel().u8(in, &ws.metrics[0], K, O, scale);
+      for(std::vector<uint8_t>::iterator it = ws.metrics.begin() ;
+          it != ws.metrics.begin() + K*O ; ++it) {
+        *it = std::min(*it, (uint8_t)d_max_metric);
+      }
+
+      //If initial state was specified
+      if(S0 != -1) {
+        std::fill(ws.alpha[0].begin(), ws.alpha[0].end(), (uint16_t)d_init_metric);
+        ws.alpha[0][d_state[S0]] = 0;
+      }
+      else {
+        std::fill(ws.alpha[0].begin(), ws.alpha[0].end(), 0);
+      }
+
+      //ADD, COMPARE and SELECT
+      for(int k=0 ; k < K ; ++k) {
+        d_kernel->acs(&ws.alpha[k & 1][0], &ws.alpha[(k + 1) & 1][0],
+            &ws.metrics[k*O], &d_idx_a[0], &d_idx_b[0], ws.trace.row(k), S);
+      }
+
+      //If final state was specified
+      if(SK != -1) {
+        tb_state = d_state[SK];
+      }
+      else{
+        //Smallest path metric after time K
+        const std::vector<uint16_t> &alpha = ws.alpha[K & 1];
+
+        tb_state = 0;
+        for(int s=1 ; s < S ; ++s) {
+          if(modulo_less(alpha[s], alpha[tb_state])) {
+            tb_state = s;
+          }
+        }
+      }
+
+      //Traceback
+      for(int k=K-1 ; k >= 0 ; --k) {
+        //Previous state on the shortest path: (tb_state >> 1) + d*S/2
+        d = ws.trace.get(k, tb_state);
+        p = (tb_state >> 1) + (d ? half : 0);
+
+        //Output previous input
+        out[k] = d_input[2*p + (tb_state & 1)];
+
+        tb_state = p;
+      }
+    }
+
+  } /* namespace lazyviterbi */
+} /* namespace gr */
@@ -0,0 +1,112 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_VITERBI_BUTTERFLY_IMPL_H
+#define INCLUDED_LAZYVITERBI_VITERBI_BUTTERFLY_IMPL_H
+
+#include <lazyviterbi/viterbi_butterfly.h>
+#include <boost/shared_ptr.hpp>
+#include "butterfly_kernels.h"
+#include "survivor_store.h"
+
+namespace gr {
+  namespace lazyviterbi {
+
+    class viterbi_butterfly_impl : public viterbi_butterfly
+    {
+      public:
+        //Scratch buffers of the algorithm (one set per worker of the decode pool)
+        struct workspace
+        {
+          //Quantized branch metrics of the whole block (plus padding, read by
+          //the kernels)
+          std::vector<uint8_t> metrics;
+          //Path metrics of even and odd sections
+          std::vector<uint16_t> alpha[2];
+          //Traceback vector (one bit per state)
+          survivor_store trace;
+
+          workspace(int S, int K, int O)
+            : metrics(K*O + 16), trace(K, S, 2)
+          {
+            alpha[0].resize(S);
+            alpha[1].resize(S);
+          }
+        };
+
+      private:
+        gr::trellis::fsm d_FSM; //Trellis description
+        int d_K;                //Number of trellis sections
+        int d_S0;               //Initial state idx (-1 if unknown)
+        int d_SK;               //Final state idx (-1 if unknown)
+
+        //States are renumbered so that the predecessors of states 2j and
+        //2j + 1 are states j and j + S/2: d_state[s] is the new index of state
+        //s of d_FSM
+        std::vector<int> d_state;
+        //Input of d_FSM on the branch from (new) state p to state
+        //((2p) mod S) + b: d_input[2p + b]
+        std::vector<unsigned char> d_input;
+        //Output symbols of the branches of each butterfly (see
+        //butterfly_acs_kernel)
+        std::vector<uint8_t> d_idx_a;
+        std::vector<uint8_t> d_idx_b;
+
+        int d_max_metric;       //Largest quantized branch metric
+        int d_init_metric;      //Initial path metric of states other than S0
+        const butterfly_kernel *d_kernel;
+
+        std::vector< boost::shared_ptr<workspace> > d_workspaces;
+
+        bool is_butterfly(const std::vector<int> &state) const;
+        void decode_block(const gr_vector_const_void_star &input_items,
+            gr_vector_void_star &output_items, int nblocks, int job, int worker);
+
+      public:
+        viterbi_butterfly_impl(const gr::trellis::fsm &FSM, int K, int S0, int SK);
+
+        gr::trellis::fsm FSM() const  { return d_FSM; }
+        int K()  const { return d_K; }
+        int S0()  const { return d_S0; }
+        int SK()  const { return d_SK; }
+        std::string kernel()  const { return d_kernel->name; }
+
+        int pool_size() const;
+
+        void set_S0(int S0);
+        void set_SK(int SK);
+        void set_pool_size(int n_threads);
+
+        void forecast (int noutput_items, gr_vector_int &ninput_items_required);
+
+        int general_work(int noutput_items, gr_vector_int &ninput_items,
+            gr_vector_const_void_star &input_items, gr_vector_void_star &output_items);
+
+        void viterbi_algorithm(int K, int S0, int SK, const float *in,
+            unsigned char *out, workspace &ws);
+
+        //Scratch buffers of a worker of the decode pool
+        workspace &get_workspace(int worker);
+    };
+
+  } // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_VITERBI_BUTTERFLY_IMPL_H */
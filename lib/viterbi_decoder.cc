@@ -0,0 +1,214 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include "viterbi_decoder.h"
+#include "block_timer.h"
+
+namespace gr {
+  namespace lazyviterbi {
+
+    decoder::sptr
+    decoder::make_viterbi(const compiled_trellis::sptr &trellis, int S0, int SK)
+    {
+      return decoder::sptr(new viterbi_decoder(trellis, S0, SK));
+    }
+
+    viterbi_decoder::viterbi_decoder(const compiled_trellis::sptr &trellis,
+        int S0, int SK)
+      : decoder(trellis, S0, SK)
+    {
+      //Use a compile-time specialized decoder if the trellis has a common shape
+      d_shape = find_viterbi_shape(*d_trellis);
+    }
+
+    decoder::workspace_sptr
+    viterbi_decoder::make_workspace(size_t K, huge_pages_t huge_pages) const
+    {
+      boost::shared_ptr<workspace> ws(new workspace(huge_pages));
+      carve_workspace(*ws, K, scratch_arena::sptr(
+            new scratch_arena(workspace_bytes(K), huge_pages)));
+
+      return ws;
+    }
+
+    size_t
+    viterbi_decoder::workspace_bytes(size_t K) const
+    {
+      const int S = d_trellis->S();
+
+      return 2*scratch_arena::bytes<float>(S)
+        + scratch_arena::bytes<uint16_t>(S)
+        + scratch_arena::bytes<uint64_t>(
+            survivor_store::words(K, S, d_trellis->max_size_PS_s()));
+    }
+
+    void
+    viterbi_decoder::carve_workspace(workspace &ws, size_t K,
+        const scratch_arena::sptr &arena) const
+    {
+      const int S = d_trellis->S();
+      const size_t max_size_PS_s = d_trellis->max_size_PS_s();
+
+      ws.arena = arena;
+      ws.alpha_prev = arena->alloc<float>(S);
+      ws.alpha_curr = arena->alloc<float>(S);
+      ws.decisions = arena->alloc<uint16_t>(S);
+      ws.trace = survivor_store(K, S, max_size_PS_s, arena->alloc<uint64_t>(
+            survivor_store::words(K, S, max_size_PS_s)));
+      ws.K = K;
+    }
+
+    void
+    viterbi_decoder::decode(const float *metrics, size_t K, int S0, int SK,
+        uint8_t *out, decoder::workspace &ws) const
+    {
+      workspace *vws = dynamic_cast<workspace*>(&ws);
+      if(!vws) {
+        throw std::invalid_argument("viterbi: workspace made by another decoder");
+      }
+
+      viterbi_algorithm(K, S0, SK, metrics, out, *vws);
+    }
+
+    void
+    viterbi_decoder::viterbi_algorithm(int K, int S0, int SK, const float *in,
+        unsigned char *out, workspace &ws) const
+    {
+      const compiled_trellis &T = *d_trellis;
+      const int S = T.S();
+      const int O = T.O();
+
+      block_timer timer(ws.stats, K);
+
+      //Blocks whose hard decisions form a path need no search
+      if(try_fast_path(in, K, S0, SK, out, ws)) {
+        return;
+      }
+
+      //Longer blocks than the workspace was made for
+      if(K > ws.K) {
+        carve_workspace(ws, K, scratch_arena::sptr(
+              new scratch_arena(workspace_bytes(K), ws.huge_pages)));
+      }
+
+      if(d_shape) {
+        d_shape->decode(T.PS(), T.PI(), T.OS(), K, S0, SK, in, out,
+            ws.decisions, ws.trace);
+        return;
+      }
+
+      int tb_state, pidx;
+      float can_metric = std::numeric_limits<float>::max();
+      float min_metric = std::numeric_limits<float>::max();
+
+      const int *offsets = T.offsets();
+      const int *PS = T.PS();
+      const int *ordered_OS = T.OS();
+      int k = 0;
+
+      //If initial state was specified
+      if(S0 != -1) {
+        std::fill(ws.alpha_prev, ws.alpha_prev + S,
+            std::numeric_limits<float>::max());
+        ws.alpha_prev[S0] = 0.0;
+      }
+      else {
+        std::fill(ws.alpha_prev, ws.alpha_prev + S, 0.0);
+      }
+
+      for(const float* in_k=in ; in_k < in + K*O ; in_k += O) {
+        //Reset minimum metric (used for normalization)
+        min_metric = std::numeric_limits<float>::max();
+
+        //For each state
+        for(int s=0 ; s < S ; ++s) {
+          //Branches yielding to s: [b0, b1)
+          int b0 = offsets[s];
+          int b1 = offsets[s + 1];
+          float metric;
+          uint16_t decision = 0;
+
+          //Pre-loop
+          //metric = alpha_prev[PS[s][0]] + in_k[OS[PS[s][0]*I + PI[s][0]]];
+          metric = ws.alpha_prev[PS[b0]] + in_k[ordered_OS[b0]];
+
+          //Loop
+          for(int b=b0+1 ; b < b1 ; ++b) {
+            //ADD
+            can_metric = ws.alpha_prev[PS[b]] + in_k[ordered_OS[b]];
+
+            //COMPARE
+            if(can_metric < metric) {
+              //SELECT
+              metric = can_metric;
+
+              //Store previous input index for traceback
+              decision = b - b0;
+            }
+          }
+
+          ws.alpha_curr[s] = metric;
+          ws.decisions[s] = decision;
+          min_metric = (metric < min_metric) ? metric : min_metric;
+        }
+
+        //Pack decisions of this time index
+        ws.trace.pack_row(k++, ws.decisions);
+
+        //Metrics normalization
+        std::transform(ws.alpha_curr, ws.alpha_curr + S, ws.alpha_curr,
+            std::bind2nd(std::minus<float>(), min_metric));
+
+        //At this point, current path metrics becomes previous path metrics
+        std::swap(ws.alpha_prev, ws.alpha_curr);
+      }
+
+      //If final state was specified
+      if(SK != -1) {
+        tb_state = SK;
+      }
+      else{
+        //at this point, alpha_prev contains the path metrics of states after time K
+        tb_state = (int)(std::min_element(ws.alpha_prev, ws.alpha_prev + S) - ws.alpha_prev);
+      }
+
+      //Traceback
+      for(unsigned char* out_k = out+K-1 ; out_k >= out ; --out_k) {
+        //Retrieve previous input index from trace
+        pidx = ws.trace.get(out_k - out, tb_state);
+
+        //Output previous input
+        *out_k = (unsigned char) T.PI(tb_state, pidx);
+
+        //Update tb_state with the previous state on the shortest path
+        tb_state = T.PS(tb_state, pidx);
+      }
+    }
+
+  } /* namespace lazyviterbi */
+} /* namespace gr */
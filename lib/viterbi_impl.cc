@@ -22,8 +22,11 @@
 #include "config.h"
 #endif
 
+#include <stdexcept>
 #include <gnuradio/io_signature.h>
+#include <boost/bind.hpp>
 #include "viterbi_impl.h"
+#include "decode_pool.h"
 
 namespace gr {
   namespace lazyviterbi {
@@ -35,48 +38,101 @@ namespace gr {
         (new viterbi_impl(FSM, K, S0, SK));
     }
 
+    viterbi::sptr
+    viterbi::make_from_file(const std::string &trellis_file, int K, int S0,
+        int SK)
+    {
+      return gnuradio::get_initial_sptr
+        (new viterbi_impl(compiled_trellis::load(trellis_file), K, S0, SK));
+    }
+
     /*
      * The private constructor
      */
     viterbi_impl::viterbi_impl(const gr::trellis::fsm &FSM, int K, int S0, int SK)
+      : viterbi_impl(compiled_trellis::get(FSM), K, S0, SK)
+    {
+    }
+
+    viterbi_impl::viterbi_impl(const compiled_trellis::sptr &trellis,
+        int K, int S0, int SK)
       : gr::block("viterbi",
               gr::io_signature::make(1, -1, sizeof(float)),
               gr::io_signature::make(1, -1, sizeof(char))),
-        d_FSM(FSM), d_K(K), d_ordered_OS(FSM.S()*FSM.I()),
-        d_alpha_prev(FSM.S()), d_alpha_curr(FSM.S()), d_trace(K*FSM.S())
+        d_K(K), d_workspaces(decode_pool::MAX_WORKERS)
     {
       //S0 and SK must represent a state of the trellis
-      if(S0 >= 0 || S0 < d_FSM.S()) {
+      if(S0 >= 0 || S0 < trellis->S()) {
         d_S0 = S0;
       }
       else {
         d_S0 = -1;
       }
 
-      if(SK >= K || SK < d_FSM.S()) {
+      if(SK >= K || SK < trellis->S()) {
         d_SK = SK;
       }
       else {
         d_SK = -1;
       }
 
-      int I = d_FSM.I();
-      int S = d_FSM.S();
-      std::vector< std::vector<int> > PS = d_FSM.PS();
-      std::vector< std::vector<int> > PI = d_FSM.PI();
-      std::vector<int> OS = d_FSM.OS();
+      d_decoder.reset(new viterbi_decoder(trellis, d_S0, d_SK));
+
+      set_relative_rate(1.0 / ((double)trellis->O()));
+      set_output_multiple(d_K);
+
+      message_port_register_out(stats_port());
+    }
+
+    int
+    viterbi_impl::pool_size() const
+    {
+      return decode_pool::instance().size();
+    }
+
+    void
+    viterbi_impl::set_pool_size(int n_threads)
+    {
+      decode_pool::instance().set_size(n_threads);
+    }
 
-      //Compute ordered_OS
-      std::vector<int>::iterator ordered_OS_it = d_ordered_OS.begin();
+    pmt::pmt_t
+    viterbi_impl::stats()
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      return stats_to_pmt(sum_stats(d_workspaces));
+    }
 
-      for(int s=0 ; s < S ; ++s) {
-        for(size_t i=0 ; i<(PS[s]).size() ; ++i) {
-          *(ordered_OS_it++) = OS[PS[s][i]*I + PI[s][i]];
-        }
+    void
+    viterbi_impl::reset_stats()
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      clear_stats(d_workspaces);
+    }
+
+    void
+    viterbi_impl::set_stats_period(double period)
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      d_stats_schedule.set_period(period);
+    }
+
+    void
+    viterbi_impl::set_fast_path(bool fast_path)
+    {
+      gr::thread::scoped_lock guard(d_setlock);
+      d_decoder->set_fast_path(fast_path);
+    }
+
+    viterbi_impl::workspace &
+    viterbi_impl::get_workspace(int worker)
+    {
+      if(!d_workspaces[worker]) {
+        d_workspaces[worker] = boost::static_pointer_cast<workspace>(
+            d_decoder->make_workspace(d_K));
       }
 
-      set_relative_rate(1.0 / ((double)d_FSM.O()));
-      set_output_multiple(d_K);
+      return *d_workspaces[worker];
     }
 
     void
@@ -96,7 +152,7 @@ namespace gr {
     void
     viterbi_impl::forecast(int noutput_items, gr_vector_int &ninput_items_required)
     {
-      int input_required =  d_FSM.O() * noutput_items;
+      int input_required =  d_decoder->trellis()->O() * noutput_items;
       unsigned ninputs = ninput_items_required.size();
       for(unsigned int i = 0; i < ninputs; i++) {
         ninput_items_required[i] = input_required;
@@ -113,125 +169,49 @@ namespace gr {
       int nstreams = input_items.size();
       int nblocks = noutput_items / d_K;
 
-      for(int m = 0; m < nstreams; m++) {
-        const float *in = (const float*)input_items[m];
-        unsigned char *out = (unsigned char*)output_items[m];
+      //One job per stream and per block
+      decode_pool::instance().run(nstreams*nblocks,
+          boost::bind(&viterbi_impl::decode_block, this, boost::cref(input_items),
+            boost::ref(output_items), nblocks, _1, _2));
 
-        for(int n = 0; n < nblocks; n++) {
-          viterbi_algorithm(d_FSM.I(), d_FSM.S(), d_FSM.O(), d_FSM.NS(),
-              d_ordered_OS, d_FSM.PS(), d_FSM.PI(), d_K, d_S0, d_SK,
-              &(in[n*d_K*d_FSM.O()]), &(out[n*d_K]));
-        }
+      if(d_stats_schedule.due()) {
+        message_port_pub(stats_port(), stats_to_pmt(sum_stats(d_workspaces)));
       }
 
-      consume_each(d_FSM.O() * noutput_items);
+      consume_each(d_decoder->trellis()->O() * noutput_items);
       return noutput_items;
     }
 
     void
-    viterbi_impl::viterbi_algorithm(int I, int S, int O, const std::vector<int> &NS,
-        const std::vector<int> &ordered_OS, const std::vector< std::vector<int> > &PS,
-        const std::vector< std::vector<int> > &PI, int K, int S0, int SK,
-        const float *in, unsigned char *out)
+    viterbi_impl::decode_block(const gr_vector_const_void_star &input_items,
+        gr_vector_void_star &output_items, int nblocks, int job, int worker)
     {
-      int tb_state, pidx;
-      float can_metric = std::numeric_limits<float>::max();
-      float min_metric = std::numeric_limits<float>::max();
-
-      std::vector<float>::iterator alpha_curr_it;
-      std::vector<int>::const_iterator PS_it;
-      std::vector<int>::iterator trace_it = d_trace.begin();
-      std::vector<int>::const_iterator ordered_OS_it = ordered_OS.begin();
-
-      //Initialize traceback vector
-      std::fill(d_trace.begin(), d_trace.end(), 0);
-
-      //If initial state was specified
-      if(S0 != -1) {
-        std::fill(d_alpha_prev.begin(), d_alpha_prev.end(),
-            std::numeric_limits<float>::max());
-        d_alpha_prev[S0] = 0.0;
-      }
-      else {
-        std::fill(d_alpha_prev.begin(), d_alpha_prev.end(), 0.0);
-      }
-
-      for(float* in_k=(float*)in ; in_k < (float*)in + K*O ; in_k += O) {
-        //Current path metric iterator
-        alpha_curr_it = d_alpha_curr.begin();
-        ordered_OS_it = ordered_OS.begin();
-
-        //Reset minimum metric (used for normalization)
-        min_metric = std::numeric_limits<float>::max();
-
-        //For each state
-        for(std::vector< std::vector<int> >::const_iterator PS_s = PS.begin() ;
-              PS_s != PS.end() ; ++PS_s) {
-          //Iterators for previous state
-          PS_it=(*PS_s).begin();
-
-          //Pre-loop
-          //*d_alpha_curr_it = alpha_prev[PS[s][i]] + in_k[OS[PS[s][i]*I + PI[s][i]]];
-          *alpha_curr_it = d_alpha_prev[*(PS_it++)] + in_k[*(ordered_OS_it++)];
-          min_metric = (*alpha_curr_it < min_metric)?*alpha_curr_it:min_metric;
-
-          //Loop
-          for(size_t i=1 ; i< (*PS_s).size() ; ++i) {
-            //ADD
-            //can_metric = alpha_prev[PS[s][i]] + in_k[OS[PS[s][i]*I + PI[s][i]]];
-            can_metric = d_alpha_prev[*(PS_it++)] + in_k[*(ordered_OS_it++)];
-
-            //COMPARE
-            if(can_metric < *alpha_curr_it) {
-              //SELECT
-              *alpha_curr_it = can_metric;
-              min_metric = (*alpha_curr_it < min_metric)?*alpha_curr_it:min_metric;
-
-              //Store previous input index for traceback
-              *trace_it = i;
-            }
-          }
-
-          //Update iterators
-          ++trace_it;
-          ++alpha_curr_it;
-        }
-
-        //Metrics normalization
-        std::transform(d_alpha_curr.begin(), d_alpha_curr.end(),
-            d_alpha_curr.begin(),
-            std::bind2nd(std::minus<float>(), min_metric));
-
-        //At this point, current path metrics becomes previous path metrics
-        d_alpha_prev.swap(d_alpha_curr);
-      }
+      int m = job / nblocks;
+      int n = job % nblocks;
+      const float *in = (const float*)input_items[m];
+      unsigned char *out = (unsigned char*)output_items[m];
+
+      d_decoder->viterbi_algorithm(d_K, d_S0, d_SK,
+          &(in[n*d_K*d_decoder->trellis()->O()]), &(out[n*d_K]),
+          get_workspace(worker));
+    }
 
-      //If final state was specified
-      if(SK != -1) {
-        tb_state = SK;
-      }
-      else{
-        //at this point, alpha_prev contains the path metrics of states after time K
-        tb_state = (int)(min_element(d_alpha_prev.begin(), d_alpha_prev.end()) - d_alpha_prev.begin());
+    void
+    viterbi_impl::viterbi_algorithm(int I, int S, int O,
+        const std::vector<int> &NS, const std::vector<int> &OS,
+        const std::vector< std::vector<int> > &/*PS*/,
+        const std::vector< std::vector<int> > &/*PI*/, int K, int S0, int SK,
+        const float *in, unsigned char *out)
+    {
+      //PS and PI are unused (the compiled trellis of the block has its own
+      //tables of predecessors): they are only kept for API compatibility
+      //Flat tables and scratch buffers are those of the trellis of the block
+      if(!d_decoder->trellis()->describes(I, S, O, NS, OS)) {
+        throw std::invalid_argument("viterbi: trellis differs from the one of the block");
       }
 
-      //Traceback
-      trace_it = d_trace.end() - S; //place trace_it at the last time index
-
-      for(unsigned char* out_k = out+K-1 ; out_k >= out ; --out_k) {
-        //Retrieve previous input index from trace
-        pidx=*(trace_it + tb_state);
-        //Update trace_it for next output symbol
-        trace_it -= S;
-
-        //Output previous input
-        *out_k = (unsigned char) PI[tb_state][pidx];
-
-        //Update tb_state with the previous state on the shortest path
-        tb_state = PS[tb_state][pidx];
-      }
+      d_decoder->viterbi_algorithm(K, S0, SK, in, out, get_workspace(0));
     }
 
   } /* namespace lazyviterbi */
 } /* namespace gr */
-
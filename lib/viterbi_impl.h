@@ -22,39 +22,54 @@
 #define INCLUDED_LAZYVITERBI_VITERBI_IMPL_H
 
 #include <lazyviterbi/viterbi.h>
+#include <boost/shared_ptr.hpp>
+#include "viterbi_decoder.h"
+#include "decode_stats.h"
 
 namespace gr {
   namespace lazyviterbi {
 
     class viterbi_impl : public viterbi
     {
+      public:
+        typedef viterbi_decoder::workspace workspace;
+
       private:
-        gr::trellis::fsm d_FSM; //Trellis description
         int d_K;                //Number of trellis sections
         int d_S0;               //Initial state idx (-1 if unknown)
         int d_SK;               //Final state idx (-1 if unknown)
 
-        //Same as d_FSM.OS(), but re-ordered in the following way:
-        //d_ordered_OS[s*I+i] = d_FSM.OS()[d_FSM.PS()[s][i]*I + d_FSM.PI()[s][i]]
-        std::vector<int> d_ordered_OS;
+        //Decoder of the blocks (shared by the workers of the decode pool)
+        boost::shared_ptr<viterbi_decoder> d_decoder;
+
+        std::vector< boost::shared_ptr<workspace> > d_workspaces;
 
-        //Store current state metrics
-        std::vector<float> d_alpha_prev;
-        //Store next state metrics
-        std::vector<float> d_alpha_curr;
-        //Traceback vector
-        std::vector<int> d_trace;
+        //Publication of the counters of the workspaces
+        stats_schedule d_stats_schedule;
+
+        void decode_block(const gr_vector_const_void_star &input_items,
+            gr_vector_void_star &output_items, int nblocks, int job, int worker);
 
       public:
         viterbi_impl(const gr::trellis::fsm &FSM, int K, int S0, int SK);
+        viterbi_impl(const compiled_trellis::sptr &trellis, int K, int S0, int SK);
 
-        gr::trellis::fsm FSM() const  { return d_FSM; }
+        gr::trellis::fsm FSM() const  { return d_decoder->trellis()->fsm(); }
         int K()  const { return d_K; }
         int S0()  const { return d_S0; }
         int SK()  const { return d_SK; }
 
+        int pool_size() const;
+        pmt::pmt_t stats();
+        double stats_period() const { return d_stats_schedule.period(); }
+        bool fast_path() const { return d_decoder->fast_path(); }
+
         void set_S0(int S0);
         void set_SK(int SK);
+        void set_pool_size(int n_threads);
+        void reset_stats();
+        void set_stats_period(double period);
+        void set_fast_path(bool fast_path);
 
         void forecast (int noutput_items, gr_vector_int &ninput_items_required);
 
@@ -62,9 +77,12 @@ namespace gr {
             gr_vector_const_void_star &input_items, gr_vector_void_star &output_items);
 
         void viterbi_algorithm(int I, int S, int O, const std::vector<int> &NS,
-            const std::vector<int> &ordered_OS, const std::vector< std::vector<int> > &PS,
+            const std::vector<int> &OS, const std::vector< std::vector<int> > &PS,
             const std::vector< std::vector<int> > &PI, int K, int S0, int SK,
             const float *in, unsigned char *out);
+
+        //Scratch buffers of a worker of the decode pool
+        workspace &get_workspace(int worker);
     };
 
   } // namespace lazyviterbi
@@ -0,0 +1,156 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <limits>
+#include "viterbi_kernels.h"
+
+namespace gr {
+namespace lazyviterbi {
+
+  template <int I, int S, int O>
+  static void
+  viterbi_shape_decode(const int *PS, const int *PI, const int *OS, int K,
+      int S0, int SK, const float *in, unsigned char *out, uint16_t *decisions,
+      survivor_store &trace)
+  {
+    int ps[S*I], os[S*I];
+    float alpha[2][S];
+    float m[O];
+    int tb_state, pidx;
+
+    std::copy(PS, PS + S*I, ps);
+    std::copy(OS, OS + S*I, os);
+
+    //If initial state was specified
+    if(S0 != -1) {
+      std::fill(alpha[0], alpha[0] + S, std::numeric_limits<float>::max());
+      alpha[0][S0] = 0.0;
+    }
+    else {
+      std::fill(alpha[0], alpha[0] + S, 0.0f);
+    }
+
+    for(int k=0 ; k < K ; ++k) {
+      const float *alpha_prev = alpha[k & 1];
+      float *alpha_curr = alpha[(k + 1) & 1];
+
+      std::copy(in + k*O, in + (k + 1)*O, m);
+
+      //ADD, COMPARE and SELECT (the first branch wins ties)
+      for(int s=0 ; s < S ; ++s) {
+        float best = alpha_prev[ps[s*I]] + m[os[s*I]];
+        uint16_t d = 0;
+
+        for(int i=1 ; i < I ; ++i) {
+          float can_metric = alpha_prev[ps[s*I + i]] + m[os[s*I + i]];
+          d = (can_metric < best) ? i : d;
+          best = (can_metric < best) ? can_metric : best;
+        }
+
+        alpha_curr[s] = best;
+        decisions[s] = d;
+      }
+
+      //Pack decisions of this time index
+      trace.pack_row(k, decisions);
+
+      //Metrics normalization
+      float min_metric = alpha_curr[0];
+      for(int s=1 ; s < S ; ++s) {
+        min_metric = (alpha_curr[s] < min_metric) ? alpha_curr[s] : min_metric;
+      }
+      for(int s=0 ; s < S ; ++s) {
+        alpha_curr[s] -= min_metric;
+      }
+    }
+
+    //If final state was specified
+    if(SK != -1) {
+      tb_state = SK;
+    }
+    else {
+      const float *alpha_K = alpha[K & 1];
+      tb_state = (int)(std::min_element(alpha_K, alpha_K + S) - alpha_K);
+    }
+
+    //Traceback
+    for(int k=K-1 ; k >= 0 ; --k) {
+      pidx = trace.get(k, tb_state);
+
+      //Output previous input
+      out[k] = (unsigned char) PI[tb_state*I + pidx];
+
+      //Update tb_state with the previous state on the shortest path
+      tb_state = ps[tb_state*I + pidx];
+    }
+  }
+
+#define LV_VITERBI_SHAPE(I, S, O) { I, S, O, &viterbi_shape_decode<I, S, O> }
+
+  const std::vector<viterbi_shape> &
+  viterbi_shapes()
+  {
+    static const viterbi_shape shapes[] = {
+      LV_VITERBI_SHAPE(2, 4, 4),
+      LV_VITERBI_SHAPE(2, 8, 4),
+      LV_VITERBI_SHAPE(2, 16, 4),
+      LV_VITERBI_SHAPE(2, 32, 4),
+      LV_VITERBI_SHAPE(2, 64, 4),
+      LV_VITERBI_SHAPE(2, 128, 4),
+      LV_VITERBI_SHAPE(2, 256, 4),
+      LV_VITERBI_SHAPE(2, 4, 8),
+      LV_VITERBI_SHAPE(2, 8, 8),
+      LV_VITERBI_SHAPE(2, 16, 8),
+      LV_VITERBI_SHAPE(2, 64, 8),
+      LV_VITERBI_SHAPE(2, 256, 8)
+    };
+    static const std::vector<viterbi_shape> list(shapes,
+        shapes + sizeof(shapes)/sizeof(shapes[0]));
+
+    return list;
+  }
+
+#undef LV_VITERBI_SHAPE
+
+  const viterbi_shape *
+  find_viterbi_shape(const compiled_trellis &trellis)
+  {
+    if(!trellis.is_regular()) {
+      return NULL;
+    }
+
+    const std::vector<viterbi_shape> &shapes = viterbi_shapes();
+    for(size_t n=0 ; n < shapes.size() ; ++n) {
+      if(shapes[n].I == trellis.I() && shapes[n].S == trellis.S()
+          && shapes[n].O == trellis.O()) {
+        return &shapes[n];
+      }
+    }
+
+    return NULL;
+  }
+
+} // namespace lazyviterbi
+} // namespace gr
@@ -0,0 +1,74 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2017-2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_VITERBI_KERNELS_H
+#define INCLUDED_LAZYVITERBI_VITERBI_KERNELS_H
+
+#include <lazyviterbi/api.h>
+#include <stdint.h>
+#include <vector>
+#include <lazyviterbi/compiled_trellis.h>
+#include "survivor_store.h"
+
+namespace gr {
+namespace lazyviterbi {
+
+  /*!
+   * \brief Classical Viterbi algorithm on a trellis of a fixed shape.
+   *
+   * Every state has exactly I branches yielding to it: the one of index i
+   * comes from state PS[s*I + i] with input PI[s*I + i], and output symbol
+   * OS[s*I + i]. Decisions of each section go through \p decisions (S items)
+   * to \p trace. Same results as viterbi_decoder::viterbi_algorithm().
+   */
+  typedef void (*viterbi_shape_kernel)(const int *PS, const int *PI,
+      const int *OS, int K, int S0, int SK, const float *in, unsigned char *out,
+      uint16_t *decisions, survivor_store &trace);
+
+  /*!
+   * \brief One instantiation of the classical Viterbi algorithm, specialized
+   * for a trellis shape: trip counts are compile-time constants, and tables
+   * and path metrics live on the stack.
+   */
+  struct viterbi_shape
+  {
+    //! Number of inputs, states and output symbols of the trellis.
+    int I, S, O;
+    //! Decoding function.
+    viterbi_shape_kernel decode;
+  };
+
+  /*!
+   * \brief Every trellis shape with a specialized instantiation (binary codes
+   * of rate 1/2 and 1/3 with 4 to 256 states).
+   */
+  const std::vector<viterbi_shape> &viterbi_shapes();
+
+  /*!
+   * \brief Instantiation matching the shape of \p trellis, or NULL if there is
+   * none (or if the trellis is not regular): its flat tables are then the
+   * PS, PI and OS tables of the instantiation.
+   */
+  const viterbi_shape *find_viterbi_shape(const compiled_trellis &trellis);
+
+} // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_VITERBI_KERNELS_H */
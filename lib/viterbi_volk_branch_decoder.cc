@@ -0,0 +1,211 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <volk/volk.h>
+#include "viterbi_volk_branch_decoder.h"
+#include "block_timer.h"
+#include "gather_kernels.h"
+
+namespace gr {
+  namespace lazyviterbi {
+
+    decoder::sptr
+    decoder::make_viterbi_volk_branch(const compiled_trellis::sptr &trellis,
+        int S0, int SK)
+    {
+      return decoder::sptr(new viterbi_volk_branch_decoder(trellis, S0, SK));
+    }
+
+    viterbi_volk_branch_decoder::viterbi_volk_branch_decoder(
+        const compiled_trellis::sptr &trellis, int S0, int SK)
+      : decoder(trellis, S0, SK)
+    {
+    }
+
+    decoder::workspace_sptr
+    viterbi_volk_branch_decoder::make_workspace(size_t K,
+        huge_pages_t huge_pages) const
+    {
+      boost::shared_ptr<workspace> ws(new workspace(huge_pages));
+      carve_workspace(*ws, K, scratch_arena::sptr(
+            new scratch_arena(workspace_bytes(K), huge_pages)));
+
+      return ws;
+    }
+
+    size_t
+    viterbi_volk_branch_decoder::workspace_bytes(size_t K) const
+    {
+      const int S = d_trellis->S();
+
+      return 2*scratch_arena::bytes<float>(S)
+        + scratch_arena::bytes<float>(d_trellis->n_branches())
+        + scratch_arena::bytes<uint16_t>(S)
+        + scratch_arena::bytes<uint64_t>(
+            survivor_store::words(K, S, d_trellis->max_size_PS_s()));
+    }
+
+    void
+    viterbi_volk_branch_decoder::carve_workspace(workspace &ws, size_t K,
+        const scratch_arena::sptr &arena) const
+    {
+      const int S = d_trellis->S();
+      const size_t max_size_PS_s = d_trellis->max_size_PS_s();
+
+      ws.arena = arena;
+      ws.alpha_curr = arena->alloc<float>(S);
+      ws.alpha_prev = arena->alloc<float>(S);
+      ws.can_metrics = arena->alloc<float>(d_trellis->n_branches());
+      ws.decisions = arena->alloc<uint16_t>(S);
+      ws.trace = survivor_store(K, S, max_size_PS_s, arena->alloc<uint64_t>(
+            survivor_store::words(K, S, max_size_PS_s)));
+      ws.K = K;
+    }
+
+    void
+    viterbi_volk_branch_decoder::decode(const float *metrics, size_t K, int S0,
+        int SK, uint8_t *out, decoder::workspace &ws) const
+    {
+      workspace *vws = dynamic_cast<workspace*>(&ws);
+      if(!vws) {
+        throw std::invalid_argument("viterbi_volk_branch: workspace made by another decoder");
+      }
+
+      viterbi_algorithm_volk_branch(K, S0, SK, metrics, out, *vws);
+    }
+
+    void
+    viterbi_volk_branch_decoder::compute_all_metrics(const float *alpha_prev,
+        const float *in_k, float *can_metrics) const
+    {
+      best_gather_kernel().gather_sub(alpha_prev, in_k, d_trellis->O(),
+          d_trellis->PS(), d_trellis->OS(), can_metrics,
+          d_trellis->n_branches());
+    }
+
+    //Volk optimized implementation adapted when the number of branch between
+    //pairs of states is greater than the number of states.
+    void
+    viterbi_volk_branch_decoder::viterbi_algorithm_volk_branch(int K, int S0,
+        int SK, const float *in, unsigned char *out, workspace &ws) const
+    {
+      const compiled_trellis &T = *d_trellis;
+      const int S = T.S();
+      const int O = T.O();
+      const int *offsets = T.offsets();
+
+      block_timer timer(ws.stats, K);
+
+      //Blocks whose hard decisions form a path need no search
+      if(try_fast_path(in, K, S0, SK, out, ws)) {
+        return;
+      }
+
+      //Longer blocks than the workspace was made for
+      if(K > ws.K) {
+        carve_workspace(ws, K, scratch_arena::sptr(
+              new scratch_arena(workspace_bytes(K), ws.huge_pages)));
+      }
+
+      int tb_state, pidx;
+      size_t n_branch_state = 0;
+      uint32_t max_idx = 0;
+
+      float *alpha_curr_it;
+      float *can_metrics_it = ws.can_metrics;
+      uint32_t branch_idx;
+      int k = 0;
+
+      //If initial state was specified
+      if(S0 != -1) {
+        std::fill(ws.alpha_prev, ws.alpha_prev + S,
+            -std::numeric_limits<float>::max());
+        ws.alpha_prev[S0] = 0.0;
+      }
+      else {
+        std::fill(ws.alpha_prev, ws.alpha_prev + S, 0.0);
+      }
+
+      for(float* in_k=(float*)in ; in_k < (float*)in + K*O ; in_k += O) {
+        //ADD
+        compute_all_metrics(ws.alpha_prev, in_k, ws.can_metrics);
+
+        alpha_curr_it = ws.alpha_curr;
+        //COMPARE
+        for(int s = 0 ; s < S ; ++s) {
+          n_branch_state = offsets[s + 1] - offsets[s];
+
+          volk_32f_index_max_32u(&branch_idx, can_metrics_it, n_branch_state);
+
+          //SELECT
+          *(alpha_curr_it++) = can_metrics_it[branch_idx];
+          ws.decisions[s] = (uint16_t)branch_idx;
+
+          //Update pointer
+          can_metrics_it += n_branch_state;
+        }
+
+        //Pack decisions of this time index
+        ws.trace.pack_row(k++, ws.decisions);
+
+        //At this point, current path metrics becomes previous path metrics
+        std::swap(ws.alpha_prev, ws.alpha_curr);
+
+        //Metrics normalization
+        volk_32f_index_max_32u(&max_idx, ws.alpha_prev, S);
+        std::transform(ws.alpha_prev, ws.alpha_prev + S, ws.alpha_prev,
+            std::bind2nd(std::minus<float>(), ws.alpha_prev[max_idx]));
+
+        //Update iterators
+        can_metrics_it = ws.can_metrics;
+      }
+
+      //If final state was specified
+      if(SK != -1) {
+        tb_state = SK;
+      }
+      else{
+        //at this point, ws.alpha_prev contains the path metrics of states after time K
+        tb_state = (int)max_idx;
+      }
+
+      //Traceback
+      for(unsigned char* out_k = out+K-1 ; out_k >= out ; --out_k) {
+        //Retrieve previous input index from trace
+        pidx = ws.trace.get(out_k - out, tb_state);
+
+        //Output previous input
+        *out_k = (unsigned char) T.PI(tb_state, pidx);
+
+        //Update tb_state with the previous state on the shortest path
+        tb_state = T.PS(tb_state, pidx);
+      }
+    }
+
+  } /* namespace lazyviterbi */
+} /* namespace gr */
@@ -0,0 +1,87 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_VITERBI_VOLK_BRANCH_DECODER_H
+#define INCLUDED_LAZYVITERBI_VITERBI_VOLK_BRANCH_DECODER_H
+
+#include <lazyviterbi/decoder.h>
+#include "scratch_arena.h"
+#include "survivor_store.h"
+
+namespace gr {
+  namespace lazyviterbi {
+
+    //Classical Viterbi algorithm, branches yielding to each state being
+    //processed in parallel (decoder of the viterbi_volk_branch block)
+    class viterbi_volk_branch_decoder : public decoder
+    {
+      public:
+        //Scratch buffers of the algorithm
+        struct workspace : public decoder::workspace
+        {
+          //Number of sections the buffers are sized for
+          int K;
+          //Backing of the arena, kept to grow it
+          decoder::huge_pages_t huge_pages;
+          //Memory of the buffers below
+          scratch_arena::sptr arena;
+          //Store current state metrics
+          float *alpha_curr;
+          //Store next state metrics
+          float *alpha_prev;
+          //Store next state candidate metrics
+          float *can_metrics;
+          //Decisions of the current time index, before packing
+          uint16_t *decisions;
+          //Traceback vector
+          survivor_store trace;
+
+          workspace(decoder::huge_pages_t huge_pages)
+            : K(0), huge_pages(huge_pages), alpha_curr(NULL),
+            alpha_prev(NULL), can_metrics(NULL), decisions(NULL) {}
+        };
+
+      private:
+        void compute_all_metrics(const float *alpha_prev, const float *in_k,
+            float *can_metrics) const;
+
+      public:
+        viterbi_volk_branch_decoder(const compiled_trellis::sptr &trellis,
+            int S0, int SK);
+
+        decoder::workspace_sptr make_workspace(size_t K,
+            huge_pages_t huge_pages=HUGE_PAGES_TRANSPARENT) const;
+        size_t workspace_bytes(size_t K) const;
+
+        //Carve the buffers of ws for K sections from arena
+        void carve_workspace(workspace &ws, size_t K,
+            const scratch_arena::sptr &arena) const;
+
+        void decode(const float *metrics, size_t K, int S0, int SK,
+            uint8_t *out, decoder::workspace &ws) const;
+
+        void viterbi_algorithm_volk_branch(int K, int S0, int SK,
+            const float *in, unsigned char *out, workspace &ws) const;
+    };
+
+  } // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_VITERBI_VOLK_BRANCH_DECODER_H */
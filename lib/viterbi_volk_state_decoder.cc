@@ -0,0 +1,599 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <volk/volk.h>
+#include <boost/bind.hpp>
+#include "viterbi_volk_state_decoder.h"
+#include "block_timer.h"
+#include "acs_kernels.h"
+#include "gather_kernels.h"
+#include "metrics_quantizer.h"
+#include "quantize_kernels.h"
+
+namespace gr {
+  namespace lazyviterbi {
+
+    decoder::sptr
+    decoder::make_viterbi_volk_state(const compiled_trellis::sptr &trellis,
+        int S0, int SK, int acs_threads, int metric_bits)
+    {
+      return decoder::sptr(new viterbi_volk_state_decoder(trellis, S0, SK,
+            acs_threads, metric_bits));
+    }
+
+    viterbi_volk_state_decoder::viterbi_volk_state_decoder(
+        const compiled_trellis::sptr &trellis, int S0, int SK, int acs_threads,
+        int metric_bits)
+      : decoder(trellis, S0, SK), d_acs_threads(acs_threads)
+    {
+      const compiled_trellis &T = *d_trellis;
+      int S = T.S();
+
+      d_max_size_PS_s = T.max_size_PS_s();
+
+      //Missing branches (states with less than d_max_size_PS_s previous
+      //states) come from state S, a sentinel path metric of -infinity: the
+      //ADD stage needs no special case, and these branches never survive
+      d_ordered_OS.resize(d_max_size_PS_s*S);
+      d_ordered_PS.resize(d_max_size_PS_s*S);
+      std::vector<int>::iterator ordered_OS_it = d_ordered_OS.begin();
+      std::vector<int>::iterator ordered_PS_it = d_ordered_PS.begin();
+
+      for(size_t i=0 ; i<d_max_size_PS_s ; ++i) {
+        for(int s=0 ; s < S ; ++s) {
+          if ((int)i < T.offsets()[s + 1] - T.offsets()[s]) {
+            *(ordered_OS_it++) = T.OS()[T.offsets()[s] + i];
+            *(ordered_PS_it++) = T.PS(s, i);
+          }
+          else {
+            *(ordered_OS_it++) = 0;
+            *(ordered_PS_it++) = S;
+          }
+        }
+      }
+
+      //Integer path metrics: branch metrics must be small enough for path
+      //metrics to remain comparable
+      if(metric_bits == 8 || metric_bits == 16) {
+        d_metric_bits = metric_bits;
+
+        int depth = trellis_mixing_depth(T.I(), S, T.NS());
+        d_max_metric = max_fixed_branch_metric(d_metric_bits, depth);
+        if(d_max_metric < 1) {
+          throw std::invalid_argument("viterbi_volk_state: trellis too deep for integer path metrics");
+        }
+        d_init_metric = depth*d_max_metric + 1;
+
+        d_fixed_OS = d_ordered_OS;
+        d_fixed_PS = d_ordered_PS;
+        for(size_t i=1 ; i<d_max_size_PS_s ; ++i) {
+          for(int s=0 ; s < S ; ++s) {
+            if(d_fixed_PS[i*S + s] == S) {
+              d_fixed_OS[i*S + s] = d_fixed_OS[s];
+              d_fixed_PS[i*S + s] = d_fixed_PS[s];
+            }
+          }
+        }
+      }
+      else {
+        d_metric_bits = 32;
+      }
+
+      //Split states into slices of 64 states: whole cache lines of path metrics,
+      //and whole words of packed decisions (at least 4 lines per thread)
+      d_acs_threads = std::max(1, std::min(d_acs_threads, S/64));
+
+      if(d_acs_threads > 1) {
+        d_acs_bounds.resize(d_acs_threads + 1);
+        for(int m=0 ; m <= d_acs_threads ; ++m) {
+          d_acs_bounds[m] = ((long)S*m/d_acs_threads) & ~63;
+        }
+        d_acs_bounds[d_acs_threads] = S;
+
+        d_acs_max.resize(2*d_acs_threads);
+        d_acs_team.reset(new thread_team(d_acs_threads));
+      }
+    }
+
+    decoder::workspace_sptr
+    viterbi_volk_state_decoder::make_workspace(size_t K,
+        huge_pages_t huge_pages) const
+    {
+      boost::shared_ptr<workspace> ws(new workspace(huge_pages));
+      carve_workspace(*ws, K, scratch_arena::sptr(
+            new scratch_arena(workspace_bytes(K), huge_pages)));
+
+      return ws;
+    }
+
+    size_t
+    viterbi_volk_state_decoder::workspace_bytes(size_t K) const
+    {
+      const int S = d_trellis->S();
+      const int O = d_trellis->O();
+      size_t bytes = 2*scratch_arena::bytes<float>(S + 1)
+        + scratch_arena::bytes<float>(d_max_size_PS_s*S)
+        + scratch_arena::bytes<uint16_t>(S)
+        + scratch_arena::bytes<uint64_t>(
+            survivor_store::words(K, S, d_max_size_PS_s));
+
+      if(d_metric_bits == 16) {
+        bytes += scratch_arena::bytes<uint16_t>(K*O)
+          + 3*scratch_arena::bytes<uint16_t>(S);
+      }
+      else if(d_metric_bits == 8) {
+        bytes += scratch_arena::bytes<uint8_t>(K*O)
+          + 3*scratch_arena::bytes<uint8_t>(S);
+      }
+
+      return bytes;
+    }
+
+    template <typename T>
+    void
+    viterbi_volk_state_decoder::carve_fixed(fixed_buffers<T> &fb, size_t K,
+        scratch_arena &arena) const
+    {
+      const int S = d_trellis->S();
+
+      fb.metrics = arena.alloc<T>(K*d_trellis->O());
+      fb.alpha[0] = arena.alloc<T>(S);
+      fb.alpha[1] = arena.alloc<T>(S);
+      fb.can_metrics = arena.alloc<T>(S);
+    }
+
+    void
+    viterbi_volk_state_decoder::carve_workspace(workspace &ws, size_t K,
+        const scratch_arena::sptr &arena) const
+    {
+      const int S = d_trellis->S();
+
+      ws.arena = arena;
+
+      //Path metrics of states 0 to S-1, and of the sentinel state S
+      ws.alpha_curr = arena->alloc<float>(S + 1);
+      ws.alpha_curr[S] = -std::numeric_limits<float>::infinity();
+      ws.alpha_prev = arena->alloc<float>(S + 1);
+      ws.alpha_prev[S] = -std::numeric_limits<float>::infinity();
+
+      ws.can_metrics = arena->alloc<float>(d_max_size_PS_s*S);
+      ws.decisions = arena->alloc<uint16_t>(S);
+      ws.trace = survivor_store(K, S, d_max_size_PS_s, arena->alloc<uint64_t>(
+            survivor_store::words(K, S, d_max_size_PS_s)));
+
+      if(d_metric_bits == 16) {
+        carve_fixed(ws.fixed16, K, *arena);
+      }
+      else if(d_metric_bits == 8) {
+        carve_fixed(ws.fixed8, K, *arena);
+      }
+
+      ws.K = K;
+    }
+
+    void
+    viterbi_volk_state_decoder::decode(const float *metrics, size_t K, int S0,
+        int SK, uint8_t *out, decoder::workspace &ws) const
+    {
+      workspace *vws = dynamic_cast<workspace*>(&ws);
+      if(!vws) {
+        throw std::invalid_argument("viterbi_volk_state: workspace made by another decoder");
+      }
+
+      viterbi_algorithm_volk_state(K, S0, SK, metrics, out, *vws);
+    }
+
+    void
+    viterbi_volk_state_decoder::compute_all_metrics(const float *alpha_prev,
+        const float *in_k, float *can_metrics) const
+    {
+      best_gather_kernel().gather_sub(alpha_prev, in_k, d_trellis->O(),
+          &d_ordered_PS[0], &d_ordered_OS[0], can_metrics,
+          d_max_size_PS_s * d_trellis->S());
+    }
+
+    void
+    viterbi_volk_state_decoder::compute_slice_metrics(const float *alpha_prev,
+        const float *in_k, float *can_metrics, int s0, int s1) const
+    {
+      const int S = d_trellis->S();
+
+      //Same as compute_all_metrics(), for states [s0, s1) only
+      for(size_t i=0 ; i < d_max_size_PS_s ; ++i) {
+        best_gather_kernel().gather_sub(alpha_prev, in_k, d_trellis->O(),
+            &d_ordered_PS[i*S + s0], &d_ordered_OS[i*S + s0],
+            can_metrics + i*S + s0, s1 - s0);
+      }
+    }
+
+    //Volk optimized implementation adapted when the number of branch between
+    //pairs of states is inferior to the number of states.
+    void
+    viterbi_volk_state_decoder::viterbi_algorithm_volk_state(int K, int S0,
+        int SK, const float *in, unsigned char *out, workspace &ws) const
+    {
+      const int S = d_trellis->S();
+      const int O = d_trellis->O();
+
+      block_timer timer(ws.stats, K);
+
+      //Blocks whose hard decisions form a path need no search
+      if(try_fast_path(in, K, S0, SK, out, ws)) {
+        return;
+      }
+
+      //Longer blocks than the workspace was made for
+      if(K > ws.K) {
+        carve_workspace(ws, K, scratch_arena::sptr(
+              new scratch_arena(workspace_bytes(K), ws.huge_pages)));
+      }
+
+      if(d_metric_bits == 16) {
+        viterbi_algorithm_fixed(S, K, S0, SK, O, in, out, ws.fixed16, ws);
+        return;
+      }
+      else if(d_metric_bits == 8) {
+        viterbi_algorithm_fixed(S, K, S0, SK, O, in, out, ws.fixed8, ws);
+        return;
+      }
+
+      //Share sections between the threads of the team, if it is not busy
+      //with another block
+      if(d_acs_team) {
+        gr::thread::mutex::scoped_try_lock team_guard(d_acs_lock);
+
+        if(team_guard.owns_lock()) {
+          viterbi_algorithm_volk_state_mt(S, K, S0, SK, O, in, out, ws);
+          return;
+        }
+      }
+
+      int tb_state, pidx;
+      size_t max_idx = 0;
+      int k = 0;
+
+      //If initial state was specified
+      if(S0 != -1) {
+        std::fill(ws.alpha_prev, ws.alpha_prev + S,
+            -std::numeric_limits<float>::max());
+        ws.alpha_prev[S0] = 0.0;
+      }
+      else {
+        std::fill(ws.alpha_prev, ws.alpha_prev + S, 0.0);
+      }
+
+      for(float* in_k=(float*)in ; in_k < (float*)in + K*O ; in_k += O) {
+        //ADD
+        compute_all_metrics(ws.alpha_prev, in_k, ws.can_metrics);
+
+        //COMPARE and SELECT, and find the largest new path metric
+        max_idx = best_acs_kernel().select(ws.can_metrics, S, d_max_size_PS_s,
+            ws.alpha_curr, ws.decisions, S);
+
+        //Pack decisions of this time index
+        ws.trace.pack_row(k++, ws.decisions);
+
+        //At this point, current path metrics becomes previous path metrics
+        std::swap(ws.alpha_prev, ws.alpha_curr);
+
+        //Metrics normalization
+        std::transform(ws.alpha_prev, ws.alpha_prev + S, ws.alpha_prev,
+            std::bind2nd(std::minus<float>(), ws.alpha_prev[max_idx]));
+      }
+
+      //If final state was specified
+      if(SK != -1) {
+        tb_state = SK;
+      }
+      else{
+        //at this point, alpha_prev contains the path metrics of states after time K
+        tb_state = (int)max_idx;
+      }
+
+      //Traceback
+      for(unsigned char* out_k = out+K-1 ; out_k >= out ; --out_k) {
+        //Retrieve previous input index from trace
+        pidx = ws.trace.get(out_k - out, tb_state);
+
+        //Output previous input
+        *out_k = (unsigned char) d_trellis->PI(tb_state, pidx);
+
+        //Update tb_state with the previous state on the shortest path
+        tb_state = d_trellis->PS(tb_state, pidx);
+      }
+    }
+
+    //Same algorithm as above, the states of each section being shared by the
+    //members of d_acs_team. Member m handles states
+    //[d_acs_bounds[m], d_acs_bounds[m+1]), and packs their decisions in its
+    //own words of each row of the trace (slices start on a word boundary).
+    void
+    viterbi_volk_state_decoder::acs_slice(int member, int O, int K, int S0,
+        const float *in, workspace &ws) const
+    {
+      const int S = d_trellis->S();
+      const int s0 = d_acs_bounds[member];
+      const int s1 = d_acs_bounds[member + 1];
+      const int n_states = s1 - s0;
+      const int n_members = d_acs_team->size();
+
+      size_t max_idx = 0;
+      //Largest path metric of the previous section
+      float norm = 0.0;
+
+      //Pointers are swapped by each member
+      float *alpha_prev = ws.alpha_prev;
+      float *alpha_curr = ws.alpha_curr;
+      uint16_t *decisions = &ws.decisions[s0];
+
+      //If initial state was specified
+      if(S0 != -1) {
+        std::fill(alpha_prev + s0, alpha_prev + s1,
+            -std::numeric_limits<float>::max());
+        if(S0 >= s0 && S0 < s1) {
+          alpha_prev[S0] = 0.0;
+        }
+      }
+      else {
+        std::fill(alpha_prev + s0, alpha_prev + s1, 0.0);
+      }
+
+      //Every slice of alpha_prev must be initialized
+      d_acs_team->barrier();
+
+      for(int k=0 ; k < K ; ++k) {
+        const float *in_k = in + k*O;
+
+        //ADD
+        compute_slice_metrics(alpha_prev, in_k, ws.can_metrics, s0, s1);
+
+        //COMPARE and SELECT, and find the largest new path metric of the slice
+        max_idx = best_acs_kernel().select(ws.can_metrics + s0, S,
+            d_max_size_PS_s, alpha_curr + s0, decisions, n_states);
+
+        //Pack decisions of this time index
+        ws.trace.pack_row(k, s0, n_states, decisions);
+
+        //Metrics normalization, by the largest metric of the previous section
+        //(the largest metric of this one is not known yet)
+        std::transform(alpha_curr + s0, alpha_curr + s1, alpha_curr + s0,
+            std::bind2nd(std::minus<float>(), norm));
+
+        //Maxima of even and odd sections are stored apart: a member may store
+        //the maximum of the next section while the others are still reading
+        //those of this section.
+        slice_max *maxima = &d_acs_max[(k & 1)*n_members];
+
+        maxima[member].metric = alpha_curr[s0 + max_idx];
+        maxima[member].state = s0 + max_idx;
+
+        //Wait for the whole section to be computed
+        d_acs_team->barrier();
+
+        norm = maxima[0].metric;
+        for(int m=1 ; m < n_members ; ++m) {
+          norm = std::max(norm, maxima[m].metric);
+        }
+
+        //At this point, current path metrics becomes previous path metrics
+        std::swap(alpha_prev, alpha_curr);
+      }
+    }
+
+    void
+    viterbi_volk_state_decoder::viterbi_algorithm_volk_state_mt(int S, int K,
+        int S0, int SK, int O, const float *in,
+        unsigned char *out, workspace &ws) const
+    {
+      int tb_state, pidx, m;
+
+      d_acs_team->run(boost::bind(&viterbi_volk_state_decoder::acs_slice, this, _1,
+            O, K, S0, in, boost::ref(ws)));
+
+      //If final state was specified
+      if(SK != -1) {
+        tb_state = SK;
+      }
+      else{
+        //Largest path metric after time K (first one in case of a tie)
+        const slice_max *maxima = &d_acs_max[((K - 1) & 1)*d_acs_team->size()];
+
+        m = 0;
+        for(int mm=1 ; mm < d_acs_team->size() ; ++mm) {
+          if(maxima[mm].metric > maxima[m].metric) {
+            m = mm;
+          }
+        }
+        tb_state = maxima[m].state;
+      }
+
+      //Traceback
+      for(int k=K-1 ; k >= 0 ; --k) {
+        //Retrieve previous input index from trace
+        pidx = ws.trace.get(k, tb_state);
+
+        //Output previous input
+        out[k] = (unsigned char) d_trellis->PI(tb_state, pidx);
+
+        //Update tb_state with the previous state on the shortest path
+        tb_state = d_trellis->PS(tb_state, pidx);
+      }
+    }
+
+    static void
+    quantize_block(const float *in, uint8_t *metrics, int K, int O, float scale)
+    {
+      best_quantize_kernel().u8(in, metrics, K, O, scale);
+    }
+
+    static void
+    quantize_block(const float *in, uint16_t *metrics, int K, int O, float scale)
+    {
+      best_quantize_kernel().u16(in, metrics, K, O, scale);
+    }
+
+    //Add-compare-select of states [s0, s1) with integer path metrics. Loops
+    //have no branches, so that the compiler vectorizes them.
+    template <typename T>
+    void
+    viterbi_volk_state_decoder::acs_fixed(const T *metrics_k, const T *alpha_prev,
+        T *alpha_curr, int s0, int s1, fixed_buffers<T> &fb, workspace &ws) const
+    {
+      const int S = d_trellis->S();
+      uint16_t *decisions = ws.decisions;
+      T *can_metrics = fb.can_metrics;
+
+      //Pre-loop
+      const int *ordered_PS_it = &d_fixed_PS[s0];
+      const int *ordered_OS_it = &d_fixed_OS[s0];
+      for(int s=s0 ; s < s1 ; ++s) {
+        alpha_curr[s] = (T)(alpha_prev[*(ordered_PS_it++)] + metrics_k[*(ordered_OS_it++)]);
+        decisions[s] = 0;
+      }
+
+      //Loop
+      for(size_t i=1 ; i < d_max_size_PS_s ; ++i) {
+        ordered_PS_it = &d_fixed_PS[i*S + s0];
+        ordered_OS_it = &d_fixed_OS[i*S + s0];
+
+        //ADD
+        for(int s=s0 ; s < s1 ; ++s) {
+          can_metrics[s] = (T)(alpha_prev[*(ordered_PS_it++)] + metrics_k[*(ordered_OS_it++)]);
+        }
+
+        //COMPARE and SELECT (missing branches are copies of the first one,
+        //and never win)
+        for(int s=s0 ; s < s1 ; ++s) {
+          bool better = modulo_less(can_metrics[s], alpha_curr[s]);
+          alpha_curr[s] = better ? can_metrics[s] : alpha_curr[s];
+          decisions[s] = better ? (uint16_t)i : decisions[s];
+        }
+      }
+    }
+
+    //Sections of a block with integer path metrics, shared by the members of
+    //d_acs_team (see acs_slice()). There is no normalization, hence no
+    //maximum to exchange: members only wait for each other once per section.
+    template <typename T>
+    void
+    viterbi_volk_state_decoder::acs_slice_fixed(int member, int O, int K,
+        fixed_buffers<T> &fb, workspace &ws) const
+    {
+      const int s0 = d_acs_bounds[member];
+      const int s1 = d_acs_bounds[member + 1];
+
+      for(int k=0 ; k < K ; ++k) {
+        acs_fixed(fb.metrics + k*O, fb.alpha[k & 1], fb.alpha[(k + 1) & 1],
+            s0, s1, fb, ws);
+
+        //Pack decisions of this time index
+        ws.trace.pack_row(k, s0, s1 - s0, &ws.decisions[s0]);
+
+        //Wait for the whole section to be computed
+        d_acs_team->barrier();
+      }
+    }
+
+    template <typename T>
+    void
+    viterbi_volk_state_decoder::viterbi_algorithm_fixed(int S, int K, int S0,
+        int SK, int O, const float *in,
+        unsigned char *out, fixed_buffers<T> &fb, workspace &ws) const
+    {
+      int tb_state, pidx;
+
+      //Quantize branch metrics of the whole block at once
+      float scale = estimate_metrics_scale(in, K, O, d_max_metric);
+      quantize_block(in, fb.metrics, K, O, scale);
+      for(T *it = fb.metrics ; it != fb.metrics + K*O ; ++it) {
+        *it = std::min(*it, (T)d_max_metric);
+      }
+
+      //If initial state was specified
+      if(S0 != -1) {
+        std::fill(fb.alpha[0], fb.alpha[0] + S, (T)d_init_metric);
+        fb.alpha[0][S0] = 0;
+      }
+      else {
+        std::fill(fb.alpha[0], fb.alpha[0] + S, 0);
+      }
+
+      //Share sections between the threads of the team, if it is not busy
+      //with another block
+      bool done = false;
+      if(d_acs_team) {
+        gr::thread::mutex::scoped_try_lock team_guard(d_acs_lock);
+
+        if(team_guard.owns_lock()) {
+          d_acs_team->run(boost::bind(&viterbi_volk_state_decoder::acs_slice_fixed<T>,
+                this, _1, O, K, boost::ref(fb), boost::ref(ws)));
+          done = true;
+        }
+      }
+
+      if(!done) {
+        for(int k=0 ; k < K ; ++k) {
+          acs_fixed(fb.metrics + k*O, fb.alpha[k & 1],
+              fb.alpha[(k + 1) & 1], 0, S, fb, ws);
+
+          //Pack decisions of this time index
+          ws.trace.pack_row(k, ws.decisions);
+        }
+      }
+
+      //If final state was specified
+      if(SK != -1) {
+        tb_state = SK;
+      }
+      else{
+        //Smallest path metric after time K
+        const T *alpha = fb.alpha[K & 1];
+
+        tb_state = 0;
+        for(int s=1 ; s < S ; ++s) {
+          if(modulo_less(alpha[s], alpha[tb_state])) {
+            tb_state = s;
+          }
+        }
+      }
+
+      //Traceback
+      for(int k=K-1 ; k >= 0 ; --k) {
+        //Retrieve previous input index from trace
+        pidx = ws.trace.get(k, tb_state);
+
+        //Output previous input
+        out[k] = (unsigned char) d_trellis->PI(tb_state, pidx);
+
+        //Update tb_state with the previous state on the shortest path
+        tb_state = d_trellis->PS(tb_state, pidx);
+      }
+    }
+
+  } /* namespace lazyviterbi */
+} /* namespace gr */
@@ -0,0 +1,175 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2018 Free Software Foundation, Inc.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_LAZYVITERBI_VITERBI_VOLK_STATE_DECODER_H
+#define INCLUDED_LAZYVITERBI_VITERBI_VOLK_STATE_DECODER_H
+
+#include <lazyviterbi/decoder.h>
+#include <gnuradio/thread/thread.h>
+#include <boost/shared_ptr.hpp>
+#include <vector>
+#include "path_metrics.h"
+#include "scratch_arena.h"
+#include "survivor_store.h"
+#include "thread_team.h"
+
+namespace gr {
+  namespace lazyviterbi {
+
+    //Classical Viterbi algorithm, states being processed in parallel
+    //(decoder of the viterbi_volk_state block)
+    class viterbi_volk_state_decoder : public decoder
+    {
+      public:
+        //Buffers of integer path metrics (metric_bits of 8 or 16)
+        template <typename T>
+        struct fixed_buffers
+        {
+          //Quantized branch metrics of the whole block
+          T *metrics;
+          //Path metrics of even and odd sections
+          T *alpha[2];
+          //Candidate metrics of a branch yielding to each state
+          T *can_metrics;
+
+          fixed_buffers() : metrics(NULL), can_metrics(NULL)
+          {
+            alpha[0] = alpha[1] = NULL;
+          }
+        };
+
+        //Scratch buffers of the algorithm
+        struct workspace : public decoder::workspace
+        {
+          //Number of sections the buffers are sized for
+          int K;
+          //Backing of the arena, kept to grow it
+          decoder::huge_pages_t huge_pages;
+          //Memory of the buffers below
+          scratch_arena::sptr arena;
+          //Store current state metrics
+          float *alpha_curr;
+          //Store next state metrics
+          float *alpha_prev;
+          //Store next state candidate metrics
+          float *can_metrics;
+          //Decisions of the current time index, before packing
+          uint16_t *decisions;
+          //Traceback vector
+          survivor_store trace;
+          //Integer path metrics (only those of metric_bits are carved)
+          fixed_buffers<uint8_t> fixed8;
+          fixed_buffers<uint16_t> fixed16;
+
+          workspace(decoder::huge_pages_t huge_pages)
+            : K(0), huge_pages(huge_pages), alpha_curr(NULL),
+            alpha_prev(NULL), can_metrics(NULL), decisions(NULL) {}
+        };
+
+      private:
+        template <typename T>
+        void carve_fixed(fixed_buffers<T> &fb, size_t K,
+            scratch_arena &arena) const;
+
+        //Output symbols of the branches, in branch-major order:
+        //d_ordered_OS[i*S+s] = d_trellis->OS()[d_trellis->offsets()[s] + i]
+        std::vector<int> d_ordered_OS;
+        //Previous states of the branches, in branch-major order:
+        //d_ordered_PS[i*S+s] = d_trellis->PS(s, i)
+        //(S, the sentinel state, if PS[s] has less than i+1 states)
+        std::vector<int> d_ordered_PS;
+        //Max size of PS[s]
+        size_t d_max_size_PS_s;
+
+        //***Integer path metrics with modulo arithmetic***//
+        int d_metric_bits;      //Size of path metrics (32 for floats)
+        int d_max_metric;       //Largest quantized branch metric
+        int d_init_metric;      //Initial path metric of states other than S0
+        //Same as d_ordered_OS and d_ordered_PS, missing branches being
+        //replaced by the first branch yielding to the same state
+        std::vector<int> d_fixed_OS;
+        std::vector<int> d_fixed_PS;
+
+        //***Add-compare-select of each section shared by several threads***//
+        int d_acs_threads;
+        //Team of d_acs_threads threads (none if d_acs_threads == 1), used by
+        //one block at a time
+        boost::shared_ptr<thread_team> d_acs_team;
+        mutable gr::thread::mutex d_acs_lock;
+        //States handled by member m: [d_acs_bounds[m], d_acs_bounds[m+1])
+        std::vector<int> d_acs_bounds;
+        //Largest path metric of the slice of each member, for even and odd
+        //sections (one cache line each)
+        struct slice_max
+        {
+          float metric;
+          int state;
+          char pad[56];
+        };
+        mutable std::vector<slice_max> d_acs_max;
+
+        void acs_slice(int member, int O, int K, int S0, const float *in,
+            workspace &ws) const;
+
+        template <typename T>
+        void acs_fixed(const T *metrics_k, const T *alpha_prev, T *alpha_curr,
+            int s0, int s1, fixed_buffers<T> &fb, workspace &ws) const;
+        template <typename T>
+        void acs_slice_fixed(int member, int O, int K, fixed_buffers<T> &fb,
+            workspace &ws) const;
+        template <typename T>
+        void viterbi_algorithm_fixed(int S, int K, int S0, int SK, int O,
+            const float *in,
+            unsigned char *out, fixed_buffers<T> &fb, workspace &ws) const;
+        void viterbi_algorithm_volk_state_mt(int S, int K, int S0, int SK,
+            int O, const float *in,
+            unsigned char *out, workspace &ws) const;
+
+        void compute_all_metrics(const float *alpha_prev, const float *in_k,
+            float *can_metrics) const;
+        void compute_slice_metrics(const float *alpha_prev, const float *in_k,
+            float *can_metrics, int s0, int s1) const;
+
+      public:
+        viterbi_volk_state_decoder(const compiled_trellis::sptr &trellis,
+            int S0, int SK, int acs_threads=1, int metric_bits=32);
+
+        int acs_threads()  const { return d_acs_threads; }
+        int metric_bits()  const { return d_metric_bits; }
+
+        decoder::workspace_sptr make_workspace(size_t K,
+            huge_pages_t huge_pages=HUGE_PAGES_TRANSPARENT) const;
+        size_t workspace_bytes(size_t K) const;
+
+        //Carve the buffers of ws for K sections from arena
+        void carve_workspace(workspace &ws, size_t K,
+            const scratch_arena::sptr &arena) const;
+
+        void decode(const float *metrics, size_t K, int S0, int SK,
+            uint8_t *out, decoder::workspace &ws) const;
+
+        void viterbi_algorithm_volk_state(int K, int S0, int SK,
+            const float *in, unsigned char *out, workspace &ws) const;
+    };
+
+  } // namespace lazyviterbi
+} // namespace gr
+
+#endif /* INCLUDED_LAZYVITERBI_VITERBI_VOLK_STATE_DECODER_H */
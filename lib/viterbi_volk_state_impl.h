@@ -22,54 +22,58 @@
 #define INCLUDED_LAZYVITERBI_VITERBI_VOLK_STATE_IMPL_H
 
 #include <lazyviterbi/viterbi_volk_state.h>
-#include <volk/volk.h>
+#include <boost/shared_ptr.hpp>
+#include "viterbi_volk_state_decoder.h"
+#include "decode_stats.h"
 
 namespace gr {
   namespace lazyviterbi {
 
     class viterbi_volk_state_impl : public viterbi_volk_state
     {
+      public:
+        typedef viterbi_volk_state_decoder::workspace workspace;
+
       private:
-        gr::trellis::fsm d_FSM; //Trellis description
         int d_K;                //Number of trellis sections
         int d_S0;               //Initial state idx (-1 if unknown)
         int d_SK;               //Final state idx (-1 if unknown)
 
-        //Same as d_FSM.OS(), but re-ordered in the following way:
-        //d_ordered_OS[i*S+s] = d_FSM.OS()[d_FSM.PS()[s][i]*I + d_FSM.PI()[s][i]]
-        std::vector<int> d_ordered_OS;
-        //Same as d_FSM.PS(), but flattened:
-        //d_ordered_PS[i*S+s] = d_FSM.PS()[s][i]
-        std::vector<int> d_ordered_PS;
-        //Input metrics, ordered as d_ordered_in_k[i] = in_k[d_ordered_OS[i]]
-        float *d_ordered_in_k;
-        //Max size of PS[s]
-        size_t d_max_size_PS_s;
-
-        //Store current state metrics
-        float *d_alpha_curr;
-        //Store next state metrics
-        float *d_alpha_prev;
-        //Store next state candidate metrics
-        float *d_can_metrics;
-        //Traceback vector
-        int *d_trace;
-
-      protected:
-        void compute_all_metrics(const float *alpha_prev, const float *in_k,
-            float *can_metrics);
+        //Decoder of the blocks (shared by the workers of the decode pool)
+        boost::shared_ptr<viterbi_volk_state_decoder> d_decoder;
+
+        std::vector< boost::shared_ptr<workspace> > d_workspaces;
+
+        //Publication of the counters of the workspaces
+        stats_schedule d_stats_schedule;
+
+        void decode_block(const gr_vector_const_void_star &input_items,
+            gr_vector_void_star &output_items, int nblocks, int job, int worker);
 
       public:
-        viterbi_volk_state_impl(const gr::trellis::fsm &FSM, int K, int S0, int SK);
-        ~viterbi_volk_state_impl();
+        viterbi_volk_state_impl(const gr::trellis::fsm &FSM, int K, int S0, int SK,
+            int acs_threads=1, int metric_bits=32);
+        viterbi_volk_state_impl(const compiled_trellis::sptr &trellis, int K,
+            int S0, int SK, int acs_threads=1, int metric_bits=32);
 
-        gr::trellis::fsm FSM() const  { return d_FSM; }
+        gr::trellis::fsm FSM() const  { return d_decoder->trellis()->fsm(); }
         int K()  const { return d_K; }
         int S0()  const { return d_S0; }
         int SK()  const { return d_SK; }
+        int acs_threads()  const { return d_decoder->acs_threads(); }
+        int metric_bits()  const { return d_decoder->metric_bits(); }
+
+        int pool_size() const;
+        pmt::pmt_t stats();
+        double stats_period() const { return d_stats_schedule.period(); }
+        bool fast_path() const { return d_decoder->fast_path(); }
 
         void set_S0(int S0);
         void set_SK(int SK);
+        void set_pool_size(int n_threads);
+        void reset_stats();
+        void set_stats_period(double period);
+        void set_fast_path(bool fast_path);
 
         void forecast (int noutput_items, gr_vector_int &ninput_items_required);
 
@@ -80,6 +84,9 @@ namespace gr {
             const std::vector<int> &OS, const std::vector< std::vector<int> > &PS,
             const std::vector< std::vector<int> > &PI, int K, int S0, int SK,
             const float *in, unsigned char *out);
+
+        //Scratch buffers of a worker of the decode pool
+        workspace &get_workspace(int worker);
     };
 
   } // namespace lazyviterbi
@@ -0,0 +1,134 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+# 
+# Copyright 2017 Free Software Foundation, Inc.
+# 
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+# 
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+# 
+
+
+import os
+import random
+import shutil
+import tempfile
+from gnuradio import gr, gr_unittest
+from gnuradio import analog, blocks, digital, trellis
+import lazyviterbi_swig as lazyviterbi
+
+FSM_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..',
+        'examples', 'fsm')
+
+class qa_auto_viterbi (gr_unittest.TestCase):
+
+    def setUp (self):
+        self.tb = gr.top_block ()
+        self.fsm = trellis.fsm(os.path.join(FSM_DIR, '171_133.fsm'))
+        # BPSK symbols of the 2 bits of each output of the code
+        self.table = [-1, -1, -1, 1, 1, -1, 1, 1]
+        # Cache files of the tests
+        self.dir = tempfile.mkdtemp()
+        self.cache = os.path.join(self.dir, 'autotune')
+
+    def tearDown (self):
+        self.tb = None
+        shutil.rmtree(self.dir)
+
+    def read_cache (self):
+        with open(self.cache) as f:
+            return f.read()
+
+    def test_001_decode (self):
+        # Encode random blocks from state 0, and decode them with the engine
+        # found by auto_viterbi and the classical Viterbi algorithm
+        K = 200
+        nblocks = 20
+        random.seed(1)
+        bits = [random.randint(0, 1) for k in range(K*nblocks)]
+
+        src = blocks.vector_source_b(bits)
+        enc = trellis.encoder_bb(self.fsm, 0, K)
+        mod = digital.chunks_to_symbols_bf(self.table, 2)
+        noise = analog.noise_source_f(analog.GR_GAUSSIAN, 0.3, 1)
+        add = blocks.add_ff()
+        metrics = trellis.metrics_f(self.fsm.O(), 2, self.table,
+                digital.TRELLIS_EUCLIDEAN)
+        dec = lazyviterbi.auto_viterbi(self.fsm, K, 0, -1, 8.0, self.cache)
+        ref = lazyviterbi.viterbi(self.fsm, K, 0, -1)
+        sink = blocks.vector_sink_b()
+        ref_sink = blocks.vector_sink_b()
+
+        self.tb.connect(src, enc, mod, (add, 0))
+        self.tb.connect(noise, (add, 1))
+        self.tb.connect(add, metrics)
+        self.tb.connect(metrics, dec, sink)
+        self.tb.connect(metrics, ref, ref_sink)
+        self.tb.run()
+
+        self.assertIn(dec.engine(), ['viterbi', 'viterbi_volk_branch',
+            'viterbi_volk_state', 'lazy_viterbi'])
+        self.assertEqual(len(ref_sink.data()), K*nblocks)
+        self.assertEqual(tuple(sink.data()), tuple(ref_sink.data()))
+        self.assertEqual(tuple(ref_sink.data()), tuple(bits))
+
+    def test_002_cache (self):
+        # Miss: the decoders are timed, and the result appended to the file
+        dec = lazyviterbi.auto_viterbi(self.fsm, 200, 0, -1, 5.0, self.cache)
+        self.assertFalse(dec.cached())
+        lines = self.read_cache().splitlines()
+        self.assertEqual(len(lines), 1)
+        key, engine = lines[0].rsplit('\t', 1)
+        self.assertEqual(engine, dec.engine())
+        self.assertTrue(key.endswith('\t200\t5.0'))
+
+        # Hit: read from the file, which is left untouched
+        dec = lazyviterbi.auto_viterbi(self.fsm, 200, 0, -1, 5.0, self.cache)
+        self.assertTrue(dec.cached())
+        self.assertEqual(dec.engine(), engine)
+        self.assertEqual(self.read_cache().splitlines(), lines)
+
+        # The last valid line wins, corrupt and truncated lines are ignored
+        with open(self.cache, 'a') as f:
+            f.write('garbage\n')
+            f.write(key + '\tviterbi_volk_branch\n')
+            f.write(key + '\tno_such_engine\n')
+            f.write(key + '\tvit')
+        dec = lazyviterbi.auto_viterbi(self.fsm, 200, 0, -1, 5.0, self.cache)
+        self.assertTrue(dec.cached())
+        self.assertEqual(dec.engine(), 'viterbi_volk_branch')
+
+        # Other block lengths are tuned apart
+        dec = lazyviterbi.auto_viterbi(self.fsm, 300, 0, -1, 5.0, self.cache)
+        self.assertFalse(dec.cached())
+
+    def test_003_no_cache (self):
+        # "none" neither reads nor writes a cache file
+        old_cache_home = os.environ.get('XDG_CACHE_HOME')
+        os.environ['XDG_CACHE_HOME'] = self.dir
+        try:
+            for i in range(2):
+                dec = lazyviterbi.auto_viterbi(self.fsm, 200, 0, -1, 5.0,
+                        'none')
+                self.assertFalse(dec.cached())
+            self.assertEqual(os.listdir(self.dir), [])
+        finally:
+            if old_cache_home is None:
+                del os.environ['XDG_CACHE_HOME']
+            else:
+                os.environ['XDG_CACHE_HOME'] = old_cache_home
+
+
+if __name__ == '__main__':
+    gr_unittest.run(qa_auto_viterbi, "qa_auto_viterbi.xml")
@@ -19,22 +19,81 @@
 # Boston, MA 02110-1301, USA.
 # 
 
+
+import os
+import random
+import pmt
 from gnuradio import gr, gr_unittest
-from gnuradio import blocks
+from gnuradio import analog, blocks, digital, trellis
 import lazyviterbi_swig as lazyviterbi
 
+FSM_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..',
+        'examples', 'fsm')
+
 class qa_dynamic_viterbi (gr_unittest.TestCase):
 
     def setUp (self):
         self.tb = gr.top_block ()
+        self.fsm = trellis.fsm(os.path.join(FSM_DIR, '171_133.fsm'))
+        # BPSK symbols of the 2 bits of each output of the code
+        self.table = [-1, -1, -1, 1, 1, -1, 1, 1]
 
     def tearDown (self):
         self.tb = None
 
-    def test_001_t (self):
-        # set up fg
-        self.tb.run ()
-        # check data
+    def check_blocks (self, dec, K, nblocks):
+        # Encode nblocks blocks of K random bits, each one from state 0, with
+        # a noise amplitude changing every 4 blocks (Q goes through several
+        # bins), and decode them with dec and the classical Viterbi algorithm
+        random.seed(K)
+        bits = [random.randint(0, 1) for k in range(K*nblocks)]
+        ampl = [0.05 + 0.03*((k // (8*K)) % 8) for k in range(2*K*nblocks)]
+
+        src = blocks.vector_source_b(bits)
+        enc = trellis.encoder_bb(self.fsm, 0, K)
+        mod = digital.chunks_to_symbols_bf(self.table, 2)
+        noise = analog.noise_source_f(analog.GR_GAUSSIAN, 1.0, K)
+        scale = blocks.multiply_ff()
+        add = blocks.add_ff()
+        metrics = trellis.metrics_f(self.fsm.O(), 2, self.table,
+                digital.TRELLIS_EUCLIDEAN)
+        ref = lazyviterbi.viterbi(self.fsm, K, 0, -1)
+        sink = blocks.vector_sink_b()
+        ref_sink = blocks.vector_sink_b()
+
+        self.tb.connect(noise, (scale, 0))
+        self.tb.connect(blocks.vector_source_f(ampl), (scale, 1))
+        self.tb.connect(src, enc, mod, (add, 0))
+        self.tb.connect(scale, (add, 1))
+        self.tb.connect(add, metrics)
+        self.tb.connect(metrics, dec, sink)
+        self.tb.connect(metrics, ref, ref_sink)
+        self.tb.run()
+
+        self.assertEqual(len(ref_sink.data()), K*nblocks)
+        self.assertEqual(tuple(sink.data()), tuple(ref_sink.data()))
+        self.assertEqual(tuple(ref_sink.data()), tuple(bits))
+
+        stats = dec.stats()
+        n_lazy = pmt.to_uint64(pmt.dict_ref(stats, pmt.intern('lazy_blocks'),
+            pmt.PMT_NIL))
+        n_viterbi = pmt.to_uint64(pmt.dict_ref(stats,
+            pmt.intern('viterbi_blocks'), pmt.PMT_NIL))
+        self.assertEqual(n_lazy + n_viterbi, nblocks)
+
+        return n_lazy, n_viterbi
+
+    def test_001_threshold (self):
+        dec = lazyviterbi.dynamic_viterbi(self.fsm, 200, 0, -1, 15.0, False)
+        self.check_blocks(dec, 200, 64)
+
+    def test_002_adaptive (self):
+        dec = lazyviterbi.dynamic_viterbi(self.fsm, 200, 0, -1, 15.0, True)
+        self.assertTrue(dec.adaptive())
+        n_lazy, n_viterbi = self.check_blocks(dec, 200, 64)
+        # Both algorithms are measured
+        self.assertGreater(n_lazy, 0)
+        self.assertGreater(n_viterbi, 0)
 
 
 if __name__ == '__main__':
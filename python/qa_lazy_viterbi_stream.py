@@ -0,0 +1,103 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+# 
+# Copyright 2017 Free Software Foundation, Inc.
+# 
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+# 
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+# 
+
+import os
+import random
+from gnuradio import gr, gr_unittest
+from gnuradio import analog, blocks, digital, trellis
+import lazyviterbi_swig as lazyviterbi
+
+FSM_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..',
+        'examples', 'fsm')
+
+class qa_lazy_viterbi_stream (gr_unittest.TestCase):
+
+    def setUp (self):
+        self.tb = gr.top_block ()
+        self.fsm = trellis.fsm(os.path.join(FSM_DIR, '171_133.fsm'))
+        # BPSK symbols of the 2 bits of each output of the code
+        self.table = [-1, -1, -1, 1, 1, -1, 1, 1]
+
+    def tearDown (self):
+        self.tb = None
+
+    def noisy_metrics (self, n, noise_ampl, seed):
+        # Encode n random bits from state 0, return the block computing the
+        # euclidean metrics of the noisy symbols
+        random.seed(seed)
+        self.bits = [random.randint(0, 1) for k in range(n)]
+
+        src = blocks.vector_source_b(self.bits)
+        enc = trellis.encoder_bb(self.fsm, 0)
+        mod = digital.chunks_to_symbols_bf(self.table, 2)
+        noise = analog.noise_source_f(analog.GR_GAUSSIAN, noise_ampl, seed)
+        add = blocks.add_ff()
+        metrics = trellis.metrics_f(self.fsm.O(), 2, self.table,
+                digital.TRELLIS_EUCLIDEAN)
+
+        self.tb.connect(src, enc, mod, (add, 0))
+        self.tb.connect(noise, (add, 1))
+        self.tb.connect(add, metrics)
+
+        return metrics
+
+    def check_stream (self, D, metric_bits, max_noutput_items=0):
+        # Decode a long stream, through many calls of general_work, and the
+        # same stream as a single block with the classical Viterbi algorithm
+        n = 20000
+        metrics = self.noisy_metrics(n, 0.5, 1)
+        stream = lazyviterbi.lazy_viterbi_stream(self.fsm, D, 0, 0.0,
+                metric_bits)
+        ref = lazyviterbi.viterbi(self.fsm, n, 0, -1)
+        stream_sink = blocks.vector_sink_b()
+        ref_sink = blocks.vector_sink_b()
+        if max_noutput_items > 0:
+            stream.set_max_noutput_items(max_noutput_items)
+
+        self.tb.connect(metrics, stream, stream_sink)
+        self.tb.connect(metrics, ref, ref_sink)
+        self.tb.run()
+
+        out = stream_sink.data()
+        ref_out = ref_sink.data()
+
+        # Decisions lag behind the stream by less than 8*(D+1) symbols
+        self.assertEqual(len(ref_out), n)
+        self.assertGreater(len(out), n - 8*(D + 1))
+        self.assertEqual(tuple(out), tuple(ref_out[:len(out)]))
+        self.assertEqual(tuple(ref_out), tuple(self.bits))
+
+        # Shadow nodes left behind by the search have been purged
+        self.assertLessEqual(stream.queued_nodes(),
+                4*(D + 1)*self.fsm.S()*self.fsm.I())
+
+    def test_001_stream_8bits (self):
+        self.check_stream(40, 8)
+
+    def test_002_stream_16bits (self):
+        self.check_stream(40, 16)
+
+    def test_003_small_windows (self):
+        self.check_stream(40, 8, 256)
+
+
+if __name__ == '__main__':
+    gr_unittest.run(qa_lazy_viterbi_stream, "qa_lazy_viterbi_stream.xml")
@@ -0,0 +1,88 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+# 
+# Copyright 2017 Free Software Foundation, Inc.
+# 
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+# 
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+# 
+
+
+import os
+import random
+from gnuradio import gr, gr_unittest
+from gnuradio import analog, blocks, digital, trellis
+import lazyviterbi_swig as lazyviterbi
+
+FSM_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..',
+        'examples', 'fsm')
+
+class qa_viterbi_batch (gr_unittest.TestCase):
+
+    def setUp (self):
+        self.tb = gr.top_block ()
+        self.fsm = trellis.fsm(os.path.join(FSM_DIR, '5_7.fsm'))
+        # BPSK symbols of the 2 bits of each output of the code
+        self.table = [-1, -1, -1, 1, 1, -1, 1, 1]
+
+    def tearDown (self):
+        self.tb = None
+
+    def check_blocks (self, K, nblocks):
+        # Encode nblocks blocks of K random bits, each one from state 0, and
+        # decode them with viterbi_batch and the classical Viterbi algorithm
+        self.tb = gr.top_block()
+        random.seed(nblocks)
+        bits = [random.randint(0, 1) for k in range(K*nblocks)]
+
+        src = blocks.vector_source_b(bits)
+        enc = trellis.encoder_bb(self.fsm, 0, K)
+        mod = digital.chunks_to_symbols_bf(self.table, 2)
+        noise = analog.noise_source_f(analog.GR_GAUSSIAN, 0.3, nblocks)
+        add = blocks.add_ff()
+        head = blocks.head(gr.sizeof_float, 2*K*nblocks)
+        metrics = trellis.metrics_f(self.fsm.O(), 2, self.table,
+                digital.TRELLIS_EUCLIDEAN)
+        dec = lazyviterbi.viterbi_batch(self.fsm, K, 0, -1)
+        ref = lazyviterbi.viterbi(self.fsm, K, 0, -1)
+        sink = blocks.vector_sink_b()
+        ref_sink = blocks.vector_sink_b()
+
+        self.tb.connect(src, enc, mod, (add, 0))
+        self.tb.connect(noise, (add, 1))
+        self.tb.connect(add, head, metrics)
+        self.tb.connect(metrics, dec, sink)
+        self.tb.connect(metrics, ref, ref_sink)
+        self.tb.run()
+
+        self.assertEqual(len(ref_sink.data()), K*nblocks)
+        self.assertEqual(tuple(sink.data()), tuple(ref_sink.data()))
+        self.assertEqual(tuple(ref_sink.data()), tuple(bits))
+
+    def test_001_partial_batches (self):
+        # Fewer blocks than a batch: the last batch is completed with dummy
+        # blocks
+        for nblocks in range(1, 16):
+            self.check_blocks(50, nblocks)
+
+    def test_002_full_batches (self):
+        self.check_blocks(50, 16)
+        self.check_blocks(50, 160)
+        # Full batches, then a partial one
+        self.check_blocks(50, 16*10 + 7)
+
+
+if __name__ == '__main__':
+    gr_unittest.run(qa_viterbi_batch, "qa_viterbi_batch.xml")
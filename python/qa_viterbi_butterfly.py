@@ -0,0 +1,126 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+# 
+# Copyright 2017 Free Software Foundation, Inc.
+# 
+# This is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3, or (at your option)
+# any later version.
+# 
+# This software is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this software; see the file COPYING.  If not, write to
+# the Free Software Foundation, Inc., 51 Franklin Street,
+# Boston, MA 02110-1301, USA.
+# 
+
+
+import os
+import random
+from gnuradio import gr, gr_unittest
+from gnuradio import analog, blocks, digital, trellis
+import lazyviterbi_swig as lazyviterbi
+
+FSM_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..',
+        'examples', 'fsm')
+
+def renumber_states (f, perm):
+    # Same trellis, state s of f being state perm[s] of the result
+    NS = [0]*(f.S()*f.I())
+    OS = [0]*(f.S()*f.I())
+    for s in range(f.S()):
+        for i in range(f.I()):
+            NS[perm[s]*f.I() + i] = perm[f.NS()[s*f.I() + i]]
+            OS[perm[s]*f.I() + i] = f.OS()[s*f.I() + i]
+
+    return trellis.fsm(f.I(), f.S(), f.O(), NS, OS)
+
+def bit_reversed (f):
+    # Shift register trellis whose new bit is the most significant one
+    m = f.S().bit_length() - 1
+    return renumber_states(f, [int(format(s, '0%db' % m)[::-1], 2)
+        for s in range(f.S())])
+
+class qa_viterbi_butterfly (gr_unittest.TestCase):
+
+    def setUp (self):
+        self.tb = gr.top_block ()
+
+    def tearDown (self):
+        self.tb = None
+
+    def check_blocks (self, f, K, nblocks):
+        # Encode nblocks blocks of K random bits, each one from state 0, and
+        # decode them with viterbi_butterfly and the classical Viterbi
+        # algorithm
+        random.seed(K)
+        bits = [random.randint(0, 1) for k in range(K*nblocks)]
+        # BPSK symbols of the bits of each output of the code
+        n = (f.O() - 1).bit_length()
+        table = []
+        for o in range(f.O()):
+            table += [2*((o >> (n - 1 - b)) & 1) - 1 for b in range(n)]
+
+        src = blocks.vector_source_b(bits)
+        enc = trellis.encoder_bb(f, 0, K)
+        mod = digital.chunks_to_symbols_bf(table, n)
+        noise = analog.noise_source_f(analog.GR_GAUSSIAN, 0.3, K)
+        add = blocks.add_ff()
+        head = blocks.head(gr.sizeof_float, K*nblocks*n)
+        metrics = trellis.metrics_f(f.O(), n, table, digital.TRELLIS_EUCLIDEAN)
+        dec = lazyviterbi.viterbi_butterfly(f, K, 0, -1)
+        ref = lazyviterbi.viterbi(f, K, 0, -1)
+        sink = blocks.vector_sink_b()
+        ref_sink = blocks.vector_sink_b()
+
+        self.tb.connect(src, enc, mod, (add, 0))
+        self.tb.connect(noise, (add, 1))
+        self.tb.connect(add, head, metrics)
+        self.tb.connect(metrics, dec, sink)
+        self.tb.connect(metrics, ref, ref_sink)
+        self.tb.run()
+
+        self.assertEqual(len(ref_sink.data()), K*nblocks)
+        self.assertEqual(tuple(sink.data()), tuple(ref_sink.data()))
+        self.assertEqual(tuple(ref_sink.data()), tuple(bits))
+
+    def test_001_codes (self):
+        for name in ['5_7.fsm', '171_133.fsm', '229_159.fsm', 'rsc_15_13.fsm']:
+            self.tb = gr.top_block()
+            self.check_blocks(trellis.fsm(os.path.join(FSM_DIR, name)), 200,
+                    20)
+
+    def test_002_bit_reversed_states (self):
+        f = bit_reversed(trellis.fsm(os.path.join(FSM_DIR, '171_133.fsm')))
+        self.check_blocks(f, 200, 20)
+
+    def test_003_kernel_fallbacks (self):
+        # 4 states (generic kernel only), 16 states (smallest SIMD trellis),
+        # and 32 output symbols (generic kernel only)
+        self.check_blocks(trellis.fsm(1, 2, [0o5, 0o7]), 100, 20)
+        self.tb = gr.top_block()
+        self.check_blocks(trellis.fsm(1, 2, [0o23, 0o35]), 100, 20)
+        self.tb = gr.top_block()
+        self.check_blocks(trellis.fsm(1, 5, [0o23, 0o35, 0o27, 0o31, 0o37]),
+                100, 20)
+
+    def test_004_not_a_butterfly (self):
+        # Swapping two states of a shift register trellis breaks both layouts
+        f = trellis.fsm(os.path.join(FSM_DIR, '171_133.fsm'))
+        perm = list(range(f.S()))
+        perm[1], perm[2] = 2, 1
+        self.assertRaises(ValueError, lazyviterbi.viterbi_butterfly,
+                renumber_states(f, perm), 100, 0, -1)
+        # Inputs of more than one bit
+        f = trellis.fsm(2, 2, [1, 0, 0, 1])
+        self.assertRaises(ValueError, lazyviterbi.viterbi_butterfly, f, 100,
+                0, -1)
+
+
+if __name__ == '__main__':
+    gr_unittest.run(qa_viterbi_butterfly, "qa_viterbi_butterfly.xml")
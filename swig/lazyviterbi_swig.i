@@ -10,19 +10,31 @@
 %{
 #include "lazyviterbi/viterbi.h"
 #include "lazyviterbi/lazy_viterbi.h"
+#include "lazyviterbi/lazy_viterbi_stream.h"
 #include "lazyviterbi/dynamic_viterbi.h"
+#include "lazyviterbi/auto_viterbi.h"
 #include "lazyviterbi/viterbi_volk_branch.h"
 #include "lazyviterbi/viterbi_volk_state.h"
+#include "lazyviterbi/viterbi_butterfly.h"
+#include "lazyviterbi/viterbi_batch.h"
 %}
 
 %include "lazyviterbi/viterbi.h"
 GR_SWIG_BLOCK_MAGIC2(lazyviterbi, viterbi);
 %include "lazyviterbi/lazy_viterbi.h"
 GR_SWIG_BLOCK_MAGIC2(lazyviterbi, lazy_viterbi);
+%include "lazyviterbi/lazy_viterbi_stream.h"
+GR_SWIG_BLOCK_MAGIC2(lazyviterbi, lazy_viterbi_stream);
 %include "lazyviterbi/dynamic_viterbi.h"
 GR_SWIG_BLOCK_MAGIC2(lazyviterbi, dynamic_viterbi);
+%include "lazyviterbi/auto_viterbi.h"
+GR_SWIG_BLOCK_MAGIC2(lazyviterbi, auto_viterbi);
 
 %include "lazyviterbi/viterbi_volk_branch.h"
 GR_SWIG_BLOCK_MAGIC2(lazyviterbi, viterbi_volk_branch);
 %include "lazyviterbi/viterbi_volk_state.h"
 GR_SWIG_BLOCK_MAGIC2(lazyviterbi, viterbi_volk_state);
+%include "lazyviterbi/viterbi_butterfly.h"
+GR_SWIG_BLOCK_MAGIC2(lazyviterbi, viterbi_butterfly);
+%include "lazyviterbi/viterbi_batch.h"
+GR_SWIG_BLOCK_MAGIC2(lazyviterbi, viterbi_batch);